@@ -25,7 +25,9 @@
  * A simple example demonstrating the usage of sp-measure library.
  * It monitors system (and process if pid is specified) resource usage.
  * The data is printed into console with 1 second interval until the
- * program is aborted with ctrl+c.
+ * program is aborted with ctrl+c. The snapshots are taken at fixed
+ * 1 second deadlines, so the time spent taking them does not make
+ * the interval drift.
  *
  * Compile:
  * 1) example in source package
@@ -38,7 +40,6 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
 
 #include <sp_measure.h>
 
@@ -58,6 +59,8 @@ int main(int argc, char* argv[])
 	sp_measure_proc_data_t* proc_data1 = &proc_data[0];
 	sp_measure_proc_data_t* proc_data2 = &proc_data[1];
 
+	sp_measure_schedule_t schedule;
+
 	/* initialize system snapshots */
 	if (sp_measure_init_sys_data(sys_data1, SNAPSHOT_SYS, NULL) < 0) {
 		fprintf(stderr, "Failed to initialize first system snapshot\n");
@@ -76,6 +79,13 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	/* take snapshots at 1 second deadlines, the first one is due immediately */
+	if (sp_measure_init_schedule(&schedule, 1000000000LL) < 0) {
+		fprintf(stderr, "Failed to initialize sampling schedule\n");
+		exit(-1);
+	}
+	sp_measure_schedule_wait(&schedule);
+
 	/* get the initial system snapshot */
 	if (sp_measure_get_sys_data(sys_data1, SNAPSHOT_SYS, NULL) < 0) {
 		fprintf(stderr, "Failed to get system snapshot\n");
@@ -100,6 +110,11 @@ int main(int argc, char* argv[])
 	/* loop until aborted */
 	while (1) {
 		int sys_mem_change, sys_cpu_usage, sys_cpu_avg_freq;
+		/* wait for the next deadline, the missed deadlines are skipped */
+		int missed = sp_measure_schedule_wait(&schedule);
+		if (missed > 0) {
+			fprintf(stderr, "Missed %d sampling deadlines\n", missed);
+		}
 		/* get the next system snapshot */
 		if (sp_measure_get_sys_data(sys_data2, SNAPSHOT_SYS, NULL) < 0) {
 			fprintf(stderr, "Failed to get system snapshot\n");
@@ -137,8 +152,6 @@ int main(int argc, char* argv[])
 		sp_measure_proc_data_t* proc_data_swap = proc_data1;
 		proc_data1 = proc_data2;
 		proc_data2 = proc_data_swap;
-
-		sleep(1);
 	}
 
 	/* releases resources allocated by snapshots.
@@ -31,6 +31,7 @@ rm -rf %{buildroot}
 %files
 %defattr(-,root,root,-)
 %{_libdir}/libspmeasure.so.*
+%{_bindir}/sp-measure-capture
 %doc COPYING README
 
 %post -p /sbin/ldconfig
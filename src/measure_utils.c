@@ -20,7 +20,139 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
  * 02110-1301  USA
  */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
 
-/* virtual file system root support */
-char sp_measure_fs_root[1] = "";
-char* sp_measure_virtual_fs_root = sp_measure_fs_root;
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/* the initial read buffer size, grown when the file does not fit */
+#define READ_BUFFER_SIZE	4096
+
+
+/**
+ * Opens cached file relative to the current file system root.
+ *
+ * @param[in] file   the cached file.
+ * @return           0 for success.
+ */
+static int file_cache_open(
+		file_cache_t* file
+		)
+{
+	char buffer[PATH_MAX];
+	if (file->fd != -1) {
+		close(file->fd);
+		STATS_ADD(syscalls, 1);
+	}
+	snprintf(buffer, sizeof(buffer), "%s%s", file->ctx->fs_root, file->path);
+	file->fd = open(buffer, O_RDONLY);
+	file->root_id = file->ctx->fs_root_id;
+	STATS_ADD(syscalls, 1);
+	if (file->fd == -1) return -1;
+	STATS_ADD(files_opened, 1);
+	return 0;
+}
+
+int file_cache_init(
+		file_cache_t* file,
+		const sp_measure_ctx_t* ctx,
+		const char* path
+		)
+{
+	file->ctx = ctx;
+	file->fd = -1;
+	file->root_id = ctx->fs_root_id;
+	file->path = strdup(path);
+	return file->path ? 0 : -ENOMEM;
+}
+
+void file_cache_free(
+		file_cache_t* file
+		)
+{
+	if (file->fd != -1) {
+		close(file->fd);
+		file->fd = -1;
+	}
+	if (file->path) {
+		free(file->path);
+		file->path = NULL;
+	}
+}
+
+int file_cache_read(
+		file_cache_t* file,
+		read_buffer_t* buffer
+		)
+{
+	int retry;
+	for (retry = 0; retry < 2; retry++) {
+		if (file->fd == -1 || file->root_id != file->ctx->fs_root_id) {
+			if (file_cache_open(file) != 0) return -1;
+		}
+		size_t offset = 0;
+		while (true) {
+			if (buffer->size - offset < 2) {
+				size_t size = buffer->size ? buffer->size * 2 : READ_BUFFER_SIZE;
+				char* data = (char*)realloc(buffer->data, size);
+				if (data == NULL) return -1;
+				buffer->data = data;
+				buffer->size = size;
+			}
+			size_t size = buffer->size - offset - 1;
+			ssize_t n = pread(file->fd, buffer->data + offset, size, offset);
+			STATS_ADD(syscalls, 1);
+			if (n < 0) break;
+			STATS_ADD(bytes_read, n);
+			offset += n;
+			/* /proc and /sys files are read in full unless the buffer is
+			 * too small, so a short read means the end of file */
+			if ((size_t)n < size) {
+				buffer->data[offset] = '\0';
+				return offset;
+			}
+		}
+		/* the file was removed or became stale - reopen it once */
+		if (errno != ESTALE && errno != ENOENT) break;
+		close(file->fd);
+		file->fd = -1;
+		STATS_ADD(syscalls, 1);
+	}
+	return -1;
+}
+
+void read_buffer_free(
+		read_buffer_t* buffer
+		)
+{
+	if (buffer->data) free(buffer->data);
+	buffer->data = NULL;
+	buffer->size = 0;
+}
+
+int64_t clock_read_ns(
+		clockid_t clock
+		)
+{
+	struct timespec ts;
+	if (clock_gettime(clock, &ts) != 0) return ESPMEASURE_UNDEFINED;
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void snapshot_set_name(
+		char* buffer,
+		const char* name
+		)
+{
+	size_t length = strnlen(name, SP_MEASURE_NAME_SIZE - 1);
+	memcpy(buffer, name, length);
+	buffer[length] = '\0';
+}
@@ -23,23 +23,280 @@
 #ifndef MEASURE_UTILS_H
 #define MEASURE_UTILS_H
 
-#define ARRAY_ITEMS(arr) (sizeof(query)/sizeof(query[0]))
+#define ARRAY_ITEMS(arr) (sizeof(arr)/sizeof(arr[0]))
 
 /**
- * Key/value pairs for file parsing.
+ * Reusable file read buffer.
  */
-typedef struct parse_query_t {
-	/* the key to look for */
-	char* key;
-	/* address where value should be written */
-	int* value;
-	/* true if the value was retrieved */
-	bool ok;
-} parse_query_t;
+typedef struct read_buffer_t {
+	/* the buffer data, always zero terminated after a successful read */
+	char* data;
+	/* the allocated buffer size */
+	size_t size;
+} read_buffer_t;
 
+/**
+ * File kept open between snapshots.
+ *
+ * The file is re-read from the beginning with pread() and reopened only
+ * when the file system root changes or the descriptor has gone stale.
+ */
+typedef struct file_cache_t {
+	/* the context providing the file system root */
+	const sp_measure_ctx_t* ctx;
+	/* the file path relative to the file system root */
+	char* path;
+	/* the opened file descriptor, -1 if not opened */
+	int fd;
+	/* the file system root generation the file was opened with */
+	unsigned int root_id;
+} file_cache_t;
+
+
+/* the default context used by the functions without _ctx suffix */
+extern sp_measure_ctx_t sp_measure_default_ctx;
+
+/* the context or the default context if NULL */
+#define CTX_OR_DEFAULT(ctx) ((ctx) ? (ctx) : &sp_measure_default_ctx)
+
+
+/**
+ * Initializes cached file.
+ *
+ * The file is not opened until it's read for the first time.
+ * @param[out] file   the cached file.
+ * @param[in] ctx     the context providing the file system root.
+ * @param[in] path    the file path relative to the file system root.
+ * @return            0 for success.
+ */
+int file_cache_init(
+		file_cache_t* file,
+		const sp_measure_ctx_t* ctx,
+		const char* path
+		);
+
+/**
+ * Closes cached file and releases its resources.
+ *
+ * @param[in] file   the cached file.
+ */
+void file_cache_free(
+		file_cache_t* file
+		);
+
+/**
+ * Reads the whole contents of a cached file.
+ *
+ * The file is opened if necessary and the read buffer is grown
+ * to fit the file contents.
+ * @param[in] file       the cached file.
+ * @param[in,out] buffer the read buffer.
+ * @return               the number of bytes read or -1 on failure.
+ */
+int file_cache_read(
+		file_cache_t* file,
+		read_buffer_t* buffer
+		);
+
+/**
+ * Releases read buffer.
+ *
+ * @param[in] buffer   the read buffer.
+ */
+void read_buffer_free(
+		read_buffer_t* buffer
+		);
+
+/**
+ * Reads the specified clock in nanoseconds.
+ *
+ * @param[in] clock   the clock identifier (CLOCK_MONOTONIC, CLOCK_BOOTTIME ...).
+ * @return            the clock value in nanoseconds or ESPMEASURE_UNDEFINED
+ *                    if the clock is not supported.
+ */
+int64_t clock_read_ns(
+		clockid_t clock
+		);
+
+/**
+ * Sets the snapshot name.
+ *
+ * The name is copied into the inline snapshot name buffer of
+ * SP_MEASURE_NAME_SIZE bytes and truncated if necessary.
+ * @param[out] buffer   the snapshot name buffer.
+ * @param[in] name      the new name.
+ */
+void snapshot_set_name(
+		char* buffer,
+		const char* name
+		);
+
+
+/*
+ * Library overhead statistics, see sp_measure_stats.h.
+ */
+
+/* non-zero when the statistics are enabled */
+extern int sp_measure_stats_enabled;
+
+/* the counters of the resource being retrieved by the calling thread,
+ * NULL if the statistics are disabled or no resource is retrieved */
+extern __thread sp_measure_stats_counters_t* sp_measure_stats_current;
+
+/**
+ * Adds value to a counter of the resource being retrieved.
+ *
+ * Only the owning thread updates its counters, so relaxed atomic
+ * accesses (plain loads and stores) are enough.
+ */
+#define STATS_ADD(field, value) \
+	do { \
+		sp_measure_stats_counters_t* stats_ = sp_measure_stats_current; \
+		if (stats_) __atomic_store_n(&stats_->field, \
+				__atomic_load_n(&stats_->field, __ATOMIC_RELAXED) + (value), __ATOMIC_RELAXED); \
+	} while (0)
+
+/**
+ * Snapshot call statistics.
+ */
+typedef struct stats_call_t {
+	/* the calling thread resource counters, NULL when the statistics are disabled */
+	sp_measure_stats_counters_t* resources;
+	/* the calling thread snapshot totals */
+	sp_measure_stats_counters_t* total;
+	/* the resource being retrieved */
+	int resource;
+	/* the resources retrieved during the call */
+	unsigned int used;
+	/* the call start times */
+	int64_t start_ns;
+	int64_t cpu_start_ns;
+	/* the last monotonic time read, the call start or the end of the
+	 * previous resource, used as the start time of the next resource */
+	int64_t mark_ns;
+	/* the wall time of the retrieved resources, summed up if a resource
+	 * is retrieved several times during the call */
+	int64_t wall_ns[SP_MEASURE_STATS_SYS_RESOURCES];
+} stats_call_t;
+
+/**
+ * Starts statistics of a snapshot call.
+ *
+ * @param[out] call   the call statistics.
+ * @param[in] proc    true for process snapshot, false for system snapshot.
+ */
+void stats_call_begin(
+		stats_call_t* call,
+		bool proc
+		);
+
+/**
+ * Finishes the call statistics.
+ *
+ * The call cpu time is split between the retrieved resources by their
+ * wall times. The call wall time ends with the last retrieved resource,
+ * so only the thread cpu time is read here.
+ * @param[in] call    the call statistics.
+ */
+void stats_call_end(
+		stats_call_t* call
+		);
+
+/**
+ * Starts retrieving a resource.
+ *
+ * No clock is read, the resource starts when the call or the previous
+ * resource ended.
+ * @param[in] call       the call statistics.
+ * @param[in] resource   the resource identifier (a single bit).
+ */
+void stats_resource_begin(
+		stats_call_t* call,
+		int resource
+		);
+
+/**
+ * Finishes retrieving a resource.
+ *
+ * @param[in] call     the call statistics.
+ * @param[in] failed   true if the resource retrieval failed.
+ */
+void stats_resource_end(
+		stats_call_t* call,
+		bool failed
+		);
+
+
+/*
+ * Process snapshot internals shared with the process set worker pool.
+ */
+
+/* size of the parse buffer used by process set snapshots */
+#define PROC_SET_BUFFER_SIZE	(64 * 1024)
+
+/**
+ * Retrieves process resource usage snapshot using the specified parse buffer.
+ *
+ * @param[out] data      the process statistics data structure.
+ * @param[in] resources  a flag specifying which process resource statistics
+ *                       should be retrieved
+ * @param[in] buffer     the parse buffer.
+ * @param[in] size       the parse buffer size.
+ * @return               0  - success
+ *                       >0 - only part of the process resource statistics was retrieved.
+ */
+int proc_get_data(
+		sp_measure_proc_data_t* data,
+		int resources,
+		char* buffer,
+		size_t size
+		);
 
-/* root of the /proc file system. */
-extern char sp_measure_fs_root[];
-extern char* sp_measure_virtual_fs_root;
+/**
+ * Marks process set snapshot as failed.
+ *
+ * This function can be called concurrently from several threads.
+ * @param[in] set     the process set.
+ * @param[in] index   the index of the failed process.
+ */
+void proc_set_mark_failed(
+		sp_measure_proc_set_t* set,
+		int index
+		);
+
+/**
+ * Creates process set worker pool.
+ *
+ * @param[in] count   the number of workers including the calling thread.
+ * @return            the worker pool or NULL on failure.
+ */
+struct sp_measure_proc_workers_t* proc_workers_create(
+		int count
+		);
+
+/**
+ * Stops the worker threads and frees the worker pool.
+ *
+ * @param[in] pool    the worker pool.
+ */
+void proc_workers_free(
+		struct sp_measure_proc_workers_t* pool
+		);
+
+/**
+ * Retrieves resource usage snapshots of the process set in parallel.
+ *
+ * The calling thread participates as the first worker.
+ * @param[in] pool       the worker pool.
+ * @param[in,out] set    the process set.
+ * @param[in] resources  a flag specifying which process resource statistics
+ *                       should be retrieved
+ * @return               the number of processes which statistics retrieval failed.
+ */
+int proc_workers_run(
+		struct sp_measure_proc_workers_t* pool,
+		sp_measure_proc_set_t* set,
+		int resources
+		);
 
 #endif
@@ -24,6 +24,8 @@
 #define SP_MEASURE_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
 
 /**
  * System resource identifiers and their generic groupings.
@@ -37,8 +39,12 @@ typedef enum {
 	SNAPSHOT_SYS_CPU_USAGE       = 1 << 5,
 	SNAPSHOT_SYS_CPU_FREQ        = 1 << 6,
 	SNAPSHOT_SYS_MEM_CGROUPS     = 1 << 7,
+	SNAPSHOT_SYS_CPU_CORE_USAGE  = 1 << 8,
+	SNAPSHOT_SYS_CPU_POLICY_FREQ = 1 << 9,
+	SNAPSHOT_SYS_MEM_DETAILS     = 1 << 10,	/** all /proc/meminfo values, see sp_measure_meminfo_key_t */
 	SNAPSHOT_SYS_MEM             = SNAPSHOT_SYS_MEM_TOTALS | SNAPSHOT_SYS_MEM_USAGE,
-	SNAPSHOT_SYS_CPU             = SNAPSHOT_SYS_CPU_MAX_FREQ | SNAPSHOT_SYS_CPU_USAGE | SNAPSHOT_SYS_CPU_FREQ,
+	SNAPSHOT_SYS_CPU             = SNAPSHOT_SYS_CPU_MAX_FREQ | SNAPSHOT_SYS_CPU_USAGE | SNAPSHOT_SYS_CPU_FREQ |
+	                               SNAPSHOT_SYS_CPU_CORE_USAGE | SNAPSHOT_SYS_CPU_POLICY_FREQ,
 	SNAPSHOT_SYS                 = SNAPSHOT_SYS_TIMESTAMP | SNAPSHOT_SYS_CPU | SNAPSHOT_SYS_MEM
 } sp_measure_sys_resource_t;
 
@@ -49,12 +55,74 @@ typedef enum {
 typedef enum {
 	SNAPSHOT_PROC_MEM_USAGE      = 1 << 0,
 	SNAPSHOT_PROC_CPU_USAGE      = 1 << 1,
+	SNAPSHOT_PROC_MEM_ROLLUP     = 1 << 2,	/** read memory usage from smaps_rollup when available */
+	SNAPSHOT_PROC_TIMESTAMP      = 1 << 3,
+	/* the individual memory fields, SNAPSHOT_PROC_MEM_USAGE retrieves all of them */
+	SNAPSHOT_PROC_MEM_SIZE           = 1 << 4,
+	SNAPSHOT_PROC_MEM_RSS            = 1 << 5,
+	SNAPSHOT_PROC_MEM_PSS            = 1 << 6,
+	SNAPSHOT_PROC_MEM_SHARED_CLEAN   = 1 << 7,
+	SNAPSHOT_PROC_MEM_SHARED_DIRTY   = 1 << 8,
+	SNAPSHOT_PROC_MEM_PRIVATE_CLEAN  = 1 << 9,
+	SNAPSHOT_PROC_MEM_PRIVATE_DIRTY  = 1 << 10,
+	SNAPSHOT_PROC_MEM_REFERENCED     = 1 << 11,
+	SNAPSHOT_PROC_MEM_SWAP           = 1 << 12,
+	SNAPSHOT_PROC_MEM_FIELDS     = SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_PSS |
+	                               SNAPSHOT_PROC_MEM_SHARED_CLEAN | SNAPSHOT_PROC_MEM_SHARED_DIRTY |
+	                               SNAPSHOT_PROC_MEM_PRIVATE_CLEAN | SNAPSHOT_PROC_MEM_PRIVATE_DIRTY |
+	                               SNAPSHOT_PROC_MEM_REFERENCED | SNAPSHOT_PROC_MEM_SWAP,
+	/* the fields required by sp_measure_diff_proc_mem_private_dirty() */
+	SNAPSHOT_PROC_MEM_PRIV_DIRTY_SUM = SNAPSHOT_PROC_MEM_PRIVATE_DIRTY | SNAPSHOT_PROC_MEM_SWAP,
 	SNAPSHOT_PROC_MEM            = SNAPSHOT_PROC_MEM_USAGE,
 	SNAPSHOT_PROC_CPU            = SNAPSHOT_PROC_CPU_USAGE,
-	SNAPSHOT_PROC                = SNAPSHOT_PROC_MEM | SNAPSHOT_PROC_CPU
+	SNAPSHOT_PROC                = SNAPSHOT_PROC_TIMESTAMP | SNAPSHOT_PROC_MEM | SNAPSHOT_PROC_CPU
 } sp_measure_proc_resource_t;
 
 
+/**
+ * System memory statistics (/proc/meminfo) keys.
+ *
+ * Used as index of the mem_details array of system snapshots.
+ */
+typedef enum {
+	MEMINFO_MEM_TOTAL,           /** MemTotal */
+	MEMINFO_MEM_FREE,            /** MemFree */
+	MEMINFO_MEM_AVAILABLE,       /** MemAvailable */
+	MEMINFO_BUFFERS,             /** Buffers */
+	MEMINFO_CACHED,              /** Cached */
+	MEMINFO_SWAP_CACHED,         /** SwapCached */
+	MEMINFO_ACTIVE,              /** Active */
+	MEMINFO_INACTIVE,            /** Inactive */
+	MEMINFO_ACTIVE_ANON,         /** Active(anon) */
+	MEMINFO_INACTIVE_ANON,       /** Inactive(anon) */
+	MEMINFO_ACTIVE_FILE,         /** Active(file) */
+	MEMINFO_INACTIVE_FILE,       /** Inactive(file) */
+	MEMINFO_UNEVICTABLE,         /** Unevictable */
+	MEMINFO_MLOCKED,             /** Mlocked */
+	MEMINFO_SWAP_TOTAL,          /** SwapTotal */
+	MEMINFO_SWAP_FREE,           /** SwapFree */
+	MEMINFO_DIRTY,               /** Dirty */
+	MEMINFO_WRITEBACK,           /** Writeback */
+	MEMINFO_ANON_PAGES,          /** AnonPages */
+	MEMINFO_MAPPED,              /** Mapped */
+	MEMINFO_SHMEM,               /** Shmem */
+	MEMINFO_SLAB,                /** Slab */
+	MEMINFO_SRECLAIMABLE,        /** SReclaimable */
+	MEMINFO_SUNRECLAIM,          /** SUnreclaim */
+	MEMINFO_KERNEL_STACK,        /** KernelStack */
+	MEMINFO_PAGE_TABLES,         /** PageTables */
+	MEMINFO_COMMIT_LIMIT,        /** CommitLimit */
+	MEMINFO_COMMITTED_AS,        /** Committed_AS */
+	MEMINFO_VMALLOC_USED,        /** VmallocUsed */
+	MEMINFO_ANON_HUGE_PAGES,     /** AnonHugePages */
+	MEMINFO_SHMEM_HUGE_PAGES,    /** ShmemHugePages */
+	MEMINFO_HUGE_PAGES_TOTAL,    /** HugePages_Total */
+	MEMINFO_HUGE_PAGES_FREE,     /** HugePages_Free */
+	MEMINFO_HUGE_PAGE_SIZE,      /** Hugepagesize */
+	MEMINFO_COUNT
+} sp_measure_meminfo_key_t;
+
+
 /**
  * Maemo5 specific - MEM watermark flags.
  */
@@ -65,7 +133,19 @@ typedef enum {
 
 #define ESPMEASURE_UNDEFINED		(-1)
 
+/* the snapshot name buffer size, longer names are truncated */
+#define SP_MEASURE_NAME_SIZE		64
+
+#include <sp_measure_ctx.h>
 #include <sp_measure_system.h>
 #include <sp_measure_process.h>
+#include <sp_measure_history.h>
+#include <sp_measure_record.h>
+#include <sp_measure_stats.h>
+#include <sp_measure_columns.h>
+#include <sp_measure_schedule.h>
+#include <sp_measure_sampler.h>
+#include <sp_measure_notify.h>
+#include <sp_measure_cgroup.h>
 
 #endif
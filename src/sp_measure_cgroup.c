@@ -0,0 +1,589 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/* the cgroup v2 hierarchy root, relative to the file system root */
+#define CGROUP_HIERARCHY_ROOT		"/sys/fs/cgroup"
+
+/* the parse buffer size, enough for memory.stat of current kernels */
+#define CGROUP_BUFFER_SIZE		8192
+
+/*
+ * Private API
+ */
+
+/**
+ * The statistics files of a group.
+ */
+enum {
+	CGROUP_FILE_MEM_CURRENT,
+	CGROUP_FILE_MEM_SWAP_CURRENT,
+	CGROUP_FILE_MEM_STAT,
+	CGROUP_FILE_CPU_STAT,
+	CGROUP_FILE_IO_STAT,
+	CGROUP_FILE_COUNT
+};
+
+/* the statistics file names, indexed by CGROUP_FILE_* */
+static const char* cgroup_file_names[CGROUP_FILE_COUNT] = {
+	"memory.current",
+	"memory.swap.current",
+	"memory.stat",
+	"cpu.stat",
+	"io.stat",
+};
+
+/**
+ * Statistics file key definition.
+ */
+typedef struct cgroup_key_t {
+	/* the key name */
+	const char* name;
+	/* the key name length */
+	int length;
+	/* the value conversion shift (10 for bytes to kB conversion) */
+	int shift;
+} cgroup_key_t;
+
+#define CGROUP_KEY(name, shift)	{name, sizeof(name) - 1, shift}
+
+/* memory.stat keys, indexed by sp_measure_cgroup_mem_stat_t */
+static const cgroup_key_t cgroup_mem_stat_keys[CGROUP_MEM_STAT_COUNT] = {
+	CGROUP_KEY("anon", 10),
+	CGROUP_KEY("file", 10),
+	CGROUP_KEY("kernel", 10),
+	CGROUP_KEY("shmem", 10),
+	CGROUP_KEY("file_mapped", 10),
+	CGROUP_KEY("file_dirty", 10),
+	CGROUP_KEY("file_writeback", 10),
+	CGROUP_KEY("pgfault", 0),
+	CGROUP_KEY("pgmajfault", 0),
+};
+
+/* cpu.stat keys */
+enum {
+	CGROUP_CPU_USAGE_USEC,
+	CGROUP_CPU_USER_USEC,
+	CGROUP_CPU_SYSTEM_USEC,
+	CGROUP_CPU_NR_THROTTLED,
+	CGROUP_CPU_THROTTLED_USEC,
+	CGROUP_CPU_COUNT
+};
+
+static const cgroup_key_t cgroup_cpu_stat_keys[CGROUP_CPU_COUNT] = {
+	CGROUP_KEY("usage_usec", 0),
+	CGROUP_KEY("user_usec", 0),
+	CGROUP_KEY("system_usec", 0),
+	CGROUP_KEY("nr_throttled", 0),
+	CGROUP_KEY("throttled_usec", 0),
+};
+
+/**
+ * Resolved group.
+ */
+typedef struct cgroup_group_t {
+	/* the group directory descriptor, -1 if not resolved */
+	int dirfd;
+	/* the statistics file descriptors, -1 if not opened */
+	int fds[CGROUP_FILE_COUNT];
+} cgroup_group_t;
+
+struct sp_measure_cgroup_files_t {
+	/* the number of sets sharing the files */
+	int ref_count;
+	/* the number of groups */
+	int count;
+	/* the group paths relative to the hierarchy root */
+	char** names;
+	/* the resolved groups */
+	cgroup_group_t* groups;
+	/* the context providing the file system root */
+	const sp_measure_ctx_t* ctx;
+	/* the file system root generation the groups were resolved with */
+	unsigned int root_id;
+	/* the parse buffer */
+	char buffer[CGROUP_BUFFER_SIZE];
+};
+
+/**
+ * Closes the group directory and statistics files, so the group is
+ * resolved again on the next snapshot.
+ *
+ * @param[in] group   the group.
+ */
+static void cgroup_close(
+		cgroup_group_t* group
+		)
+{
+	int i;
+	for (i = 0; i < CGROUP_FILE_COUNT; i++) {
+		if (group->fds[i] != -1) {
+			close(group->fds[i]);
+			group->fds[i] = -1;
+		}
+	}
+	if (group->dirfd != -1) {
+		close(group->dirfd);
+		group->dirfd = -1;
+	}
+}
+
+/**
+ * Releases the shared group files.
+ *
+ * @param[in] files   the group files.
+ */
+static void cgroup_files_free(
+		struct sp_measure_cgroup_files_t* files
+		)
+{
+	int i;
+	for (i = 0; i < files->count; i++) {
+		if (files->groups) cgroup_close(&files->groups[i]);
+		if (files->names[i]) free(files->names[i]);
+	}
+	if (files->groups) free(files->groups);
+	free(files->names);
+	free(files);
+}
+
+/**
+ * Reads the group statistics file into the parse buffer.
+ *
+ * The group directory is resolved and the file opened if necessary.
+ * A removed group is closed, so it's resolved again if it's recreated.
+ * @param[in] files   the group files.
+ * @param[in] index   the group index.
+ * @param[in] file    the statistics file (CGROUP_FILE_*).
+ * @return            the zero terminated file contents or NULL if the
+ *                    file could not be read.
+ */
+static const char* cgroup_read_file(
+		struct sp_measure_cgroup_files_t* files,
+		int index,
+		int file
+		)
+{
+	cgroup_group_t* group = &files->groups[index];
+	char* buffer = files->buffer;
+	size_t offset = 0;
+	ssize_t n;
+
+	if (group->dirfd == -1) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s" CGROUP_HIERARCHY_ROOT "/%s", files->ctx->fs_root, files->names[index]);
+		group->dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		STATS_ADD(syscalls, 1);
+		if (group->dirfd == -1) return NULL;
+	}
+	if (group->fds[file] == -1) {
+		group->fds[file] = openat(group->dirfd, cgroup_file_names[file], O_RDONLY | O_CLOEXEC);
+		STATS_ADD(syscalls, 1);
+		if (group->fds[file] == -1) {
+			struct stat st;
+			/* the directory of a removed group has no links left */
+			if (fstat(group->dirfd, &st) != 0 || st.st_nlink == 0) cgroup_close(group);
+			return NULL;
+		}
+		STATS_ADD(files_opened, 1);
+	}
+	/* the files are regenerated when read from the beginning */
+	while (offset < CGROUP_BUFFER_SIZE - 1 &&
+			(n = pread(group->fds[file], buffer + offset, CGROUP_BUFFER_SIZE - 1 - offset, offset)) != 0) {
+		STATS_ADD(syscalls, 1);
+		if (n < 0) {
+			/* reading files of a removed group fails with ENODEV */
+			cgroup_close(group);
+			return NULL;
+		}
+		STATS_ADD(bytes_read, n);
+		offset += n;
+	}
+	buffer[offset] = '\0';
+	return buffer;
+}
+
+/**
+ * Reads the single value group statistics file.
+ *
+ * @param[in] files   the group files.
+ * @param[in] index   the group index.
+ * @param[in] file    the statistics file (CGROUP_FILE_*).
+ * @param[out] value  the value converted from bytes to kB.
+ * @return            0 for success.
+ */
+static int cgroup_read_kb(
+		struct sp_measure_cgroup_files_t* files,
+		int index,
+		int file,
+		int64_t* value
+		)
+{
+	const char* buffer = cgroup_read_file(files, index, file);
+	if (buffer == NULL || *buffer < '0' || *buffer > '9') {
+		*value = ESPMEASURE_UNDEFINED;
+		return -1;
+	}
+	*value = strtoll(buffer, NULL, 10) >> 10;
+	return 0;
+}
+
+/**
+ * Parses the flat keyed ("<key> <value>" lines) group statistics file.
+ *
+ * The values of the keys not found in the file are set to ESPMEASURE_UNDEFINED.
+ * @param[in] buffer   the file contents.
+ * @param[in] keys     the keys to parse.
+ * @param[in] count    the number of keys.
+ * @param[out] values  the parsed values, indexed as the keys.
+ */
+static void cgroup_parse_keys(
+		const char* buffer,
+		const cgroup_key_t* keys,
+		int count,
+		int64_t* values
+		)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		values[i] = ESPMEASURE_UNDEFINED;
+	}
+	while (*buffer) {
+		for (i = 0; i < count; i++) {
+			if (!strncmp(buffer, keys[i].name, keys[i].length) && buffer[keys[i].length] == ' ') {
+				values[i] = strtoll(buffer + keys[i].length + 1, NULL, 10) >> keys[i].shift;
+				break;
+			}
+		}
+		buffer = strchr(buffer, '\n');
+		if (buffer == NULL) break;
+		buffer++;
+	}
+}
+
+/**
+ * Parses the nested keyed ("<device> <key>=<value> ...") io.stat file,
+ * summing up the values of all devices.
+ *
+ * @param[in] buffer   the file contents.
+ * @param[out] data    the cgroup snapshot.
+ */
+static void cgroup_parse_io_stat(
+		const char* buffer,
+		sp_measure_cgroup_data_t* data
+		)
+{
+	data->io_rbytes = data->io_wbytes = data->io_rios = data->io_wios = 0;
+	while (*buffer) {
+		const char* eol = strchr(buffer, '\n');
+		if (eol == NULL) eol = buffer + strlen(buffer);
+		/* skip the device number */
+		const char* ptr = memchr(buffer, ' ', eol - buffer);
+		while (ptr && ptr < eol) {
+			ptr++;
+			const char* value_ptr = memchr(ptr, '=', eol - ptr);
+			if (value_ptr == NULL) break;
+			int64_t value = strtoll(value_ptr + 1, NULL, 10);
+			if (!strncmp(ptr, "rbytes=", 7)) data->io_rbytes += value;
+			else if (!strncmp(ptr, "wbytes=", 7)) data->io_wbytes += value;
+			else if (!strncmp(ptr, "rios=", 5)) data->io_rios += value;
+			else if (!strncmp(ptr, "wios=", 5)) data->io_wios += value;
+			ptr = memchr(ptr, ' ', eol - ptr);
+		}
+		if (*eol == '\0') break;
+		buffer = eol + 1;
+	}
+}
+
+/**
+ * Sets all cgroup snapshot values undefined.
+ *
+ * @param[out] data   the cgroup snapshot.
+ */
+static void cgroup_data_clear(
+		sp_measure_cgroup_data_t* data
+		)
+{
+	int64_t* values = (int64_t*)data;
+	size_t i;
+	for (i = 0; i < sizeof(sp_measure_cgroup_data_t) / sizeof(int64_t); i++) {
+		values[i] = ESPMEASURE_UNDEFINED;
+	}
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_cgroup_set(
+		sp_measure_cgroup_set_t* new_set,
+		const char* const* names,
+		int count,
+		const sp_measure_cgroup_set_t* sample_set
+		)
+{
+	return sp_measure_init_cgroup_set_ctx(NULL, new_set, names, count, sample_set);
+}
+
+int sp_measure_init_cgroup_set_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_cgroup_set_t* new_set,
+		const char* const* names,
+		int count,
+		const sp_measure_cgroup_set_t* sample_set
+		)
+{
+	int i, j;
+	memset(new_set, 0, sizeof(sp_measure_cgroup_set_t));
+	if (sample_set) {
+		new_set->files = sample_set->files;
+		new_set->files->ref_count++;
+		count = sample_set->count;
+	}
+	else {
+		if (count < 0 || (count && names == NULL)) return -EINVAL;
+		struct sp_measure_cgroup_files_t* files = (struct sp_measure_cgroup_files_t*)malloc(sizeof(struct sp_measure_cgroup_files_t));
+		if (files == NULL) return -ENOMEM;
+		files->ref_count = 1;
+		files->count = count;
+		files->ctx = CTX_OR_DEFAULT(ctx);
+		files->root_id = files->ctx->fs_root_id;
+		files->names = (char**)calloc(count + 1, sizeof(char*));
+		files->groups = (cgroup_group_t*)malloc(sizeof(cgroup_group_t) * (count + 1));
+		if (files->names == NULL || files->groups == NULL) {
+			files->count = 0;
+			cgroup_files_free(files);
+			return -ENOMEM;
+		}
+		for (i = 0; i < count; i++) {
+			files->groups[i].dirfd = -1;
+			for (j = 0; j < CGROUP_FILE_COUNT; j++) files->groups[i].fds[j] = -1;
+		}
+		for (i = 0; i < count; i++) {
+			files->names[i] = strdup(names[i]);
+			if (files->names[i] == NULL) {
+				cgroup_files_free(files);
+				return -ENOMEM;
+			}
+		}
+		new_set->files = files;
+	}
+	new_set->count = count;
+	new_set->names = new_set->files->names;
+	new_set->data = (sp_measure_cgroup_data_t*)malloc(sizeof(sp_measure_cgroup_data_t) * (count + 1));
+	new_set->failed = (int*)calloc(count + 1, sizeof(int));
+	if (new_set->data == NULL || new_set->failed == NULL) {
+		sp_measure_free_cgroup_set(new_set);
+		return -ENOMEM;
+	}
+	for (i = 0; i < count; i++) {
+		cgroup_data_clear(&new_set->data[i]);
+	}
+	if (sample_set) return 0;
+
+	/* resolve the group directories, the missing groups are
+	 * resolved again on every snapshot */
+	for (i = 0; i < count; i++) {
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%s" CGROUP_HIERARCHY_ROOT "/%s", new_set->files->ctx->fs_root, names[i]);
+		new_set->files->groups[i].dirfd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	return 0;
+}
+
+int sp_measure_free_cgroup_set(
+		sp_measure_cgroup_set_t* set
+		)
+{
+	if (set->files && --set->files->ref_count == 0) cgroup_files_free(set->files);
+	if (set->data) free(set->data);
+	if (set->failed) free(set->failed);
+	memset(set, 0, sizeof(sp_measure_cgroup_set_t));
+	return 0;
+}
+
+int sp_measure_get_cgroup_set_data(
+		sp_measure_cgroup_set_t* set,
+		int resources
+		)
+{
+	struct sp_measure_cgroup_files_t* files = set->files;
+	int64_t values[CGROUP_CPU_COUNT];
+	const char* buffer;
+	int i, nfailed = 0;
+
+	/* the groups are resolved again after the file system root has changed */
+	if (files->root_id != files->ctx->fs_root_id) {
+		for (i = 0; i < files->count; i++) {
+			cgroup_close(&files->groups[i]);
+		}
+		files->root_id = files->ctx->fs_root_id;
+	}
+	for (i = 0; i < set->count; i++) {
+		sp_measure_cgroup_data_t* data = &set->data[i];
+		int failed = 0;
+		if (resources & SNAPSHOT_CGROUP_TIMESTAMP) {
+			data->timestamp_ns = clock_read_ns(CLOCK_MONOTONIC);
+			if (data->timestamp_ns == ESPMEASURE_UNDEFINED) failed |= SNAPSHOT_CGROUP_TIMESTAMP;
+		}
+		if (resources & SNAPSHOT_CGROUP_MEM_USAGE) {
+			if (cgroup_read_kb(files, i, CGROUP_FILE_MEM_CURRENT, &data->mem_current) != 0) {
+				failed |= SNAPSHOT_CGROUP_MEM_USAGE;
+			}
+			/* the swap usage is not available without swap accounting */
+			cgroup_read_kb(files, i, CGROUP_FILE_MEM_SWAP_CURRENT, &data->mem_swap_current);
+		}
+		if (resources & SNAPSHOT_CGROUP_MEM_STAT) {
+			buffer = cgroup_read_file(files, i, CGROUP_FILE_MEM_STAT);
+			cgroup_parse_keys(buffer ? buffer : "", cgroup_mem_stat_keys, CGROUP_MEM_STAT_COUNT, data->mem_stat);
+			if (buffer == NULL) failed |= SNAPSHOT_CGROUP_MEM_STAT;
+		}
+		if (resources & SNAPSHOT_CGROUP_CPU_STAT) {
+			buffer = cgroup_read_file(files, i, CGROUP_FILE_CPU_STAT);
+			cgroup_parse_keys(buffer ? buffer : "", cgroup_cpu_stat_keys, CGROUP_CPU_COUNT, values);
+			data->cpu_usage_usec = values[CGROUP_CPU_USAGE_USEC];
+			data->cpu_user_usec = values[CGROUP_CPU_USER_USEC];
+			data->cpu_system_usec = values[CGROUP_CPU_SYSTEM_USEC];
+			data->cpu_nr_throttled = values[CGROUP_CPU_NR_THROTTLED];
+			data->cpu_throttled_usec = values[CGROUP_CPU_THROTTLED_USEC];
+			if (buffer == NULL || data->cpu_usage_usec == ESPMEASURE_UNDEFINED) failed |= SNAPSHOT_CGROUP_CPU_STAT;
+		}
+		if (resources & SNAPSHOT_CGROUP_IO_STAT) {
+			buffer = cgroup_read_file(files, i, CGROUP_FILE_IO_STAT);
+			if (buffer) {
+				cgroup_parse_io_stat(buffer, data);
+			}
+			else {
+				data->io_rbytes = data->io_wbytes = data->io_rios = data->io_wios = ESPMEASURE_UNDEFINED;
+				failed |= SNAPSHOT_CGROUP_IO_STAT;
+			}
+		}
+		set->failed[i] = failed;
+		if (failed) nfailed++;
+	}
+	return nfailed;
+}
+
+/**
+ * Calculates difference of two defined values.
+ *
+ * @param[in] value1   the first value.
+ * @param[in] value2   the second value.
+ * @param[out] diff    the difference.
+ * @return             0 for success, -EINVAL if either value is undefined.
+ */
+static int cgroup_diff_value(
+		int64_t value1,
+		int64_t value2,
+		int64_t* diff
+		)
+{
+	if (value1 == ESPMEASURE_UNDEFINED || value2 == ESPMEASURE_UNDEFINED) return -EINVAL;
+	*diff = value2 - value1;
+	return 0;
+}
+
+/**
+ * Clamps difference to the range of the reported int values.
+ *
+ * @param[in] value   the difference.
+ * @return            the clamped difference.
+ */
+static int cgroup_clamp_diff(
+		int64_t value
+		)
+{
+	if (value > INT_MAX) return INT_MAX;
+	if (value < INT_MIN) return INT_MIN;
+	return value;
+}
+
+int sp_measure_diff_cgroup_cpu_usage(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		)
+{
+	int64_t usage_usec, elapsed_ns, elapsed_usec, usage;
+	if (cgroup_diff_value(data1->cpu_usage_usec, data2->cpu_usage_usec, &usage_usec) != 0 ||
+			cgroup_diff_value(data1->timestamp_ns, data2->timestamp_ns, &elapsed_ns) != 0 ||
+			elapsed_ns < 1000) {
+		return -EINVAL;
+	}
+	/* the usage is calculated with microsecond precision, dividing before
+	 * multiplying so large cpu times over long intervals can't overflow */
+	elapsed_usec = elapsed_ns / 1000;
+	usage = usage_usec / elapsed_usec;
+	if (usage > INT_MAX / 10000) usage = INT_MAX;
+	else if (usage < INT_MIN / 10000) usage = INT_MIN;
+	else usage = usage * 10000 + usage_usec % elapsed_usec * 10000 / elapsed_usec;
+	*diff = cgroup_clamp_diff(usage);
+	return 0;
+}
+
+int sp_measure_diff_cgroup_mem_current(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		)
+{
+	int64_t value;
+	if (cgroup_diff_value(data1->mem_current, data2->mem_current, &value) != 0) return -EINVAL;
+	*diff = cgroup_clamp_diff(value);
+	return 0;
+}
+
+int sp_measure_diff_cgroup_io_read(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		)
+{
+	int64_t value;
+	if (cgroup_diff_value(data1->io_rbytes, data2->io_rbytes, &value) != 0) return -EINVAL;
+	*diff = cgroup_clamp_diff(value >> 10);
+	return 0;
+}
+
+int sp_measure_diff_cgroup_io_write(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		)
+{
+	int64_t value;
+	if (cgroup_diff_value(data1->io_wbytes, data2->io_wbytes, &value) != 0) return -EINVAL;
+	*diff = cgroup_clamp_diff(value >> 10);
+	return 0;
+}
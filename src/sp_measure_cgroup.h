@@ -0,0 +1,306 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_CGROUP_H
+#define SP_MEASURE_CGROUP_H
+
+/** @file sp_measure_cgroup.h
+ * API for cgroup v2 resource usage snapshots.
+ *
+ * A cgroup set snapshots the resource usage of any number of control
+ * groups of the unified (v2) cgroup hierarchy mounted at /sys/fs/cgroup.
+ * The group directories are resolved once when the set is initialized
+ * and kept open, and the statistics files are opened relative to them
+ * on the first snapshot and then re-read with pread(), so taking a
+ * snapshot does not resolve any paths.
+ *
+ * The groups which did not exist at initialization or have been
+ * removed since are resolved again on the following snapshots.
+ *
+ * The legacy (v1) memory cgroup usage is still available as part of
+ * the system snapshots, see sp_measure_cgroup_select() and
+ * SNAPSHOT_SYS_MEM_CGROUPS.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_cgroup_set_t set1, set2;
+ *    const char* groups[] = {"system.slice", "user.slice"};
+ *    sp_measure_init_cgroup_set(&set1, groups, 2, NULL);
+ *    sp_measure_init_cgroup_set(&set2, NULL, 0, &set1);
+ *    sp_measure_get_cgroup_set_data(&set1, SNAPSHOT_CGROUP);
+ *    sleep(1);
+ *    sp_measure_get_cgroup_set_data(&set2, SNAPSHOT_CGROUP);
+ *    int usage;
+ *    sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &usage);
+ *    printf("system.slice cpu usage: %5.1f%%\n", (float)usage / 100);
+ *    sp_measure_free_cgroup_set(&set2);
+ *    sp_measure_free_cgroup_set(&set1);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cgroup resource identifiers.
+ */
+typedef enum {
+	SNAPSHOT_CGROUP_TIMESTAMP    = 1 << 0,
+	SNAPSHOT_CGROUP_MEM_USAGE    = 1 << 1,	/** memory.current, memory.swap.current */
+	SNAPSHOT_CGROUP_MEM_STAT     = 1 << 2,	/** memory.stat, see sp_measure_cgroup_mem_stat_t */
+	SNAPSHOT_CGROUP_CPU_STAT     = 1 << 3,	/** cpu.stat */
+	SNAPSHOT_CGROUP_IO_STAT      = 1 << 4,	/** io.stat, summed over all devices */
+	SNAPSHOT_CGROUP              = SNAPSHOT_CGROUP_TIMESTAMP | SNAPSHOT_CGROUP_MEM_USAGE |
+	                               SNAPSHOT_CGROUP_MEM_STAT | SNAPSHOT_CGROUP_CPU_STAT |
+	                               SNAPSHOT_CGROUP_IO_STAT
+} sp_measure_cgroup_resource_t;
+
+/**
+ * Cgroup memory statistics (memory.stat) keys.
+ *
+ * Used as index of the mem_stat array of cgroup snapshots. The memory
+ * sizes are in kB, the event counters as reported by kernel.
+ */
+typedef enum {
+	CGROUP_MEM_STAT_ANON,            /** anon */
+	CGROUP_MEM_STAT_FILE,            /** file */
+	CGROUP_MEM_STAT_KERNEL,          /** kernel (Linux 5.18) */
+	CGROUP_MEM_STAT_SHMEM,           /** shmem */
+	CGROUP_MEM_STAT_FILE_MAPPED,     /** file_mapped */
+	CGROUP_MEM_STAT_FILE_DIRTY,      /** file_dirty */
+	CGROUP_MEM_STAT_FILE_WRITEBACK,  /** file_writeback */
+	CGROUP_MEM_STAT_PGFAULT,         /** pgfault */
+	CGROUP_MEM_STAT_PGMAJFAULT,      /** pgmajfault */
+	CGROUP_MEM_STAT_COUNT
+} sp_measure_cgroup_mem_stat_t;
+
+/**
+ * Cgroup resource usage snapshot.
+ *
+ * The values not provided by the kernel are set to ESPMEASURE_UNDEFINED.
+ */
+typedef struct sp_measure_cgroup_data_t {
+	/* the snapshot CLOCK_MONOTONIC timestamp in nanoseconds */
+	int64_t timestamp_ns;
+
+	/* the memory usage in kB (memory.current) */
+	int64_t mem_current;
+	/* the swap usage in kB (memory.swap.current) */
+	int64_t mem_swap_current;
+	/* the memory statistics, indexed by sp_measure_cgroup_mem_stat_t */
+	int64_t mem_stat[CGROUP_MEM_STAT_COUNT];
+
+	/* the total, user and system cpu time in microseconds (cpu.stat) */
+	int64_t cpu_usage_usec;
+	int64_t cpu_user_usec;
+	int64_t cpu_system_usec;
+	/* the number of throttled periods and the total throttled time in
+	 * microseconds, available only with the cpu controller enabled */
+	int64_t cpu_nr_throttled;
+	int64_t cpu_throttled_usec;
+
+	/* the bytes and operations read and written (io.stat) */
+	int64_t io_rbytes;
+	int64_t io_wbytes;
+	int64_t io_rios;
+	int64_t io_wios;
+} sp_measure_cgroup_data_t;
+
+/* the cgroup set resolved group data */
+struct sp_measure_cgroup_files_t;
+
+/**
+ * Cgroup set snapshot.
+ */
+typedef struct sp_measure_cgroup_set_t {
+	/* the number of groups in the set */
+	int count;
+	/* the group paths relative to the cgroup hierarchy root */
+	char** names;
+	/* the group snapshots, data[i] is the snapshot of group names[i] */
+	sp_measure_cgroup_data_t* data;
+	/* the failed resources of every group during the last snapshot,
+	 * see FIELD_CGROUP_SET_FAILED() */
+	int* failed;
+
+	/* the resolved group directories and opened statistics files,
+	 * shared by the sets initialized from the same sample set */
+	struct sp_measure_cgroup_files_t* files;
+} sp_measure_cgroup_set_t;
+
+
+/**
+ * Initializes cgroup set snapshot data structure.
+ *
+ * If sample_set parameter is NULL the group directories are resolved.
+ * Otherwise the groups and their resolved directories are shared with
+ * the sample_set structure, which must not be freed before this set.
+ * Afterwards the set must be freed with sp_measure_free_cgroup_set()
+ * function.
+ * @param[out] new_set     the cgroup set to initialize.
+ * @param[in] names        the group paths relative to the cgroup hierarchy
+ *                         root, for example "system.slice/dbus.service".
+ *                         Empty string is the root group.
+ * @param[in] count        the number of groups.
+ * @param[in] sample_set   the sample set (optional).
+ * @return                 0  - success
+ *                         <0 - unrecoverable error.
+ */
+int sp_measure_init_cgroup_set(
+		sp_measure_cgroup_set_t* new_set,
+		const char* const* names,
+		int count,
+		const sp_measure_cgroup_set_t* sample_set
+		);
+
+/**
+ * Initializes cgroup set snapshot data structure of the specified context.
+ *
+ * See sp_measure_init_cgroup_set() function. The sets initialized from
+ * the sample_set structure use the context of the sample_set structure.
+ * @param[in] ctx          the library context, NULL for the default context.
+ * @param[out] new_set     the cgroup set to initialize.
+ * @param[in] names        the group paths relative to the cgroup hierarchy root.
+ * @param[in] count        the number of groups.
+ * @param[in] sample_set   the sample set (optional).
+ * @return                 0  - success
+ *                         <0 - unrecoverable error.
+ */
+int sp_measure_init_cgroup_set_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_cgroup_set_t* new_set,
+		const char* const* names,
+		int count,
+		const sp_measure_cgroup_set_t* sample_set
+		);
+
+/**
+ * Releases resources allocated by the cgroup set.
+ *
+ * @param[in] set   the cgroup set to free.
+ * @return          0 for success.
+ */
+int sp_measure_free_cgroup_set(
+		sp_measure_cgroup_set_t* set
+		);
+
+/**
+ * Retrieves resource usage snapshots of all groups in the set.
+ *
+ * @param[in] set         the cgroup set.
+ * @param[in] resources   a flag specifying which cgroup resource statistics
+ *                        should be retrieved (see sp_measure_cgroup_resource_t).
+ * @return                >=0 - the number of groups with failed resources,
+ *                              see FIELD_CGROUP_SET_FAILED().
+ *                        <0  - unrecoverable error.
+ */
+int sp_measure_get_cgroup_set_data(
+		sp_measure_cgroup_set_t* set,
+		int resources
+		);
+
+/**
+ * Retrieves cgroup cpu usage during the time slice between two snapshots.
+ *
+ * The cpu usage is measured as (% of one cpu used) * 100, so it can
+ * exceed 100% on multi-core systems. The usage is clamped to the int range.
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the cpu usage.
+ * @return           0 for success.
+ */
+int sp_measure_diff_cgroup_cpu_usage(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		);
+
+/**
+ * Retrieves cgroup memory usage change between two snapshots.
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the memory usage change in kB.
+ * @return           0 for success.
+ */
+int sp_measure_diff_cgroup_mem_current(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		);
+
+/**
+ * Retrieves the amount of data read by cgroup between two snapshots.
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the read data in kB.
+ * @return           0 for success.
+ */
+int sp_measure_diff_cgroup_io_read(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		);
+
+/**
+ * Retrieves the amount of data written by cgroup between two snapshots.
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the written data in kB.
+ * @return           0 for success.
+ */
+int sp_measure_diff_cgroup_io_write(
+		const sp_measure_cgroup_data_t* data1,
+		const sp_measure_cgroup_data_t* data2,
+		int* diff
+		);
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_CGROUP_SET_DATA(set, index)    (&(set)->data[index])
+#define FIELD_CGROUP_SET_FAILED(set, index)  (set)->failed[index]
+#define FIELD_CGROUP_SET_NAME(set, index)    (set)->names[index]
+
+#define FIELD_CGROUP_TIMESTAMP_NS(data)      (data)->timestamp_ns
+#define FIELD_CGROUP_MEM_CURRENT(data)       (data)->mem_current
+#define FIELD_CGROUP_MEM_SWAP_CURRENT(data)  (data)->mem_swap_current
+#define FIELD_CGROUP_MEM_STAT(data, key)     (data)->mem_stat[key]
+#define FIELD_CGROUP_CPU_USAGE_USEC(data)    (data)->cpu_usage_usec
+#define FIELD_CGROUP_CPU_USER_USEC(data)     (data)->cpu_user_usec
+#define FIELD_CGROUP_CPU_SYSTEM_USEC(data)   (data)->cpu_system_usec
+#define FIELD_CGROUP_CPU_NR_THROTTLED(data)  (data)->cpu_nr_throttled
+#define FIELD_CGROUP_CPU_THROTTLED_USEC(data) (data)->cpu_throttled_usec
+#define FIELD_CGROUP_IO_RBYTES(data)         (data)->io_rbytes
+#define FIELD_CGROUP_IO_WBYTES(data)         (data)->io_wbytes
+#define FIELD_CGROUP_IO_RIOS(data)           (data)->io_rios
+#define FIELD_CGROUP_IO_WIOS(data)           (data)->io_wios
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
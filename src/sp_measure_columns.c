@@ -0,0 +1,306 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+#include <stdbool.h>
+
+#include "sp_measure.h"
+
+/*
+ * Private API
+ */
+
+/* the number of column values fitting into the column alignment */
+#define COLUMN_ROW_CHUNK	(SP_MEASURE_COLUMN_ALIGNMENT / sizeof(int64_t))
+
+/**
+ * Converts snapshot field value to column value.
+ *
+ * @param[in] value   the snapshot field value.
+ * @return            the column value.
+ */
+static inline int64_t column_value(
+		int value
+		)
+{
+	return value == ESPMEASURE_UNDEFINED ? SP_MEASURE_COLUMN_UNDEFINED : value;
+}
+
+/**
+ * Checks if the first value ranks higher than the second one.
+ *
+ * Larger values rank higher, equal values are ranked by ascending index.
+ * @param[in] values   the column.
+ * @param[in] index1   the index of the first value.
+ * @param[in] index2   the index of the second value.
+ * @return             true if the first value ranks higher.
+ */
+static inline bool column_ranks_higher(
+		const int64_t* values,
+		int index1,
+		int index2
+		)
+{
+	return values[index1] > values[index2] || (values[index1] == values[index2] && index1 < index2);
+}
+
+/**
+ * Restores the top-k heap order after its root was replaced.
+ *
+ * The heap root is the lowest ranking value, so a new value has to
+ * be compared only with the root.
+ * @param[in] values    the column.
+ * @param[in,out] heap  the heap of column indices.
+ * @param[in] size      the number of indices in the heap.
+ * @param[in] node      the node to sift down.
+ */
+static void column_heap_sift_down(
+		const int64_t* values,
+		int* heap,
+		int size,
+		int node
+		)
+{
+	while (true) {
+		int lowest = node, child = node * 2 + 1;
+		if (child < size && column_ranks_higher(values, heap[lowest], heap[child])) lowest = child;
+		child++;
+		if (child < size && column_ranks_higher(values, heap[lowest], heap[child])) lowest = child;
+		if (lowest == node) break;
+		int index = heap[node];
+		heap[node] = heap[lowest];
+		heap[lowest] = index;
+		node = lowest;
+	}
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_proc_columns(
+		sp_measure_proc_columns_t* columns,
+		int count
+		)
+{
+	void* block;
+	int i, j;
+	memset(columns, 0, sizeof(sp_measure_proc_columns_t));
+	if (count < 0) return -EINVAL;
+
+	/* every column starts at an aligned address */
+	int capacity = count ? (count + COLUMN_ROW_CHUNK - 1) & ~(COLUMN_ROW_CHUNK - 1) : COLUMN_ROW_CHUNK;
+	if (posix_memalign(&block, SP_MEASURE_COLUMN_ALIGNMENT, sizeof(int64_t) * capacity * PROC_COLUMN_COUNT) != 0) {
+		return -ENOMEM;
+	}
+	columns->count = count;
+	columns->capacity = capacity;
+	for (i = 0; i < PROC_COLUMN_COUNT; i++) {
+		columns->columns[i] = (int64_t*)block + i * capacity;
+		for (j = 0; j < capacity; j++) {
+			columns->columns[i][j] = SP_MEASURE_COLUMN_UNDEFINED;
+		}
+	}
+	return 0;
+}
+
+int sp_measure_free_proc_columns(
+		sp_measure_proc_columns_t* columns
+		)
+{
+	if (columns->columns[0]) free(columns->columns[0]);
+	memset(columns, 0, sizeof(sp_measure_proc_columns_t));
+	return 0;
+}
+
+int sp_measure_get_proc_columns(
+		sp_measure_proc_columns_t* columns,
+		const sp_measure_proc_set_t* set
+		)
+{
+	int64_t** col = columns->columns;
+	int i, j;
+	if (set->count != columns->count) return -EINVAL;
+
+	for (i = 0; i < set->count; i++) {
+		const sp_measure_proc_data_t* data = FIELD_PROC_SET_DATA(set, i);
+		col[PROC_COLUMN_PID][i] = set->pids[i];
+		if (FIELD_PROC_SET_FAILED(set, i)) {
+			for (j = PROC_COLUMN_PID + 1; j < PROC_COLUMN_COUNT; j++) {
+				col[j][i] = SP_MEASURE_COLUMN_UNDEFINED;
+			}
+			continue;
+		}
+		col[PROC_COLUMN_TIMESTAMP_NS][i] = data->timestamp_ns > 0 ? data->timestamp_ns : SP_MEASURE_COLUMN_UNDEFINED;
+		col[PROC_COLUMN_CPU_UTIME][i] = column_value(data->cpu_utime);
+		col[PROC_COLUMN_CPU_STIME][i] = column_value(data->cpu_stime);
+		col[PROC_COLUMN_CPU_TICKS][i] = data->cpu_utime == ESPMEASURE_UNDEFINED || data->cpu_stime == ESPMEASURE_UNDEFINED ?
+				SP_MEASURE_COLUMN_UNDEFINED : (int64_t)data->cpu_utime + data->cpu_stime;
+		col[PROC_COLUMN_MEM_SIZE][i] = column_value(data->mem_size);
+		col[PROC_COLUMN_MEM_RSS][i] = column_value(data->mem_rss);
+		col[PROC_COLUMN_MEM_PSS][i] = column_value(data->mem_pss);
+		col[PROC_COLUMN_MEM_SHARED_CLEAN][i] = column_value(data->mem_shared_clean);
+		col[PROC_COLUMN_MEM_SHARED_DIRTY][i] = column_value(data->mem_shared_dirty);
+		col[PROC_COLUMN_MEM_PRIVATE_CLEAN][i] = column_value(data->mem_private_clean);
+		col[PROC_COLUMN_MEM_PRIVATE_DIRTY][i] = column_value(data->mem_private_dirty);
+		col[PROC_COLUMN_MEM_SWAP][i] = column_value(data->mem_swap);
+		col[PROC_COLUMN_MEM_REFERENCED][i] = column_value(data->mem_referenced);
+	}
+	return 0;
+}
+
+int sp_measure_diff_proc_columns(
+		const sp_measure_proc_columns_t* columns1,
+		const sp_measure_proc_columns_t* columns2,
+		int column,
+		int64_t* diff
+		)
+{
+	if (column < 0 || column >= PROC_COLUMN_COUNT || columns1->count != columns2->count) {
+		return -EINVAL;
+	}
+	if (memcmp(columns1->columns[PROC_COLUMN_PID], columns2->columns[PROC_COLUMN_PID],
+			sizeof(int64_t) * columns1->count) != 0) {
+		return -EINVAL;
+	}
+	sp_measure_column_diff(columns1->columns[column], columns2->columns[column], diff, columns1->count);
+	return 0;
+}
+
+int64_t* sp_measure_alloc_column(
+		int count
+		)
+{
+	void* values;
+	if (count < 0) return NULL;
+	if (posix_memalign(&values, SP_MEASURE_COLUMN_ALIGNMENT, sizeof(int64_t) * (count ? count : 1)) != 0) {
+		return NULL;
+	}
+	return (int64_t*)values;
+}
+
+void sp_measure_free_column(
+		int64_t* values
+		)
+{
+	free(values);
+}
+
+/*
+ * The column kernels below are written without data dependent branches
+ * in their main loops, so the compiler can vectorize them.
+ */
+
+void sp_measure_column_diff(
+		const int64_t* values1,
+		const int64_t* values2,
+		int64_t* diff,
+		int count
+		)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		int64_t value1 = values1[i], value2 = values2[i];
+		diff[i] = (value1 == SP_MEASURE_COLUMN_UNDEFINED) | (value2 == SP_MEASURE_COLUMN_UNDEFINED) ?
+				SP_MEASURE_COLUMN_UNDEFINED : value2 - value1;
+	}
+}
+
+int sp_measure_column_sum(
+		const int64_t* values,
+		int count,
+		int64_t* sum
+		)
+{
+	int64_t total = 0;
+	int i, defined = 0;
+	for (i = 0; i < count; i++) {
+		int64_t value = values[i];
+		int valid = value != SP_MEASURE_COLUMN_UNDEFINED;
+		total += valid ? value : 0;
+		defined += valid;
+	}
+	*sum = total;
+	return defined;
+}
+
+int sp_measure_column_max(
+		const int64_t* values,
+		int count
+		)
+{
+	/* the undefined value is the smallest int64_t value, so it never
+	 * wins over a defined value */
+	int64_t max = SP_MEASURE_COLUMN_UNDEFINED;
+	int i;
+	for (i = 0; i < count; i++) {
+		max = values[i] > max ? values[i] : max;
+	}
+	if (max == SP_MEASURE_COLUMN_UNDEFINED) return -1;
+	for (i = 0; values[i] != max; i++) ;
+	return i;
+}
+
+int sp_measure_column_top(
+		const int64_t* values,
+		int count,
+		int* indices,
+		int k
+		)
+{
+	int i, size = 0;
+	if (k <= 0) return 0;
+
+	/* keep the k highest ranking values in a heap with the lowest
+	 * ranking value at the root. Most values rank lower than the root,
+	 * so the heap is rarely updated. */
+	for (i = 0; i < count; i++) {
+		if (values[i] == SP_MEASURE_COLUMN_UNDEFINED) continue;
+		if (size < k) {
+			int node = size++;
+			indices[node] = i;
+			/* sift up */
+			while (node > 0) {
+				int parent = (node - 1) / 2;
+				if (!column_ranks_higher(values, indices[parent], indices[node])) break;
+				int index = indices[parent];
+				indices[parent] = indices[node];
+				indices[node] = index;
+				node = parent;
+			}
+		}
+		else if (values[i] > values[indices[0]]) {
+			indices[0] = i;
+			column_heap_sift_down(values, indices, size, 0);
+		}
+	}
+	/* sort by descending rank by moving the root to the end */
+	for (i = size - 1; i > 0; i--) {
+		int index = indices[0];
+		indices[0] = indices[i];
+		indices[i] = index;
+		column_heap_sift_down(values, indices, i, 0);
+	}
+	return size;
+}
@@ -0,0 +1,271 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_COLUMNS_H
+#define SP_MEASURE_COLUMNS_H
+
+/** @file sp_measure_columns.h
+ * API for columnar process set snapshots.
+ *
+ * A process set snapshot (see sp_measure_proc_set_t) stores the
+ * statistics of every process in a separate sp_measure_proc_data_t
+ * structure. Comparing thousands of processes field by field is
+ * dominated by the pointer chasing in the comparison functions, so
+ * the statistics can be copied into a columnar snapshot instead. The
+ * columnar snapshot holds one contiguous, cache line aligned int64_t
+ * array per field, row i of every column being the process pids[i]
+ * of the source set. The column kernels (difference, sum, maximum,
+ * top-k) are plain loops over whole columns which the compiler can
+ * vectorize.
+ *
+ * The values which could not be retrieved are set to
+ * SP_MEASURE_COLUMN_UNDEFINED. The kernels skip such values and the
+ * difference of two values is undefined if either of them is undefined.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_proc_set_t set;
+ *    sp_measure_proc_columns_t columns1, columns2;
+ *    int64_t* diff;
+ *    int top[10], i, n;
+ *    sp_measure_init_proc_set(&set, pids, count, 0, NULL);
+ *    sp_measure_init_proc_columns(&columns1, count);
+ *    sp_measure_init_proc_columns(&columns2, count);
+ *    diff = sp_measure_alloc_column(count);
+ *
+ *    sp_measure_get_proc_set_data(&set, SNAPSHOT_PROC_CPU_USAGE);
+ *    sp_measure_get_proc_columns(&columns1, &set);
+ *    sleep(1);
+ *    sp_measure_get_proc_set_data(&set, SNAPSHOT_PROC_CPU_USAGE);
+ *    sp_measure_get_proc_columns(&columns2, &set);
+ *
+ *    // the 10 processes which used the most cpu time during the last second
+ *    sp_measure_diff_proc_columns(&columns1, &columns2, PROC_COLUMN_CPU_TICKS, diff);
+ *    n = sp_measure_column_top(diff, count, top, 10);
+ *    for (i = 0; i < n; i++) printf("%d: %lld ticks\n", set.pids[top[i]], (long long)diff[top[i]]);
+ *
+ *    sp_measure_free_column(diff);
+ *    sp_measure_free_proc_columns(&columns1);
+ *    sp_measure_free_proc_columns(&columns2);
+ *    sp_measure_free_proc_set(&set);
+ * @endcode
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the value of fields which could not be retrieved */
+#define SP_MEASURE_COLUMN_UNDEFINED	INT64_MIN
+
+/* the column arrays are aligned to this many bytes */
+#define SP_MEASURE_COLUMN_ALIGNMENT	64
+
+/**
+ * Process snapshot columns.
+ */
+typedef enum {
+	PROC_COLUMN_PID = 0,             /** process identifier */
+	PROC_COLUMN_TIMESTAMP_NS,        /** CLOCK_MONOTONIC snapshot timestamp */
+	PROC_COLUMN_CPU_TICKS,           /** user + system time ticks */
+	PROC_COLUMN_CPU_UTIME,           /** user time ticks */
+	PROC_COLUMN_CPU_STIME,           /** system time ticks */
+	PROC_COLUMN_MEM_SIZE,            /** memory size */
+	PROC_COLUMN_MEM_RSS,             /** resident memory */
+	PROC_COLUMN_MEM_PSS,             /** proportional set size */
+	PROC_COLUMN_MEM_SHARED_CLEAN,    /** shared clean memory */
+	PROC_COLUMN_MEM_SHARED_DIRTY,    /** shared dirty memory */
+	PROC_COLUMN_MEM_PRIVATE_CLEAN,   /** private clean memory */
+	PROC_COLUMN_MEM_PRIVATE_DIRTY,   /** private dirty memory */
+	PROC_COLUMN_MEM_SWAP,            /** swapped out memory */
+	PROC_COLUMN_MEM_REFERENCED,      /** referenced memory */
+	PROC_COLUMN_COUNT
+} sp_measure_proc_column_t;
+
+/**
+ * Columnar process set snapshot.
+ */
+typedef struct sp_measure_proc_columns_t {
+	/* the number of processes (rows) */
+	int count;
+	/* the number of allocated rows, a multiple of the number of values
+	 * fitting into SP_MEASURE_COLUMN_ALIGNMENT bytes */
+	int capacity;
+	/* the column arrays indexed by sp_measure_proc_column_t, allocated
+	 * from a single memory block */
+	int64_t* columns[PROC_COLUMN_COUNT];
+} sp_measure_proc_columns_t;
+
+
+/**
+ * Initializes columnar process set snapshot.
+ *
+ * Afterwards the snapshot must be freed with sp_measure_free_proc_columns()
+ * function.
+ * @param[out] columns   the columnar snapshot to initialize.
+ * @param[in] count      the number of processes.
+ * @return               0 for success, -EINVAL for invalid process count
+ *                       or -ENOMEM if there is not enough memory.
+ */
+int sp_measure_init_proc_columns(
+		sp_measure_proc_columns_t* columns,
+		int count
+		);
+
+/**
+ * Releases columnar process set snapshot.
+ *
+ * @param[in] columns   the columnar snapshot to free.
+ * @return              0 for success.
+ */
+int sp_measure_free_proc_columns(
+		sp_measure_proc_columns_t* columns
+		);
+
+/**
+ * Copies the latest process set snapshot into columns.
+ *
+ * All fields of the processes marked failed in the process set are set
+ * to SP_MEASURE_COLUMN_UNDEFINED, except their process identifiers.
+ * @param[out] columns   the columnar snapshot.
+ * @param[in] set        the process set.
+ * @return               0 for success, -EINVAL if the number of processes
+ *                       in the set differs from the columnar snapshot.
+ */
+int sp_measure_get_proc_columns(
+		sp_measure_proc_columns_t* columns,
+		const sp_measure_proc_set_t* set
+		);
+
+/**
+ * Calculates the difference of a column between two columnar snapshots.
+ *
+ * The snapshots must be taken from process sets containing the same
+ * processes in the same order, for example from the same set or sets
+ * sharing the sample set.
+ * @param[in] columns1  the first snapshot.
+ * @param[in] columns2  the second snapshot.
+ * @param[in] column    the column to compare (see sp_measure_proc_column_t).
+ * @param[out] diff     the differences, an array of columns1->count items.
+ *                      The difference is SP_MEASURE_COLUMN_UNDEFINED if
+ *                      the value is undefined in either snapshot.
+ * @return              0 for success, -EINVAL if the snapshots don't
+ *                      contain the same processes or the column is invalid.
+ */
+int sp_measure_diff_proc_columns(
+		const sp_measure_proc_columns_t* columns1,
+		const sp_measure_proc_columns_t* columns2,
+		int column,
+		int64_t* diff
+		);
+
+
+/**
+ * Allocates an aligned column array.
+ *
+ * @param[in] count   the number of values.
+ * @return            the column array or NULL if there is not enough memory.
+ *                    The array must be freed with sp_measure_free_column().
+ */
+int64_t* sp_measure_alloc_column(
+		int count
+		);
+
+/**
+ * Releases a column array allocated with sp_measure_alloc_column().
+ *
+ * @param[in] values   the column array.
+ */
+void sp_measure_free_column(
+		int64_t* values
+		);
+
+/**
+ * Calculates the difference of two columns.
+ *
+ * @param[in] values1   the first column.
+ * @param[in] values2   the second column.
+ * @param[out] diff     the differences values2[i] - values1[i]. Can be the
+ *                      same array as one of the input columns.
+ * @param[in] count     the number of values.
+ */
+void sp_measure_column_diff(
+		const int64_t* values1,
+		const int64_t* values2,
+		int64_t* diff,
+		int count
+		);
+
+/**
+ * Calculates the sum of column values.
+ *
+ * @param[in] values   the column.
+ * @param[in] count    the number of values.
+ * @param[out] sum     the sum of the defined values.
+ * @return             the number of defined values.
+ */
+int sp_measure_column_sum(
+		const int64_t* values,
+		int count,
+		int64_t* sum
+		);
+
+/**
+ * Finds the maximum column value.
+ *
+ * @param[in] values   the column.
+ * @param[in] count    the number of values.
+ * @return             the index of the maximum value (the first one if
+ *                     there are several) or -1 if there are no defined
+ *                     values.
+ */
+int sp_measure_column_max(
+		const int64_t* values,
+		int count
+		);
+
+/**
+ * Finds the largest column values.
+ *
+ * @param[in] values    the column.
+ * @param[in] count     the number of values.
+ * @param[out] indices  the indices of the largest values, sorted by
+ *                      descending value. Equal values are sorted by
+ *                      ascending index.
+ * @param[in] k         the maximum number of indices to return.
+ * @return              the number of returned indices - k or less if
+ *                      the column has less defined values.
+ */
+int sp_measure_column_top(
+		const int64_t* values,
+		int count,
+		int* indices,
+		int k
+		);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/* the real file system root */
+static char ctx_real_fs_root[1] = "";
+
+sp_measure_ctx_t sp_measure_default_ctx = {
+	.fs_root = ctx_real_fs_root,
+	.fs_root_id = 0,
+};
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_ctx(
+		sp_measure_ctx_t* ctx
+		)
+{
+	ctx->fs_root = ctx_real_fs_root;
+	ctx->fs_root_id = 0;
+	return 0;
+}
+
+int sp_measure_free_ctx(
+		sp_measure_ctx_t* ctx
+		)
+{
+	if (ctx->fs_root != ctx_real_fs_root) free(ctx->fs_root);
+	ctx->fs_root = ctx_real_fs_root;
+	return 0;
+}
+
+int sp_measure_ctx_set_fs_root(
+		sp_measure_ctx_t* ctx,
+		const char* path
+		)
+{
+	if (ctx == NULL) ctx = &sp_measure_default_ctx;
+	char* root = ctx_real_fs_root;
+	if (path) {
+		root = strdup(path);
+		if (root == NULL) return -ENOMEM;
+	}
+	if (ctx->fs_root != ctx_real_fs_root) free(ctx->fs_root);
+	ctx->fs_root = root;
+	/* invalidate the files opened relative to the previous root */
+	ctx->fs_root_id++;
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+#ifndef SP_MEASURE_CTX_H
+#define SP_MEASURE_CTX_H
+
+/** @file sp_measure_ctx.h
+ * API for independent library contexts.
+ *
+ * The library reads the /proc and /sys files relative to a file system
+ * root, which can be replaced with a captured or generated rootfs. A
+ * context lets different threads sample different roots at the same time.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_ctx_t ctx;
+ *    sp_measure_sys_data_t data;
+ *    sp_measure_init_ctx(&ctx);
+ *    sp_measure_ctx_set_fs_root(&ctx, "./rootfs1");
+ *    sp_measure_init_sys_data_ctx(&ctx, &data, SNAPSHOT_SYS, NULL);
+ *    sp_measure_get_sys_data(&data, SNAPSHOT_SYS, NULL);
+ *    ...
+ *    sp_measure_free_sys_data(&data);
+ *    sp_measure_free_ctx(&ctx);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Library context.
+ *
+ * The context owns the file system root the /proc and /sys files are read
+ * from. Snapshot data structures initialized with a context keep a reference
+ * to it, and their file caches and buffers are private to them, so snapshots
+ * of different contexts can be taken concurrently from different threads
+ * without locking.
+ *
+ * The functions without the _ctx suffix use the default context, which is
+ * configured with sp_measure_set_fs_root() function. The _ctx functions
+ * accept NULL context for the default context too.
+ */
+typedef struct sp_measure_ctx_t {
+	/* the file system root prefix, empty string for the real root */
+	char* fs_root;
+	/* the file system root generation, changed whenever the root is changed */
+	unsigned int fs_root_id;
+} sp_measure_ctx_t;
+
+
+/**
+ * Initializes library context.
+ *
+ * The context reads files from the real file system root. The context must
+ * not be freed before the snapshot data structures initialized with it.
+ * Afterwards the context must be freed with sp_measure_free_ctx() function.
+ * @param[out] ctx   the context to initialize.
+ * @return           0 for success.
+ */
+int sp_measure_init_ctx(
+		sp_measure_ctx_t* ctx
+		);
+
+/**
+ * Releases resources allocated by the library context.
+ *
+ * @param[in] ctx   the context to free.
+ * @return          0 for success.
+ */
+int sp_measure_free_ctx(
+		sp_measure_ctx_t* ctx
+		);
+
+/**
+ * Sets the file system root of the library context.
+ *
+ * See sp_measure_set_fs_root() function. The files kept open by the snapshot
+ * data structures of the context are reopened relative to the new root.
+ * The root must not be changed while a snapshot of the context is being
+ * taken.
+ * @param[in] ctx    the context, NULL for the default context.
+ * @param[in] path   the new file system root. Use NULL to reset it to the
+ *                   real file system root.
+ * @return           0 for success, -ENOMEM if there is not enough memory.
+ */
+int sp_measure_ctx_set_fs_root(
+		sp_measure_ctx_t* ctx,
+		const char* path
+		);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
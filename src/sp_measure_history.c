@@ -0,0 +1,215 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <errno.h>
+
+#include "sp_measure.h"
+
+/*
+ * Private API
+ */
+
+/**
+ * Converts snapshot age to the history slot index.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] age       the snapshot age.
+ * @return              the slot index or -1 if there is no snapshot
+ *                      of the specified age.
+ */
+static int history_slot(
+		const sp_measure_history_t* history,
+		int age
+		)
+{
+	if (age < 0 || age >= history->count) return -1;
+	return (history->head - 1 - age + history->capacity) % history->capacity;
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_history(
+		sp_measure_history_t* history,
+		int capacity,
+		int sys_resources,
+		int pid,
+		int proc_resources
+		)
+{
+	return sp_measure_init_history_ctx(NULL, history, capacity, sys_resources, pid, proc_resources);
+}
+
+int sp_measure_init_history_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_history_t* history,
+		int capacity,
+		int sys_resources,
+		int pid,
+		int proc_resources
+		)
+{
+	int i, rc;
+	memset(history, 0, sizeof(sp_measure_history_t));
+	if (capacity < 1) return -EINVAL;
+
+	/* allocate all snapshot slots from a single block */
+	size_t size = sizeof(sp_measure_sys_data_t) * capacity;
+	if (pid) size += (sizeof(sp_measure_proc_data_t) + sizeof(int)) * capacity;
+	char* arena = (char*)malloc(size);
+	if (arena == NULL) return -ENOMEM;
+	memset(arena, 0, size);
+
+	history->capacity = capacity;
+	history->sys_resources = sys_resources | SNAPSHOT_SYS_TIMESTAMP;
+	history->proc_resources = proc_resources | SNAPSHOT_PROC_TIMESTAMP;
+	history->sys = (sp_measure_sys_data_t*)arena;
+
+	rc = sp_measure_init_sys_data_ctx(ctx, &history->sys[0], history->sys_resources, NULL);
+	if (rc < 0) {
+		free(arena);
+		history->sys = NULL;
+		return rc;
+	}
+	for (i = 1; i < capacity; i++) {
+		sp_measure_init_sys_data(&history->sys[i], 0, &history->sys[0]);
+	}
+
+	if (pid) {
+		history->proc = (sp_measure_proc_data_t*)(arena + sizeof(sp_measure_sys_data_t) * capacity);
+		history->proc_rc = (int*)(history->proc + capacity);
+		int proc_rc = sp_measure_init_proc_data_ctx(ctx, &history->proc[0], pid, history->proc_resources, NULL);
+		if (proc_rc < 0) {
+			history->proc = NULL;
+			sp_measure_free_history(history);
+			return proc_rc;
+		}
+		for (i = 0; i < capacity; i++) {
+			if (i) sp_measure_init_proc_data(&history->proc[i], 0, 0, &history->proc[0]);
+			history->proc_rc[i] = -1;
+		}
+	}
+	return rc;
+}
+
+int sp_measure_free_history(
+		sp_measure_history_t* history
+		)
+{
+	int i;
+	if (history->sys == NULL) return 0;
+	for (i = 0; i < history->capacity; i++) {
+		sp_measure_free_sys_data(&history->sys[i]);
+		if (history->proc) sp_measure_free_proc_data(&history->proc[i]);
+	}
+	/* the process snapshots are allocated from the same block */
+	free(history->sys);
+	memset(history, 0, sizeof(sp_measure_history_t));
+	return 0;
+}
+
+int sp_measure_history_push(
+		sp_measure_history_t* history
+		)
+{
+	int slot = history->head;
+	int rc = sp_measure_get_sys_data(&history->sys[slot], history->sys_resources, NULL);
+	if (rc < 0) return rc;
+	if (history->proc) {
+		history->proc_rc[slot] = sp_measure_get_proc_data(&history->proc[slot], history->proc_resources, NULL);
+	}
+	history->head = (slot + 1) % history->capacity;
+	if (history->count < history->capacity) history->count++;
+	return rc;
+}
+
+sp_measure_sys_data_t* sp_measure_history_sys(
+		const sp_measure_history_t* history,
+		int age
+		)
+{
+	int slot = history_slot(history, age);
+	return slot < 0 ? NULL : &history->sys[slot];
+}
+
+sp_measure_proc_data_t* sp_measure_history_proc(
+		const sp_measure_history_t* history,
+		int age
+		)
+{
+	int slot = history_slot(history, age);
+	if (slot < 0 || history->proc == NULL || history->proc_rc[slot] < 0) return NULL;
+	return &history->proc[slot];
+}
+
+int sp_measure_history_find(
+		const sp_measure_history_t* history,
+		int64_t period
+		)
+{
+	if (history->count == 0) return -EINVAL;
+	int64_t latest = history->sys[history_slot(history, 0)].timestamp_ns;
+	/* the timestamps are monotonic, so binary search for the latest
+	 * snapshot old enough */
+	int low = 0, high = history->count - 1;
+	while (low < high) {
+		int age = (low + high) / 2;
+		if (latest - history->sys[history_slot(history, age)].timestamp_ns >= period) {
+			high = age;
+		}
+		else {
+			low = age + 1;
+		}
+	}
+	return low;
+}
+
+int sp_measure_history_diff_sys(
+		const sp_measure_history_t* history,
+		int age1,
+		int age2,
+		sp_measure_sys_diff_t fn,
+		int* diff
+		)
+{
+	const sp_measure_sys_data_t* data1 = sp_measure_history_sys(history, age1);
+	const sp_measure_sys_data_t* data2 = sp_measure_history_sys(history, age2);
+	if (data1 == NULL || data2 == NULL) return -EINVAL;
+	return fn(data1, data2, diff);
+}
+
+int sp_measure_history_diff_proc(
+		const sp_measure_history_t* history,
+		int age1,
+		int age2,
+		sp_measure_proc_diff_t fn,
+		int* diff
+		)
+{
+	const sp_measure_proc_data_t* data1 = sp_measure_history_proc(history, age1);
+	const sp_measure_proc_data_t* data2 = sp_measure_history_proc(history, age2);
+	if (data1 == NULL || data2 == NULL) return -EINVAL;
+	return fn(data1, data2, diff);
+}
@@ -0,0 +1,267 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_HISTORY_H
+#define SP_MEASURE_HISTORY_H
+
+/** @file sp_measure_history.h
+ * API for fixed size snapshot history.
+ *
+ * The history keeps the last N system (and optionally process) snapshots
+ * in a ring buffer. All snapshot slots are allocated at initialization
+ * from a single memory block and share the same common data, so taking
+ * new snapshots does not allocate memory once every slot has been filled.
+ *
+ * The snapshots are addressed by their age - 0 is the latest snapshot,
+ * 1 the previous one and so on.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_history_t history;
+ *    // keep 10 minutes of system and process 1234 snapshots at 10Hz
+ *    sp_measure_init_history(&history, 6000, SNAPSHOT_SYS, 1234, SNAPSHOT_PROC);
+ *    while (running) {
+ *        sp_measure_history_push(&history);
+ *        // cpu usage during the last 10 seconds
+ *        int age = sp_measure_history_find(&history, 10LL * 1000000000);
+ *        int value;
+ *        sp_measure_history_diff_sys(&history, age, 0, sp_measure_diff_sys_cpu_usage, &value);
+ *        printf("cpu usage: %5.1f%%\n", (float)value / 100);
+ *        usleep(100000);
+ *    }
+ *    sp_measure_free_history(&history);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * System snapshot comparison function, see sp_measure_diff_sys_* functions.
+ */
+typedef int (*sp_measure_sys_diff_t)(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int* diff
+		);
+
+/**
+ * Process snapshot comparison function, see sp_measure_diff_proc_* functions.
+ */
+typedef int (*sp_measure_proc_diff_t)(
+		const sp_measure_proc_data_t* data1,
+		const sp_measure_proc_data_t* data2,
+		int* diff
+		);
+
+/**
+ * Snapshot history.
+ */
+typedef struct sp_measure_history_t {
+	/* the maximum number of snapshots */
+	int capacity;
+	/* the number of stored snapshots */
+	int count;
+	/* the slot for the next snapshot */
+	int head;
+
+	/* the resources retrieved by system snapshots */
+	int sys_resources;
+	/* the resources retrieved by process snapshots */
+	int proc_resources;
+
+	/* the system snapshot slots */
+	sp_measure_sys_data_t* sys;
+	/* the process snapshot slots, NULL if process is not monitored */
+	sp_measure_proc_data_t* proc;
+	/* the process snapshot results, see sp_measure_get_proc_data() */
+	int* proc_rc;
+} sp_measure_history_t;
+
+
+/**
+ * Initializes snapshot history.
+ *
+ * Allocates all snapshot slots and initializes the snapshot common data.
+ * Afterwards the history must be freed with sp_measure_free_history()
+ * function.
+ * @param[out] history      the history to initialize.
+ * @param[in] capacity      the maximum number of stored snapshots.
+ * @param[in] sys_resources a flag specifying which system resource
+ *                          statistics should be retrieved. The timestamp
+ *                          is always retrieved.
+ * @param[in] pid           the monitored process id or 0 if only system
+ *                          snapshots are taken.
+ * @param[in] proc_resources a flag specifying which process resource
+ *                          statistics should be retrieved.
+ * @return                  0  - success
+ *                          >0 - only part of the initial system resource statistics
+ *                               was retrieved (see sp_measure_init_sys_data()).
+ *                          <0 - unrecoverable error.
+ */
+int sp_measure_init_history(
+		sp_measure_history_t* history,
+		int capacity,
+		int sys_resources,
+		int pid,
+		int proc_resources
+		);
+
+/**
+ * Initializes snapshot history of the specified context.
+ *
+ * See sp_measure_init_history() function.
+ * @param[in] ctx           the library context, NULL for the default context.
+ * @param[out] history      the history to initialize.
+ * @param[in] capacity      the maximum number of stored snapshots.
+ * @param[in] sys_resources a flag specifying which system resource
+ *                          statistics should be retrieved.
+ * @param[in] pid           the monitored process id or 0 if only system
+ *                          snapshots are taken.
+ * @param[in] proc_resources a flag specifying which process resource
+ *                          statistics should be retrieved.
+ * @return                  see sp_measure_init_history() function.
+ */
+int sp_measure_init_history_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_history_t* history,
+		int capacity,
+		int sys_resources,
+		int pid,
+		int proc_resources
+		);
+
+/**
+ * Releases snapshot history.
+ *
+ * @param[in] history   the history to free.
+ * @return              0 for success.
+ */
+int sp_measure_free_history(
+		sp_measure_history_t* history
+		);
+
+/**
+ * Takes a new snapshot, overwriting the oldest one if the history is full.
+ *
+ * @param[in] history   the snapshot history.
+ * @return              0  - success
+ *                      >0 - only part of the system resource statistics was
+ *                           retrieved (see sp_measure_get_sys_data()).
+ *                      <0 - unrecoverable error.
+ *                      The process snapshot failures are not reported, instead
+ *                      sp_measure_history_proc() returns NULL for such snapshots.
+ */
+int sp_measure_history_push(
+		sp_measure_history_t* history
+		);
+
+/**
+ * Retrieves system snapshot from history.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] age       the snapshot age, 0 being the latest snapshot.
+ * @return              the system snapshot or NULL if there is no snapshot
+ *                      of the specified age.
+ */
+sp_measure_sys_data_t* sp_measure_history_sys(
+		const sp_measure_history_t* history,
+		int age
+		);
+
+/**
+ * Retrieves process snapshot from history.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] age       the snapshot age, 0 being the latest snapshot.
+ * @return              the process snapshot or NULL if there is no snapshot
+ *                      of the specified age or it has failed.
+ */
+sp_measure_proc_data_t* sp_measure_history_proc(
+		const sp_measure_history_t* history,
+		int age
+		);
+
+/**
+ * Finds the snapshot taken the specified time before the latest snapshot.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] period    the time period in nanoseconds.
+ * @return              the age of the latest snapshot taken at least period
+ *                      nanoseconds before the latest snapshot. If the history
+ *                      does not cover the whole period the age of the oldest
+ *                      snapshot is returned. -EINVAL if the history is empty.
+ */
+int sp_measure_history_find(
+		const sp_measure_history_t* history,
+		int64_t period
+		);
+
+/**
+ * Compares two system snapshots in history.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] age1      the age of the first (older) snapshot.
+ * @param[in] age2      the age of the second (newer) snapshot.
+ * @param[in] fn        the comparison function, for example sp_measure_diff_sys_cpu_usage.
+ * @param[out] diff     the comparison result.
+ * @return              0 for success.
+ */
+int sp_measure_history_diff_sys(
+		const sp_measure_history_t* history,
+		int age1,
+		int age2,
+		sp_measure_sys_diff_t fn,
+		int* diff
+		);
+
+/**
+ * Compares two process snapshots in history.
+ *
+ * @param[in] history   the snapshot history.
+ * @param[in] age1      the age of the first (older) snapshot.
+ * @param[in] age2      the age of the second (newer) snapshot.
+ * @param[in] fn        the comparison function, for example sp_measure_diff_proc_cpu_ticks.
+ * @param[out] diff     the comparison result.
+ * @return              0 for success.
+ */
+int sp_measure_history_diff_proc(
+		const sp_measure_history_t* history,
+		int age1,
+		int age2,
+		sp_measure_proc_diff_t fn,
+		int* diff
+		);
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_HISTORY_COUNT(history)         (history)->count
+#define FIELD_HISTORY_CAPACITY(history)      (history)->capacity
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/epoll.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Private API
+ */
+
+/* the notification source files, indexed by source bit number */
+static const char* notify_paths[SP_MEASURE_NOTIFY_SOURCES] = {
+	"/proc/pressure/memory",
+	"/proc/pressure/cpu",
+	"/proc/pressure/io",
+	"/sys/kernel/low_watermark",
+	"/sys/kernel/high_watermark",
+};
+
+/**
+ * Reads the sysfs node value, which re-arms the node for the next
+ * change notification.
+ *
+ * @param[in] fd   the node file descriptor.
+ */
+static void notify_rearm_sysfs(
+		int fd
+		)
+{
+	char buffer[32];
+	lseek(fd, 0, SEEK_SET);
+	ssize_t n = read(fd, buffer, sizeof(buffer));
+	STATS_ADD(syscalls, 2);
+	if (n > 0) STATS_ADD(bytes_read, n);
+}
+
+/**
+ * Adds source file descriptor into the notification epoll descriptor.
+ *
+ * The descriptor is closed if it can't be added.
+ * @param[in] notify   the notifications.
+ * @param[in] index    the source bit number.
+ * @param[in] fd       the source file descriptor.
+ * @return             0 for success, -errno otherwise.
+ */
+static int notify_add_fd(
+		sp_measure_notify_t* notify,
+		int index,
+		int fd
+		)
+{
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	/* both PSI triggers and sysfs nodes notify with POLLPRI, the sysfs
+	 * nodes are always readable so POLLIN must not be polled */
+	event.events = EPOLLPRI;
+	event.data.u32 = index;
+	if (epoll_ctl(notify->fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		int rc = -errno;
+		close(fd);
+		return rc;
+	}
+	notify->fds[index] = fd;
+	notify->sources |= 1 << index;
+	return 0;
+}
+
+/**
+ * Removes registered source.
+ *
+ * @param[in] notify   the notifications.
+ * @param[in] index    the source bit number.
+ */
+static void notify_remove_fd(
+		sp_measure_notify_t* notify,
+		int index
+		)
+{
+	if (notify->fds[index] == -1) return;
+	epoll_ctl(notify->fd, EPOLL_CTL_DEL, notify->fds[index], NULL);
+	close(notify->fds[index]);
+	notify->fds[index] = -1;
+	notify->sources &= ~(1 << index);
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_notify(
+		sp_measure_notify_t* notify,
+		int resources,
+		sp_measure_notify_fn_t callback,
+		void* user_data
+		)
+{
+	return sp_measure_init_notify_ctx(NULL, notify, resources, callback, user_data);
+}
+
+int sp_measure_init_notify_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_notify_t* notify,
+		int resources,
+		sp_measure_notify_fn_t callback,
+		void* user_data
+		)
+{
+	int i, rc;
+	memset(notify, 0, sizeof(sp_measure_notify_t));
+	for (i = 0; i < SP_MEASURE_NOTIFY_SOURCES; i++) {
+		notify->fds[i] = -1;
+	}
+	notify->fd = epoll_create1(EPOLL_CLOEXEC);
+	if (notify->fd == -1) return -errno;
+
+	notify->resources = resources | SNAPSHOT_SYS_TIMESTAMP;
+	notify->ctx = CTX_OR_DEFAULT(ctx);
+	notify->callback = callback;
+	notify->user_data = user_data;
+	rc = sp_measure_init_sys_data_ctx(ctx, &notify->data, notify->resources, NULL);
+	if (rc < 0) {
+		close(notify->fd);
+		notify->fd = -1;
+		return rc;
+	}
+	return 0;
+}
+
+int sp_measure_free_notify(
+		sp_measure_notify_t* notify
+		)
+{
+	int i;
+	if (notify->fd == -1) return 0;
+	for (i = 0; i < SP_MEASURE_NOTIFY_SOURCES; i++) {
+		notify_remove_fd(notify, i);
+	}
+	close(notify->fd);
+	notify->fd = -1;
+	sp_measure_free_sys_data(&notify->data);
+	return 0;
+}
+
+int sp_measure_notify_add_psi(
+		sp_measure_notify_t* notify,
+		int source,
+		int full,
+		int stall_us,
+		int window_us
+		)
+{
+	char buffer[PATH_MAX];
+	if ( !(source & NOTIFY_PSI) || (source & (source - 1)) || stall_us <= 0 || window_us <= 0) {
+		return -EINVAL;
+	}
+	int index = __builtin_ctz(source);
+	/* a new trigger replaces the old one */
+	notify_remove_fd(notify, index);
+
+	snprintf(buffer, sizeof(buffer), "%s%s", notify->ctx->fs_root, notify_paths[index]);
+	int fd = open(buffer, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd == -1) return -errno;
+	/* the trigger stays registered as long as the file is kept open */
+	int size = snprintf(buffer, sizeof(buffer), "%s %d %d", full ? "full" : "some", stall_us, window_us);
+	if (write(fd, buffer, size + 1) < 0) {
+		int rc = -errno;
+		close(fd);
+		return rc;
+	}
+	return notify_add_fd(notify, index, fd);
+}
+
+int sp_measure_notify_add_watermarks(
+		sp_measure_notify_t* notify
+		)
+{
+	char path[PATH_MAX];
+	int index, rc = -ENOENT;
+	for (index = __builtin_ctz(NOTIFY_MEM_WATERMARK_LOW); index <= __builtin_ctz(NOTIFY_MEM_WATERMARK_HIGH); index++) {
+		notify_remove_fd(notify, index);
+		snprintf(path, sizeof(path), "%s%s", notify->ctx->fs_root, notify_paths[index]);
+		int fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd == -1) {
+			if (rc == -ENOENT) rc = -errno;
+			continue;
+		}
+		/* sysfs nodes notify only after their value has been read */
+		notify_rearm_sysfs(fd);
+		int err = notify_add_fd(notify, index, fd);
+		if (err != 0 && rc == -ENOENT) rc = err;
+	}
+	return notify->sources & NOTIFY_MEM_WATERMARK ? notify->sources & NOTIFY_MEM_WATERMARK : rc;
+}
+
+int sp_measure_notify_dispatch(
+		sp_measure_notify_t* notify,
+		int timeout_ms
+		)
+{
+	struct epoll_event events[SP_MEASURE_NOTIFY_SOURCES];
+	int i, sources = 0;
+	int count = epoll_wait(notify->fd, events, SP_MEASURE_NOTIFY_SOURCES, timeout_ms);
+	STATS_ADD(syscalls, 1);
+	if (count < 0) return errno == EINTR ? 0 : -errno;
+	for (i = 0; i < count; i++) {
+		int index = events[i].data.u32;
+		if ( (1 << index) & NOTIFY_MEM_WATERMARK) notify_rearm_sysfs(notify->fds[index]);
+		sources |= 1 << index;
+	}
+	if (sources) {
+		int rc = sp_measure_get_sys_data(&notify->data, notify->resources, NULL);
+		if (notify->callback) notify->callback(sources, &notify->data, rc, notify->user_data);
+	}
+	return sources;
+}
@@ -0,0 +1,249 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_NOTIFY_H
+#define SP_MEASURE_NOTIFY_H
+
+/** @file sp_measure_notify.h
+ * API for event driven resource pressure notifications.
+ *
+ * Instead of polling the pressure related statistics at a high rate, the
+ * kernel can notify about the pressure changes:
+ * - the pressure stall information (PSI) triggers registered into
+ *   /proc/pressure/{memory,cpu,io} files notify when the tasks have been
+ *   stalled on the resource for longer than a threshold within a time
+ *   window (Linux 5.2 and newer).
+ * - the Maemo memory watermark sysfs nodes (see SNAPSHOT_SYS_MEM_WATERMARK)
+ *   notify when the watermark state changes.
+ *
+ * All notification sources are collected into a single epoll descriptor,
+ * which can be added into the application's own poll/epoll loop. When the
+ * descriptor becomes readable, sp_measure_notify_dispatch() retrieves the
+ * pending notifications, takes an immediate system snapshot and passes it
+ * to the notification callback.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    void on_pressure(int sources, const sp_measure_sys_data_t* data, int rc, void* user_data)
+ *    {
+ *        printf("memory pressure, %d kB used\n", FIELD_SYS_MEM_USED(data));
+ *    }
+ *
+ *    sp_measure_notify_t notify;
+ *    sp_measure_init_notify(&notify, SNAPSHOT_SYS_MEM, on_pressure, NULL);
+ *    // notify when tasks were stalled on memory for 100ms within 1 second
+ *    sp_measure_notify_add_psi(&notify, NOTIFY_PSI_MEMORY, 0, 100000, 1000000);
+ *    while (running) {
+ *        // or add FIELD_NOTIFY_FD(&notify) into the application's event loop
+ *        sp_measure_notify_dispatch(&notify, -1);
+ *    }
+ *    sp_measure_free_notify(&notify);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Notification source identifiers.
+ */
+typedef enum {
+	NOTIFY_PSI_MEMORY          = 1 << 0,	/** /proc/pressure/memory trigger */
+	NOTIFY_PSI_CPU             = 1 << 1,	/** /proc/pressure/cpu trigger */
+	NOTIFY_PSI_IO              = 1 << 2,	/** /proc/pressure/io trigger */
+	NOTIFY_MEM_WATERMARK_LOW   = 1 << 3,	/** /sys/kernel/low_watermark change */
+	NOTIFY_MEM_WATERMARK_HIGH  = 1 << 4,	/** /sys/kernel/high_watermark change */
+	NOTIFY_PSI                 = NOTIFY_PSI_MEMORY | NOTIFY_PSI_CPU | NOTIFY_PSI_IO,
+	NOTIFY_MEM_WATERMARK       = NOTIFY_MEM_WATERMARK_LOW | NOTIFY_MEM_WATERMARK_HIGH
+} sp_measure_notify_source_t;
+
+/* the number of notification sources */
+#define SP_MEASURE_NOTIFY_SOURCES	5
+
+/**
+ * Notification callback.
+ *
+ * @param[in] sources     the sources which have notified, see
+ *                        sp_measure_notify_source_t enumeration.
+ * @param[in] data        the system snapshot taken after receiving the
+ *                        notifications.
+ * @param[in] rc          the snapshot result, see sp_measure_get_sys_data().
+ * @param[in] user_data   the user data given to sp_measure_init_notify().
+ */
+typedef void (*sp_measure_notify_fn_t)(
+		int sources,
+		const sp_measure_sys_data_t* data,
+		int rc,
+		void* user_data
+		);
+
+/**
+ * Pressure notifications.
+ */
+typedef struct sp_measure_notify_t {
+	/* the epoll descriptor collecting all sources */
+	int fd;
+	/* the registered sources */
+	int sources;
+	/* the source file descriptors, indexed by source bit number, -1 if not registered */
+	int fds[SP_MEASURE_NOTIFY_SOURCES];
+
+	/* the resources retrieved by the notification snapshots */
+	int resources;
+	/* the notification snapshot */
+	sp_measure_sys_data_t data;
+
+	/* the notification callback */
+	sp_measure_notify_fn_t callback;
+	/* the callback user data */
+	void* user_data;
+
+	/* the context providing the file system root of the sources */
+	const sp_measure_ctx_t* ctx;
+} sp_measure_notify_t;
+
+
+/**
+ * Initializes pressure notifications.
+ *
+ * No sources are registered initially, see sp_measure_notify_add_psi()
+ * and sp_measure_notify_add_watermarks() functions. Afterwards the
+ * notifications must be freed with sp_measure_free_notify() function.
+ * @param[out] notify     the notifications to initialize.
+ * @param[in] resources   a flag specifying which system resource statistics
+ *                        the notification snapshots retrieve. The timestamp
+ *                        is always retrieved.
+ * @param[in] callback    the notification callback.
+ * @param[in] user_data   the user data passed to the callback.
+ * @return                0  - success
+ *                        <0 - unrecoverable error (-errno).
+ */
+int sp_measure_init_notify(
+		sp_measure_notify_t* notify,
+		int resources,
+		sp_measure_notify_fn_t callback,
+		void* user_data
+		);
+
+/**
+ * Initializes pressure notifications of the specified context.
+ *
+ * See sp_measure_init_notify() function. The notification sources are
+ * opened relative to the file system root of the context.
+ * @param[in] ctx         the library context, NULL for the default context.
+ * @param[out] notify     the notifications to initialize.
+ * @param[in] resources   a flag specifying which system resource statistics
+ *                        the notification snapshots retrieve.
+ * @param[in] callback    the notification callback.
+ * @param[in] user_data   the user data passed to the callback.
+ * @return                0  - success
+ *                        <0 - unrecoverable error (-errno).
+ */
+int sp_measure_init_notify_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_notify_t* notify,
+		int resources,
+		sp_measure_notify_fn_t callback,
+		void* user_data
+		);
+
+/**
+ * Releases pressure notifications.
+ *
+ * @param[in] notify   the notifications to free.
+ * @return             0 for success.
+ */
+int sp_measure_free_notify(
+		sp_measure_notify_t* notify
+		);
+
+/**
+ * Registers pressure stall information trigger.
+ *
+ * The trigger notifies when the tasks have been stalled on the resource
+ * for longer than stall_us microseconds within window_us microseconds
+ * time window. The kernel limits the window to 0.5-10 seconds, and for
+ * unprivileged processes the window must be a multiple of 2 seconds.
+ * @param[in] notify      the notifications.
+ * @param[in] source      the PSI source - NOTIFY_PSI_MEMORY, NOTIFY_PSI_CPU
+ *                        or NOTIFY_PSI_IO.
+ * @param[in] full        0 to track the time some tasks were stalled,
+ *                        1 to track the time all non-idle tasks were stalled
+ *                        (not supported for cpu by older kernels).
+ * @param[in] stall_us    the stall time threshold in microseconds.
+ * @param[in] window_us   the time window in microseconds.
+ * @return                0  - success
+ *                        <0 - the trigger could not be registered (-errno),
+ *                             -ENOENT if the kernel does not support PSI.
+ */
+int sp_measure_notify_add_psi(
+		sp_measure_notify_t* notify,
+		int source,
+		int full,
+		int stall_us,
+		int window_us
+		);
+
+/**
+ * Registers memory watermark change notifications.
+ *
+ * The watermark nodes are registered where present and pollable.
+ * @param[in] notify   the notifications.
+ * @return             >0 - the registered sources (NOTIFY_MEM_WATERMARK_LOW,
+ *                          NOTIFY_MEM_WATERMARK_HIGH).
+ *                     <0 - no watermark node could be registered (-errno),
+ *                          -ENOENT if the kernel does not provide them.
+ */
+int sp_measure_notify_add_watermarks(
+		sp_measure_notify_t* notify
+		);
+
+/**
+ * Waits for notifications and dispatches them to the callback.
+ *
+ * The callback is called once with all received notifications and a
+ * system snapshot taken immediately after receiving them.
+ * @param[in] notify       the notifications.
+ * @param[in] timeout_ms   the maximum time to wait in milliseconds, 0 to
+ *                         return immediately and -1 to wait infinitely.
+ * @return                 >0 - the sources which have notified.
+ *                         0  - no notifications were received.
+ *                         <0 - waiting failed (-errno).
+ */
+int sp_measure_notify_dispatch(
+		sp_measure_notify_t* notify,
+		int timeout_ms
+		);
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_NOTIFY_FD(notify)              (notify)->fd
+#define FIELD_NOTIFY_SOURCES(notify)         (notify)->sources
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,83 +37,520 @@
  * Private API
  */
 
+/* the memory fields provided by /proc/<pid>/statm and /proc/<pid>/status files */
+#define PROC_MEM_STATM_FIELDS	(SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS)
+#define PROC_MEM_STATUS_FIELDS	(SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_SWAP)
+
+/* number of bits in process set failure bitmap word */
+#define PROC_SET_WORD_BITS	(8 * sizeof(unsigned int))
+
+/*
+ * The smaps files are parsed block by block. The line ends of a block
+ * are located with SIMD compare instructions producing a bitmask of the
+ * newline positions, the line keys are dispatched by their first two
+ * characters and the values are parsed without libc calls.
+ *
+ * Define SMAPS_SCAN_SCALAR to use the portable line end scanner also
+ * on x86 builds.
+ */
+#if defined(__AVX2__) && !defined(SMAPS_SCAN_SCALAR)
+
+#include <immintrin.h>
+
+/* the number of bytes scanned for line ends at once */
+#define SMAPS_SCAN_WIDTH	32
+
+static inline uint32_t smaps_scan_eol(
+		const char* ptr
+		)
+{
+	__m256i chunk = _mm256_loadu_si256((const __m256i*)ptr);
+	return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+}
+
+#elif defined(__SSE2__) && !defined(SMAPS_SCAN_SCALAR)
+
+#include <emmintrin.h>
+
+#define SMAPS_SCAN_WIDTH	16
+
+static inline uint32_t smaps_scan_eol(
+		const char* ptr
+		)
+{
+	__m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+}
+
+#else
+
+#define SMAPS_SCAN_WIDTH	8
+
+/**
+ * Scans line ends.
+ *
+ * @param[in] ptr   the SMAPS_SCAN_WIDTH bytes to scan.
+ * @return          a bitmask with bit i set if ptr[i] is a newline.
+ */
+static inline uint32_t smaps_scan_eol(
+		const char* ptr
+		)
+{
+	uint64_t word;
+	uint32_t mask = 0;
+	int i;
+	memcpy(&word, ptr, sizeof(word));
+	/* check first if any of the bytes is a newline (zero after xor) */
+	word ^= 0x0a0a0a0a0a0a0a0aULL;
+	if (((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) == 0) return 0;
+	for (i = 0; i < SMAPS_SCAN_WIDTH; i++) {
+		mask |= (uint32_t)(ptr[i] == '\n') << i;
+	}
+	return mask;
+}
+
+#endif
+
+/**
+ * The memory usage fields of /proc/<pid>/smaps file.
+ */
+enum {
+	SMAPS_SIZE,
+	SMAPS_RSS,
+	SMAPS_PSS,
+	SMAPS_SHARED_CLEAN,
+	SMAPS_SHARED_DIRTY,
+	SMAPS_PRIVATE_CLEAN,
+	SMAPS_PRIVATE_DIRTY,
+	SMAPS_REFERENCED,
+	SMAPS_SWAP,
+	SMAPS_FIELD_COUNT
+};
+
+/* the first two key characters as a dispatch value */
+#define SMAPS_PREFIX(c1, c2)	(((c1) << 8) | (c2))
+
+/* matches the whole key including the colon */
+#define SMAPS_KEY(name, id) \
+	if (length > sizeof(name) - 1 && !memcmp(line, name, sizeof(name) - 1)) { \
+		*offset = sizeof(name) - 1; \
+		return id; \
+	}
+
+/**
+ * Identifies the memory usage field of a smaps line.
+ *
+ * @param[in] line     the line.
+ * @param[in] length   the line length.
+ * @param[out] offset  the offset of the value following the key.
+ * @return             the field identifier or -1 if the line does not
+ *                     contain a memory usage field.
+ */
+static inline int smaps_line_field(
+		const char* line,
+		size_t length,
+		size_t* offset
+		)
+{
+	if (length < 5) return -1;
+	switch (SMAPS_PREFIX((unsigned char)line[0], (unsigned char)line[1])) {
+		case SMAPS_PREFIX('S', 'i'):
+			SMAPS_KEY("Size:", SMAPS_SIZE);
+			break;
+		case SMAPS_PREFIX('R', 's'):
+			SMAPS_KEY("Rss:", SMAPS_RSS);
+			break;
+		case SMAPS_PREFIX('P', 's'):
+			SMAPS_KEY("Pss:", SMAPS_PSS);
+			break;
+		case SMAPS_PREFIX('S', 'h'):
+			SMAPS_KEY("Shared_Clean:", SMAPS_SHARED_CLEAN);
+			SMAPS_KEY("Shared_Dirty:", SMAPS_SHARED_DIRTY);
+			break;
+		case SMAPS_PREFIX('P', 'r'):
+			SMAPS_KEY("Private_Clean:", SMAPS_PRIVATE_CLEAN);
+			SMAPS_KEY("Private_Dirty:", SMAPS_PRIVATE_DIRTY);
+			break;
+		case SMAPS_PREFIX('R', 'e'):
+			SMAPS_KEY("Referenced:", SMAPS_REFERENCED);
+			break;
+		case SMAPS_PREFIX('S', 'w'):
+			SMAPS_KEY("Swap:", SMAPS_SWAP);
+			break;
+	}
+	return -1;
+}
+
+/**
+ * Adds memory usage value from a single /proc/<pid>/smaps line.
+ *
+ * The value must be followed by a space (the kB unit), otherwise
+ * the line is ignored.
+ * @param[in,out] values   the memory usage fields.
+ * @param[in] line         the line.
+ * @param[in] end          the end of the line (excluding newline).
+ */
+static inline void smaps_parse_line(
+		int* values,
+		const char* line,
+		const char* end
+		)
+{
+	size_t offset;
+	int field = smaps_line_field(line, end - line, &offset);
+	if (field < 0) return;
+
+	const char* ptr = line + offset;
+	while (ptr < end && *ptr == ' ') ptr++;
+	const char* digits = ptr;
+	unsigned int value = 0;
+	while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+		value = value * 10 + (*ptr++ - '0');
+	}
+	if (ptr == digits || ptr == end || *ptr != ' ') return;
+	values[field] += (int)value;
+}
+
+/**
+ * Parses the complete lines of a smaps file block.
+ *
+ * @param[in,out] values   the memory usage fields.
+ * @param[in] line         the start of the first line.
+ * @param[in] end          the end of the block.
+ * @return                 the start of the incomplete last line.
+ */
+static const char* smaps_parse_block(
+		int* values,
+		const char* line,
+		const char* end
+		)
+{
+	const char* ptr = line;
+	for (; end - ptr >= SMAPS_SCAN_WIDTH; ptr += SMAPS_SCAN_WIDTH) {
+		uint32_t mask = smaps_scan_eol(ptr);
+		while (mask) {
+			const char* eol = ptr + __builtin_ctz(mask);
+			smaps_parse_line(values, line, eol);
+			line = eol + 1;
+			mask &= mask - 1;
+		}
+	}
+	for (; ptr < end; ptr++) {
+		if (*ptr == '\n') {
+			smaps_parse_line(values, line, ptr);
+			line = ptr + 1;
+		}
+	}
+	return line;
+}
 
 /**
  * Calculates process clean and dirty memory.
  *
- * The clean and dirty memory is calculated by simply parsing
- * /proc/<pid>/smaps file.
- * @param[in,out] stats    in  - the smaps file pointer.
- *                         out - memory statistics.
+ * The clean and dirty memory is calculated by summing up the
+ * memory usage values in /proc/<pid>/smaps formatted file.
+ * The file is read in blocks as large as the parse buffer.
+ * @param[out] stats       the memory statistics.
+ * @param[in] path         the file to parse.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
  * @return                 0 for success.
  */
-static int file_parse_proc_smaps(
-		sp_measure_proc_data_t* data
+static int file_parse_smaps_file(
+		sp_measure_proc_data_t* data,
+		const char* path,
+		char* buffer,
+		size_t size
 		)
 {
-	char buffer[128];
+	int* fields[SMAPS_FIELD_COUNT] = {
+		[SMAPS_SIZE] = &data->mem_size,
+		[SMAPS_RSS] = &data->mem_rss,
+		[SMAPS_PSS] = &data->mem_pss,
+		[SMAPS_SHARED_CLEAN] = &data->mem_shared_clean,
+		[SMAPS_SHARED_DIRTY] = &data->mem_shared_dirty,
+		[SMAPS_PRIVATE_CLEAN] = &data->mem_private_clean,
+		[SMAPS_PRIVATE_DIRTY] = &data->mem_private_dirty,
+		[SMAPS_REFERENCED] = &data->mem_referenced,
+		[SMAPS_SWAP] = &data->mem_swap,
+	};
+	int values[SMAPS_FIELD_COUNT] = {0};
 	unsigned i;
-	parse_query_t query[] = {
-			{"Private_Clean", &data->mem_private_clean, false},
-			{"Private_Dirty", &data->mem_private_dirty, false},
-			{"Swap", &data->mem_swap, false},
-			{"Shared_Clean", &data->mem_shared_clean, false},
-			{"Shared_Dirty", &data->mem_shared_dirty, false},
-			{"Size", &data->mem_size, false},
-			{"Pss", &data->mem_pss, false},
-			{"Rss", &data->mem_rss, false},
-			{"Referenced", &data->mem_referenced, false},
-		};
-	FILE* fp = fopen(data->common->proc_smaps_path, "r");
-	if (!fp) {
-		for (i = 0; i < ARRAY_ITEMS(query); i++) {
-			*(query[i].value) = ESPMEASURE_UNDEFINED;
+	int fd = open(path, O_RDONLY);
+	STATS_ADD(syscalls, 1);
+	if (fd == -1) {
+		for (i = 0; i < SMAPS_FIELD_COUNT; i++) {
+			*fields[i] = ESPMEASURE_UNDEFINED;
 		}
 		return -1;
 	}
-	for (i = 0; i < ARRAY_ITEMS(query); i++) {
-		*(query[i].value) = 0;
-	}
-	while (fgets(buffer, sizeof(buffer), fp)) {
-		if (buffer[0] == 0)
-			continue;
-		/* We are only interested in /proc/pid/smaps lines that start
-		 * with one of these letters.
-		 */
-		if (!(buffer[0] == 'P' ||
-		      buffer[0] == 'R' ||
-		      buffer[0] == 'S'))
-			continue;
-		char* colon = strchr(buffer, ':');
-		if (colon == NULL || colon[1] == 0 || buffer == colon)
-			continue;
-		*colon = 0;
-		for (i = 0; i < ARRAY_ITEMS(query); i++) {
-			if (strcmp(query[i].key, buffer) != 0)
-				continue;
-			char* start = &colon[1];
-			char* end;
-			int value;
-			while (*start && *start == ' ')
-				++start;
-			/* Checking the end would not be strictly required with atoi(). */
-			end = start;
-			while (*end && *end >= '0' && *end <= '9')
-				++end;
-			if (*end != ' ')
-				break;
-			*end = 0;
-			value = atoi(start);
-			if (value <= 0)
-				break;
-			*(query[i].value) += value;
+	STATS_ADD(files_opened, 1);
+	size_t length = 0;
+	bool skip = false;
+	while (true) {
+		ssize_t n = read(fd, buffer + length, size - length - 1);
+		STATS_ADD(syscalls, 1);
+		if (n <= 0)
 			break;
+		STATS_ADD(bytes_read, n);
+		length += n;
+		const char* line = buffer;
+		if (skip) {
+			/* the rest of a line which did not fit into buffer */
+			const char* eol = memchr(buffer, '\n', length);
+			if (eol == NULL) {
+				length = 0;
+				continue;
+			}
+			line = eol + 1;
+			skip = false;
+		}
+		line = smaps_parse_block(values, line, buffer + length);
+		length = buffer + length - line;
+		if (length == size - 1) {
+			/* the line does not fit into buffer, none of the
+			 * memory usage lines are that long */
+			length = 0;
+			skip = true;
+		}
+		else {
+			memmove(buffer, line, length);
+		}
+	}
+	if (length && !skip) {
+		smaps_parse_line(values, buffer, buffer + length);
+	}
+	close(fd);
+	STATS_ADD(syscalls, 1);
+	for (i = 0; i < SMAPS_FIELD_COUNT; i++) {
+		*fields[i] = values[i];
+	}
+	return 0;
+}
+
+/**
+ * Calculates process memory usage from /proc/<pid>/smaps file.
+ *
+ * @param[out] stats       the memory statistics.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
+ * @return                 0 for success.
+ */
+static int file_parse_proc_smaps(
+		sp_measure_proc_data_t* data,
+		char* buffer,
+		size_t size
+		)
+{
+	return file_parse_smaps_file(data, data->common->proc_smaps_path, buffer, size);
+}
+
+/**
+ * Reads the beginning of /proc/<pid>/status file.
+ *
+ * The file is read into the parse buffer with plain read() calls,
+ * so no stream buffer is allocated.
+ * @param[in] path         the status file path.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
+ * @return                 0 for success.
+ */
+static int file_read_status(
+		const char* path,
+		char* buffer,
+		size_t size
+		)
+{
+	size_t offset = 0;
+	ssize_t n;
+	int fd = open(path, O_RDONLY);
+	STATS_ADD(syscalls, 1);
+	if (fd == -1) return -1;
+	STATS_ADD(files_opened, 1);
+	/* the memory values are near the beginning of the file, so it's
+	 * enough to read only the first buffer full */
+	while (offset < size - 1 && (n = read(fd, buffer + offset, size - 1 - offset)) > 0) {
+		STATS_ADD(syscalls, 1);
+		STATS_ADD(bytes_read, n);
+		offset += n;
+	}
+	close(fd);
+	STATS_ADD(syscalls, 2);
+	buffer[offset] = '\0';
+	return 0;
+}
+
+/**
+ * Finds a kB value in /proc/<pid>/status file contents.
+ *
+ * @param[in] buffer       the zero terminated file contents.
+ * @param[in] key          the value key including the colon and
+ *                         the preceding newline.
+ * @param[out] value       the value.
+ * @return                 0 for success.
+ */
+static int status_find_value(
+		const char* buffer,
+		const char* key,
+		int* value
+		)
+{
+	const char* ptr = strstr(buffer, key);
+	if (ptr == NULL) return -1;
+	*value = atoi(ptr + strlen(key));
+	return 0;
+}
+
+/**
+ * Retrieves process memory usage from /proc/<pid>/status file.
+ *
+ * The file provides the memory size, resident memory and swap usage
+ * as maintained by kernel memory counters. The swap usage is missing
+ * from old kernels.
+ * @param[out] data        the memory statistics.
+ * @param[in] fields       the requested memory fields.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
+ * @return                 0 if all requested fields were retrieved.
+ */
+static int file_parse_proc_status(
+		sp_measure_proc_data_t* data,
+		int fields,
+		char* buffer,
+		size_t size
+		)
+{
+	int mem_size, mem_rss, mem_swap;
+	if (file_read_status(data->common->proc_status_path, buffer, size) != 0) return -1;
+	if (status_find_value(buffer, "\nVmSize:", &mem_size) != 0 ||
+			status_find_value(buffer, "\nVmRSS:", &mem_rss) != 0) {
+		return -1;
+	}
+	if (status_find_value(buffer, "\nVmSwap:", &mem_swap) != 0) {
+		if (fields & SNAPSHOT_PROC_MEM_SWAP) return -1;
+		mem_swap = ESPMEASURE_UNDEFINED;
+	}
+	data->mem_size = mem_size;
+	data->mem_rss = mem_rss;
+	data->mem_swap = mem_swap;
+	return 0;
+}
+
+/**
+ * Retrieves process memory usage from /proc/<pid>/statm file.
+ *
+ * The file provides the memory size and resident memory in pages.
+ * @param[out] data        the memory statistics.
+ * @return                 0 for success.
+ */
+static int file_parse_proc_statm(
+		sp_measure_proc_data_t* data
+		)
+{
+	char buffer[128];
+	int n, fd = open(data->common->proc_statm_path, O_RDONLY);
+	STATS_ADD(syscalls, 1);
+	if (fd == -1) return -1;
+	n = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	STATS_ADD(files_opened, 1);
+	STATS_ADD(syscalls, 2);
+	if (n <= 0) return -1;
+	STATS_ADD(bytes_read, n);
+	buffer[n] = '\0';
+
+	/* the first two values are the memory size and resident pages */
+	const char* ptr = buffer;
+	int64_t pages[2];
+	int i;
+	for (i = 0; i < 2; i++) {
+		while (*ptr == ' ') ptr++;
+		if (*ptr < '0' || *ptr > '9') return -1;
+		pages[i] = 0;
+		while (*ptr >= '0' && *ptr <= '9') {
+			pages[i] = pages[i] * 10 + (*ptr++ - '0');
 		}
 	}
-	fclose(fp);
+	/* the sizes are clamped, as VmSize can exceed INT_MAX kB */
+	for (i = 0; i < 2; i++) {
+		pages[i] *= data->common->page_size_kb;
+		if (pages[i] > INT_MAX) pages[i] = INT_MAX;
+	}
+	data->mem_size = pages[0];
+	data->mem_rss = pages[1];
 	return 0;
 }
 
+/**
+ * Calculates process memory usage from /proc/<pid>/smaps_rollup file.
+ *
+ * The rollup file contains already summed up values of all mappings,
+ * except the mapping sizes. The memory size is taken from the VmSize
+ * field of /proc/<pid>/status file instead.
+ * @param[out] stats       the memory statistics.
+ * @param[in] fields       the requested memory fields.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
+ * @return                 0 for success.
+ */
+static int file_parse_proc_smaps_rollup(
+		sp_measure_proc_data_t* data,
+		int fields,
+		char* buffer,
+		size_t size
+		)
+{
+	if (data->common->proc_smaps_rollup_path == NULL) return -1;
+	if (file_parse_smaps_file(data, data->common->proc_smaps_rollup_path, buffer, size) != 0) return -1;
+	data->mem_size = ESPMEASURE_UNDEFINED;
+	if ( (fields & SNAPSHOT_PROC_MEM_SIZE) && (file_read_status(data->common->proc_status_path, buffer, size) != 0 ||
+			status_find_value(buffer, "\nVmSize:", &data->mem_size) != 0)) {
+		data->mem_size = ESPMEASURE_UNDEFINED;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Retrieves process memory usage from the cheapest source providing
+ * the requested fields.
+ *
+ * The sources are tried in the order of their cost - statm, status,
+ * smaps_rollup (only if SNAPSHOT_PROC_MEM_ROLLUP is requested) and
+ * smaps, which provides all fields. A source missing from the kernel
+ * or not providing all requested fields is skipped.
+ * @param[out] data        the memory statistics.
+ * @param[in] resources    the requested resources.
+ * @param[in] buffer       the parse buffer.
+ * @param[in] size         the parse buffer size.
+ * @return                 0 for success.
+ */
+static int proc_get_mem_usage(
+		sp_measure_proc_data_t* data,
+		int resources,
+		char* buffer,
+		size_t size
+		)
+{
+	int fields = resources & SNAPSHOT_PROC_MEM_USAGE ? SNAPSHOT_PROC_MEM_FIELDS : resources & SNAPSHOT_PROC_MEM_FIELDS;
+	if ( !(fields & ~PROC_MEM_STATUS_FIELDS) ) {
+		/* the fields not provided by statm/status files are left undefined */
+		data->mem_pss = ESPMEASURE_UNDEFINED;
+		data->mem_shared_clean = ESPMEASURE_UNDEFINED;
+		data->mem_shared_dirty = ESPMEASURE_UNDEFINED;
+		data->mem_private_clean = ESPMEASURE_UNDEFINED;
+		data->mem_private_dirty = ESPMEASURE_UNDEFINED;
+		data->mem_referenced = ESPMEASURE_UNDEFINED;
+		if ( !(fields & ~PROC_MEM_STATM_FIELDS) ) {
+			data->mem_swap = ESPMEASURE_UNDEFINED;
+			if (file_parse_proc_statm(data) == 0) return 0;
+		}
+		if (file_parse_proc_status(data, fields, buffer, size) == 0) return 0;
+	}
+	if ( (resources & SNAPSHOT_PROC_MEM_ROLLUP) && file_parse_proc_smaps_rollup(data, fields, buffer, size) == 0) return 0;
+	return file_parse_proc_smaps(data, buffer, size);
+}
+
 /**
  * Get cpu statistics from /proc/<pid>/stat file.
  *
@@ -127,15 +564,19 @@ static int file_parse_proc_stat(
 {
 	int rc = -1;
 	int fd = open(data->common->proc_stat_path, O_RDONLY);
+	STATS_ADD(syscalls, 1);
 	if (fd != -1) {
 		char* ptr = NULL;
 		unsigned idx = 2;
 		char buffer[1024];
 		int n = read(fd, buffer, sizeof(buffer) - 1);
+		STATS_ADD(files_opened, 1);
+		STATS_ADD(syscalls, 2);
 		if (n < 0) {
 			rc = -errno;
 		}
 		else {
+			STATS_ADD(bytes_read, n);
 			if (n >= sizeof(buffer)) n = sizeof(buffer) - 1;
 			buffer[n] = '\0';
 
@@ -172,20 +613,21 @@ static int file_parse_proc_stat(
 /**
  * Retrieves process name.
  *
+ * @param[in] ctx   the context providing the file system root.
  * @param[in] pid   the process identifier.
  * @return          allocated string containing process name or NULL if
  *                  process name could not be retrieved.
  */
-char* get_process_name(int pid)
+char* get_process_name(const sp_measure_ctx_t* ctx, int pid)
 {
 	int fd, n;
 	char* proc_name = NULL;
 	char buffer[PATH_MAX];
 
-	snprintf(buffer, sizeof(buffer), "%s/proc/%d/cmdline", sp_measure_virtual_fs_root, pid);
+	snprintf(buffer, sizeof(buffer), "%s/proc/%d/cmdline", ctx->fs_root, pid);
 	fd = open(buffer, O_RDONLY);
 	if (fd == -1) {
-		snprintf(buffer, sizeof(buffer), "%s/proc/%d/status", sp_measure_virtual_fs_root, pid);
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/status", ctx->fs_root, pid);
 		FILE* fp = fopen(buffer, "r");
 		if (fp) {
 			char name[256];
@@ -233,6 +675,21 @@ int sp_measure_init_proc_data(
 		int pid,
 		int resources,
 		const sp_measure_proc_data_t* sample_data		)
+{
+	return sp_measure_init_proc_data_ctx(NULL, new_data, pid, resources, sample_data);
+}
+
+/**
+ * Initializes process snapshot data structure without the parse buffer.
+ *
+ * See sp_measure_init_proc_data_ctx() function.
+ */
+static int proc_init_data(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_proc_data_t* new_data,
+		int pid,
+		const sp_measure_proc_data_t* sample_data
+		)
 {
 	memset(new_data, 0, sizeof(sp_measure_proc_data_t));
 	if (sample_data) {
@@ -244,21 +701,56 @@ int sp_measure_init_proc_data(
 		char buffer[PATH_MAX];
 		new_data->common = (sp_measure_proc_common_t*)malloc(sizeof(sp_measure_proc_common_t));
 		if (new_data->common == NULL) return -ENOMEM;
+		memset(new_data->common, 0, sizeof(sp_measure_proc_common_t));
 
 		new_data->common->pid = pid;
 		new_data->common->ref_count = 1;
+		new_data->common->page_size_kb = sysconf(_SC_PAGESIZE) >> 10;
+		new_data->common->ctx = ctx = CTX_OR_DEFAULT(ctx);
 
 		/* open data files */
-		snprintf(buffer, sizeof(buffer), "%s/proc/%d/smaps", sp_measure_virtual_fs_root, pid);
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/smaps", ctx->fs_root, pid);
 		new_data->common->proc_smaps_path = strdup(buffer);
 		if (new_data->common->proc_smaps_path == NULL) return -ENOMEM;
 
-		snprintf(buffer, sizeof(buffer), "%s/proc/%d/stat", sp_measure_virtual_fs_root, pid);
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/stat", ctx->fs_root, pid);
 		new_data->common->proc_stat_path = strdup(buffer);
 		if (new_data->common->proc_stat_path == NULL) return -ENOMEM;
 
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/status", ctx->fs_root, pid);
+		new_data->common->proc_status_path = strdup(buffer);
+		if (new_data->common->proc_status_path == NULL) return -ENOMEM;
+
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/statm", ctx->fs_root, pid);
+		new_data->common->proc_statm_path = strdup(buffer);
+		if (new_data->common->proc_statm_path == NULL) return -ENOMEM;
+
+		/* smaps_rollup is available only since Linux 4.14 */
+		snprintf(buffer, sizeof(buffer), "%s/proc/%d/smaps_rollup", ctx->fs_root, pid);
+		if (access(buffer, R_OK) == 0) {
+			new_data->common->proc_smaps_rollup_path = strdup(buffer);
+			if (new_data->common->proc_smaps_rollup_path == NULL) return -ENOMEM;
+		}
+
 		/* read process name */
-		new_data->common->name = get_process_name(pid);
+		new_data->common->name = get_process_name(ctx, pid);
+	}
+	return 0;
+}
+
+int sp_measure_init_proc_data_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_proc_data_t* new_data,
+		int pid,
+		int resources,
+		const sp_measure_proc_data_t* sample_data
+		)
+{
+	int rc = proc_init_data(ctx, new_data, pid, sample_data);
+	if (rc < 0) return rc;
+	if (new_data->common->buffer == NULL) {
+		new_data->common->buffer = (char*)malloc(PROC_SET_BUFFER_SIZE);
+		if (new_data->common->buffer == NULL) return -ENOMEM;
 	}
 	return 0;
 }
@@ -269,7 +761,7 @@ int sp_measure_reinit_proc_data(
 		)
 {
 	if (data->common->name) free(data->common->name);
-	data->common->name = get_process_name(data->common->pid);
+	data->common->name = get_process_name(data->common->ctx, data->common->pid);
 
 	return 0;
 }
@@ -278,40 +770,186 @@ int sp_measure_free_proc_data(
 		sp_measure_proc_data_t* data
 		)
 {
-	if (data->name) free(data->name);
 	if (--data->common->ref_count == 0) {
 		if (data->common->name) free(data->common->name);
 		if (data->common->proc_smaps_path) free(data->common->proc_smaps_path);
 		if (data->common->proc_stat_path) free(data->common->proc_stat_path);
+		if (data->common->proc_status_path) free(data->common->proc_status_path);
+		if (data->common->proc_statm_path) free(data->common->proc_statm_path);
+		if (data->common->proc_smaps_rollup_path) free(data->common->proc_smaps_rollup_path);
+		if (data->common->buffer) free(data->common->buffer);
 		free(data->common);
 	}
 	return 0;
 }
 
 
+int proc_get_data(
+		sp_measure_proc_data_t* data,
+		int resources,
+		char* buffer,
+		size_t size
+		)
+{
+	int rc = 0;
+	stats_call_t stats;
+	stats_call_begin(&stats, true);
+	if (resources & SNAPSHOT_PROC_TIMESTAMP) {
+		stats_resource_begin(&stats, SNAPSHOT_PROC_TIMESTAMP);
+		data->timestamp_ns = clock_read_ns(CLOCK_MONOTONIC);
+		if (data->timestamp_ns == ESPMEASURE_UNDEFINED) rc |= SNAPSHOT_PROC_TIMESTAMP;
+		stats_resource_end(&stats, rc & SNAPSHOT_PROC_TIMESTAMP);
+	}
+	if (resources & (SNAPSHOT_PROC_MEM_USAGE | SNAPSHOT_PROC_MEM_FIELDS)) {
+		int mem_resources = resources & (SNAPSHOT_PROC_MEM_USAGE | SNAPSHOT_PROC_MEM_FIELDS);
+		/* the statistics are accounted to the memory usage resource, or to
+		 * the first requested memory field */
+		stats_resource_begin(&stats, mem_resources & SNAPSHOT_PROC_MEM_USAGE ? SNAPSHOT_PROC_MEM_USAGE :
+				mem_resources & -mem_resources);
+		if (proc_get_mem_usage(data, resources, buffer, size) != 0) rc |= mem_resources;
+		stats_resource_end(&stats, rc & mem_resources);
+	}
+	if (resources & SNAPSHOT_PROC_CPU_USAGE) {
+		stats_resource_begin(&stats, SNAPSHOT_PROC_CPU_USAGE);
+		if (file_parse_proc_stat(data) != 0) rc |= SNAPSHOT_PROC_CPU_USAGE;
+		stats_resource_end(&stats, rc & SNAPSHOT_PROC_CPU_USAGE);
+	}
+	stats_call_end(&stats);
+	return rc;
+}
+
+void proc_set_mark_failed(
+		sp_measure_proc_set_t* set,
+		int index
+		)
+{
+	__sync_fetch_and_or(&set->failed[index / PROC_SET_WORD_BITS], 1U << (index % PROC_SET_WORD_BITS));
+}
+
 int sp_measure_get_proc_data(
 		sp_measure_proc_data_t* data,
 		int resources,
 		const char* name
 		)
 {
-	int rc = 0;
 	/* first check if the process still exists */
 	if (access(data->common->proc_stat_path, F_OK) != 0) {
 		return -1;
 	}
-	if (name) {
-		if (data->name) free(data->name);
-		data->name = strdup(name);
-		if (data->name == NULL) return -ENOMEM;
+	/* the process set snapshots are initialized without the buffer */
+	if (data->common->buffer == NULL) {
+		data->common->buffer = (char*)malloc(PROC_SET_BUFFER_SIZE);
+		if (data->common->buffer == NULL) return -ENOMEM;
 	}
-	if ( (resources & SNAPSHOT_PROC_MEM_USAGE) && file_parse_proc_smaps(data) != 0) {
-		rc |= SNAPSHOT_PROC_MEM_USAGE;
+	if (name) snapshot_set_name(data->name, name);
+	return proc_get_data(data, resources, data->common->buffer, PROC_SET_BUFFER_SIZE);
+}
+
+
+int sp_measure_init_proc_set(
+		sp_measure_proc_set_t* new_set,
+		const int* pids,
+		int count,
+		int resources,
+		const sp_measure_proc_set_t* sample_set
+		)
+{
+	return sp_measure_init_proc_set_ctx(NULL, new_set, pids, count, resources, sample_set);
+}
+
+int sp_measure_init_proc_set_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_proc_set_t* new_set,
+		const int* pids,
+		int count,
+		int resources,
+		const sp_measure_proc_set_t* sample_set
+		)
+{
+	int i, rc;
+	memset(new_set, 0, sizeof(sp_measure_proc_set_t));
+	if (sample_set) {
+		pids = sample_set->pids;
+		count = sample_set->count;
 	}
-	if ( (resources & SNAPSHOT_PROC_CPU_USAGE) && file_parse_proc_stat(data) != 0) {
-		rc |= SNAPSHOT_PROC_CPU_USAGE;
+	new_set->pids = (int*)malloc(sizeof(int) * (count ? count : 1));
+	new_set->data = (sp_measure_proc_data_t*)calloc(count ? count : 1, sizeof(sp_measure_proc_data_t));
+	new_set->failed = (unsigned int*)calloc(count / PROC_SET_WORD_BITS + 1, sizeof(unsigned int));
+	new_set->buffer = (char*)malloc(PROC_SET_BUFFER_SIZE);
+	if (new_set->pids == NULL || new_set->data == NULL || new_set->failed == NULL || new_set->buffer == NULL) {
+		sp_measure_free_proc_set(new_set);
+		return -ENOMEM;
 	}
-	return rc;
+	new_set->buffer_size = PROC_SET_BUFFER_SIZE;
+	memcpy(new_set->pids, pids, sizeof(int) * count);
+	for (i = 0; i < count; i++) {
+		rc = proc_init_data(ctx, &new_set->data[i], pids[i], sample_set ? &sample_set->data[i] : NULL);
+		if (rc < 0) {
+			sp_measure_free_proc_set(new_set);
+			return rc;
+		}
+		new_set->count++;
+	}
+	return 0;
+}
+
+int sp_measure_free_proc_set(
+		sp_measure_proc_set_t* set
+		)
+{
+	int i;
+	if (set->workers) proc_workers_free(set->workers);
+	for (i = 0; i < set->count; i++) {
+		sp_measure_free_proc_data(&set->data[i]);
+	}
+	if (set->pids) free(set->pids);
+	if (set->data) free(set->data);
+	if (set->failed) free(set->failed);
+	if (set->buffer) free(set->buffer);
+	memset(set, 0, sizeof(sp_measure_proc_set_t));
+	return 0;
+}
+
+int sp_measure_get_proc_set_data(
+		sp_measure_proc_set_t* set,
+		int resources
+		)
+{
+	int i, nfailed = 0;
+	memset(set->failed, 0, sizeof(unsigned int) * (set->count / PROC_SET_WORD_BITS + 1));
+	if (set->workers) {
+		return proc_workers_run(set->workers, set, resources);
+	}
+	for (i = 0; i < set->count; i++) {
+		/* a process which has exited fails all its resources,
+		 * so there is no need for separate existence check */
+		if (proc_get_data(&set->data[i], resources, set->buffer, set->buffer_size) != 0) {
+			proc_set_mark_failed(set, i);
+			nfailed++;
+		}
+	}
+	return nfailed;
+}
+
+int sp_measure_proc_set_workers(
+		sp_measure_proc_set_t* set,
+		int count
+		)
+{
+	if (count < 0) return -EINVAL;
+	if (count == 0) {
+		count = sysconf(_SC_NPROCESSORS_ONLN);
+		if (count < 1) count = 1;
+	}
+	if (set->workers) {
+		proc_workers_free(set->workers);
+		set->workers = NULL;
+	}
+	if (count > 1) {
+		set->workers = proc_workers_create(count);
+		if (set->workers == NULL) return -ENOMEM;
+	}
+	return count;
 }
 
 
@@ -356,3 +994,20 @@ int sp_measure_diff_proc_cpu_ticks(
 	return 0;
 }
 
+int sp_measure_diff_proc_timestamp_ns(
+		const sp_measure_proc_data_t* data1,
+		const sp_measure_proc_data_t* data2,
+		int64_t* diff
+		)
+{
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (data1->timestamp_ns == ESPMEASURE_UNDEFINED || data2->timestamp_ns == ESPMEASURE_UNDEFINED ||
+			data1->timestamp_ns == 0 || data2->timestamp_ns == 0) {
+		return -EINVAL;
+	}
+	*diff = data2->timestamp_ns - data1->timestamp_ns;
+	return 0;
+}
+
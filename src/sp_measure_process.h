@@ -75,6 +75,23 @@ typedef struct sp_measure_proc_common_t {
 	char* proc_smaps_path;
 	/* path of the /proc/<pid>/data file */
 	char* proc_stat_path;
+	/* path of the /proc/<pid>/smaps_rollup file, NULL if not provided by kernel */
+	char* proc_smaps_rollup_path;
+	/* path of the /proc/<pid>/status file */
+	char* proc_status_path;
+	/* path of the /proc/<pid>/statm file */
+	char* proc_statm_path;
+
+	/* the context the process snapshot was initialized with */
+	const sp_measure_ctx_t* ctx;
+
+	/* the memory page size in kB */
+	int page_size_kb;
+
+	/* the smaps parse buffer used by sp_measure_get_proc_data(), shared by
+	 * all snapshots of the process. Not allocated for the process set
+	 * snapshots, which have their own buffers */
+	char* buffer;
 
 	/* process common data reference counter */
 	int ref_count;
@@ -87,8 +104,15 @@ typedef struct sp_measure_proc_data_t {
 	/* common process data, initialized at the beginning and not a subject to change */
 	sp_measure_proc_common_t* common;
 
-	/* the snapshot name */
-	char* name;
+	/* the snapshot name, empty if not set. The name is stored inline
+	 * so taking a named snapshot does not allocate memory */
+	char name[SP_MEASURE_NAME_SIZE];
+
+	/* the snapshot CLOCK_MONOTONIC timestamp in nanoseconds */
+	int64_t timestamp_ns;
+	/* the intended snapshot time of the sampling schedule, 0 if the
+	 * snapshot was not stamped by a schedule, see sp_measure_schedule_stamp_proc() */
+	int64_t scheduled_ns;
 
 	/* process memory statistics (from /proc/<pid>/smaps) */
 	int mem_private_clean;
@@ -116,6 +140,9 @@ typedef struct sp_measure_proc_data_t {
  * name are retrieved from system. Otherwise they are copied from the
  * sample_data structure.
  * The rest of parameters are reseted to zero values.
+ * The snapshots initialized from the same sample share the common process
+ * data including the smaps parse buffer, so they must not be taken
+ * concurrently from different threads.
  * Afterwards the internal data structure data must be freed with
  * sp_measure_free_proc_data() function.
  * @param[out] new_data    the process snapshot data structure to initialize.
@@ -139,6 +166,28 @@ int sp_measure_init_proc_data(
 		const sp_measure_proc_data_t* sample_data
 		);
 
+/**
+ * Initializes process snapshot data structure of the specified context.
+ *
+ * See sp_measure_init_proc_data() function. The snapshots initialized from
+ * the sample_data snapshot use the context of the sample_data snapshot.
+ * @param[in] ctx          the library context, NULL for the default context.
+ * @param[out] new_data    the process snapshot data structure to initialize.
+ * @param[in] pid          the process id (ignored if sample_data is given).
+ * @param[in] resources    a flag specifying which initial process resource
+ *                         statistics should be retrieved (ignored if
+ *                         sample_data is given).
+ * @param[in] sample_data  An already initialized process snapshot.
+ * @return                 see sp_measure_init_proc_data() function.
+ */
+int sp_measure_init_proc_data_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_proc_data_t* new_data,
+		int pid,
+		int resources,
+		const sp_measure_proc_data_t* sample_data
+		);
+
 
 /**
  * Reinitializes process snapshot data structure.
@@ -167,10 +216,23 @@ int sp_measure_free_proc_data(
  * Retrieves process resource usage snapshot.
  *
  * The data data structure must be initialized by sp_measure_init_proc_data() or
- * sp_measure_init_cloned_proc_data() functions.
+ * sp_measure_init_cloned_proc_data() functions. Snapshots sharing the same
+ * common process data must not be taken concurrently.
  * @param[out] data      the process statistics data structure.
  * @param[in] resources  a flag specifying which process resource statistics
- *                       should be retrieved
+ *                       should be retrieved. SNAPSHOT_PROC_MEM_USAGE retrieves all
+ *                       memory fields, the SNAPSHOT_PROC_MEM_<field> identifiers
+ *                       only the specified fields. The memory fields are read from
+ *                       the cheapest source providing them - the memory size and
+ *                       resident memory from /proc/<pid>/statm, the swap usage from
+ *                       /proc/<pid>/status and the rest by summing up every mapping
+ *                       in /proc/<pid>/smaps. The fields not provided by the used
+ *                       source are set to ESPMEASURE_UNDEFINED.
+ *                       If SNAPSHOT_PROC_MEM_ROLLUP is set, the smaps fields are
+ *                       read from the /proc/<pid>/smaps_rollup totals instead.
+ *                       Without rollup support in kernel the smaps file is used
+ *                       instead. In rollup mode the memory size is the VmSize
+ *                       value of /proc/<pid>/status.
  * @param[in] name       the snapshot name (optional). Can be NULL if snapshot naming
  *                       is not required.
  * @return               0  - success
@@ -187,6 +249,141 @@ int sp_measure_get_proc_data(
 		);
 
 
+/* process set worker pool, private to the library */
+struct sp_measure_proc_workers_t;
+
+/**
+ * Process set snapshot.
+ *
+ * Holds snapshots of a set of processes, which are all refreshed with
+ * a single sp_measure_get_proc_set_data() call sharing one parse buffer.
+ */
+typedef struct sp_measure_proc_set_t {
+	/* the number of processes in the set */
+	int count;
+	/* the process identifiers */
+	int* pids;
+	/* the process snapshots, data[i] is the snapshot of process pids[i] */
+	sp_measure_proc_data_t* data;
+	/* bitmap of processes which resource usage statistics retrieval
+	 * failed during the last snapshot, see FIELD_PROC_SET_FAILED() */
+	unsigned int* failed;
+
+	/* the parse buffer shared by all process snapshots */
+	char* buffer;
+	/* the parse buffer size */
+	int buffer_size;
+
+	/* the worker pool for parallel snapshots, NULL if disabled */
+	struct sp_measure_proc_workers_t* workers;
+} sp_measure_proc_set_t;
+
+
+/**
+ * Initializes process set snapshot data structure.
+ *
+ * If sample_set parameter is NULL every process snapshot is initialized
+ * as with sp_measure_init_proc_data(). Otherwise the process identifiers
+ * and the 'global' process parameters are copied from the sample_set
+ * structure.
+ * Afterwards the internal data structure must be freed with
+ * sp_measure_free_proc_set() function.
+ * @param[out] new_set     the process set data structure to initialize.
+ * @param[in] pids         the process identifiers (ignored if sample_set is given).
+ * @param[in] count        the number of process identifiers (ignored if
+ *                         sample_set is given).
+ * @param[in] resources    a flag specifying which initial process resource
+ *                         statistics should be retrieved (ignored if
+ *                         sample_set is given).
+ * @param[in] sample_set   An already initialized process set.
+ * @return                 0  - success
+ *                         <0 - unrecoverable error during initialization.
+ */
+int sp_measure_init_proc_set(
+		sp_measure_proc_set_t* new_set,
+		const int* pids,
+		int count,
+		int resources,
+		const sp_measure_proc_set_t* sample_set
+		);
+
+/**
+ * Initializes process set snapshot data structure of the specified context.
+ *
+ * See sp_measure_init_proc_set() function.
+ * @param[in] ctx          the library context, NULL for the default context.
+ * @param[out] new_set     the process set data structure to initialize.
+ * @param[in] pids         the process identifiers (ignored if sample_set is given).
+ * @param[in] count        the number of process identifiers (ignored if
+ *                         sample_set is given).
+ * @param[in] resources    a flag specifying which initial process resource
+ *                         statistics should be retrieved (ignored if
+ *                         sample_set is given).
+ * @param[in] sample_set   An already initialized process set.
+ * @return                 0  - success
+ *                         <0 - unrecoverable error during initialization.
+ */
+int sp_measure_init_proc_set_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_proc_set_t* new_set,
+		const int* pids,
+		int count,
+		int resources,
+		const sp_measure_proc_set_t* sample_set
+		);
+
+/**
+ * Releases process set snapshot data structure.
+ *
+ * @param[in] set    the process set data structure to free.
+ * @return           0 for success.
+ */
+int sp_measure_free_proc_set(
+		sp_measure_proc_set_t* set
+		);
+
+/**
+ * Retrieves resource usage snapshots of all processes in the set.
+ *
+ * Unlike sp_measure_get_proc_data() this function does not check
+ * separately if the processes still exist. Instead the processes which
+ * statistics could not be fully retrieved (including the exited processes)
+ * are marked in the failed bitmap.
+ * @param[in,out] set    the process set.
+ * @param[in] resources  a flag specifying which process resource statistics
+ *                       should be retrieved (see sp_measure_get_proc_data()).
+ * @return               >=0 - the number of processes which statistics
+ *                             retrieval failed.
+ *                       <0  - unrecoverable error.
+ */
+int sp_measure_get_proc_set_data(
+		sp_measure_proc_set_t* set,
+		int resources
+		);
+
+/**
+ * Configures parallel process set snapshots.
+ *
+ * By default process set snapshots are taken in the calling thread.
+ * This function creates a pool of worker threads which take the snapshots
+ * in parallel. Every worker has its own parse buffer and a queue of
+ * processes to sample. A worker which has run out of processes steals
+ * half of the remaining processes from the queue of another worker, so
+ * a single process with huge smaps file does not stall the whole set.
+ * The thread calling sp_measure_get_proc_set_data() acts as one of the
+ * workers.
+ * @param[in,out] set    the process set.
+ * @param[in] count      the number of workers. 0 - use the number of online
+ *                       cpus, 1 - disable parallel snapshots.
+ * @return               >0 - the number of workers.
+ *                       <0 - failed to create the worker threads.
+ */
+int sp_measure_proc_set_workers(
+		sp_measure_proc_set_t* set,
+		int count
+		);
+
+
 /**
  * The process snapshot field comparison functions.
  *
@@ -228,12 +425,28 @@ int sp_measure_diff_proc_cpu_ticks(
 		int* diff
 		);
 
+/**
+ * Retrieves time difference between two process snapshots (in nanoseconds).
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the CLOCK_MONOTONIC time difference in nanoseconds.
+ * @return           0 for success.
+ */
+int sp_measure_diff_proc_timestamp_ns(
+		const sp_measure_proc_data_t* data1,
+		const sp_measure_proc_data_t* data2,
+		int64_t* diff
+		);
+
 /*
  * Field access definitions
  */
 
 #define FIELD_PROC_PID(data)                 (data)->common->pid
 #define FIELD_PROC_NAME(data)                (data)->common->name
+#define FIELD_PROC_TIMESTAMP_NS(data)        (data)->timestamp_ns
+#define FIELD_PROC_SCHEDULED_NS(data)        (data)->scheduled_ns
 #define FIELD_PROC_MEM_PRIVATE_CLEAN(data)   (data)->mem_private_clean
 #define FIELD_PROC_MEM_PRIVATE_DIRTY(data)   (data)->mem_private_dirty
 #define FIELD_PROC_MEM_SWAP(data)            (data)->mem_swap
@@ -248,6 +461,10 @@ int sp_measure_diff_proc_cpu_ticks(
 #define FIELD_PROC_CPU_STIME(data)           (data)->cpu_stime
 #define FIELD_PROC_CPU_UTIME(data)           (data)->cpu_utime
 
+#define FIELD_PROC_SET_DATA(set, index)      (&(set)->data[index])
+#define FIELD_PROC_SET_FAILED(set, index)    (((set)->failed[(index) / (8 * sizeof(unsigned int))] >> \
+                                             ((index) % (8 * sizeof(unsigned int)))) & 1)
+
 #ifdef __cplusplus
 }
 #endif
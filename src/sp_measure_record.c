@@ -0,0 +1,694 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Private API
+ */
+
+/* aligns size to 8 bytes */
+#define RECORD_ALIGN(size)		(((size) + 7) & ~7)
+
+/**
+ * Record field source kinds.
+ */
+enum {
+	SOURCE_SYS,        /* system snapshot structure field */
+	SOURCE_PROC,       /* process snapshot structure field */
+	SOURCE_FREQ,       /* ticks spent at the cpu frequency */
+	SOURCE_CORE_TOTAL, /* total ticks of a cpu core */
+	SOURCE_CORE_IDLE,  /* idle ticks of a cpu core */
+};
+
+/**
+ * Record field source.
+ */
+struct sp_measure_record_source_t {
+	/* the source kind */
+	int kind;
+	/* the value size in bytes */
+	int size;
+	/* the value offset in the snapshot structure */
+	size_t data_offset;
+	/* the process, cpu frequency or cpu core index */
+	int index;
+	/* the value offset in the record */
+	int offset;
+};
+
+/**
+ * Snapshot structure field definition.
+ */
+typedef struct record_field_def_t {
+	/* the resource providing the field */
+	int resource;
+	/* the field name */
+	const char* name;
+	/* the value size in bytes */
+	int size;
+	/* the value offset in the snapshot structure */
+	size_t offset;
+	/* the field flags, see sp_measure_record_field_flags_t */
+	int flags;
+} record_field_def_t;
+
+#define SYS_FIELD(resource, name, field, flags) \
+	{ resource, name, sizeof(((sp_measure_sys_data_t*)0)->field), offsetof(sp_measure_sys_data_t, field), flags }
+
+#define PROC_FIELD(resource, name, field, flags) \
+	{ resource, name, sizeof(((sp_measure_proc_data_t*)0)->field), offsetof(sp_measure_proc_data_t, field), flags }
+
+#define COUNTER		SP_MEASURE_RECORD_FIELD_COUNTER
+#define GAUGE		0
+
+static const record_field_def_t sys_fields[] = {
+	SYS_FIELD(SNAPSHOT_SYS_TIMESTAMP, "timestamp_ns", timestamp_ns, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_TIMESTAMP, "boottime_ns", timestamp_boottime_ns, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_USAGE, "mem_free", mem_free, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_USAGE, "mem_buffers", mem_buffers, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_USAGE, "mem_cached", mem_cached, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_USAGE, "mem_swap_free", mem_swap_free, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_USAGE, "mem_swap_cached", mem_swap_cached, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_CGROUPS, "mem_cgroup", mem_cgroup, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_MEM_WATERMARK, "mem_watermark", mem_watermark, GAUGE),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks_total", cpu_ticks_total, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks_idle", cpu_ticks_idle, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.user", cpu_ticks.user, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.nice", cpu_ticks.nice, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.system", cpu_ticks.system, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.idle", cpu_ticks.idle, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.iowait", cpu_ticks.iowait, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.irq", cpu_ticks.irq, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.softirq", cpu_ticks.softirq, COUNTER),
+	SYS_FIELD(SNAPSHOT_SYS_CPU_USAGE, "cpu_ticks.steal", cpu_ticks.steal, COUNTER),
+};
+
+static const record_field_def_t proc_fields[] = {
+	PROC_FIELD(SNAPSHOT_PROC_TIMESTAMP, "timestamp_ns", timestamp_ns, COUNTER),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_PRIVATE_CLEAN, "mem_private_clean", mem_private_clean, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_PRIVATE_DIRTY, "mem_private_dirty", mem_private_dirty, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_SWAP, "mem_swap", mem_swap, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_SIZE, "mem_size", mem_size, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_SHARED_CLEAN, "mem_shared_clean", mem_shared_clean, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_SHARED_DIRTY, "mem_shared_dirty", mem_shared_dirty, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_PSS, "mem_pss", mem_pss, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_RSS, "mem_rss", mem_rss, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_MEM_REFERENCED, "mem_referenced", mem_referenced, GAUGE),
+	PROC_FIELD(SNAPSHOT_PROC_CPU_USAGE, "cpu_stime", cpu_stime, COUNTER),
+	PROC_FIELD(SNAPSHOT_PROC_CPU_USAGE, "cpu_utime", cpu_utime, COUNTER),
+};
+
+/* /proc/meminfo key names, indexed by sp_measure_meminfo_key_t */
+static const char* meminfo_names[MEMINFO_COUNT] = {
+	"MemTotal", "MemFree", "MemAvailable", "Buffers", "Cached", "SwapCached",
+	"Active", "Inactive", "Active(anon)", "Inactive(anon)", "Active(file)",
+	"Inactive(file)", "Unevictable", "Mlocked", "SwapTotal", "SwapFree",
+	"Dirty", "Writeback", "AnonPages", "Mapped", "Shmem", "Slab",
+	"SReclaimable", "SUnreclaim", "KernelStack", "PageTables", "CommitLimit",
+	"Committed_AS", "VmallocUsed", "AnonHugePages", "ShmemHugePages",
+	"HugePages_Total", "HugePages_Free", "Hugepagesize",
+};
+
+/**
+ * Adds a field to the record layout.
+ *
+ * @param[in,out] fields   the field descriptors.
+ * @param[in,out] sources  the field sources.
+ * @param[in,out] count    the number of added fields.
+ * @param[in] proc         the process index or -1 for system fields.
+ * @param[in] kind         the source kind.
+ * @param[in] flags        the field flags.
+ * @param[in] size         the value size.
+ * @param[in] data_offset  the value offset in snapshot structure.
+ * @param[in] index        the source index.
+ * @param[in] format       the field name format.
+ */
+static void record_add_field(
+		sp_measure_record_field_t* fields,
+		struct sp_measure_record_source_t* sources,
+		int* count,
+		int proc,
+		int kind,
+		int flags,
+		int size,
+		size_t data_offset,
+		int index,
+		const char* format,
+		...
+		) __attribute__((format(printf, 10, 11)));
+
+static void record_add_field(
+		sp_measure_record_field_t* fields,
+		struct sp_measure_record_source_t* sources,
+		int* count,
+		int proc,
+		int kind,
+		int flags,
+		int size,
+		size_t data_offset,
+		int index,
+		const char* format,
+		...
+		)
+{
+	va_list ap;
+	sp_measure_record_field_t* field = &fields[*count];
+	struct sp_measure_record_source_t* source = &sources[*count];
+	va_start(ap, format);
+	vsnprintf(field->name, sizeof(field->name), format, ap);
+	va_end(ap);
+	field->proc = proc;
+	field->size = size;
+	field->flags = flags;
+	source->kind = kind;
+	source->size = size;
+	source->data_offset = data_offset;
+	source->index = index;
+	(*count)++;
+}
+
+/**
+ * Builds the record layout.
+ *
+ * @param[out] fields     the field descriptors (can be NULL to only count the fields).
+ * @param[out] sources    the field sources.
+ * @param[in] sys         the sample system snapshot.
+ * @param[in] sys_resources   the recorded system resources.
+ * @param[in] proc_count      the number of recorded processes.
+ * @param[in] proc_resources  the recorded process resources.
+ * @return                the number of fields.
+ */
+static int record_build_fields(
+		sp_measure_record_field_t* fields,
+		struct sp_measure_record_source_t* sources,
+		const sp_measure_sys_data_t* sys,
+		int sys_resources,
+		int proc_count,
+		int proc_resources
+		)
+{
+	int count = 0, i, j;
+	if (proc_resources & SNAPSHOT_PROC_MEM_USAGE) proc_resources |= SNAPSHOT_PROC_MEM_FIELDS;
+	if (fields == NULL) {
+		for (i = 0; i < ARRAY_ITEMS(sys_fields); i++) {
+			if (sys_resources & sys_fields[i].resource) count++;
+		}
+		if (sys_resources & SNAPSHOT_SYS_MEM_DETAILS) count += MEMINFO_COUNT;
+		if (sys_resources & SNAPSHOT_SYS_CPU_FREQ) count += sys->cpu_freq_ticks_count;
+		if (sys_resources & SNAPSHOT_SYS_CPU_CORE_USAGE) count += sys->cpu_core_count * 2;
+		for (i = 0; i < ARRAY_ITEMS(proc_fields); i++) {
+			if (proc_resources & proc_fields[i].resource) count += proc_count;
+		}
+		return count;
+	}
+	for (i = 0; i < ARRAY_ITEMS(sys_fields); i++) {
+		const record_field_def_t* def = &sys_fields[i];
+		if (sys_resources & def->resource) {
+			record_add_field(fields, sources, &count, -1, SOURCE_SYS, def->flags, def->size, def->offset, 0, "%s", def->name);
+		}
+	}
+	if (sys_resources & SNAPSHOT_SYS_MEM_DETAILS) {
+		for (i = 0; i < MEMINFO_COUNT; i++) {
+			record_add_field(fields, sources, &count, -1, SOURCE_SYS, GAUGE, sizeof(int),
+					offsetof(sp_measure_sys_data_t, mem_details) + sizeof(int) * i, 0, "meminfo.%s", meminfo_names[i]);
+		}
+	}
+	if (sys_resources & SNAPSHOT_SYS_CPU_FREQ) {
+		for (i = 0; i < sys->cpu_freq_ticks_count; i++) {
+			record_add_field(fields, sources, &count, -1, SOURCE_FREQ, COUNTER, sizeof(int), 0, i,
+					"cpu_freq_ticks.%d", sys->cpu_freq_ticks[i].freq);
+		}
+	}
+	if (sys_resources & SNAPSHOT_SYS_CPU_CORE_USAGE) {
+		for (i = 0; i < sys->cpu_core_count; i++) {
+			record_add_field(fields, sources, &count, -1, SOURCE_CORE_TOTAL, COUNTER, sizeof(long long), 0, i, "cpu_core.%d.total", i);
+			record_add_field(fields, sources, &count, -1, SOURCE_CORE_IDLE, COUNTER, sizeof(long long), 0, i, "cpu_core.%d.idle", i);
+		}
+	}
+	for (j = 0; j < proc_count; j++) {
+		for (i = 0; i < ARRAY_ITEMS(proc_fields); i++) {
+			const record_field_def_t* def = &proc_fields[i];
+			if (proc_resources & def->resource) {
+				record_add_field(fields, sources, &count, j, SOURCE_PROC, def->flags, def->size, def->offset, j, "%s", def->name);
+			}
+		}
+	}
+	return count;
+}
+
+/**
+ * Compressed block index.
+ */
+struct sp_measure_record_blocks_t {
+	/* the number of blocks */
+	int count;
+	/* the block offsets in file */
+	size_t* offsets;
+	/* the decoded records of the cached block */
+	char* records;
+	/* the cached block index, -1 if none */
+	int cached;
+};
+
+/**
+ * Writes data to file.
+ *
+ * @param[in] fd     the file descriptor.
+ * @param[in] data   the data to write.
+ * @param[in] size   the data size.
+ * @return           0 for success.
+ */
+static int record_write_all(
+		int fd,
+		const char* data,
+		size_t size
+		)
+{
+	while (size) {
+		ssize_t n = write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -errno;
+		}
+		data += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/**
+ * Encodes the buffered records and writes them to compressed file.
+ *
+ * The buffered records are dropped if the block can't be written, so
+ * the record buffer is free for the following records.
+ * @param[in] writer   the recording file writer.
+ * @return             0 for success.
+ */
+static int record_write_block(
+		sp_measure_record_writer_t* writer
+		)
+{
+	if (writer->pending == 0) return 0;
+	int size = sp_measure_record_encode_block(&writer->header, writer->fields, writer->record,
+			writer->pending, writer->block, writer->block_size);
+	int rc = size < 0 ? size : record_write_all(writer->fd, writer->block, size);
+	if (rc == 0) writer->count += writer->pending;
+	writer->pending = 0;
+	return rc;
+}
+
+/**
+ * Builds the block index of compressed file.
+ *
+ * @param[in] reader   the recording file reader.
+ * @return             0 for success.
+ */
+static int record_index_blocks(
+		sp_measure_record_reader_t* reader
+		)
+{
+	const sp_measure_record_header_t* header = reader->header;
+	struct sp_measure_record_blocks_t* blocks;
+	sp_measure_record_block_t block;
+	int capacity = 0;
+	size_t offset;
+
+	if (header->block_records == 0) return -EINVAL;
+	blocks = (struct sp_measure_record_blocks_t*)calloc(1, sizeof(struct sp_measure_record_blocks_t));
+	if (blocks == NULL) return -ENOMEM;
+	reader->blocks = blocks;
+	blocks->cached = -1;
+	blocks->records = (char*)malloc((size_t)header->record_size * header->block_records);
+	if (blocks->records == NULL) return -ENOMEM;
+
+	/* every block except the last one must be full, so records can be
+	 * located by their index. Incomplete trailing block is ignored */
+	for (offset = header->header_size; offset + sizeof(block) <= reader->size; offset += block.size) {
+		memcpy(&block, reader->map + offset, sizeof(block));
+		if (block.size < sizeof(block) || offset + block.size > reader->size ||
+				block.count == 0 || block.count > header->block_records) {
+			break;
+		}
+		if (blocks->count == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			size_t* offsets = (size_t*)realloc(blocks->offsets, sizeof(size_t) * capacity);
+			if (offsets == NULL) return -ENOMEM;
+			blocks->offsets = offsets;
+		}
+		blocks->offsets[blocks->count++] = offset;
+		reader->count += block.count;
+		if (block.count < header->block_records) break;
+	}
+	return 0;
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_record_writer_open(
+		sp_measure_record_writer_t* writer,
+		const char* path,
+		const sp_measure_sys_data_t* sys,
+		int sys_resources,
+		const sp_measure_proc_data_t* procs,
+		int proc_count,
+		int proc_resources,
+		int flags
+		)
+{
+	int i, rc;
+	memset(writer, 0, sizeof(sp_measure_record_writer_t));
+	writer->fd = -1;
+	if (proc_count < 0 || (proc_count && procs == NULL)) return -EINVAL;
+
+	int field_count = record_build_fields(NULL, NULL, sys, sys_resources, proc_count, proc_resources);
+
+	sp_measure_record_header_t* header = &writer->header;
+	memcpy(header->magic, SP_MEASURE_RECORD_MAGIC, sizeof(header->magic));
+	header->version = SP_MEASURE_RECORD_VERSION;
+	header->byte_order = SP_MEASURE_RECORD_BYTE_ORDER;
+	header->sys_resources = sys_resources;
+	header->proc_resources = proc_count ? proc_resources : 0;
+	header->field_count = field_count;
+	header->fields_offset = sizeof(sp_measure_record_header_t);
+	header->proc_count = proc_count;
+	header->procs_offset = header->fields_offset + sizeof(sp_measure_record_field_t) * field_count;
+	header->freq_count = (sys_resources & SNAPSHOT_SYS_CPU_FREQ) ? sys->cpu_freq_ticks_count : 0;
+	header->freqs_offset = header->procs_offset + sizeof(sp_measure_record_proc_t) * proc_count;
+	header->header_size = RECORD_ALIGN(header->freqs_offset + sizeof(int32_t) * header->freq_count);
+	header->mem_total = sys->common->mem_total;
+	header->mem_swap = sys->common->mem_swap;
+	header->cpu_max_freq = sys->common->cpu_max_freq;
+	header->cpu_core_count = sys->cpu_core_count;
+	header->flags = flags;
+	header->block_records = (flags & SP_MEASURE_RECORD_COMPRESSED) ? SP_MEASURE_RECORD_BLOCK_RECORDS : 0;
+	header->start_time = time(NULL);
+	header->start_timestamp_ns = clock_read_ns(CLOCK_MONOTONIC);
+
+	char* buffer = (char*)calloc(1, header->header_size);
+	writer->sources = (struct sp_measure_record_source_t*)calloc(field_count ? field_count : 1,
+			sizeof(struct sp_measure_record_source_t));
+	writer->freqs = (int*)calloc(header->freq_count ? header->freq_count : 1, sizeof(int));
+	if (buffer == NULL || writer->sources == NULL || writer->freqs == NULL) {
+		rc = -ENOMEM;
+		goto failure;
+	}
+	sp_measure_record_field_t* fields = (sp_measure_record_field_t*)(buffer + header->fields_offset);
+	record_build_fields(fields, writer->sources, sys, sys_resources, proc_count, proc_resources);
+
+	/* place 64 bit values first to keep every value naturally aligned */
+	int offset = 0;
+	for (i = 0; i < field_count; i++) {
+		if (fields[i].size == sizeof(int64_t)) {
+			fields[i].offset = writer->sources[i].offset = offset;
+			offset += sizeof(int64_t);
+		}
+	}
+	for (i = 0; i < field_count; i++) {
+		if (fields[i].size != sizeof(int64_t)) {
+			fields[i].offset = writer->sources[i].offset = offset;
+			offset += sizeof(int32_t);
+		}
+	}
+	header->record_size = RECORD_ALIGN(offset ? offset : 1);
+
+	sp_measure_record_proc_t* proc_descs = (sp_measure_record_proc_t*)(buffer + header->procs_offset);
+	for (i = 0; i < proc_count; i++) {
+		proc_descs[i].pid = procs[i].common->pid;
+		if (procs[i].common->name) {
+			strncpy(proc_descs[i].name, procs[i].common->name, sizeof(proc_descs[i].name) - 1);
+		}
+	}
+	int32_t* freqs = (int32_t*)(buffer + header->freqs_offset);
+	for (i = 0; i < header->freq_count; i++) {
+		freqs[i] = writer->freqs[i] = sys->cpu_freq_ticks[i].freq;
+	}
+	memcpy(buffer, header, sizeof(sp_measure_record_header_t));
+
+	writer->fields = (sp_measure_record_field_t*)malloc(sizeof(sp_measure_record_field_t) * (field_count ? field_count : 1));
+	writer->record = (char*)calloc(header->block_records ? header->block_records : 1, header->record_size);
+	if (writer->fields == NULL || writer->record == NULL) {
+		rc = -ENOMEM;
+		goto failure;
+	}
+	memcpy(writer->fields, fields, sizeof(sp_measure_record_field_t) * field_count);
+	if (flags & SP_MEASURE_RECORD_COMPRESSED) {
+		writer->block_size = SP_MEASURE_RECORD_BLOCK_BOUND(header, header->block_records);
+		writer->block = (char*)malloc(writer->block_size);
+		if (writer->block == NULL) {
+			rc = -ENOMEM;
+			goto failure;
+		}
+	}
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (writer->fd == -1) {
+		rc = -errno;
+		goto failure;
+	}
+	if ( (rc = record_write_all(writer->fd, buffer, header->header_size)) != 0) {
+		goto failure;
+	}
+	free(buffer);
+	return 0;
+
+failure:
+	if (buffer) free(buffer);
+	sp_measure_record_writer_close(writer);
+	return rc;
+}
+
+int sp_measure_record_write(
+		sp_measure_record_writer_t* writer,
+		const sp_measure_sys_data_t* sys,
+		const sp_measure_proc_data_t* procs
+		)
+{
+	int i, freq_index = 0;
+	if (writer->fd == -1) return -EINVAL;
+	char* record = writer->record + (size_t)writer->header.record_size * writer->pending;
+	for (i = 0; i < writer->header.field_count; i++) {
+		const struct sp_measure_record_source_t* source = &writer->sources[i];
+		char* value = record + source->offset;
+		switch (source->kind) {
+			case SOURCE_SYS:
+				memcpy(value, (const char*)sys + source->data_offset, source->size);
+				break;
+
+			case SOURCE_PROC:
+				memcpy(value, (const char*)&procs[source->index] + source->data_offset, source->size);
+				break;
+
+			case SOURCE_FREQ: {
+				/* both the recorded and snapshot frequencies are sorted */
+				int freq = writer->freqs[source->index], ticks = ESPMEASURE_UNDEFINED;
+				while (freq_index < sys->cpu_freq_ticks_count && sys->cpu_freq_ticks[freq_index].freq < freq) {
+					freq_index++;
+				}
+				if (freq_index < sys->cpu_freq_ticks_count && sys->cpu_freq_ticks[freq_index].freq == freq) {
+					ticks = sys->cpu_freq_ticks[freq_index].ticks;
+				}
+				memcpy(value, &ticks, sizeof(int));
+				break;
+			}
+
+			case SOURCE_CORE_TOTAL:
+			case SOURCE_CORE_IDLE: {
+				long long ticks = ESPMEASURE_UNDEFINED;
+				if (source->index < sys->cpu_core_count) {
+					const sp_measure_cpu_ticks_t* core = &sys->cpu_core_ticks[source->index];
+					ticks = source->kind == SOURCE_CORE_TOTAL ? core->total : core->idle;
+				}
+				memcpy(value, &ticks, sizeof(long long));
+				break;
+			}
+		}
+	}
+	if (writer->header.flags & SP_MEASURE_RECORD_COMPRESSED) {
+		if (++writer->pending < writer->header.block_records) return 0;
+		return record_write_block(writer);
+	}
+	int rc = record_write_all(writer->fd, record, writer->header.record_size);
+	if (rc == 0) writer->count++;
+	return rc;
+}
+
+int sp_measure_record_writer_close(
+		sp_measure_record_writer_t* writer
+		)
+{
+	int rc = 0;
+	if (writer->fd != -1) {
+		rc = record_write_block(writer);
+		close(writer->fd);
+	}
+	if (writer->sources) free(writer->sources);
+	if (writer->fields) free(writer->fields);
+	if (writer->block) free(writer->block);
+	if (writer->freqs) free(writer->freqs);
+	if (writer->record) free(writer->record);
+	memset(writer, 0, sizeof(sp_measure_record_writer_t));
+	writer->fd = -1;
+	return rc;
+}
+
+int sp_measure_record_reader_open(
+		sp_measure_record_reader_t* reader,
+		const char* path
+		)
+{
+	struct stat st;
+	int i;
+	memset(reader, 0, sizeof(sp_measure_record_reader_t));
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return -errno;
+	if (fstat(fd, &st) != 0 || st.st_size < sizeof(sp_measure_record_header_t)) {
+		close(fd);
+		return -EINVAL;
+	}
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -errno;
+	reader->map = (const char*)map;
+	reader->size = st.st_size;
+
+	/* validate the header before trusting any offsets */
+	const sp_measure_record_header_t* header = (const sp_measure_record_header_t*)map;
+	if (memcmp(header->magic, SP_MEASURE_RECORD_MAGIC, sizeof(header->magic)) ||
+			header->version != SP_MEASURE_RECORD_VERSION ||
+			header->byte_order != SP_MEASURE_RECORD_BYTE_ORDER ||
+			header->header_size > reader->size || header->record_size == 0 ||
+			header->fields_offset + (uint64_t)header->field_count * sizeof(sp_measure_record_field_t) > header->header_size ||
+			header->procs_offset + (uint64_t)header->proc_count * sizeof(sp_measure_record_proc_t) > header->header_size ||
+			header->freqs_offset + (uint64_t)header->freq_count * sizeof(int32_t) > header->header_size) {
+		sp_measure_record_reader_close(reader);
+		return -EINVAL;
+	}
+	reader->header = header;
+	reader->fields = (const sp_measure_record_field_t*)(reader->map + header->fields_offset);
+	reader->procs = (const sp_measure_record_proc_t*)(reader->map + header->procs_offset);
+	reader->freqs = (const int32_t*)(reader->map + header->freqs_offset);
+	for (i = 0; i < header->field_count; i++) {
+		const sp_measure_record_field_t* field = &reader->fields[i];
+		if ((field->size != sizeof(int32_t) && field->size != sizeof(int64_t)) ||
+				field->offset + field->size > header->record_size) {
+			sp_measure_record_reader_close(reader);
+			return -EINVAL;
+		}
+	}
+	if (header->flags & SP_MEASURE_RECORD_COMPRESSED) {
+		int rc = record_index_blocks(reader);
+		if (rc != 0) {
+			sp_measure_record_reader_close(reader);
+			return rc;
+		}
+	}
+	else {
+		reader->count = (reader->size - header->header_size) / header->record_size;
+	}
+	return 0;
+}
+
+int sp_measure_record_reader_close(
+		sp_measure_record_reader_t* reader
+		)
+{
+	if (reader->map) munmap((void*)reader->map, reader->size);
+	if (reader->blocks) {
+		if (reader->blocks->offsets) free(reader->blocks->offsets);
+		if (reader->blocks->records) free(reader->blocks->records);
+		free(reader->blocks);
+	}
+	memset(reader, 0, sizeof(sp_measure_record_reader_t));
+	return 0;
+}
+
+const void* sp_measure_record_get(
+		const sp_measure_record_reader_t* reader,
+		int index
+		)
+{
+	if (index < 0 || index >= reader->count) return NULL;
+	if (reader->blocks) {
+		struct sp_measure_record_blocks_t* blocks = reader->blocks;
+		int block = index / reader->header->block_records;
+		if (block != blocks->cached) {
+			size_t offset = blocks->offsets[block];
+			blocks->cached = -1;
+			if (sp_measure_record_decode_block(reader->header, reader->fields, reader->map + offset,
+					reader->size - offset, blocks->records, reader->header->block_records) < 0) {
+				return NULL;
+			}
+			blocks->cached = block;
+		}
+		return blocks->records + (size_t)reader->header->record_size * (index % reader->header->block_records);
+	}
+	return reader->map + reader->header->header_size + (size_t)reader->header->record_size * index;
+}
+
+int sp_measure_record_find_field(
+		const sp_measure_record_reader_t* reader,
+		const char* name,
+		int proc
+		)
+{
+	int i;
+	for (i = 0; i < reader->header->field_count; i++) {
+		if (reader->fields[i].proc == proc && !strncmp(reader->fields[i].name, name, SP_MEASURE_RECORD_NAME_SIZE)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int64_t sp_measure_record_value(
+		const sp_measure_record_reader_t* reader,
+		const void* record,
+		int field
+		)
+{
+	const sp_measure_record_field_t* desc = &reader->fields[field];
+	const char* value = (const char*)record + desc->offset;
+	if (desc->size == sizeof(int64_t)) {
+		int64_t value64;
+		memcpy(&value64, value, sizeof(value64));
+		return value64;
+	}
+	int32_t value32;
+	memcpy(&value32, value, sizeof(value32));
+	return value32;
+}
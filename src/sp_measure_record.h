@@ -0,0 +1,439 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_RECORD_H
+#define SP_MEASURE_RECORD_H
+
+/** @file sp_measure_record.h
+ * API for recording snapshots into binary files.
+ *
+ * The recording file starts with a header describing the recorded
+ * resources, the common system and process parameters and the record
+ * field layout. The header is followed by fixed size records - one
+ * record per system snapshot, containing also the snapshots of the
+ * recorded processes.
+ *
+ * File layout (all values in the byte order of the recording device):
+ *   sp_measure_record_header_t                   header
+ *   sp_measure_record_field_t[field_count]       at header.fields_offset
+ *   int32_t[freq_count]                          recorded cpu frequencies
+ *                                                at header.freqs_offset
+ *   sp_measure_record_proc_t[proc_count]         at header.procs_offset
+ *   records                                      at header.header_size,
+ *                                                header.record_size bytes each
+ *
+ * 64 bit fields are aligned at 8 bytes and 32 bit fields at 4 bytes
+ * within a record. Unavailable values are stored as ESPMEASURE_UNDEFINED.
+ *
+ * In compressed files (SP_MEASURE_RECORD_COMPRESSED header flag) the records
+ * are stored in blocks of up to header.block_records records. Every block
+ * starts with sp_measure_record_block_t header and can be decoded
+ * independently with sp_measure_record_decode_block() function. Counter
+ * fields are stored as delta of delta values and gauge fields as XOR
+ * of the previous value, typically taking less than 2 bytes per value.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_record_writer_t writer;
+ *    sp_measure_get_sys_data(&sys, SNAPSHOT_SYS, NULL);
+ *    sp_measure_record_writer_open(&writer, "capture.spm", &sys, SNAPSHOT_SYS, NULL, 0, 0,
+ *            SP_MEASURE_RECORD_COMPRESSED);
+ *    while (running) {
+ *        sp_measure_get_sys_data(&sys, SNAPSHOT_SYS, NULL);
+ *        sp_measure_record_write(&writer, &sys, NULL);
+ *    }
+ *    sp_measure_record_writer_close(&writer);
+ *
+ *    sp_measure_record_reader_t reader;
+ *    sp_measure_record_reader_open(&reader, "capture.spm");
+ *    int field = sp_measure_record_find_field(&reader, "mem_free", -1);
+ *    for (i = 0; i < FIELD_RECORD_COUNT(&reader); i++) {
+ *        const void* record = sp_measure_record_get(&reader, i);
+ *        printf("%lld\n", (long long)sp_measure_record_value(&reader, record, field));
+ *    }
+ *    sp_measure_record_reader_close(&reader);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the recording file magic */
+#define SP_MEASURE_RECORD_MAGIC       "SPMEASUR"
+
+/* the recording file format version. Version 2 added the flags and
+ * block_records header fields, moving the following fields, so version 1
+ * files are not accepted */
+#define SP_MEASURE_RECORD_VERSION     2
+
+/* the byte order marker */
+#define SP_MEASURE_RECORD_BYTE_ORDER  0x01020304
+
+/* the maximum length of field and process names (including terminating zero) */
+#define SP_MEASURE_RECORD_NAME_SIZE   32
+
+/* the default number of records in compressed block */
+#define SP_MEASURE_RECORD_BLOCK_RECORDS  256
+
+/**
+ * Recording file flags.
+ */
+typedef enum {
+	SP_MEASURE_RECORD_COMPRESSED = 1 << 0,	/** records are stored in compressed blocks */
+} sp_measure_record_flags_t;
+
+/**
+ * Record field flags.
+ */
+typedef enum {
+	SP_MEASURE_RECORD_FIELD_COUNTER = 1 << 0,	/** monotonically growing counter, not a gauge */
+} sp_measure_record_field_flags_t;
+
+/**
+ * Recording file header.
+ */
+typedef struct sp_measure_record_header_t {
+	/* SP_MEASURE_RECORD_MAGIC */
+	char magic[8];
+	/* SP_MEASURE_RECORD_VERSION */
+	uint32_t version;
+	/* SP_MEASURE_RECORD_BYTE_ORDER, written in the recording device byte order */
+	uint32_t byte_order;
+	/* the total header size - offset of the first record */
+	uint32_t header_size;
+	/* the size of a record */
+	uint32_t record_size;
+
+	/* the recorded system resources, see sp_measure_sys_resource_t */
+	uint32_t sys_resources;
+	/* the recorded process resources, see sp_measure_proc_resource_t */
+	uint32_t proc_resources;
+
+	/* the field descriptors */
+	uint32_t field_count;
+	uint32_t fields_offset;
+	/* the recorded cpu frequencies (KHz) */
+	uint32_t freq_count;
+	uint32_t freqs_offset;
+	/* the recorded processes */
+	uint32_t proc_count;
+	uint32_t procs_offset;
+
+	/* the common system parameters, see sp_measure_sys_common_t */
+	int32_t mem_total;
+	int32_t mem_swap;
+	int32_t cpu_max_freq;
+	int32_t cpu_core_count;
+
+	/* the recording file flags, see sp_measure_record_flags_t */
+	uint32_t flags;
+	/* the maximum number of records in compressed block */
+	uint32_t block_records;
+
+	/* the recording start time - wall clock time in seconds since
+	 * the Epoch and the matching CLOCK_MONOTONIC timestamp */
+	int64_t start_time;
+	int64_t start_timestamp_ns;
+} sp_measure_record_header_t;
+
+/**
+ * Record field descriptor.
+ */
+typedef struct sp_measure_record_field_t {
+	/* the field name, for example "mem_free" or "cpu_freq_ticks.600000" */
+	char name[SP_MEASURE_RECORD_NAME_SIZE];
+	/* the process index for process fields, -1 for system fields */
+	int32_t proc;
+	/* the value size in bytes - 4 or 8 */
+	uint32_t size;
+	/* the value offset within record */
+	uint32_t offset;
+	/* the field flags, see sp_measure_record_field_flags_t */
+	uint32_t flags;
+} sp_measure_record_field_t;
+
+/**
+ * Recorded process descriptor.
+ */
+typedef struct sp_measure_record_proc_t {
+	/* the process id */
+	int32_t pid;
+	/* the process name, truncated if necessary */
+	char name[SP_MEASURE_RECORD_NAME_SIZE];
+	uint32_t reserved;
+} sp_measure_record_proc_t;
+
+
+/**
+ * Compressed record block header.
+ */
+typedef struct sp_measure_record_block_t {
+	/* the block size in bytes, including this header */
+	uint32_t size;
+	/* the number of records in block */
+	uint32_t count;
+} sp_measure_record_block_t;
+
+
+/* record field sources, private to the library */
+struct sp_measure_record_source_t;
+
+/* compressed block index, private to the library */
+struct sp_measure_record_blocks_t;
+
+/**
+ * Recording file writer.
+ */
+typedef struct sp_measure_record_writer_t {
+	/* the recording file descriptor */
+	int fd;
+	/* the recording file header */
+	sp_measure_record_header_t header;
+	/* the record field sources */
+	struct sp_measure_record_source_t* sources;
+	/* the record field descriptors */
+	sp_measure_record_field_t* fields;
+	/* the recorded cpu frequencies */
+	int* freqs;
+	/* the record buffer, holds block_records records in compressed files */
+	char* record;
+	/* the number of buffered records not yet written to compressed file */
+	int pending;
+	/* the compressed block buffer */
+	char* block;
+	/* the compressed block buffer size */
+	size_t block_size;
+	/* the number of written records */
+	int count;
+} sp_measure_record_writer_t;
+
+/**
+ * Recording file reader.
+ */
+typedef struct sp_measure_record_reader_t {
+	/* the mapped file */
+	const char* map;
+	/* the mapped file size */
+	size_t size;
+	/* the recording file header */
+	const sp_measure_record_header_t* header;
+	/* the field descriptors */
+	const sp_measure_record_field_t* fields;
+	/* the recorded cpu frequencies */
+	const int32_t* freqs;
+	/* the recorded processes */
+	const sp_measure_record_proc_t* procs;
+	/* the number of complete records in file */
+	int count;
+	/* the block index of compressed file */
+	struct sp_measure_record_blocks_t* blocks;
+} sp_measure_record_reader_t;
+
+
+/**
+ * Creates a new recording file.
+ *
+ * The record layout is derived from the specified resources and the
+ * sample snapshots. The sample system snapshot should have been already
+ * taken, as the recorded cpu frequencies and cpu cores are taken from it.
+ * Afterwards the writer must be closed with sp_measure_record_writer_close()
+ * function.
+ * @param[out] writer        the writer to initialize.
+ * @param[in] path           the recording file path. Existing file is truncated.
+ * @param[in] sys            the sample system snapshot.
+ * @param[in] sys_resources  the recorded system resources.
+ * @param[in] procs          the sample process snapshots (can be NULL if
+ *                           proc_count is 0).
+ * @param[in] proc_count     the number of recorded processes.
+ * @param[in] proc_resources the recorded process resources.
+ * @param[in] flags          the recording file flags, see sp_measure_record_flags_t.
+ * @return                   0 for success, negative error code otherwise.
+ */
+int sp_measure_record_writer_open(
+		sp_measure_record_writer_t* writer,
+		const char* path,
+		const sp_measure_sys_data_t* sys,
+		int sys_resources,
+		const sp_measure_proc_data_t* procs,
+		int proc_count,
+		int proc_resources,
+		int flags
+		);
+
+/**
+ * Appends a record to the recording file.
+ *
+ * Compressed files are written a block at a time, so the records are
+ * buffered until the block is full or the writer is closed. If the block
+ * can't be written, its records are dropped and the error is returned.
+ * @param[in] writer   the recording file writer.
+ * @param[in] sys      the system snapshot.
+ * @param[in] procs    the process snapshots, in the same order as given to
+ *                     sp_measure_record_writer_open() function.
+ * @return             0 for success, negative error code otherwise.
+ */
+int sp_measure_record_write(
+		sp_measure_record_writer_t* writer,
+		const sp_measure_sys_data_t* sys,
+		const sp_measure_proc_data_t* procs
+		);
+
+/**
+ * Closes the recording file.
+ *
+ * Writes the buffered records of compressed file.
+ * @param[in] writer   the recording file writer.
+ * @return             0 for success.
+ */
+int sp_measure_record_writer_close(
+		sp_measure_record_writer_t* writer
+		);
+
+/**
+ * Opens recording file for reading.
+ *
+ * The file is mapped into memory and records are accessed directly
+ * from the mapped memory. Incomplete trailing record is ignored.
+ * The records of compressed files are decoded a block at a time into
+ * the reader buffer.
+ * @param[out] reader   the reader to initialize.
+ * @param[in] path      the recording file path.
+ * @return              0 for success, negative error code otherwise.
+ */
+int sp_measure_record_reader_open(
+		sp_measure_record_reader_t* reader,
+		const char* path
+		);
+
+/**
+ * Closes the recording file.
+ *
+ * @param[in] reader   the recording file reader.
+ * @return             0 for success.
+ */
+int sp_measure_record_reader_close(
+		sp_measure_record_reader_t* reader
+		);
+
+/**
+ * Retrieves a record.
+ *
+ * @param[in] reader   the recording file reader.
+ * @param[in] index    the record index.
+ * @return             the record or NULL if index is out of range. The records
+ *                     of compressed files stay valid only until a record
+ *                     from another block is retrieved.
+ */
+const void* sp_measure_record_get(
+		const sp_measure_record_reader_t* reader,
+		int index
+		);
+
+/**
+ * Finds record field by its name.
+ *
+ * @param[in] reader   the recording file reader.
+ * @param[in] name     the field name.
+ * @param[in] proc     the process index for process fields, -1 for system fields.
+ * @return             the field index or -1 if the field was not recorded.
+ */
+int sp_measure_record_find_field(
+		const sp_measure_record_reader_t* reader,
+		const char* name,
+		int proc
+		);
+
+/**
+ * Retrieves record field value.
+ *
+ * @param[in] reader   the recording file reader.
+ * @param[in] record   the record.
+ * @param[in] field    the field index.
+ * @return             the field value.
+ */
+int64_t sp_measure_record_value(
+		const sp_measure_record_reader_t* reader,
+		const void* record,
+		int field
+		);
+
+/**
+ * Encodes records into a compressed block.
+ *
+ * @param[in] header    the recording file header.
+ * @param[in] fields    the record field descriptors.
+ * @param[in] records   the records to encode.
+ * @param[in] count     the number of records.
+ * @param[out] block    the output buffer.
+ * @param[in] size      the output buffer size, see SP_MEASURE_RECORD_BLOCK_BOUND.
+ * @return              the block size or negative error code
+ *                      (-ENOSPC if the output buffer is too small).
+ */
+int sp_measure_record_encode_block(
+		const sp_measure_record_header_t* header,
+		const sp_measure_record_field_t* fields,
+		const void* records,
+		int count,
+		void* block,
+		size_t size
+		);
+
+/**
+ * Decodes a compressed block.
+ *
+ * @param[in] header    the recording file header.
+ * @param[in] fields    the record field descriptors.
+ * @param[in] block     the compressed block.
+ * @param[in] size      the available block data size.
+ * @param[out] records  the decoded records.
+ * @param[in] max_count the maximum number of records to decode.
+ * @return              the number of decoded records or negative error code.
+ */
+int sp_measure_record_decode_block(
+		const sp_measure_record_header_t* header,
+		const sp_measure_record_field_t* fields,
+		const void* block,
+		size_t size,
+		void* records,
+		int max_count
+		);
+
+/* the maximum size of compressed block - 78 bits per value in the worst case */
+#define SP_MEASURE_RECORD_BLOCK_BOUND(header, count) \
+	(sizeof(sp_measure_record_block_t) + ((size_t)(header)->field_count * (count) * 78 + 7) / 8)
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_RECORD_COUNT(reader)           (reader)->count
+#define FIELD_RECORD_FIELD_COUNT(reader)     (reader)->header->field_count
+#define FIELD_RECORD_FIELD(reader, index)    (&(reader)->fields[index])
+#define FIELD_RECORD_PROC_COUNT(reader)      (reader)->header->proc_count
+#define FIELD_RECORD_PROC(reader, index)     (&(reader)->procs[index])
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/*
+ * Compressed record block encoding.
+ *
+ * A block is a sp_measure_record_block_t header followed by a bit stream
+ * containing the block records column by column. The first value of
+ * every column is stored as is (64 bits), the following values are
+ * encoded depending on the field kind (Gorilla, Pelkonen et al. 2015):
+ *
+ * Counters (SP_MEASURE_RECORD_FIELD_COUNTER) - delta of delta:
+ *   '0'                      - the same delta as before
+ *   '10'    + 7 bits         - zigzag encoded delta of delta
+ *   '110'   + 12 bits
+ *   '1110'  + 20 bits
+ *   '11110' + 32 bits
+ *   '11111' + 64 bits
+ *
+ * Gauges - XOR with the previous value:
+ *   '0'                      - the same value as before
+ *   '10' + meaningful bits   - the XOR fits into the previous
+ *                              leading/trailing zero window
+ *   '11' + 6 bits leading zeros + 6 bits (length - 1) + meaningful bits
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Private API
+ */
+
+/**
+ * Bit stream.
+ */
+typedef struct bit_stream_t {
+	/* the stream data */
+	uint8_t* data;
+	/* the stream size in bits */
+	size_t size;
+	/* the current position in bits */
+	size_t pos;
+	/* set when reading or writing past the end of stream */
+	bool overflow;
+} bit_stream_t;
+
+/* the delta of delta value widths, see the encoding description above */
+static const int dod_bits[] = {7, 12, 20, 32, 64};
+
+/**
+ * Writes bits to stream.
+ *
+ * The stream data must be zero initialized.
+ * @param[in] stream   the bit stream.
+ * @param[in] value    the value to write.
+ * @param[in] nbits    the number of lowest value bits to write (1-64).
+ */
+static void bits_write(
+		bit_stream_t* stream,
+		uint64_t value,
+		int nbits
+		)
+{
+	if (stream->pos + nbits > stream->size) {
+		stream->overflow = true;
+		return;
+	}
+	while (nbits > 0) {
+		int room = 8 - (stream->pos & 7);
+		int n = nbits < room ? nbits : room;
+		uint8_t chunk = (value >> (nbits - n)) & ((1U << n) - 1);
+		stream->data[stream->pos >> 3] |= chunk << (room - n);
+		stream->pos += n;
+		nbits -= n;
+	}
+}
+
+/**
+ * Reads bits from stream.
+ *
+ * @param[in] stream   the bit stream.
+ * @param[in] nbits    the number of bits to read (1-64).
+ * @return             the read value.
+ */
+static uint64_t bits_read(
+		bit_stream_t* stream,
+		int nbits
+		)
+{
+	uint64_t value = 0;
+	if (stream->pos + nbits > stream->size) {
+		stream->overflow = true;
+		return 0;
+	}
+	while (nbits > 0) {
+		int room = 8 - (stream->pos & 7);
+		int n = nbits < room ? nbits : room;
+		uint8_t chunk = (stream->data[stream->pos >> 3] >> (room - n)) & ((1U << n) - 1);
+		value = (value << n) | chunk;
+		stream->pos += n;
+		nbits -= n;
+	}
+	return value;
+}
+
+/**
+ * Counts the leading '1' bits of a prefix code.
+ *
+ * @param[in] stream   the bit stream.
+ * @param[in] max      the maximum prefix length.
+ * @return             the number of '1' bits read.
+ */
+static int bits_read_prefix(
+		bit_stream_t* stream,
+		int max
+		)
+{
+	int n = 0;
+	while (n < max && bits_read(stream, 1)) n++;
+	return n;
+}
+
+/**
+ * Reads a field value from record.
+ */
+static int64_t record_read_value(
+		const char* record,
+		const sp_measure_record_field_t* field
+		)
+{
+	if (field->size == sizeof(int64_t)) {
+		int64_t value;
+		memcpy(&value, record + field->offset, sizeof(value));
+		return value;
+	}
+	int32_t value;
+	memcpy(&value, record + field->offset, sizeof(value));
+	return value;
+}
+
+/**
+ * Writes a field value into record.
+ */
+static void record_write_value(
+		char* record,
+		const sp_measure_record_field_t* field,
+		int64_t value
+		)
+{
+	if (field->size == sizeof(int64_t)) {
+		memcpy(record + field->offset, &value, sizeof(value));
+	}
+	else {
+		int32_t value32 = (int32_t)value;
+		memcpy(record + field->offset, &value32, sizeof(value32));
+	}
+}
+
+/**
+ * Encodes counter column as delta of delta values.
+ */
+static void encode_counter(
+		bit_stream_t* stream,
+		const char* records,
+		int record_size,
+		int count,
+		const sp_measure_record_field_t* field
+		)
+{
+	int i, bucket;
+	int64_t prev = record_read_value(records, field), prev_delta = 0;
+	bits_write(stream, prev, 64);
+	for (i = 1; i < count; i++) {
+		int64_t value = record_read_value(records + (size_t)record_size * i, field);
+		int64_t delta = (int64_t)((uint64_t)value - (uint64_t)prev);
+		int64_t dod = (int64_t)((uint64_t)delta - (uint64_t)prev_delta);
+		uint64_t zz = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+		if (zz == 0) {
+			bits_write(stream, 0, 1);
+		}
+		else {
+			for (bucket = 0; bucket < ARRAY_ITEMS(dod_bits) - 1; bucket++) {
+				if (zz < (1ULL << dod_bits[bucket])) break;
+			}
+			/* bucket+1 '1' bits, terminated by '0' unless it's the last bucket */
+			if (bucket < ARRAY_ITEMS(dod_bits) - 1) {
+				bits_write(stream, ((1ULL << (bucket + 1)) - 1) << 1, bucket + 2);
+			}
+			else {
+				bits_write(stream, (1ULL << (bucket + 1)) - 1, bucket + 1);
+			}
+			bits_write(stream, zz, dod_bits[bucket]);
+		}
+		prev = value;
+		prev_delta = delta;
+	}
+}
+
+/**
+ * Decodes delta of delta encoded counter column.
+ */
+static void decode_counter(
+		bit_stream_t* stream,
+		char* records,
+		int record_size,
+		int count,
+		const sp_measure_record_field_t* field
+		)
+{
+	int i;
+	uint64_t prev = bits_read(stream, 64), prev_delta = 0;
+	record_write_value(records, field, prev);
+	for (i = 1; i < count; i++) {
+		int bucket = bits_read_prefix(stream, ARRAY_ITEMS(dod_bits));
+		uint64_t dod = 0;
+		if (bucket) {
+			uint64_t zz = bits_read(stream, dod_bits[bucket - 1]);
+			dod = (zz >> 1) ^ -(zz & 1);
+		}
+		prev_delta += dod;
+		prev += prev_delta;
+		record_write_value(records + (size_t)record_size * i, field, prev);
+	}
+}
+
+/**
+ * Encodes gauge column as XOR with the previous values.
+ */
+static void encode_gauge(
+		bit_stream_t* stream,
+		const char* records,
+		int record_size,
+		int count,
+		const sp_measure_record_field_t* field
+		)
+{
+	int i, window_lead = -1, window_trail = 0;
+	uint64_t prev = record_read_value(records, field);
+	bits_write(stream, prev, 64);
+	for (i = 1; i < count; i++) {
+		uint64_t value = record_read_value(records + (size_t)record_size * i, field);
+		uint64_t xor = value ^ prev;
+		prev = value;
+		if (xor == 0) {
+			bits_write(stream, 0, 1);
+			continue;
+		}
+		int lead = __builtin_clzll(xor), trail = __builtin_ctzll(xor);
+		if (window_lead >= 0 && lead >= window_lead && trail >= window_trail) {
+			bits_write(stream, 2, 2);
+			bits_write(stream, xor >> window_trail, 64 - window_lead - window_trail);
+		}
+		else {
+			int length = 64 - lead - trail;
+			bits_write(stream, 3, 2);
+			bits_write(stream, lead, 6);
+			bits_write(stream, length - 1, 6);
+			bits_write(stream, xor >> trail, length);
+			window_lead = lead;
+			window_trail = trail;
+		}
+	}
+}
+
+/**
+ * Decodes XOR encoded gauge column.
+ */
+static void decode_gauge(
+		bit_stream_t* stream,
+		char* records,
+		int record_size,
+		int count,
+		const sp_measure_record_field_t* field
+		)
+{
+	int i, window_lead = 0, window_trail = 0;
+	uint64_t prev = bits_read(stream, 64);
+	record_write_value(records, field, prev);
+	for (i = 1; i < count; i++) {
+		if (bits_read(stream, 1)) {
+			if (bits_read(stream, 1)) {
+				window_lead = bits_read(stream, 6);
+				int length = bits_read(stream, 6) + 1;
+				window_trail = 64 - window_lead - length;
+				if (window_trail < 0) {
+					stream->overflow = true;
+					return;
+				}
+			}
+			prev ^= bits_read(stream, 64 - window_lead - window_trail) << window_trail;
+		}
+		record_write_value(records + (size_t)record_size * i, field, prev);
+	}
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_record_encode_block(
+		const sp_measure_record_header_t* header,
+		const sp_measure_record_field_t* fields,
+		const void* records,
+		int count,
+		void* block,
+		size_t size
+		)
+{
+	int i;
+	if (count < 1 || size < sizeof(sp_measure_record_block_t)) return -EINVAL;
+	memset(block, 0, size);
+	bit_stream_t stream = {
+		.data = (uint8_t*)block + sizeof(sp_measure_record_block_t),
+		.size = (size - sizeof(sp_measure_record_block_t)) * 8,
+	};
+	for (i = 0; i < header->field_count; i++) {
+		if (fields[i].flags & SP_MEASURE_RECORD_FIELD_COUNTER) {
+			encode_counter(&stream, (const char*)records, header->record_size, count, &fields[i]);
+		}
+		else {
+			encode_gauge(&stream, (const char*)records, header->record_size, count, &fields[i]);
+		}
+	}
+	if (stream.overflow) return -ENOSPC;
+
+	sp_measure_record_block_t block_header = {
+		.size = sizeof(sp_measure_record_block_t) + (stream.pos + 7) / 8,
+		.count = count,
+	};
+	memcpy(block, &block_header, sizeof(block_header));
+	return block_header.size;
+}
+
+int sp_measure_record_decode_block(
+		const sp_measure_record_header_t* header,
+		const sp_measure_record_field_t* fields,
+		const void* block,
+		size_t size,
+		void* records,
+		int max_count
+		)
+{
+	int i;
+	sp_measure_record_block_t block_header;
+	if (size < sizeof(sp_measure_record_block_t)) return -EINVAL;
+	memcpy(&block_header, block, sizeof(block_header));
+	if (block_header.size > size || block_header.size < sizeof(sp_measure_record_block_t) ||
+			block_header.count < 1 || block_header.count > max_count) {
+		return -EINVAL;
+	}
+	bit_stream_t stream = {
+		.data = (uint8_t*)block + sizeof(sp_measure_record_block_t),
+		.size = (block_header.size - sizeof(sp_measure_record_block_t)) * 8,
+	};
+	memset(records, 0, (size_t)header->record_size * block_header.count);
+	for (i = 0; i < header->field_count && !stream.overflow; i++) {
+		if (fields[i].flags & SP_MEASURE_RECORD_FIELD_COUNTER) {
+			decode_counter(&stream, (char*)records, header->record_size, block_header.count, &fields[i]);
+		}
+		else {
+			decode_gauge(&stream, (char*)records, header->record_size, block_header.count, &fields[i]);
+		}
+	}
+	if (stream.overflow) return -EINVAL;
+	return block_header.count;
+}
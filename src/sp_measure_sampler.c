@@ -0,0 +1,347 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/* the ring index alignment, keeps the producer and consumer indices
+ * in separate cache lines */
+#define SAMPLER_INDEX_ALIGNMENT		64
+
+/*
+ * Private API
+ */
+
+struct sp_measure_sampler_thread_t {
+	/* the number of published entries, written only by the sampler thread */
+	uint64_t head __attribute__((aligned(SAMPLER_INDEX_ALIGNMENT)));
+	/* the number of snapshots skipped because the ring was full */
+	uint64_t dropped;
+	/* the last snapshot sequence number */
+	uint64_t sequence;
+
+	/* the number of released entries, written only by the consumer */
+	uint64_t tail __attribute__((aligned(SAMPLER_INDEX_ALIGNMENT)));
+
+	/* the sampler thread */
+	pthread_t thread;
+	/* true if the sampler thread is running */
+	bool running;
+
+	/* protects the configuration and the thread control flags */
+	pthread_mutex_t lock;
+	/* signalled when the thread must quit or has been reconfigured */
+	pthread_cond_t wakeup;
+	/* true if the sampler thread must exit */
+	bool quit;
+	/* true if the configuration has been changed */
+	bool reconfigured;
+
+	/* the sampling period */
+	int64_t period_ns;
+	/* the sampled system resources */
+	int sys_resources;
+	/* the sampled process resources */
+	int proc_resources;
+};
+
+/**
+ * Takes snapshot into the next free ring entry and publishes it.
+ *
+ * @param[in] sampler         the sampler.
+ * @param[in] schedule        the sampling schedule.
+ * @param[in] sys_resources   the system resources to retrieve.
+ * @param[in] proc_resources  the process resources to retrieve.
+ */
+static void sampler_take_snapshot(
+		sp_measure_sampler_t* sampler,
+		const sp_measure_schedule_t* schedule,
+		int sys_resources,
+		int proc_resources
+		)
+{
+	int i;
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	uint64_t head = thread->head;
+	uint64_t sequence = ++thread->sequence;
+	/* the consumer releases entries by advancing the tail, which makes
+	 * its writes to the released entry visible before it's reused */
+	if (head - __atomic_load_n(&thread->tail, __ATOMIC_ACQUIRE) >= (uint64_t)sampler->capacity) {
+		__atomic_store_n(&thread->dropped, thread->dropped + 1, __ATOMIC_RELAXED);
+		return;
+	}
+	sp_measure_sampler_entry_t* entry = &sampler->entries[head % sampler->capacity];
+	entry->sequence = sequence;
+	entry->sys_resources = sys_resources;
+	entry->proc_resources = entry->procs.count ? proc_resources : 0;
+	entry->sys_rc = sp_measure_get_sys_data(&entry->sys, sys_resources, NULL);
+	sp_measure_schedule_stamp_sys(schedule, &entry->sys);
+	if (entry->procs.count) {
+		entry->procs_rc = sp_measure_get_proc_set_data(&entry->procs, proc_resources);
+		for (i = 0; i < entry->procs.count; i++) {
+			sp_measure_schedule_stamp_proc(schedule, &entry->procs.data[i]);
+		}
+	}
+	/* publish the entry after its contents have been written */
+	__atomic_store_n(&thread->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * The sampler thread.
+ *
+ * The snapshots are taken at the sampling schedule deadlines, so the
+ * snapshot time does not accumulate into the period.
+ * @param[in] arg   the sampler.
+ * @return          NULL.
+ */
+static void* sampler_thread(
+		void* arg
+		)
+{
+	sp_measure_sampler_t* sampler = (sp_measure_sampler_t*)arg;
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	sp_measure_schedule_t schedule;
+	struct timespec ts;
+
+	pthread_mutex_lock(&thread->lock);
+	sp_measure_init_schedule(&schedule, thread->period_ns);
+	while (1) {
+		sp_measure_schedule_next(&schedule);
+		ts.tv_sec = schedule.deadline_ns / 1000000000LL;
+		ts.tv_nsec = schedule.deadline_ns % 1000000000LL;
+		while (!thread->quit && !thread->reconfigured) {
+			if (pthread_cond_timedwait(&thread->wakeup, &thread->lock, &ts) == ETIMEDOUT) break;
+		}
+		if (thread->quit) break;
+		if (thread->reconfigured) {
+			/* restart the schedule with the new period */
+			thread->reconfigured = false;
+			sp_measure_init_schedule(&schedule, thread->period_ns);
+			sp_measure_schedule_next(&schedule);
+		}
+		int sys_resources = thread->sys_resources;
+		int proc_resources = thread->proc_resources;
+		pthread_mutex_unlock(&thread->lock);
+
+		sampler_take_snapshot(sampler, &schedule, sys_resources, proc_resources);
+
+		pthread_mutex_lock(&thread->lock);
+	}
+	pthread_mutex_unlock(&thread->lock);
+	return NULL;
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_sampler(
+		sp_measure_sampler_t* sampler,
+		int capacity,
+		int64_t period_ns,
+		int sys_resources,
+		const int* pids,
+		int count,
+		int proc_resources
+		)
+{
+	return sp_measure_init_sampler_ctx(NULL, sampler, capacity, period_ns, sys_resources, pids, count, proc_resources);
+}
+
+int sp_measure_init_sampler_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_sampler_t* sampler,
+		int capacity,
+		int64_t period_ns,
+		int sys_resources,
+		const int* pids,
+		int count,
+		int proc_resources
+		)
+{
+	int i, rc;
+	void* block;
+	pthread_condattr_t attr;
+
+	memset(sampler, 0, sizeof(sp_measure_sampler_t));
+	if (capacity < 2 || period_ns <= 0 || count < 0 || (count && pids == NULL)) return -EINVAL;
+
+	if (posix_memalign(&block, SAMPLER_INDEX_ALIGNMENT, sizeof(struct sp_measure_sampler_thread_t)) != 0) {
+		return -ENOMEM;
+	}
+	sampler->thread = (struct sp_measure_sampler_thread_t*)block;
+	memset(sampler->thread, 0, sizeof(struct sp_measure_sampler_thread_t));
+	pthread_mutex_init(&sampler->thread->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sampler->thread->wakeup, &attr);
+	pthread_condattr_destroy(&attr);
+	sampler->thread->period_ns = period_ns;
+	sampler->thread->sys_resources = sys_resources | SNAPSHOT_SYS_TIMESTAMP;
+	sampler->thread->proc_resources = proc_resources;
+
+	sampler->entries = (sp_measure_sampler_entry_t*)calloc(capacity, sizeof(sp_measure_sampler_entry_t));
+	if (sampler->entries == NULL) {
+		sp_measure_free_sampler(sampler);
+		return -ENOMEM;
+	}
+	sampler->sys_resources = sys_resources | SNAPSHOT_SYS_TIMESTAMP;
+	sampler->proc_resources = proc_resources;
+
+	/* the entries share the common data of the first entry */
+	rc = sp_measure_init_sys_data_ctx(ctx, &sampler->entries[0].sys, sampler->sys_resources, NULL);
+	if (rc < 0) {
+		sp_measure_free_sampler(sampler);
+		return rc;
+	}
+	for (i = 1; i < capacity; i++) {
+		rc = sp_measure_init_sys_data(&sampler->entries[i].sys, 0, &sampler->entries[0].sys);
+		if (rc < 0) {
+			/* release the entries initialized so far */
+			sampler->capacity = i;
+			sp_measure_free_sampler(sampler);
+			return rc;
+		}
+	}
+	sampler->capacity = capacity;
+
+	if (count) {
+		int proc_rc = sp_measure_init_proc_set_ctx(ctx, &sampler->entries[0].procs, pids, count, proc_resources, NULL);
+		for (i = 1; i < capacity && proc_rc >= 0; i++) {
+			proc_rc = sp_measure_init_proc_set(&sampler->entries[i].procs, NULL, 0, 0, &sampler->entries[0].procs);
+		}
+		if (proc_rc < 0) {
+			sp_measure_free_sampler(sampler);
+			return proc_rc;
+		}
+	}
+
+	return rc;
+}
+
+int sp_measure_free_sampler(
+		sp_measure_sampler_t* sampler
+		)
+{
+	int i;
+	if (sampler->thread == NULL) return 0;
+	sp_measure_sampler_stop(sampler);
+	/* the capacity is the number of entries with initialized snapshots */
+	for (i = 0; i < sampler->capacity; i++) {
+		sp_measure_free_sys_data(&sampler->entries[i].sys);
+		sp_measure_free_proc_set(&sampler->entries[i].procs);
+	}
+	if (sampler->entries) free(sampler->entries);
+	pthread_cond_destroy(&sampler->thread->wakeup);
+	pthread_mutex_destroy(&sampler->thread->lock);
+	free(sampler->thread);
+	memset(sampler, 0, sizeof(sp_measure_sampler_t));
+	return 0;
+}
+
+int sp_measure_sampler_start(
+		sp_measure_sampler_t* sampler
+		)
+{
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	if (thread->running) return -EALREADY;
+	thread->quit = false;
+	thread->reconfigured = false;
+	int rc = pthread_create(&thread->thread, NULL, sampler_thread, sampler);
+	if (rc != 0) return -rc;
+	thread->running = true;
+	return 0;
+}
+
+int sp_measure_sampler_stop(
+		sp_measure_sampler_t* sampler
+		)
+{
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	if (!thread->running) return 0;
+	pthread_mutex_lock(&thread->lock);
+	thread->quit = true;
+	pthread_cond_signal(&thread->wakeup);
+	pthread_mutex_unlock(&thread->lock);
+	pthread_join(thread->thread, NULL);
+	thread->running = false;
+	return 0;
+}
+
+int sp_measure_sampler_reconfigure(
+		sp_measure_sampler_t* sampler,
+		int64_t period_ns,
+		int sys_resources,
+		int proc_resources
+		)
+{
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	sys_resources |= SNAPSHOT_SYS_TIMESTAMP;
+	/* the entries can't retrieve resources they were not initialized for */
+	if (period_ns <= 0 || (sys_resources & ~sampler->sys_resources) ||
+			(proc_resources & ~sampler->proc_resources)) {
+		return -EINVAL;
+	}
+	pthread_mutex_lock(&thread->lock);
+	thread->period_ns = period_ns;
+	thread->sys_resources = sys_resources;
+	thread->proc_resources = proc_resources;
+	thread->reconfigured = true;
+	pthread_cond_signal(&thread->wakeup);
+	pthread_mutex_unlock(&thread->lock);
+	return 0;
+}
+
+sp_measure_sampler_entry_t* sp_measure_sampler_peek(
+		sp_measure_sampler_t* sampler
+		)
+{
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	uint64_t tail = thread->tail;
+	/* the acquire pairs with the entry publishing in the sampler thread */
+	if (tail == __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE)) return NULL;
+	return &sampler->entries[tail % sampler->capacity];
+}
+
+int sp_measure_sampler_pop(
+		sp_measure_sampler_t* sampler
+		)
+{
+	struct sp_measure_sampler_thread_t* thread = sampler->thread;
+	uint64_t tail = thread->tail;
+	if (tail == __atomic_load_n(&thread->head, __ATOMIC_ACQUIRE)) return -ENOENT;
+	__atomic_store_n(&thread->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+uint64_t sp_measure_sampler_dropped(
+		const sp_measure_sampler_t* sampler
+		)
+{
+	return __atomic_load_n(&sampler->thread->dropped, __ATOMIC_RELAXED);
+}
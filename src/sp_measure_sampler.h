@@ -0,0 +1,279 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_SAMPLER_H
+#define SP_MEASURE_SAMPLER_H
+
+/** @file sp_measure_sampler.h
+ * API for background snapshot sampling.
+ *
+ * The sampler takes system and process set snapshots on a dedicated
+ * thread at a fixed period, so the /proc parsing latency is moved away
+ * from the application threads. The completed snapshots are published
+ * through a single producer, single consumer ring of entries. All entries
+ * are allocated and initialized by sp_measure_init_sampler(), the sampler
+ * thread fills them in place and the consumer accesses them directly.
+ * The ring indices are updated with atomic operations only, so neither
+ * side ever blocks the other - sp_measure_sampler_peek() and
+ * sp_measure_sampler_pop() are wait-free.
+ *
+ * The snapshots are taken at the deadlines of a sampling schedule (see
+ * sp_measure_schedule_t) and stamped with the intended snapshot time,
+ * see FIELD_SYS_SCHEDULED_NS() and FIELD_PROC_SCHEDULED_NS().
+ *
+ * If the consumer does not keep up and the ring is full, the sampler
+ * skips the snapshot and increments the dropped snapshot counter. The
+ * skipped snapshots can also be detected from the gaps in the entry
+ * sequence numbers.
+ *
+ * Only a single thread may consume the entries, and the start, stop,
+ * reconfigure and free functions must be called from the same thread.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_sampler_t sampler;
+ *    int pids[] = {1234};
+ *    // sample system and process 1234 at 10Hz
+ *    sp_measure_init_sampler(&sampler, 16, 100000000LL, SNAPSHOT_SYS, pids, 1, SNAPSHOT_PROC);
+ *    sp_measure_sampler_start(&sampler);
+ *    while (running) {
+ *        sp_measure_sampler_entry_t* entry;
+ *        while ( (entry = sp_measure_sampler_peek(&sampler)) ) {
+ *            process_snapshot(&entry->sys, &entry->procs);
+ *            sp_measure_sampler_pop(&sampler);
+ *        }
+ *        do_other_work();
+ *    }
+ *    sp_measure_sampler_stop(&sampler);
+ *    sp_measure_free_sampler(&sampler);
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the sampler thread data */
+struct sp_measure_sampler_thread_t;
+
+/**
+ * Sampler ring entry.
+ */
+typedef struct sp_measure_sampler_entry_t {
+	/* the snapshot sequence number, starting from 1 */
+	uint64_t sequence;
+	/* the system snapshot */
+	sp_measure_sys_data_t sys;
+	/* the system snapshot result, see sp_measure_get_sys_data() */
+	int sys_rc;
+	/* the process set snapshot, empty if no processes are sampled */
+	sp_measure_proc_set_t procs;
+	/* the process set snapshot result, see sp_measure_get_proc_set_data() */
+	int procs_rc;
+	/* the system resources retrieved by the snapshot. The entries are
+	 * reused, so the fields of the other resources can hold values of
+	 * an earlier snapshot */
+	int sys_resources;
+	/* the process resources retrieved by the snapshot, 0 if no processes
+	 * are sampled */
+	int proc_resources;
+} sp_measure_sampler_entry_t;
+
+/**
+ * Background snapshot sampler.
+ */
+typedef struct sp_measure_sampler_t {
+	/* the number of ring entries */
+	int capacity;
+	/* the ring entries */
+	sp_measure_sampler_entry_t* entries;
+
+	/* the system resources the entries were initialized for */
+	int sys_resources;
+	/* the process resources the entries were initialized for */
+	int proc_resources;
+
+	/* the sampler thread and ring state */
+	struct sp_measure_sampler_thread_t* thread;
+} sp_measure_sampler_t;
+
+
+/**
+ * Initializes background sampler.
+ *
+ * Allocates and initializes all ring entries. The sampler thread is not
+ * started until sp_measure_sampler_start() is called. Afterwards the
+ * sampler must be freed with sp_measure_free_sampler() function.
+ * @param[out] sampler      the sampler to initialize.
+ * @param[in] capacity      the number of ring entries (at least 2).
+ * @param[in] period_ns     the sampling period in nanoseconds.
+ * @param[in] sys_resources a flag specifying which system resource
+ *                          statistics should be retrieved. The timestamp
+ *                          is always retrieved.
+ * @param[in] pids          the sampled process identifiers (can be NULL
+ *                          if count is 0).
+ * @param[in] count         the number of sampled processes.
+ * @param[in] proc_resources a flag specifying which process resource
+ *                          statistics should be retrieved.
+ * @return                  0  - success
+ *                          >0 - only part of the initial system resource statistics
+ *                               was retrieved (see sp_measure_init_sys_data()).
+ *                          <0 - unrecoverable error.
+ */
+int sp_measure_init_sampler(
+		sp_measure_sampler_t* sampler,
+		int capacity,
+		int64_t period_ns,
+		int sys_resources,
+		const int* pids,
+		int count,
+		int proc_resources
+		);
+
+/**
+ * Initializes background sampler of the specified context.
+ *
+ * See sp_measure_init_sampler() function. Samplers of different contexts
+ * can read different file system roots concurrently.
+ * @param[in] ctx           the library context, NULL for the default context.
+ * @param[out] sampler      the sampler to initialize.
+ * @param[in] capacity      the number of ring entries (at least 2).
+ * @param[in] period_ns     the sampling period in nanoseconds.
+ * @param[in] sys_resources a flag specifying which system resource
+ *                          statistics should be retrieved.
+ * @param[in] pids          the sampled process identifiers (can be NULL
+ *                          if count is 0).
+ * @param[in] count         the number of sampled processes.
+ * @param[in] proc_resources a flag specifying which process resource
+ *                          statistics should be retrieved.
+ * @return                  see sp_measure_init_sampler() function.
+ */
+int sp_measure_init_sampler_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_sampler_t* sampler,
+		int capacity,
+		int64_t period_ns,
+		int sys_resources,
+		const int* pids,
+		int count,
+		int proc_resources
+		);
+
+/**
+ * Releases background sampler.
+ *
+ * The sampler thread is stopped if it is running.
+ * @param[in] sampler   the sampler to free.
+ * @return              0 for success.
+ */
+int sp_measure_free_sampler(
+		sp_measure_sampler_t* sampler
+		);
+
+/**
+ * Starts the sampler thread.
+ *
+ * The first snapshot is taken immediately, the following ones at
+ * absolute period boundaries from the start time.
+ * @param[in] sampler   the sampler.
+ * @return              0  - success
+ *                      <0 - the thread could not be started (-errno), or
+ *                           -EALREADY if the sampler is already running.
+ */
+int sp_measure_sampler_start(
+		sp_measure_sampler_t* sampler
+		);
+
+/**
+ * Stops the sampler thread.
+ *
+ * Waits until the snapshot being taken is finished. The entries already
+ * published can still be consumed after the sampler has been stopped.
+ * @param[in] sampler   the sampler.
+ * @return              0 for success.
+ */
+int sp_measure_sampler_stop(
+		sp_measure_sampler_t* sampler
+		);
+
+/**
+ * Changes the sampling period and resources.
+ *
+ * Can be called while the sampler is running, in which case the next
+ * snapshot is taken immediately with the new configuration.
+ * @param[in] sampler        the sampler.
+ * @param[in] period_ns      the new sampling period in nanoseconds.
+ * @param[in] sys_resources  the new system resources, must be a subset
+ *                           of the resources given at initialization.
+ * @param[in] proc_resources the new process resources, must be a subset
+ *                           of the resources given at initialization.
+ * @return                   0 for success, -EINVAL for invalid parameters.
+ */
+int sp_measure_sampler_reconfigure(
+		sp_measure_sampler_t* sampler,
+		int64_t period_ns,
+		int sys_resources,
+		int proc_resources
+		);
+
+/**
+ * Retrieves the oldest published entry.
+ *
+ * The entry stays valid and is not modified by the sampler thread
+ * until it is released with sp_measure_sampler_pop(). This function
+ * is wait-free.
+ * @param[in] sampler   the sampler.
+ * @return              the oldest entry or NULL if there are no
+ *                      published entries.
+ */
+sp_measure_sampler_entry_t* sp_measure_sampler_peek(
+		sp_measure_sampler_t* sampler
+		);
+
+/**
+ * Releases the oldest published entry, handing it back to the sampler
+ * thread.
+ *
+ * This function is wait-free.
+ * @param[in] sampler   the sampler.
+ * @return              0 for success, -ENOENT if there are no published
+ *                      entries.
+ */
+int sp_measure_sampler_pop(
+		sp_measure_sampler_t* sampler
+		);
+
+/**
+ * Retrieves the number of snapshots skipped because the ring was full.
+ *
+ * @param[in] sampler   the sampler.
+ * @return              the number of skipped snapshots.
+ */
+uint64_t sp_measure_sampler_dropped(
+		const sp_measure_sampler_t* sampler
+		);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
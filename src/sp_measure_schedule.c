@@ -0,0 +1,99 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_init_schedule(
+		sp_measure_schedule_t* schedule,
+		int64_t period_ns
+		)
+{
+	memset(schedule, 0, sizeof(sp_measure_schedule_t));
+	if (period_ns <= 0) return -EINVAL;
+	schedule->period_ns = period_ns;
+	schedule->start_ns = clock_read_ns(CLOCK_MONOTONIC);
+	if (schedule->start_ns == ESPMEASURE_UNDEFINED) return -errno;
+	schedule->tick = -1;
+	return 0;
+}
+
+int sp_measure_schedule_next(
+		sp_measure_schedule_t* schedule
+		)
+{
+	int64_t missed = 0;
+	schedule->tick++;
+	/* the deadlines are calculated from the start time rather than
+	 * accumulated, so rounding errors don't add up either */
+	schedule->deadline_ns = schedule->start_ns + schedule->tick * schedule->period_ns;
+	if (schedule->tick) {
+		int64_t now = clock_read_ns(CLOCK_MONOTONIC);
+		if (now - schedule->deadline_ns >= schedule->period_ns) {
+			missed = (now - schedule->deadline_ns) / schedule->period_ns;
+			schedule->tick += missed;
+			schedule->deadline_ns += missed * schedule->period_ns;
+			schedule->missed += missed;
+		}
+	}
+	return missed;
+}
+
+int sp_measure_schedule_wait(
+		sp_measure_schedule_t* schedule
+		)
+{
+	struct timespec ts;
+	int rc, missed = sp_measure_schedule_next(schedule);
+	ts.tv_sec = schedule->deadline_ns / 1000000000LL;
+	ts.tv_nsec = schedule->deadline_ns % 1000000000LL;
+	while ( (rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR) ;
+	return rc ? -rc : missed;
+}
+
+int sp_measure_schedule_stamp_sys(
+		const sp_measure_schedule_t* schedule,
+		sp_measure_sys_data_t* data
+		)
+{
+	data->scheduled_ns = schedule->deadline_ns;
+	return 0;
+}
+
+int sp_measure_schedule_stamp_proc(
+		const sp_measure_schedule_t* schedule,
+		sp_measure_proc_data_t* data
+		)
+{
+	data->scheduled_ns = schedule->deadline_ns;
+	return 0;
+}
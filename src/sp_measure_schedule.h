@@ -0,0 +1,152 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_SCHEDULE_H
+#define SP_MEASURE_SCHEDULE_H
+
+/** @file sp_measure_schedule.h
+ * API for drift-free periodic sampling.
+ *
+ * Sleeping a fixed interval after taking the snapshots makes the
+ * sampling period drift by the time spent taking them, which skews
+ * every rate calculated from the snapshot differences. The schedule
+ * instead sleeps until absolute CLOCK_MONOTONIC deadlines at multiples
+ * of the period from the schedule start. If the caller falls behind by
+ * more than a period, the missed deadlines are skipped and counted.
+ *
+ * The intended (deadline) time of a tick can be stored into snapshots
+ * with sp_measure_schedule_stamp_sys() and sp_measure_schedule_stamp_proc()
+ * functions, so the actual snapshot timestamp can be compared with it.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_schedule_t schedule;
+ *    // sample at 10Hz
+ *    sp_measure_init_schedule(&schedule, 100000000LL);
+ *    while (running) {
+ *        int missed = sp_measure_schedule_wait(&schedule);
+ *        sp_measure_get_sys_data(&sys, SNAPSHOT_SYS, NULL);
+ *        sp_measure_schedule_stamp_sys(&schedule, &sys);
+ *        printf("late by %lld ns, missed %d ticks\n",
+ *                FIELD_SYS_TIMESTAMP_NS(&sys) - FIELD_SYS_SCHEDULED_NS(&sys), missed);
+ *    }
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sampling schedule.
+ */
+typedef struct sp_measure_schedule_t {
+	/* the sampling period in nanoseconds */
+	int64_t period_ns;
+	/* the CLOCK_MONOTONIC time of the first tick */
+	int64_t start_ns;
+	/* the CLOCK_MONOTONIC deadline of the current tick */
+	int64_t deadline_ns;
+	/* the current tick number, -1 before the first tick */
+	int64_t tick;
+	/* the total number of skipped ticks */
+	int64_t missed;
+} sp_measure_schedule_t;
+
+
+/**
+ * Initializes sampling schedule.
+ *
+ * The first tick is due immediately.
+ * @param[out] schedule   the schedule to initialize.
+ * @param[in] period_ns   the sampling period in nanoseconds.
+ * @return                0 for success, -EINVAL for invalid period.
+ */
+int sp_measure_init_schedule(
+		sp_measure_schedule_t* schedule,
+		int64_t period_ns
+		);
+
+/**
+ * Advances the schedule to the next tick without sleeping.
+ *
+ * The deadlines already passed by more than a period are skipped.
+ * Can be used to wait for the deadline by other means than
+ * sp_measure_schedule_wait(), for example with a timed wait on a
+ * condition variable using CLOCK_MONOTONIC clock.
+ * @param[in] schedule   the schedule.
+ * @return               the number of ticks skipped.
+ */
+int sp_measure_schedule_next(
+		sp_measure_schedule_t* schedule
+		);
+
+/**
+ * Advances the schedule to the next tick and sleeps until its deadline.
+ *
+ * @param[in] schedule   the schedule.
+ * @return               >=0 - the number of ticks skipped because the
+ *                             deadline had already passed.
+ *                       <0  - sleeping failed (-errno).
+ */
+int sp_measure_schedule_wait(
+		sp_measure_schedule_t* schedule
+		);
+
+/**
+ * Stores the current tick deadline into system snapshot.
+ *
+ * @param[in] schedule   the schedule.
+ * @param[out] data      the system snapshot.
+ * @return               0 for success.
+ */
+int sp_measure_schedule_stamp_sys(
+		const sp_measure_schedule_t* schedule,
+		sp_measure_sys_data_t* data
+		);
+
+/**
+ * Stores the current tick deadline into process snapshot.
+ *
+ * @param[in] schedule   the schedule.
+ * @param[out] data      the process snapshot.
+ * @return               0 for success.
+ */
+int sp_measure_schedule_stamp_proc(
+		const sp_measure_schedule_t* schedule,
+		sp_measure_proc_data_t* data
+		);
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_SCHEDULE_PERIOD_NS(schedule)    (schedule)->period_ns
+#define FIELD_SCHEDULE_DEADLINE_NS(schedule)  (schedule)->deadline_ns
+#define FIELD_SCHEDULE_TICK(schedule)         (schedule)->tick
+#define FIELD_SCHEDULE_MISSED(schedule)       (schedule)->missed
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Private API
+ */
+
+/**
+ * Thread statistics block.
+ *
+ * Every thread taking snapshots gets its own block, which is linked
+ * into the global block list so the statistics can be summed up.
+ */
+typedef struct stats_block_t {
+	sp_measure_stats_t stats;
+	struct stats_block_t* prev;
+	struct stats_block_t* next;
+} stats_block_t;
+
+int sp_measure_stats_enabled = 0;
+
+__thread sp_measure_stats_counters_t* sp_measure_stats_current = NULL;
+
+/* the calling thread statistics block */
+static __thread stats_block_t* stats_local = NULL;
+
+/* the statistics blocks of the running threads */
+static stats_block_t* stats_blocks = NULL;
+
+/* the statistics of the exited threads */
+static sp_measure_stats_t stats_retired;
+
+/* protects the block list and the exited thread statistics, the
+ * counters itself are updated without locking */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t stats_key;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+
+/* relaxed read of a counter updated by another thread */
+#define STATS_LOAD(counters, field)	__atomic_load_n(&(counters)->field, __ATOMIC_RELAXED)
+
+/* relaxed update of a counter owned by the calling thread */
+#define STATS_INC(counters, field, value) \
+	__atomic_store_n(&(counters)->field, STATS_LOAD(counters, field) + (value), __ATOMIC_RELAXED)
+
+/**
+ * Adds counters.
+ *
+ * @param[in,out] dst   the destination counters.
+ * @param[in] src       the counters to add.
+ */
+static void stats_counters_add(
+		sp_measure_stats_counters_t* dst,
+		const sp_measure_stats_counters_t* src
+		)
+{
+	dst->calls += STATS_LOAD(src, calls);
+	dst->wall_ns += STATS_LOAD(src, wall_ns);
+	dst->cpu_ns += STATS_LOAD(src, cpu_ns);
+	dst->bytes_read += STATS_LOAD(src, bytes_read);
+	dst->files_opened += STATS_LOAD(src, files_opened);
+	dst->syscalls += STATS_LOAD(src, syscalls);
+	dst->failures += STATS_LOAD(src, failures);
+}
+
+/**
+ * Adds all statistics counters.
+ *
+ * @param[in,out] dst   the destination statistics.
+ * @param[in] src       the statistics to add.
+ */
+static void stats_add(
+		sp_measure_stats_t* dst,
+		const sp_measure_stats_t* src
+		)
+{
+	int i;
+	for (i = 0; i < SP_MEASURE_STATS_SYS_RESOURCES; i++) {
+		stats_counters_add(&dst->sys[i], &src->sys[i]);
+	}
+	for (i = 0; i < SP_MEASURE_STATS_PROC_RESOURCES; i++) {
+		stats_counters_add(&dst->proc[i], &src->proc[i]);
+	}
+	stats_counters_add(&dst->sys_total, &src->sys_total);
+	stats_counters_add(&dst->proc_total, &src->proc_total);
+}
+
+/**
+ * Moves the statistics of an exiting thread to the exited thread statistics.
+ */
+static void stats_block_retire(
+		void* arg
+		)
+{
+	stats_block_t* block = (stats_block_t*)arg;
+	pthread_mutex_lock(&stats_lock);
+	stats_add(&stats_retired, &block->stats);
+	if (block->prev) block->prev->next = block->next;
+	else stats_blocks = block->next;
+	if (block->next) block->next->prev = block->prev;
+	pthread_mutex_unlock(&stats_lock);
+	free(block);
+}
+
+static void stats_key_create(void)
+{
+	pthread_key_create(&stats_key, stats_block_retire);
+}
+
+/**
+ * Retrieves the calling thread statistics block.
+ *
+ * The block is allocated when the thread takes its first snapshot
+ * with the statistics enabled.
+ * @return   the statistics block or NULL on failure.
+ */
+static stats_block_t* stats_block_get(void)
+{
+	if (stats_local) return stats_local;
+
+	pthread_once(&stats_once, stats_key_create);
+	stats_block_t* block = (stats_block_t*)calloc(1, sizeof(stats_block_t));
+	if (block == NULL) return NULL;
+	pthread_mutex_lock(&stats_lock);
+	block->next = stats_blocks;
+	if (stats_blocks) stats_blocks->prev = block;
+	stats_blocks = block;
+	pthread_mutex_unlock(&stats_lock);
+	pthread_setspecific(stats_key, block);
+	stats_local = block;
+	return block;
+}
+
+/**
+ * Sums up the totals of snapshot counters.
+ *
+ * The data counters of the snapshot totals are sums of the resource
+ * counters.
+ */
+static void stats_sum_totals(
+		sp_measure_stats_counters_t* total,
+		const sp_measure_stats_counters_t* resources,
+		int count
+		)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		total->bytes_read += resources[i].bytes_read;
+		total->files_opened += resources[i].files_opened;
+		total->syscalls += resources[i].syscalls;
+		total->failures += resources[i].failures;
+	}
+}
+
+/*
+ * Internal API implementation
+ */
+
+void stats_call_begin(
+		stats_call_t* call,
+		bool proc
+		)
+{
+	call->resources = NULL;
+	if (!__atomic_load_n(&sp_measure_stats_enabled, __ATOMIC_RELAXED)) return;
+	stats_block_t* block = stats_block_get();
+	if (block == NULL) return;
+	call->resources = proc ? block->stats.proc : block->stats.sys;
+	call->total = proc ? &block->stats.proc_total : &block->stats.sys_total;
+	call->used = 0;
+	memset(call->wall_ns, 0, sizeof(call->wall_ns));
+	call->start_ns = clock_read_ns(CLOCK_MONOTONIC);
+	call->mark_ns = call->start_ns;
+	call->cpu_start_ns = clock_read_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void stats_call_end(
+		stats_call_t* call
+		)
+{
+	int64_t wall_sum = 0;
+	int i;
+	if (call->resources == NULL) return;
+	int64_t cpu_ns = clock_read_ns(CLOCK_THREAD_CPUTIME_ID) - call->cpu_start_ns;
+	STATS_INC(call->total, calls, 1);
+	STATS_INC(call->total, wall_ns, call->mark_ns - call->start_ns);
+	STATS_INC(call->total, cpu_ns, cpu_ns);
+
+	for (i = 0; i < SP_MEASURE_STATS_SYS_RESOURCES; i++) {
+		if (call->used & (1U << i)) wall_sum += call->wall_ns[i];
+	}
+	if (wall_sum == 0) return;
+	for (i = 0; i < SP_MEASURE_STATS_SYS_RESOURCES; i++) {
+		if (call->used & (1U << i)) {
+			STATS_INC(&call->resources[i], cpu_ns, cpu_ns * call->wall_ns[i] / wall_sum);
+		}
+	}
+}
+
+void stats_resource_begin(
+		stats_call_t* call,
+		int resource
+		)
+{
+	if (call->resources == NULL) return;
+	call->resource = __builtin_ctz(resource);
+	sp_measure_stats_current = &call->resources[call->resource];
+}
+
+void stats_resource_end(
+		stats_call_t* call,
+		bool failed
+		)
+{
+	if (call->resources == NULL) return;
+	int64_t now_ns = clock_read_ns(CLOCK_MONOTONIC);
+	int64_t wall_ns = now_ns - call->mark_ns;
+	call->mark_ns = now_ns;
+	sp_measure_stats_counters_t* counters = &call->resources[call->resource];
+	STATS_INC(counters, calls, 1);
+	STATS_INC(counters, wall_ns, wall_ns);
+	if (failed) STATS_INC(counters, failures, 1);
+	call->wall_ns[call->resource] += wall_ns;
+	call->used |= 1U << call->resource;
+	sp_measure_stats_current = NULL;
+}
+
+/*
+ * Public API implementation
+ */
+
+int sp_measure_stats_enable(
+		int enable
+		)
+{
+	return __atomic_exchange_n(&sp_measure_stats_enabled, enable != 0, __ATOMIC_RELAXED);
+}
+
+int sp_measure_stats_get(
+		sp_measure_stats_t* stats
+		)
+{
+	stats_block_t* block;
+	memset(stats, 0, sizeof(sp_measure_stats_t));
+	pthread_mutex_lock(&stats_lock);
+	stats_add(stats, &stats_retired);
+	for (block = stats_blocks; block; block = block->next) {
+		stats_add(stats, &block->stats);
+	}
+	pthread_mutex_unlock(&stats_lock);
+	stats_sum_totals(&stats->sys_total, stats->sys, SP_MEASURE_STATS_SYS_RESOURCES);
+	stats_sum_totals(&stats->proc_total, stats->proc, SP_MEASURE_STATS_PROC_RESOURCES);
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SP_MEASURE_STATS_H
+#define SP_MEASURE_STATS_H
+
+/** @file sp_measure_stats.h
+ * API for the library self-overhead statistics.
+ *
+ * When enabled, the library counts the time spent, the data read and
+ * the system calls made while retrieving every snapshot resource. The
+ * counters are kept per thread and updated without locks, so they can
+ * be left enabled in production. sp_measure_stats_get() sums up the
+ * counters of all threads, including the exited ones.
+ *
+ * The counters are cumulative, compare two sp_measure_stats_get() results
+ * to get the overhead of a sampling period.
+ *
+ * Short example (without any error checking):
+ * @code
+ *    sp_measure_stats_t stats1, stats2;
+ *    sp_measure_stats_enable(1);
+ *    sp_measure_stats_get(&stats1);
+ *    ...  take snapshots  ...
+ *    sp_measure_stats_get(&stats2);
+ *    printf("snapshot cpu time: %lld ns\n",
+ *            (long long)(stats2.sys_total.cpu_ns - stats1.sys_total.cpu_ns));
+ * @endcode
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the number of system resource counter slots (sp_measure_sys_resource_t bits) */
+#define SP_MEASURE_STATS_SYS_RESOURCES		16
+
+/* the number of process resource counter slots (sp_measure_proc_resource_t bits) */
+#define SP_MEASURE_STATS_PROC_RESOURCES		16
+
+/**
+ * Overhead counters.
+ */
+typedef struct sp_measure_stats_counters_t {
+	/* the number of times the resource was retrieved */
+	int64_t calls;
+	/* the wall time spent (CLOCK_MONOTONIC) */
+	int64_t wall_ns;
+	/* the thread cpu time spent. The per resource values are estimated
+	 * by splitting the snapshot cpu time by the resource wall times */
+	int64_t cpu_ns;
+	/* the number of bytes read from files */
+	int64_t bytes_read;
+	/* the number of files opened */
+	int64_t files_opened;
+	/* the number of file system calls (open, read, close ...) */
+	int64_t syscalls;
+	/* the number of failed resource retrievals */
+	int64_t failures;
+} sp_measure_stats_counters_t;
+
+/**
+ * Library overhead statistics.
+ */
+typedef struct sp_measure_stats_t {
+	/* the system snapshot counters, indexed by the resource bit number
+	 * (SNAPSHOT_SYS_MEM_USAGE -> 2 etc). /proc/meminfo and /proc/stat
+	 * reads are accounted to the lowest requested resource using them */
+	sp_measure_stats_counters_t sys[SP_MEASURE_STATS_SYS_RESOURCES];
+	/* the process snapshot counters, indexed by the resource bit number */
+	sp_measure_stats_counters_t proc[SP_MEASURE_STATS_PROC_RESOURCES];
+	/* the system snapshot totals, the cpu time is measured exactly */
+	sp_measure_stats_counters_t sys_total;
+	/* the process snapshot totals, including process set snapshots */
+	sp_measure_stats_counters_t proc_total;
+} sp_measure_stats_t;
+
+
+/**
+ * Enables or disables the overhead statistics.
+ *
+ * The statistics are disabled by default.
+ * @param[in] enable   non-zero to enable, zero to disable the statistics.
+ * @return             the previous state.
+ */
+int sp_measure_stats_enable(
+		int enable
+		);
+
+/**
+ * Retrieves the overhead statistics of all threads.
+ *
+ * The counters of other threads are read while they are being updated,
+ * so a value may lag behind by the snapshot in progress.
+ * @param[out] stats   the overhead statistics.
+ * @return             0 for success.
+ */
+int sp_measure_stats_get(
+		sp_measure_stats_t* stats
+		);
+
+/*
+ * Field access definitions
+ */
+
+#define FIELD_STATS_SYS(stats, resource)     (&(stats)->sys[__builtin_ctz(resource)])
+#define FIELD_STATS_PROC(stats, resource)    (&(stats)->proc[__builtin_ctz(resource)])
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,9 +28,10 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/time.h>
-#include <ftw.h>
+#include <sys/stat.h>
 #include <stdint.h>
 #include <limits.h>
+#include <dirent.h>
 
 #include "sp_measure.h"
 #include "measure_utils.h"
@@ -40,80 +41,123 @@
  */
 
 
-/* the chunk size must be a power of 2 */
+/* the number of values in /proc/stat cpu lines used for cpu ticks */
+#define STAT_CPU_FIELDS			8
+
+/* the frequency table growth chunk size, used only when the kernel
+ * reports more frequencies than were found during initialization */
 #define CPU_FREQ_TICKS_CHUNK_SIZE	(1 << 5)
 
+/* the cpu policies array allocation chunk size */
+#define CPU_POLICY_CHUNK_SIZE		8
+
+/* the cpu policy id marking cpu0 frequency statistics fallback */
+#define CPU_POLICY_CPU0			(-1)
+
 /**
- * Set ticks spent at the specified frequency.
+ * Appends ticks spent at the specified frequency to frequency table.
  *
- * @param[out] data  the system snapshot.
- * @param[in] freq        the cpu frequency in Hz.
- * @param[in] ticks       the number of ticks spent at the frequency freq.
- * @return                0 for success.
+ * The table is normally preallocated during initialization, so it
+ * is grown only if the kernel starts reporting new frequencies.
+ * @param[in,out] table     the ticks per frequency array.
+ * @param[in,out] count     the number of used items in the array.
+ * @param[in,out] capacity  the number of allocated items in the array.
+ * @param[in] freq          the cpu frequency in Hz.
+ * @param[in] ticks         the number of ticks spent at the frequency freq.
+ * @return                  0 for success, -ENOMEM if the table could not be grown.
  */
-static int cpu_stats_set_freq_ticks(
-		sp_measure_sys_data_t* data,
+static int cpu_stats_add_freq_ticks(
+		sp_measure_cpu_freq_ticks_t** table,
+		int* count,
+		int* capacity,
 		int freq,
 		int ticks
 		)
 {
-	sp_measure_cpu_freq_ticks_t* state = data->cpu_freq_ticks;
-	if (state) {
-		/* find existing data or free record for the specified frequency */
-		while (true) {
-			if (state - data->cpu_freq_ticks >= data->cpu_freq_ticks_count) {
-				state = NULL;
-				break;
-			}
-			if (state->freq == freq) break;
-			state++;
-		}
-	}
-	if (state == NULL) {
-		/* A new ticks per freq record must be added.
-		   Check if the array has any free space and increase if necessary */
-		if (! (data->cpu_freq_ticks_count & (CPU_FREQ_TICKS_CHUNK_SIZE - 1)) ) {
-			data->cpu_freq_ticks = (sp_measure_cpu_freq_ticks_t*)
-					     realloc(data->cpu_freq_ticks, (data->cpu_freq_ticks_count + CPU_FREQ_TICKS_CHUNK_SIZE) *
-					     sizeof(sp_measure_cpu_freq_ticks_t));
-			if (data->cpu_freq_ticks == NULL) {
-				fprintf(stderr, "Not enough memory to allocate cpu ticks per frequency array of size %d\n",
-						data->cpu_freq_ticks_count);
-				exit(-1);
-			}
-		}
-		state = &data->cpu_freq_ticks[data->cpu_freq_ticks_count++];
+	if (*count == *capacity) {
+		sp_measure_cpu_freq_ticks_t* state = (sp_measure_cpu_freq_ticks_t*)realloc(*table,
+				(*capacity + CPU_FREQ_TICKS_CHUNK_SIZE) * sizeof(sp_measure_cpu_freq_ticks_t));
+		if (state == NULL) return -ENOMEM;
+		*table = state;
+		*capacity += CPU_FREQ_TICKS_CHUNK_SIZE;
 	}
-	state->freq = freq;
-	state->ticks = ticks;
+	(*table)[*count].freq = freq;
+	(*table)[*count].ticks = ticks;
+	(*count)++;
 	return 0;
 }
 
+/**
+ * Sorts frequency table by ascending frequency.
+ *
+ * Kernel lists the frequencies either in ascending or descending order,
+ * so the table is normally either already sorted or needs only to be
+ * reversed.
+ * @param[in,out] table   the ticks per frequency array.
+ * @param[in] count       the number of items in the array.
+ */
+static void cpu_stats_sort_freq_ticks(
+		sp_measure_cpu_freq_ticks_t* table,
+		int count
+		)
+{
+	int i, j;
+	bool ascending = true, descending = true;
+	for (i = 1; i < count; i++) {
+		if (table[i - 1].freq > table[i].freq) ascending = false;
+		if (table[i - 1].freq < table[i].freq) descending = false;
+	}
+	if (ascending) return;
+	if (descending) {
+		for (i = 0, j = count - 1; i < j; i++, j--) {
+			sp_measure_cpu_freq_ticks_t state = table[i];
+			table[i] = table[j];
+			table[j] = state;
+		}
+		return;
+	}
+	/* insertion sort for the unlikely case of unordered table */
+	for (i = 1; i < count; i++) {
+		sp_measure_cpu_freq_ticks_t state = table[i];
+		for (j = i; j > 0 && table[j - 1].freq > state.freq; j--) {
+			table[j] = table[j - 1];
+		}
+		table[j] = state;
+	}
+}
+
 /**
  * Calculates average frequency during the time slice between two snapshots.
  *
- * @param[in] first   the first snapshot.
- * @param[in] second  the second snapshot.
- * @return            average frequency in Hz
+ * The frequency tables must be sorted by ascending frequency. The
+ * frequencies missing from the first table are assumed to have had
+ * zero ticks.
+ * @param[in] first         the first snapshot ticks per frequency array.
+ * @param[in] first_count   the number of items in the first array.
+ * @param[in] second        the second snapshot ticks per frequency array.
+ * @param[in] second_count  the number of items in the second array.
+ * @return                  average frequency in Hz
  */
 static int cpu_stats_diff_avg_freq(
-		const sp_measure_sys_data_t* first,
-		const sp_measure_sys_data_t* second
+		const sp_measure_cpu_freq_ticks_t* first,
+		int first_count,
+		const sp_measure_cpu_freq_ticks_t* second,
+		int second_count
 		)
 {
-	int i, j;
+	int i = 0, j;
 	uint64_t total_time = 0;
 	uint64_t total_freq = 0;
-	for (i = 0; i < second->cpu_freq_ticks_count; i++) {
-		uint64_t ticks = 0;
-		uint64_t freq = second->cpu_freq_ticks[i].freq;
-		for (j = 0; j < first->cpu_freq_ticks_count; j++) {
-			if (first->cpu_freq_ticks[i].freq == freq) {
-				ticks = first->cpu_freq_ticks[i].ticks;
-				break;
-			}
+	for (j = 0; j < second_count; j++) {
+		int64_t ticks = 0;
+		uint64_t freq = second[j].freq;
+		while (i < first_count && first[i].freq < second[j].freq) i++;
+		if (i < first_count && first[i].freq == second[j].freq) {
+			ticks = first[i].ticks;
 		}
-		uint64_t diff = second->cpu_freq_ticks[i].ticks - ticks;
+		int64_t diff = second[j].ticks - ticks;
+		/* ignore the statistics reset between snapshots */
+		if (diff <= 0) continue;
 		total_time += diff;
 		total_freq += freq * diff;
 	}
@@ -121,39 +165,222 @@ static int cpu_stats_diff_avg_freq(
 }
 
 /**
- * Retrieves values specified in data structure (key field) from
- * /proc/meminfo file.
+ * Files read by system snapshots.
+ */
+struct sp_measure_sys_files_t {
+	/* the context providing the file system root */
+	const sp_measure_ctx_t* ctx;
+
+	file_cache_t meminfo;
+	file_cache_t stat;
+	file_cache_t time_in_state;
+	file_cache_t low_watermark;
+	file_cache_t high_watermark;
+	/* time_in_state files of the cpu frequency policies */
+	file_cache_t* policy_time_in_state;
+	/* number of items in policy_time_in_state array */
+	int policy_count;
+
+	/* the number of items preallocated for every frequency table,
+	 * 0 if the tables are allocated on demand */
+	int freq_ticks_capacity;
+	/* the number of items preallocated for cpu_core_ticks arrays,
+	 * 0 if the arrays are allocated on demand */
+	int core_ticks_capacity;
+
+	/* full path of the memory cgroup usage file, NULL if no cgroup is selected */
+	char* cgroup_usage_path;
+
+	/* the buffer shared by all system file reads */
+	read_buffer_t buffer;
+};
+
+/**
+ * Creates the system snapshot file cache.
  *
- * @param[in,out] data    in  - list of keys to read.
- *                        out - the scanned values.
- * @param[in] length      the number of items in data list.
- * @return                the number of values retrieved.
+ * The files are opened when they are read for the first time and
+ * are kept open until the common system data is freed.
+ * @param[in] ctx   the context providing the file system root.
+ * @return          the file cache or NULL if there is not enough memory.
  */
-static int file_parse_proc_meminfo(
-		parse_query_t* data,
+static struct sp_measure_sys_files_t* sys_files_create(
+		const sp_measure_ctx_t* ctx
+		)
+{
+	struct sp_measure_sys_files_t* files = (struct sp_measure_sys_files_t*)malloc(sizeof(struct sp_measure_sys_files_t));
+	if (files == NULL) return NULL;
+	memset(files, 0, sizeof(struct sp_measure_sys_files_t));
+	files->ctx = ctx;
+	if (file_cache_init(&files->meminfo, ctx, "/proc/meminfo") != 0 ||
+			file_cache_init(&files->stat, ctx, "/proc/stat") != 0 ||
+			file_cache_init(&files->time_in_state, ctx, "/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state") != 0 ||
+			file_cache_init(&files->low_watermark, ctx, "/sys/kernel/low_watermark") != 0 ||
+			file_cache_init(&files->high_watermark, ctx, "/sys/kernel/high_watermark") != 0) {
+		file_cache_free(&files->meminfo);
+		file_cache_free(&files->stat);
+		file_cache_free(&files->time_in_state);
+		file_cache_free(&files->low_watermark);
+		file_cache_free(&files->high_watermark);
+		free(files);
+		return NULL;
+	}
+	return files;
+}
+
+/**
+ * Closes the system snapshot files and frees the file cache.
+ *
+ * @param[in] files   the file cache.
+ */
+static void sys_files_free(
+		struct sp_measure_sys_files_t* files
+		)
+{
+	int i;
+	file_cache_free(&files->meminfo);
+	file_cache_free(&files->stat);
+	file_cache_free(&files->time_in_state);
+	file_cache_free(&files->low_watermark);
+	file_cache_free(&files->high_watermark);
+	for (i = 0; i < files->policy_count; i++) {
+		file_cache_free(&files->policy_time_in_state[i]);
+	}
+	if (files->policy_time_in_state) free(files->policy_time_in_state);
+	if (files->cgroup_usage_path) free(files->cgroup_usage_path);
+	read_buffer_free(&files->buffer);
+	free(files);
+}
+
+/**
+ * Matches /proc/meminfo key against a known key name.
+ *
+ * Used only inside meminfo_key_lookup() switch.
+ */
+#define MEMINFO_KEY(name, id) \
+	if (length == sizeof(name) - 1 && !memcmp(key, name, sizeof(name) - 1)) return id
+
+/**
+ * Finds /proc/meminfo key identifier.
+ *
+ * The keys are first dispatched by their first character, so in the
+ * worst case only few keys must be compared.
+ * @param[in] key      the key name (not zero terminated).
+ * @param[in] length   the key name length.
+ * @return             the key identifier or -1 for unknown keys.
+ */
+static int meminfo_key_lookup(
+		const char* key,
 		int length
 		)
 {
-	int nscanned = 0, value = 0, i;
-	char key[128], buffer[PATH_MAX];
-	snprintf(buffer, sizeof(buffer), "%s/proc/meminfo", sp_measure_virtual_fs_root);
-	FILE* fp = fopen(buffer, "r");
-	if (fp) {
-		while (fgets(buffer, sizeof(buffer), fp) && nscanned < length) {
-			if (sscanf(buffer, "%[^:]: %d", key, &value) == 2) {
-				for (i = 0; i < length; i++) {
-					if (!data[i].ok) {
-						if (!strcmp(data[i].key, key)) {
-							data[i].ok = true;
-							*(data[i].value) = value;
-							nscanned++;
-							break;
-						}
-					}
+	switch (*key) {
+	case 'A':
+		MEMINFO_KEY("Active", MEMINFO_ACTIVE);
+		MEMINFO_KEY("Active(anon)", MEMINFO_ACTIVE_ANON);
+		MEMINFO_KEY("Active(file)", MEMINFO_ACTIVE_FILE);
+		MEMINFO_KEY("AnonPages", MEMINFO_ANON_PAGES);
+		MEMINFO_KEY("AnonHugePages", MEMINFO_ANON_HUGE_PAGES);
+		break;
+	case 'B':
+		MEMINFO_KEY("Buffers", MEMINFO_BUFFERS);
+		break;
+	case 'C':
+		MEMINFO_KEY("Cached", MEMINFO_CACHED);
+		MEMINFO_KEY("CommitLimit", MEMINFO_COMMIT_LIMIT);
+		MEMINFO_KEY("Committed_AS", MEMINFO_COMMITTED_AS);
+		break;
+	case 'D':
+		MEMINFO_KEY("Dirty", MEMINFO_DIRTY);
+		break;
+	case 'H':
+		MEMINFO_KEY("HugePages_Total", MEMINFO_HUGE_PAGES_TOTAL);
+		MEMINFO_KEY("HugePages_Free", MEMINFO_HUGE_PAGES_FREE);
+		MEMINFO_KEY("Hugepagesize", MEMINFO_HUGE_PAGE_SIZE);
+		break;
+	case 'I':
+		MEMINFO_KEY("Inactive", MEMINFO_INACTIVE);
+		MEMINFO_KEY("Inactive(anon)", MEMINFO_INACTIVE_ANON);
+		MEMINFO_KEY("Inactive(file)", MEMINFO_INACTIVE_FILE);
+		break;
+	case 'K':
+		MEMINFO_KEY("KernelStack", MEMINFO_KERNEL_STACK);
+		break;
+	case 'M':
+		MEMINFO_KEY("MemTotal", MEMINFO_MEM_TOTAL);
+		MEMINFO_KEY("MemFree", MEMINFO_MEM_FREE);
+		MEMINFO_KEY("MemAvailable", MEMINFO_MEM_AVAILABLE);
+		MEMINFO_KEY("Mlocked", MEMINFO_MLOCKED);
+		MEMINFO_KEY("Mapped", MEMINFO_MAPPED);
+		break;
+	case 'P':
+		MEMINFO_KEY("PageTables", MEMINFO_PAGE_TABLES);
+		break;
+	case 'S':
+		MEMINFO_KEY("SwapCached", MEMINFO_SWAP_CACHED);
+		MEMINFO_KEY("SwapTotal", MEMINFO_SWAP_TOTAL);
+		MEMINFO_KEY("SwapFree", MEMINFO_SWAP_FREE);
+		MEMINFO_KEY("Shmem", MEMINFO_SHMEM);
+		MEMINFO_KEY("Slab", MEMINFO_SLAB);
+		MEMINFO_KEY("SReclaimable", MEMINFO_SRECLAIMABLE);
+		MEMINFO_KEY("SUnreclaim", MEMINFO_SUNRECLAIM);
+		MEMINFO_KEY("ShmemHugePages", MEMINFO_SHMEM_HUGE_PAGES);
+		break;
+	case 'U':
+		MEMINFO_KEY("Unevictable", MEMINFO_UNEVICTABLE);
+		break;
+	case 'V':
+		MEMINFO_KEY("VmallocUsed", MEMINFO_VMALLOC_USED);
+		break;
+	case 'W':
+		MEMINFO_KEY("Writeback", MEMINFO_WRITEBACK);
+		break;
+	}
+	return -1;
+}
+
+#undef MEMINFO_KEY
+
+/**
+ * Retrieves all known values from /proc/meminfo file.
+ *
+ * The file is read once and scanned in a single pass.
+ * @param[in] files    the system file cache.
+ * @param[out] values  the scanned values, indexed by sp_measure_meminfo_key_t.
+ *                     Values not found are set to ESPMEASURE_UNDEFINED.
+ * @return             the number of values retrieved or -1 if the file
+ *                     could not be read.
+ */
+static int file_parse_proc_meminfo(
+		struct sp_measure_sys_files_t* files,
+		int* values
+		)
+{
+	int nscanned = 0, i;
+	for (i = 0; i < MEMINFO_COUNT; i++) values[i] = ESPMEASURE_UNDEFINED;
+
+	int size = file_cache_read(&files->meminfo, &files->buffer);
+	if (size < 0) return -1;
+
+	const char* ptr = files->buffer.data;
+	const char* end = ptr + size;
+	while (ptr < end) {
+		const char* key = ptr;
+		while (ptr < end && *ptr != ':' && *ptr != '\n') ptr++;
+		if (ptr < end && *ptr == ':') {
+			int id = meminfo_key_lookup(key, ptr - key);
+			ptr++;
+			while (ptr < end && *ptr == ' ') ptr++;
+			if (id >= 0 && ptr < end && *ptr >= '0' && *ptr <= '9') {
+				long long value = 0;
+				while (ptr < end && *ptr >= '0' && *ptr <= '9') {
+					if (value <= INT_MAX) value = value * 10 + *ptr - '0';
+					ptr++;
 				}
+				if (values[id] == ESPMEASURE_UNDEFINED) nscanned++;
+				values[id] = value > INT_MAX ? INT_MAX : (int)value;
 			}
 		}
-		fclose(fp);
+		while (ptr < end && *ptr++ != '\n') ;
 	}
 	return nscanned;
 }
@@ -161,17 +388,19 @@ static int file_parse_proc_meminfo(
 /**
  * Reads single integer value from a file.
  *
+ * @param[in] ctx        the context providing the file system root.
  * @param[in] filename   the file to read.
  * @param[out] value     the read value.
  * @return               0 for success.
  */
 static int file_read_int(
+		const sp_measure_ctx_t* ctx,
 		const char* filename,
 		int* value
 		)
 {
 	char buffer[PATH_MAX];
-	snprintf(buffer, sizeof(buffer), "%s%s", sp_measure_virtual_fs_root, filename);
+	snprintf(buffer, sizeof(buffer), "%s%s", ctx->fs_root, filename);
 	int fd = open(buffer, O_RDONLY);
 	if (fd != -1) {
 		int n = read(fd, buffer, sizeof(buffer) - 1);
@@ -186,25 +415,50 @@ static int file_read_int(
 }
 
 /**
- * Reads single int value from a cgroup file with conversion to kbytes.
+ * Reads single integer value from a cached file.
  *
- * @param[in] filename   the file to read.
+ * @param[in] file       the cached file.
+ * @param[in] buffer     the read buffer.
  * @param[out] value     the read value.
  * @return               0 for success.
  */
-static int cgroup_read_int(
-		sp_measure_sys_data_t* data,
-		const char* filename
+static int file_cache_read_int(
+		file_cache_t* file,
+		read_buffer_t* buffer,
+		int* value
 		)
 {
-	if (data->common->cgroup_root) {
-		char buffer[PATH_MAX];
-		snprintf(buffer, sizeof(buffer), "%s/%s", data->common->cgroup_root, filename);
-		int fd = open(buffer, O_RDONLY);
+	if (file_cache_read(file, buffer) > 0) {
+		*value = atoi(buffer->data);
+		return 0;
+	}
+	return -1;
+}
+
+/**
+ * Reads the selected memory cgroup usage with conversion to kbytes.
+ *
+ * The usage file path is built when the cgroup is selected.
+ * @param[out] data      the system snapshot.
+ * @return               0 for success.
+ */
+static int cgroup_read_usage(
+		sp_measure_sys_data_t* data
+		)
+{
+	const char* path = data->common->files->cgroup_usage_path;
+	if (path) {
+		/* the usage is a 64 bit integer in bytes */
+		char buffer[32];
+		int fd = open(path, O_RDONLY);
+		STATS_ADD(syscalls, 1);
 		if (fd != -1) {
 			int n = read(fd, buffer, sizeof(buffer) - 1);
 			close(fd);
+			STATS_ADD(files_opened, 1);
+			STATS_ADD(syscalls, 2);
 			if (n > 0) {
+				STATS_ADD(bytes_read, n);
 				buffer[n] = '\0';
 				data->mem_cgroup = (int)(strtoull(buffer, NULL, 10) >> 10);
 				return 0;
@@ -228,17 +482,13 @@ static int sys_init_memory_data(
 		sp_measure_sys_data_t* data
 		)
 {
-	parse_query_t query[] = {
-		{ "MemTotal",  &data->common->mem_total, false },
-		{ "SwapTotal", &data->common->mem_swap, false },
-	};
-
-	if (file_parse_proc_meminfo(query, ARRAY_ITEMS(query))
-			!= ARRAY_ITEMS(query)) {
-		int i;
-		for (i = 0; i < ARRAY_ITEMS(query); i++) {
-			*query[i].value = ESPMEASURE_UNDEFINED;
-		}
+	int values[MEMINFO_COUNT];
+	file_parse_proc_meminfo(data->common->files, values);
+	data->common->mem_total = values[MEMINFO_MEM_TOTAL];
+	data->common->mem_swap = values[MEMINFO_SWAP_TOTAL];
+	if (data->common->mem_total == ESPMEASURE_UNDEFINED || data->common->mem_swap == ESPMEASURE_UNDEFINED) {
+		data->common->mem_total = ESPMEASURE_UNDEFINED;
+		data->common->mem_swap = ESPMEASURE_UNDEFINED;
 		return -1;
 	}
 	return 0;
@@ -256,7 +506,7 @@ static int sys_init_cpu_data(
 		sp_measure_sys_data_t* data
 		)
 {
-	int rc = file_read_int("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", &data->common->cpu_max_freq);
+	int rc = file_read_int(data->common->files->ctx, "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", &data->common->cpu_max_freq);
 	if (rc) {
 		data->common->cpu_max_freq = ESPMEASURE_UNDEFINED;
 	}
@@ -264,43 +514,389 @@ static int sys_init_cpu_data(
 }
 
 
+/**
+ * Compares cpu frequency policies by their number.
+ */
+static int cpu_policy_compare(
+		const void* policy1,
+		const void* policy2
+		)
+{
+	return ((const sp_measure_cpu_policy_t*)policy1)->id - ((const sp_measure_cpu_policy_t*)policy2)->id;
+}
+
+/**
+ * Discovers the cpu frequency policies.
+ *
+ * Every cpufreq policy directory in /sys/devices/system/cpu/cpufreq/
+ * describes a group of cpus sharing the same clock. If the kernel does
+ * not provide the policy directories, the cpu0 frequency statistics are
+ * used as the only policy.
+ * The common parameters are assigned during initialization and not
+ * changed during snapshots.
+ * @param[out] stats  the system snapshot.
+ * @return            0 for success.
+ */
+static int sys_init_cpu_policies(
+		sp_measure_sys_data_t* data
+		)
+{
+	sp_measure_sys_common_t* common = data->common;
+	struct sp_measure_sys_files_t* files = common->files;
+	char buffer[PATH_MAX];
+	struct dirent* entry;
+	int i, id, count = 0, size = 0;
+
+	snprintf(buffer, sizeof(buffer), "%s/sys/devices/system/cpu/cpufreq", files->ctx->fs_root);
+	DIR* dir = opendir(buffer);
+	if (dir) {
+		while ( (entry = readdir(dir)) ) {
+			if (sscanf(entry->d_name, "policy%d", &id) != 1) continue;
+			if (count == size) {
+				size += CPU_POLICY_CHUNK_SIZE;
+				sp_measure_cpu_policy_t* policies = (sp_measure_cpu_policy_t*)realloc(common->cpu_policies,
+						size * sizeof(sp_measure_cpu_policy_t));
+				if (policies == NULL) {
+					closedir(dir);
+					return -ENOMEM;
+				}
+				common->cpu_policies = policies;
+			}
+			common->cpu_policies[count++].id = id;
+		}
+		closedir(dir);
+	}
+	if (count) {
+		qsort(common->cpu_policies, count, sizeof(sp_measure_cpu_policy_t), cpu_policy_compare);
+	}
+	else {
+		/* fall back to cpu0 frequency statistics */
+		common->cpu_policies = (sp_measure_cpu_policy_t*)malloc(sizeof(sp_measure_cpu_policy_t));
+		if (common->cpu_policies == NULL) return -ENOMEM;
+		common->cpu_policies[0].id = CPU_POLICY_CPU0;
+		count = 1;
+	}
+	files->policy_time_in_state = (file_cache_t*)calloc(count, sizeof(file_cache_t));
+	if (files->policy_time_in_state == NULL) return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		sp_measure_cpu_policy_t* policy = &common->cpu_policies[i];
+		char path[64];
+		if (policy->id == CPU_POLICY_CPU0) {
+			policy->id = 0;
+			strcpy(path, "/sys/devices/system/cpu/cpu0/cpufreq");
+		}
+		else {
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpufreq/policy%d", policy->id);
+		}
+		snprintf(buffer, sizeof(buffer), "%s/cpuinfo_max_freq", path);
+		if (file_read_int(files->ctx, buffer, &policy->max_freq) != 0) {
+			policy->max_freq = ESPMEASURE_UNDEFINED;
+		}
+		snprintf(buffer, sizeof(buffer), "%s/stats/time_in_state", path);
+		if (file_cache_init(&files->policy_time_in_state[i], files->ctx, buffer) != 0) return -ENOMEM;
+		files->policy_count++;
+	}
+	common->cpu_policy_count = count;
+	return 0;
+}
+
+/**
+ * Counts the frequencies listed in a time_in_state file.
+ *
+ * @param[in] file     the time_in_state file.
+ * @param[in] buffer   the read buffer.
+ * @return             the number of frequencies, 0 if the file can't be read.
+ */
+static int file_count_time_in_state(
+		file_cache_t* file,
+		read_buffer_t* buffer
+		)
+{
+	int count = 0;
+	if (file_cache_read(file, buffer) > 0) {
+		const char* ptr;
+		for (ptr = buffer->data; *ptr; ptr++) {
+			if (*ptr == '\n') count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Retrieves the number of cpus the kernel can report.
+ *
+ * The number is taken from the last cpu listed in possible cpu mask
+ * (/sys/devices/system/cpu/possible) or from the last cpu line in
+ * /proc/stat if the mask is not available.
+ * @param[in] files   the system file cache.
+ * @return            the number of cpus, 0 if it can't be retrieved.
+ */
+static int sys_read_cpu_count(
+		struct sp_measure_sys_files_t* files
+		)
+{
+	char buffer[PATH_MAX];
+	const char* ptr;
+	int count = 0;
+
+	snprintf(buffer, sizeof(buffer), "%s/sys/devices/system/cpu/possible", files->ctx->fs_root);
+	int fd = open(buffer, O_RDONLY);
+	if (fd != -1) {
+		int n = read(fd, buffer, sizeof(buffer) - 1);
+		close(fd);
+		if (n > 0) {
+			/* the mask is a list of ranges, for example 0-3,8-11 */
+			buffer[n] = '\0';
+			for (ptr = buffer; *ptr; ptr++) {
+				if (*ptr >= '0' && *ptr <= '9' && (ptr == buffer || ptr[-1] < '0' || ptr[-1] > '9')) {
+					count = atoi(ptr) + 1;
+				}
+			}
+		}
+	}
+	if (file_cache_read(&files->stat, &files->buffer) > 0) {
+		for (ptr = files->buffer.data; ptr[0] == 'c' && ptr[1] == 'p' && ptr[2] == 'u'; ptr++) {
+			if (ptr[3] >= '0' && ptr[3] <= '9' && atoi(ptr + 3) >= count) count = atoi(ptr + 3) + 1;
+			while (*ptr && *ptr != '\n') ptr++;
+			if (*ptr == '\0') break;
+		}
+	}
+	return count;
+}
+
+/**
+ * Determines the sizes of the cpu statistics tables.
+ *
+ * The snapshot tables are preallocated with these sizes, so the
+ * snapshots don't need to allocate memory.
+ * @param[in] common   the common system data.
+ */
+static void sys_init_table_sizes(
+		sp_measure_sys_common_t* common
+		)
+{
+	struct sp_measure_sys_files_t* files = common->files;
+	int i, count;
+	files->freq_ticks_capacity = file_count_time_in_state(&files->time_in_state, &files->buffer);
+	for (i = 0; i < files->policy_count; i++) {
+		count = file_count_time_in_state(&files->policy_time_in_state[i], &files->buffer);
+		if (count > files->freq_ticks_capacity) files->freq_ticks_capacity = count;
+	}
+	files->core_ticks_capacity = sys_read_cpu_count(files);
+}
+
+/**
+ * Preallocates the cpu statistics tables of a snapshot.
+ *
+ * @param[out] data   the system snapshot.
+ * @return            0 for success, -ENOMEM if there is not enough memory.
+ */
+static int sys_data_alloc_tables(
+		sp_measure_sys_data_t* data
+		)
+{
+	struct sp_measure_sys_files_t* files = data->common->files;
+	int i;
+	if (files->freq_ticks_capacity) {
+		data->cpu_freq_ticks = (sp_measure_cpu_freq_ticks_t*)malloc(files->freq_ticks_capacity *
+				sizeof(sp_measure_cpu_freq_ticks_t));
+		if (data->cpu_freq_ticks == NULL) return -ENOMEM;
+		data->cpu_freq_ticks_capacity = files->freq_ticks_capacity;
+	}
+	if (files->core_ticks_capacity) {
+		data->cpu_core_ticks = (sp_measure_cpu_ticks_t*)malloc(files->core_ticks_capacity *
+				sizeof(sp_measure_cpu_ticks_t));
+		if (data->cpu_core_ticks == NULL) return -ENOMEM;
+		data->cpu_core_capacity = files->core_ticks_capacity;
+	}
+	if (files->policy_count) {
+		data->cpu_policy_freq_ticks = (sp_measure_cpu_policy_freq_ticks_t*)calloc(files->policy_count,
+				sizeof(sp_measure_cpu_policy_freq_ticks_t));
+		if (data->cpu_policy_freq_ticks == NULL) return -ENOMEM;
+		data->cpu_policy_count = files->policy_count;
+		for (i = 0; i < files->policy_count && files->freq_ticks_capacity; i++) {
+			data->cpu_policy_freq_ticks[i].freq_ticks = (sp_measure_cpu_freq_ticks_t*)malloc(
+					files->freq_ticks_capacity * sizeof(sp_measure_cpu_freq_ticks_t));
+			if (data->cpu_policy_freq_ticks[i].freq_ticks == NULL) return -ENOMEM;
+			data->cpu_policy_freq_ticks[i].freq_ticks_capacity = files->freq_ticks_capacity;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Parses a cpu line of /proc/stat file.
+ *
+ * @param[in] ptr       the first value of the line.
+ * @param[out] ticks    the parsed cpu ticks.
+ * @param[out] sum      the sum of all values in the line (including guest time).
+ * @return              the end of the line.
+ */
+static const char* stat_parse_cpu_line(
+		const char* ptr,
+		sp_measure_cpu_ticks_t* ticks,
+		long long* sum
+		)
+{
+	long long values[STAT_CPU_FIELDS] = {0};
+	int index = 0;
+	*sum = 0;
+	while (*ptr && *ptr != '\n') {
+		long long value = 0;
+		while (*ptr == ' ') ptr++;
+		if (*ptr < '0' || *ptr > '9') break;
+		while (*ptr >= '0' && *ptr <= '9') {
+			value = value * 10 + (*ptr++ - '0');
+		}
+		if (index < STAT_CPU_FIELDS) values[index++] = value;
+		*sum += value;
+	}
+	ticks->user = values[0];
+	ticks->nice = values[1];
+	ticks->system = values[2];
+	ticks->idle = values[3];
+	ticks->iowait = values[4];
+	ticks->irq = values[5];
+	ticks->softirq = values[6];
+	ticks->steal = values[7];
+	ticks->total = values[0] + values[1] + values[2] + values[3] + values[4] + values[5] + values[6] + values[7];
+	while (*ptr && *ptr != '\n') ptr++;
+	return ptr;
+}
+
+/**
+ * Grows the per cpu core ticks array.
+ *
+ * The array never shrinks, the cpu cores going offline are
+ * marked by setting their total ticks to ESPMEASURE_UNDEFINED.
+ * The array is reallocated only if the cpu number exceeds the
+ * number of cpus already allocated in the snapshot.
+ * @param[out] stats    the system snapshot.
+ * @param[in] count     the new number of cpu cores.
+ * @return              0 for success, -ENOMEM if the array could not be grown.
+ */
+static int cpu_stats_grow_core_count(
+		sp_measure_sys_data_t* stats,
+		int count
+		)
+{
+	if (count > stats->cpu_core_capacity) {
+		sp_measure_cpu_ticks_t* ticks = (sp_measure_cpu_ticks_t*)realloc(stats->cpu_core_ticks,
+				count * sizeof(sp_measure_cpu_ticks_t));
+		if (ticks == NULL) return -ENOMEM;
+		stats->cpu_core_ticks = ticks;
+		stats->cpu_core_capacity = count;
+	}
+	stats->cpu_core_count = count;
+	return 0;
+}
+
 /**
  * Retrieve snapshot cpu ticks.
  *
+ * The /proc/stat cpu lines are parsed in a single pass over the
+ * file contents. The per cpu core lines are parsed only if
+ * SNAPSHOT_SYS_CPU_CORE_USAGE resource is requested.
  * @param[out] stats    the system snapshot.
- * @return              0 for success.
+ * @param[in] resources the requested resources.
+ * @return              0 for success, -ENOMEM if the per cpu core array
+ *                      could not be grown, otherwise the failed resource
+ *                      identifiers.
  */
-static int sys_get_cpu_ticks_total(
-		sp_measure_sys_data_t* stats
+static int sys_get_cpu_ticks(
+		sp_measure_sys_data_t* stats,
+		int resources
 		)
 {
-	char buffer[PATH_MAX];
-	snprintf(buffer, sizeof(buffer), "%s/proc/stat", sp_measure_virtual_fs_root);
-	FILE* fp = fopen(buffer, "r");
-	if (fp) {
-		stats->cpu_ticks_total = 0;
-		while (fgets(buffer, sizeof(buffer), fp)) {
-			if (strstr(buffer, "cpu ")) {
-				int index = 0;
-				char *ptr = buffer + 3;
-				char *token, *saveptr = NULL;
-				while (*ptr == ' ') ptr++;
-				while ( (token = strtok_r(ptr, " ", &saveptr)) ) {
-					int ticks = atoi(token);
-					stats->cpu_ticks_total += ticks;
-					if (index++ == 3) {
-						stats->cpu_ticks_idle = ticks;
+	struct sp_measure_sys_files_t* files = stats->common->files;
+	bool cores = (resources & SNAPSHOT_SYS_CPU_CORE_USAGE) != 0;
+	int i, ncores = 0, rc = SNAPSHOT_SYS_CPU_USAGE, err = 0;
+	if (file_cache_read(&files->stat, &files->buffer) >= 0) {
+		const char* ptr = files->buffer.data;
+		long long sum;
+		/* the cpu lines are at the beginning of the file */
+		while (ptr[0] == 'c' && ptr[1] == 'p' && ptr[2] == 'u') {
+			ptr += 3;
+			if (*ptr == ' ') {
+				ptr = stat_parse_cpu_line(ptr, &stats->cpu_ticks, &sum);
+				stats->cpu_ticks_total = sum;
+				stats->cpu_ticks_idle = stats->cpu_ticks.idle;
+				rc = 0;
+			}
+			else if (cores) {
+				int cpu = 0;
+				while (*ptr >= '0' && *ptr <= '9') {
+					cpu = cpu * 10 + (*ptr++ - '0');
+				}
+				if (cpu >= stats->cpu_core_count && (err = cpu_stats_grow_core_count(stats, cpu + 1)) != 0) {
+					cores = false;
+				}
+				else {
+					/* the missing cpus are offline */
+					for (i = ncores; i < cpu; i++) {
+						stats->cpu_core_ticks[i].total = ESPMEASURE_UNDEFINED;
 					}
-					ptr = NULL;
+					ptr = stat_parse_cpu_line(ptr, &stats->cpu_core_ticks[cpu], &sum);
+					ncores = cpu + 1;
 				}
+			}
+			while (*ptr && *ptr != '\n') ptr++;
+			if (*ptr == '\n') ptr++;
+		}
+	}
+	if (rc != 0) {
+		stats->cpu_ticks_total = ESPMEASURE_UNDEFINED;
+		stats->cpu_ticks_idle = ESPMEASURE_UNDEFINED;
+		stats->cpu_ticks.total = ESPMEASURE_UNDEFINED;
+	}
+	if (resources & SNAPSHOT_SYS_CPU_CORE_USAGE) {
+		if (!cores) ncores = 0;
+		for (i = ncores; i < stats->cpu_core_count; i++) {
+			stats->cpu_core_ticks[i].total = ESPMEASURE_UNDEFINED;
+		}
+		if (ncores == 0) rc |= SNAPSHOT_SYS_CPU_CORE_USAGE;
+	}
+	return err ? err : rc & resources;
+}
 
+/**
+ * Parses cpu frequency statistics (time_in_state) file.
+ *
+ * The frequency table is sorted by ascending frequency.
+ * @param[in] file       the time_in_state file.
+ * @param[in] buffer     the read buffer.
+ * @param[in,out] table  the ticks per frequency array.
+ * @param[in,out] count  the number of used items in the array.
+ * @param[in,out] capacity  the number of allocated items in the array.
+ * @return               0 for success, -ENOMEM if the table could not be
+ *                       grown, -1 if the file could not be read.
+ */
+static int file_parse_time_in_state(
+		file_cache_t* file,
+		read_buffer_t* buffer,
+		sp_measure_cpu_freq_ticks_t** table,
+		int* count,
+		int* capacity
+		)
+{
+	/* the table is rebuilt from scratch, the old allocation is reused */
+	*count = 0;
+	if (file_cache_read(file, buffer) >= 0) {
+		int freq, ticks;
+		char* line = buffer->data;
+		while (line && *line) {
+			char* next = strchr(line, '\n');
+			if (next) *next++ = '\0';
+			if (sscanf(line, "%d %d", &freq, &ticks) == 2 &&
+					cpu_stats_add_freq_ticks(table, count, capacity, freq, ticks) != 0) {
+				return -ENOMEM;
 			}
+			line = next;
 		}
-		fclose(fp);
+		cpu_stats_sort_freq_ticks(*table, *count);
 		return 0;
 	}
-	stats->cpu_ticks_total = ESPMEASURE_UNDEFINED;
-	stats->cpu_ticks_idle = ESPMEASURE_UNDEFINED;
 	return -1;
 }
 
@@ -314,20 +910,39 @@ static int sys_get_cpu_ticks_per_freq(
 		sp_measure_sys_data_t* stats
 		)
 {
-	char buffer[PATH_MAX];
-	snprintf(buffer, sizeof(buffer), "%s/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state", sp_measure_virtual_fs_root);
-	FILE* fp = fopen(buffer, "r");
-	if (fp) {
-		int freq, ticks;
-		while (fgets(buffer, sizeof(buffer), fp)) {
-			if (sscanf(buffer, "%d %d", &freq, &ticks) == 2) {
-				cpu_stats_set_freq_ticks(stats, freq, ticks);
-			}
+	struct sp_measure_sys_files_t* files = stats->common->files;
+	return file_parse_time_in_state(&files->time_in_state, &files->buffer,
+			&stats->cpu_freq_ticks, &stats->cpu_freq_ticks_count, &stats->cpu_freq_ticks_capacity);
+}
+
+/**
+ * Retrieves ticks per frequency statistics for all cpu frequency policies.
+ *
+ * @param[out] stats   the cpu snapshot.
+ * @return             0 for success, -ENOMEM if there is not enough memory.
+ */
+static int sys_get_cpu_policy_ticks_per_freq(
+		sp_measure_sys_data_t* stats
+		)
+{
+	struct sp_measure_sys_files_t* files = stats->common->files;
+	int i, err, rc = 0;
+	if (files->policy_count == 0) return -1;
+	if (stats->cpu_policy_freq_ticks == NULL) {
+		stats->cpu_policy_freq_ticks = (sp_measure_cpu_policy_freq_ticks_t*)calloc(files->policy_count,
+				sizeof(sp_measure_cpu_policy_freq_ticks_t));
+		if (stats->cpu_policy_freq_ticks == NULL) return -ENOMEM;
+		stats->cpu_policy_count = files->policy_count;
+	}
+	for (i = 0; i < stats->cpu_policy_count; i++) {
+		sp_measure_cpu_policy_freq_ticks_t* policy = &stats->cpu_policy_freq_ticks[i];
+		if ( (err = file_parse_time_in_state(&files->policy_time_in_state[i], &files->buffer,
+				&policy->freq_ticks, &policy->freq_ticks_count, &policy->freq_ticks_capacity)) != 0) {
+			policy->freq_ticks_count = 0;
+			if (rc != -ENOMEM) rc = err;
 		}
-		fclose(fp);
-		return 0;
 	}
-	return -1;
+	return rc;
 }
 
 
@@ -338,6 +953,8 @@ static int sys_get_cpu_ticks_per_freq(
 static void sys_data_free_common(sp_measure_sys_common_t* common)
 {
 	if (common->cgroup_root) free(common->cgroup_root);
+	if (common->cpu_policies) free(common->cpu_policies);
+	if (common->files) sys_files_free(common->files);
 	free(common);
 }
 
@@ -349,6 +966,16 @@ int sp_measure_init_sys_data(
 		int resources,
 		const sp_measure_sys_data_t* sample_data
 		)
+{
+	return sp_measure_init_sys_data_ctx(NULL, new_data, resources, sample_data);
+}
+
+int sp_measure_init_sys_data_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_sys_data_t* new_data,
+		int resources,
+		const sp_measure_sys_data_t* sample_data
+		)
 {
 	int rc = 0;
 	memset(new_data, 0, sizeof(sp_measure_sys_data_t));
@@ -361,10 +988,21 @@ int sp_measure_init_sys_data(
 		if (new_data->common == NULL) return -ENOMEM;
 		memset(new_data->common, 0, sizeof(sp_measure_sys_common_t));
 		new_data->common->ref_count = 1;
+		new_data->common->files = sys_files_create(CTX_OR_DEFAULT(ctx));
+		if (new_data->common->files == NULL) {
+			free(new_data->common);
+			return -ENOMEM;
+		}
 		if ( (resources & SNAPSHOT_SYS_MEM_TOTALS) && sys_init_memory_data(new_data) != 0) rc |= SNAPSHOT_SYS_MEM_TOTALS;
 		if ( (resources & SNAPSHOT_SYS_CPU_MAX_FREQ) && sys_init_cpu_data(new_data) != 0) rc |= SNAPSHOT_SYS_CPU_MAX_FREQ;
+		if ( (resources & SNAPSHOT_SYS_CPU) && sys_init_cpu_policies(new_data) != 0) rc |= SNAPSHOT_SYS_CPU_POLICY_FREQ;
+		if ( (resources & SNAPSHOT_SYS_CPU) ) sys_init_table_sizes(new_data->common);
 		if ( (resources & SNAPSHOT_SYS_MEM_CGROUPS) ) sp_measure_cgroup_select(new_data, NULL);
 	}
+	if (sys_data_alloc_tables(new_data) != 0) {
+		sp_measure_free_sys_data(new_data);
+		return -ENOMEM;
+	}
 	return rc;
 }
 
@@ -372,8 +1010,15 @@ int sp_measure_free_sys_data(
         sp_measure_sys_data_t* data
     )
 {
-	if (data->name) free(data->name);
 	if (data->cpu_freq_ticks) free(data->cpu_freq_ticks);
+	if (data->cpu_core_ticks) free(data->cpu_core_ticks);
+	if (data->cpu_policy_freq_ticks) {
+		int i;
+		for (i = 0; i < data->cpu_policy_count; i++) {
+			if (data->cpu_policy_freq_ticks[i].freq_ticks) free(data->cpu_policy_freq_ticks[i].freq_ticks);
+		}
+		free(data->cpu_policy_freq_ticks);
+	}
 	if (--data->common->ref_count == 0) {
 		sys_data_free_common(data->common);
 	}
@@ -381,30 +1026,74 @@ int sp_measure_free_sys_data(
 }
 
 
-static const char* cgroup_pattern = NULL;
-static char* cgroup_root = NULL;
-
-static int cgroup_match(const char *fpath, const struct stat *sb, int tflag)
+/**
+ * Finds the first directory containing the cgroup name in its path.
+ *
+ * The directory tree is scanned in the same pre-order as ftw() does, but
+ * the scan state is kept on stack so concurrent scans don't interfere.
+ * @param[in] path   the directory to scan.
+ * @param[in] name   the cgroup name.
+ * @return           the allocated path of the found directory or NULL.
+ */
+static char* cgroup_find(
+		const char* path,
+		const char* name
+		)
 {
-    if (FTW_D == tflag && strstr(fpath, cgroup_pattern)) {
-		cgroup_root = strdup(fpath);
-		return 1;
+	char child[PATH_MAX];
+	struct dirent* entry;
+	struct stat st;
+	char* match = NULL;
+
+	if (strstr(path, name)) return strdup(path);
+	DIR* dir = opendir(path);
+	if (dir == NULL) return NULL;
+	while (match == NULL && (entry = readdir(dir))) {
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+		if (snprintf(child, sizeof(child), "%s/%s", path, entry->d_name) >= (int)sizeof(child)) continue;
+		if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(child, &st) == 0 && S_ISDIR(st.st_mode))) {
+			match = cgroup_find(child, name);
+		}
 	}
-	return 0; /* To tell ftw() to continue */
+	closedir(dir);
+	return match;
 }
 
 
 const char* sp_measure_cgroup_select(sp_measure_sys_data_t* data, const char* name)
 {
-	static const char* root = "/syspart";
-	cgroup_root = NULL;
+	const char* fs_root = data->common->files->ctx->fs_root;
+	char* cgroup_root = NULL;
+	char root[PATH_MAX];
+	snprintf(root, sizeof(root), "%s/syspart", fs_root);
 
 	if (NULL != name && 0 != *name) {
-		cgroup_pattern = name;
-		ftw(root, cgroup_match, 32);
+		char path[PATH_MAX];
+		struct stat st;
+		/* the group is usually a direct child of the hierarchy root,
+		 * scan the whole hierarchy only if it's not */
+		snprintf(path, sizeof(path), "%s/syspart/%s", fs_root, name);
+		if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+			cgroup_root = strdup(path);
+		}
+		else {
+			cgroup_root = cgroup_find(root, name);
+		}
 	}
 	if (data->common->cgroup_root) free(data->common->cgroup_root);
 	data->common->cgroup_root = cgroup_root ? cgroup_root : strdup(root);
+
+	/* build the usage file path once instead of on every snapshot */
+	struct sp_measure_sys_files_t* files = data->common->files;
+	if (files->cgroup_usage_path) free(files->cgroup_usage_path);
+	files->cgroup_usage_path = NULL;
+	if (data->common->cgroup_root) {
+		size_t size = strlen(data->common->cgroup_root) + sizeof("/memory.memsw.usage_in_bytes");
+		files->cgroup_usage_path = (char*)malloc(size);
+		if (files->cgroup_usage_path) {
+			snprintf(files->cgroup_usage_path, size, "%s/memory.memsw.usage_in_bytes", data->common->cgroup_root);
+		}
+	}
 	return data->common->cgroup_root;
 }
 
@@ -414,56 +1103,99 @@ int sp_measure_get_sys_data(
 		const char* name
 		)
 {
-	int rc = 0;
-	if (name) {
-		if (data->name) free(data->name);
-		data->name = strdup(name);
-		if (data->name == NULL) return -ENOMEM;
-	}
+	int rc = 0, err = 0, res;
+	stats_call_t stats;
+	if (name) snapshot_set_name(data->name, name);
+	stats_call_begin(&stats, false);
 	if (resources & SNAPSHOT_SYS_TIMESTAMP) {
 		struct timeval tv;
-		if ( (rc = gettimeofday(&tv, NULL)) != 0) return rc;
+		stats_resource_begin(&stats, SNAPSHOT_SYS_TIMESTAMP);
+		if ( (rc = gettimeofday(&tv, NULL)) != 0) {
+			stats_resource_end(&stats, true);
+			stats_call_end(&stats);
+			return rc;
+		}
 		data->timestamp = tv.tv_sec % (60 * 60 * 24) * 1000 + tv.tv_usec / 1000;
+		data->timestamp_ns = clock_read_ns(CLOCK_MONOTONIC);
+#ifdef CLOCK_BOOTTIME
+		data->timestamp_boottime_ns = clock_read_ns(CLOCK_BOOTTIME);
+#else
+		data->timestamp_boottime_ns = ESPMEASURE_UNDEFINED;
+#endif
+		stats_resource_end(&stats, false);
 	}
-	if (resources & SNAPSHOT_SYS_MEM_USAGE) {
-		parse_query_t query[] = {
-			{ "MemFree",  &data->mem_free, false },
-			{ "Buffers", &data->mem_buffers, false },
-			{ "Cached", &data->mem_cached, false },
-			{ "SwapCached", &data->mem_swap_cached, false },
-			{ "SwapFree", &data->mem_swap_free, false },
-		};
-		if (file_parse_proc_meminfo(query, ARRAY_ITEMS(query))
-				!= ARRAY_ITEMS(query)) {
-			int i;
-			for (i = 0; i < ARRAY_ITEMS(query); i++) {
-				*query[i].value = ESPMEASURE_UNDEFINED;
+	if (resources & (SNAPSHOT_SYS_MEM_USAGE | SNAPSHOT_SYS_MEM_DETAILS)) {
+		int values[MEMINFO_COUNT];
+		stats_resource_begin(&stats, resources & SNAPSHOT_SYS_MEM_USAGE ? SNAPSHOT_SYS_MEM_USAGE : SNAPSHOT_SYS_MEM_DETAILS);
+		int nscanned = file_parse_proc_meminfo(data->common->files, values);
+		if (resources & SNAPSHOT_SYS_MEM_USAGE) {
+			data->mem_free = values[MEMINFO_MEM_FREE];
+			data->mem_buffers = values[MEMINFO_BUFFERS];
+			data->mem_cached = values[MEMINFO_CACHED];
+			data->mem_swap_cached = values[MEMINFO_SWAP_CACHED];
+			data->mem_swap_free = values[MEMINFO_SWAP_FREE];
+			if (data->mem_free == ESPMEASURE_UNDEFINED || data->mem_buffers == ESPMEASURE_UNDEFINED ||
+					data->mem_cached == ESPMEASURE_UNDEFINED || data->mem_swap_cached == ESPMEASURE_UNDEFINED ||
+					data->mem_swap_free == ESPMEASURE_UNDEFINED) {
+				data->mem_free = ESPMEASURE_UNDEFINED;
+				data->mem_buffers = ESPMEASURE_UNDEFINED;
+				data->mem_cached = ESPMEASURE_UNDEFINED;
+				data->mem_swap_cached = ESPMEASURE_UNDEFINED;
+				data->mem_swap_free = ESPMEASURE_UNDEFINED;
+				rc |= SNAPSHOT_SYS_MEM_USAGE;
 			}
-			rc |= SNAPSHOT_SYS_MEM_USAGE;
 		}
+		if (resources & SNAPSHOT_SYS_MEM_DETAILS) {
+			memcpy(data->mem_details, values, sizeof(data->mem_details));
+			if (nscanned <= 0) rc |= SNAPSHOT_SYS_MEM_DETAILS;
+		}
+		stats_resource_end(&stats, rc & (SNAPSHOT_SYS_MEM_USAGE | SNAPSHOT_SYS_MEM_DETAILS));
 	}
 	if (resources & SNAPSHOT_SYS_MEM_CGROUPS) {
-		if (cgroup_read_int(data, "memory.memsw.usage_in_bytes") != 0) {
+		stats_resource_begin(&stats, SNAPSHOT_SYS_MEM_CGROUPS);
+		if (cgroup_read_usage(data) != 0) {
 			rc |= SNAPSHOT_SYS_MEM_CGROUPS;
 		}
+		stats_resource_end(&stats, rc & SNAPSHOT_SYS_MEM_CGROUPS);
 	}
 	if (resources & SNAPSHOT_SYS_MEM_WATERMARK) {
 		int low = 0, high = 0;
-		if (file_read_int("/sys/kernel/low_watermark", &low) != 0) {
+		struct sp_measure_sys_files_t* files = data->common->files;
+		stats_resource_begin(&stats, SNAPSHOT_SYS_MEM_WATERMARK);
+		if (file_cache_read_int(&files->low_watermark, &files->buffer, &low) != 0) {
 			rc |= SNAPSHOT_SYS_MEM_WATERMARK;
 		}
-		if (file_read_int("/sys/kernel/high_watermark", &high) != 0) {
+		if (file_cache_read_int(&files->high_watermark, &files->buffer, &high) != 0) {
 			rc |= SNAPSHOT_SYS_MEM_WATERMARK;
 		}
 		data->mem_watermark = low | (high << 1);
+		stats_resource_end(&stats, rc & SNAPSHOT_SYS_MEM_WATERMARK);
 	}
-	if ( (resources & SNAPSHOT_SYS_CPU_USAGE) && sys_get_cpu_ticks_total(data) != 0) {
-		rc |= SNAPSHOT_SYS_CPU_USAGE;
+	if (resources & (SNAPSHOT_SYS_CPU_USAGE | SNAPSHOT_SYS_CPU_CORE_USAGE)) {
+		stats_resource_begin(&stats, resources & SNAPSHOT_SYS_CPU_USAGE ? SNAPSHOT_SYS_CPU_USAGE : SNAPSHOT_SYS_CPU_CORE_USAGE);
+		if ( (res = sys_get_cpu_ticks(data, resources)) == -ENOMEM) err = res;
+		else rc |= res;
+		stats_resource_end(&stats, rc & (SNAPSHOT_SYS_CPU_USAGE | SNAPSHOT_SYS_CPU_CORE_USAGE));
 	}
-	if ( (resources & SNAPSHOT_SYS_CPU_FREQ) && sys_get_cpu_ticks_per_freq(data) != 0) {
-		rc |= SNAPSHOT_SYS_CPU_FREQ;
+	if (resources & SNAPSHOT_SYS_CPU_FREQ) {
+		stats_resource_begin(&stats, SNAPSHOT_SYS_CPU_FREQ);
+		if ( (res = sys_get_cpu_ticks_per_freq(data)) != 0) {
+			rc |= SNAPSHOT_SYS_CPU_FREQ;
+			if (res == -ENOMEM) err = res;
+		}
+		stats_resource_end(&stats, rc & SNAPSHOT_SYS_CPU_FREQ);
 	}
-	return rc;
+	if (resources & SNAPSHOT_SYS_CPU_POLICY_FREQ) {
+		stats_resource_begin(&stats, SNAPSHOT_SYS_CPU_POLICY_FREQ);
+		if ( (res = sys_get_cpu_policy_ticks_per_freq(data)) != 0) {
+			rc |= SNAPSHOT_SYS_CPU_POLICY_FREQ;
+			if (res == -ENOMEM) err = res;
+		}
+		stats_resource_end(&stats, rc & SNAPSHOT_SYS_CPU_POLICY_FREQ);
+	}
+	stats_call_end(&stats);
+	/* allocation failures are reported as errors, not as missing resources */
+	return err ? err : rc;
 }
 
 
@@ -480,6 +1212,12 @@ int sp_measure_diff_sys_timestamp(
 	if (data1->common != data2->common) {
 		return -EINVAL;
 	}
+	int64_t diff_ns;
+	if (sp_measure_diff_sys_timestamp_ns(data1, data2, &diff_ns) == 0) {
+		*diff = diff_ns / 1000000;
+		return 0;
+	}
+	/* fall back to wall clock timestamps */
 	*diff = data2->timestamp - data1->timestamp;
 	if (*diff < 0) {
 		*diff += 24 * 60 * 60 * 1000;
@@ -487,6 +1225,40 @@ int sp_measure_diff_sys_timestamp(
 	return 0;
 }
 
+int sp_measure_diff_sys_timestamp_ns(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int64_t* diff
+		)
+{
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (data1->timestamp_ns == ESPMEASURE_UNDEFINED || data2->timestamp_ns == ESPMEASURE_UNDEFINED ||
+			data1->timestamp_ns == 0 || data2->timestamp_ns == 0) {
+		return -EINVAL;
+	}
+	*diff = data2->timestamp_ns - data1->timestamp_ns;
+	return 0;
+}
+
+int sp_measure_diff_sys_boottime_ns(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int64_t* diff
+		)
+{
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (data1->timestamp_boottime_ns == ESPMEASURE_UNDEFINED || data2->timestamp_boottime_ns == ESPMEASURE_UNDEFINED ||
+			data1->timestamp_boottime_ns == 0 || data2->timestamp_boottime_ns == 0) {
+		return -EINVAL;
+	}
+	*diff = data2->timestamp_boottime_ns - data1->timestamp_boottime_ns;
+	return 0;
+}
+
 int sp_measure_diff_sys_cpu_ticks(
 		const sp_measure_sys_data_t* data1,
 		const sp_measure_sys_data_t* data2,
@@ -521,6 +1293,67 @@ int sp_measure_diff_sys_cpu_usage(
 	return 0;
 }
 
+int sp_measure_diff_sys_cpu_core_ticks(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		sp_measure_cpu_ticks_t* diff,
+		int count
+		)
+{
+	int i;
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (count > data1->cpu_core_count) count = data1->cpu_core_count;
+	if (count > data2->cpu_core_count) count = data2->cpu_core_count;
+	for (i = 0; i < count; i++) {
+		const sp_measure_cpu_ticks_t* ticks1 = &data1->cpu_core_ticks[i];
+		const sp_measure_cpu_ticks_t* ticks2 = &data2->cpu_core_ticks[i];
+		if (ticks1->total == ESPMEASURE_UNDEFINED || ticks2->total == ESPMEASURE_UNDEFINED) {
+			memset(&diff[i], 0, sizeof(sp_measure_cpu_ticks_t));
+			diff[i].total = ESPMEASURE_UNDEFINED;
+			continue;
+		}
+		diff[i].user = ticks2->user - ticks1->user;
+		diff[i].nice = ticks2->nice - ticks1->nice;
+		diff[i].system = ticks2->system - ticks1->system;
+		diff[i].idle = ticks2->idle - ticks1->idle;
+		diff[i].iowait = ticks2->iowait - ticks1->iowait;
+		diff[i].irq = ticks2->irq - ticks1->irq;
+		diff[i].softirq = ticks2->softirq - ticks1->softirq;
+		diff[i].steal = ticks2->steal - ticks1->steal;
+		diff[i].total = ticks2->total - ticks1->total;
+	}
+	return count;
+}
+
+int sp_measure_diff_sys_cpu_core_usage(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int* diff,
+		int count
+		)
+{
+	int i;
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (count > data1->cpu_core_count) count = data1->cpu_core_count;
+	if (count > data2->cpu_core_count) count = data2->cpu_core_count;
+	for (i = 0; i < count; i++) {
+		const sp_measure_cpu_ticks_t* ticks1 = &data1->cpu_core_ticks[i];
+		const sp_measure_cpu_ticks_t* ticks2 = &data2->cpu_core_ticks[i];
+		if (ticks1->total == ESPMEASURE_UNDEFINED || ticks2->total == ESPMEASURE_UNDEFINED) {
+			diff[i] = ESPMEASURE_UNDEFINED;
+			continue;
+		}
+		long long total = ticks2->total - ticks1->total;
+		long long idle = ticks2->idle - ticks1->idle;
+		diff[i] = total ? (total - idle) * 10000 / total : 0;
+	}
+	return count;
+}
+
 int sp_measure_diff_sys_cpu_avg_freq(
 		const sp_measure_sys_data_t* data1,
 		const sp_measure_sys_data_t* data2,
@@ -530,10 +1363,33 @@ int sp_measure_diff_sys_cpu_avg_freq(
 	if (data1->common != data2->common) {
 		return -EINVAL;
 	}
-	*diff = cpu_stats_diff_avg_freq(data1, data2);
+	*diff = cpu_stats_diff_avg_freq(data1->cpu_freq_ticks, data1->cpu_freq_ticks_count,
+			data2->cpu_freq_ticks, data2->cpu_freq_ticks_count);
 	return 0;
 }
 
+int sp_measure_diff_sys_cpu_policy_avg_freq(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int* diff,
+		int count
+		)
+{
+	int i;
+	if (data1->common != data2->common) {
+		return -EINVAL;
+	}
+	if (count > data1->cpu_policy_count) count = data1->cpu_policy_count;
+	if (count > data2->cpu_policy_count) count = data2->cpu_policy_count;
+	for (i = 0; i < count; i++) {
+		const sp_measure_cpu_policy_freq_ticks_t* policy1 = &data1->cpu_policy_freq_ticks[i];
+		const sp_measure_cpu_policy_freq_ticks_t* policy2 = &data2->cpu_policy_freq_ticks[i];
+		diff[i] = cpu_stats_diff_avg_freq(policy1->freq_ticks, policy1->freq_ticks_count,
+				policy2->freq_ticks, policy2->freq_ticks_count);
+	}
+	return count;
+}
+
 int sp_measure_diff_sys_mem_used(
 		const sp_measure_sys_data_t* data1,
 		const sp_measure_sys_data_t* data2,
@@ -567,12 +1423,5 @@ int sp_measure_diff_sys_mem_cgroup(
 
 int sp_measure_set_fs_root(const char* path)
 {
-	if (sp_measure_virtual_fs_root != sp_measure_fs_root) {
-		free(sp_measure_virtual_fs_root);
-	}
-	sp_measure_virtual_fs_root = path ? strdup(path) : sp_measure_fs_root;
-	if (sp_measure_virtual_fs_root) {
-		return 0;
-	}
-	return -1;
+	return sp_measure_ctx_set_fs_root(NULL, path);
 }
@@ -66,6 +66,19 @@
 extern "C" {
 #endif
 
+/* system snapshot file cache, private to the library */
+struct sp_measure_sys_files_t;
+
+/**
+ * Cpu frequency policy - a group of cpus sharing the same clock.
+ */
+typedef struct sp_measure_cpu_policy_t {
+	/* the policy number (N in /sys/devices/system/cpu/cpufreq/policyN) */
+	int id;
+	/* maximum cpu frequency of the policy in KHz */
+	int max_freq;
+} sp_measure_cpu_policy_t;
+
 /**
  * Common system information.
  */
@@ -78,11 +91,19 @@ typedef struct sp_measure_sys_common_t {
 	/* maximum cpu frequency in KHz */
 	int cpu_max_freq;
 
+	/* cpu frequency policies, sorted by policy number */
+	sp_measure_cpu_policy_t* cpu_policies;
+	/* number of items in cpu_policies array */
+	int cpu_policy_count;
+
 	/* system common data reference counter */
 	int ref_count;
 
 	/* root of the cgroups file system. */
 	char* cgroup_root;
+
+	/* files kept open between snapshots */
+	struct sp_measure_sys_files_t* files;
 } sp_measure_sys_common_t;
 
 /**
@@ -95,6 +116,35 @@ typedef struct sp_measure_cpu_freq_ticks_t {
 	int ticks;
 } sp_measure_cpu_freq_ticks_t;
 
+/**
+ * Ticks per frequency statistics of a cpu frequency policy.
+ */
+typedef struct sp_measure_cpu_policy_freq_ticks_t {
+	/* ticks per frequencies, sorted by ascending frequency */
+	sp_measure_cpu_freq_ticks_t* freq_ticks;
+	/* number of used items in freq_ticks array */
+	int freq_ticks_count;
+	/* number of allocated items in freq_ticks array */
+	int freq_ticks_capacity;
+} sp_measure_cpu_policy_freq_ticks_t;
+
+/**
+ * Cpu time split by the kind of work, in cpu ticks (from /proc/stat).
+ */
+typedef struct sp_measure_cpu_ticks_t {
+	long long user;
+	long long nice;
+	long long system;
+	long long idle;
+	long long iowait;
+	long long irq;
+	long long softirq;
+	long long steal;
+	/* sum of the above fields (guest time is already included in user
+	 * time by kernel), ESPMEASURE_UNDEFINED for offline cpus */
+	long long total;
+} sp_measure_cpu_ticks_t;
+
 /**
  * System resource usage snapshot
  */
@@ -102,8 +152,9 @@ typedef struct sp_measure_sys_data_t {
 	/* common system data, initialized at the beginning and not a subject to change */
 	sp_measure_sys_common_t* common;
 
-	/* the snapshot name */
-	char* name;
+	/* the snapshot name, empty if not set. The name is stored inline
+	 * so taking a named snapshot does not allocate memory */
+	char name[SP_MEASURE_NAME_SIZE];
 
 	/* The snapshot timestamp in milliseconds since midnight.
 	 * The milliseconds resolution was deemed satisfactory as the
@@ -112,6 +163,18 @@ typedef struct sp_measure_sys_data_t {
 	 * only as CPU ticks i.e. at 10ms accuracy */
 	int timestamp;
 
+	/* The snapshot CLOCK_MONOTONIC timestamp in nanoseconds. Unlike the
+	 * timestamp above it is not affected by wall clock changes and does
+	 * not wrap around at midnight */
+	int64_t timestamp_ns;
+	/* The snapshot CLOCK_BOOTTIME timestamp in nanoseconds (includes the
+	 * time spent in suspend), ESPMEASURE_UNDEFINED if not supported */
+	int64_t timestamp_boottime_ns;
+	/* The intended snapshot time (CLOCK_MONOTONIC nanoseconds) of the
+	 * sampling schedule, 0 if the snapshot was not stamped by a schedule,
+	 * see sp_measure_schedule_stamp_sys() */
+	int64_t scheduled_ns;
+
 	/* the unused system memory */
 	int mem_free;
 	/* memory used for file buffers */
@@ -124,6 +187,10 @@ typedef struct sp_measure_sys_data_t {
 	/* swap memory used for caching */
 	int mem_swap_cached;
 
+	/* all /proc/meminfo values indexed by sp_measure_meminfo_key_t,
+	 * ESPMEASURE_UNDEFINED for keys not provided by the kernel */
+	int mem_details[MEMINFO_COUNT];
+
 	/* contents of memory.memsw.usage_in_bytes for specified cgroup or root group */
 	int mem_cgroup;
 
@@ -135,10 +202,25 @@ typedef struct sp_measure_sys_data_t {
 	int cpu_ticks_total;
 	/* idle cpu ticks */
 	int cpu_ticks_idle;
-	/* ticks per frequencies */
+	/* cpu ticks of all cpus split by the kind of work */
+	sp_measure_cpu_ticks_t cpu_ticks;
+	/* cpu ticks per cpu core, indexed by cpu number */
+	sp_measure_cpu_ticks_t* cpu_core_ticks;
+	/* number of items in cpu_core_ticks array */
+	int cpu_core_count;
+	/* number of allocated items in cpu_core_ticks array */
+	int cpu_core_capacity;
+	/* ticks per frequencies, sorted by ascending frequency */
 	sp_measure_cpu_freq_ticks_t* cpu_freq_ticks;
 	/* number of used items in freq_ticks array */
 	int cpu_freq_ticks_count;
+	/* number of allocated items in freq_ticks array */
+	int cpu_freq_ticks_capacity;
+	/* ticks per frequencies for every cpu frequency policy,
+	 * in the same order as common cpu_policies array */
+	sp_measure_cpu_policy_freq_ticks_t* cpu_policy_freq_ticks;
+	/* number of items in cpu_policy_freq_ticks array */
+	int cpu_policy_count;
 
 } sp_measure_sys_data_t;
 
@@ -170,6 +252,25 @@ int sp_measure_init_sys_data(
 		const sp_measure_sys_data_t* sample_data
 		);
 
+/**
+ * Initializes system snapshot data structure of the specified context.
+ *
+ * See sp_measure_init_sys_data() function. The snapshots initialized from
+ * the sample_data snapshot use the context of the sample_data snapshot.
+ * @param[in] ctx          the library context, NULL for the default context.
+ * @param[out] new_data    the system snapshot data structure to initialize.
+ * @param[in] resources    a flag specifying which system parameters should be
+ *                         retrieved (ignored if sample_data is given).
+ * @param[in] sample_data  An already initialized system snapshot.
+ * @return                 see sp_measure_init_sys_data() function.
+ */
+int sp_measure_init_sys_data_ctx(
+		const sp_measure_ctx_t* ctx,
+		sp_measure_sys_data_t* new_data,
+		int resources,
+		const sp_measure_sys_data_t* sample_data
+		);
+
 
 /**
  * Releases system snapshot data structure.
@@ -187,6 +288,8 @@ int sp_measure_free_sys_data(
  * select cgroup based on its name.
  *
  * This functions scans /syspart folder contents to find proper cgroup by name.
+ * The /syspart/<name> directory is selected directly if it exists. The folder
+ * is located under the file system root set by sp_measure_set_fs_root().
  * @param[in] data   the system snapshot data structure.
  * @param[in] name   the system cgroup to be selected.
  * @return           the full path of selected cgroup.
@@ -204,7 +307,8 @@ const char* sp_measure_cgroup_select(sp_measure_sys_data_t* data, const char* na
  *                       >0 - only a part of the system resource usage statistics was retrieved.
  *                            The returned value consists of the failed resource identifiers
  *                            (see sp_measure_sys_resource_t enumeration).
- *                       <0 - unrecoverable error during resource usage statistics retrieval.
+ *                       <0 - unrecoverable error during resource usage statistics retrieval,
+ *                            -ENOMEM if the snapshot tables could not be grown.
  */
 int sp_measure_get_sys_data(
 		sp_measure_sys_data_t* data,
@@ -229,6 +333,8 @@ int sp_measure_get_sys_data(
 /**
  * Retrieves time difference between two snapshots (in milliseconds).
  *
+ * The difference is calculated from the monotonic timestamps, so it is
+ * not affected by wall clock changes.
  * @param[in] data1  the first snapshot.
  * @param[in] data2  the second snapshot.
  * @param[out] diff  the time difference in milliseconds.
@@ -240,6 +346,35 @@ int sp_measure_diff_sys_timestamp(
 		int* diff
 		);
 
+/**
+ * Retrieves time difference between two snapshots (in nanoseconds).
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the CLOCK_MONOTONIC time difference in nanoseconds.
+ * @return           0 for success.
+ */
+int sp_measure_diff_sys_timestamp_ns(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int64_t* diff
+		);
+
+/**
+ * Retrieves time difference between two snapshots including the
+ * time spent in suspend (in nanoseconds).
+ *
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the CLOCK_BOOTTIME time difference in nanoseconds.
+ * @return           0 for success.
+ */
+int sp_measure_diff_sys_boottime_ns(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int64_t* diff
+		);
+
 /**
  * Retrieves number of total cpu ticks happened between two snapshots.
  *
@@ -269,6 +404,46 @@ int sp_measure_diff_sys_cpu_usage(
 		int* diff
 		);
 
+/**
+ * Retrieves per cpu core ticks spent between two snapshots.
+ *
+ * The ticks of cpu cores which were offline during either of snapshots
+ * have total field set to ESPMEASURE_UNDEFINED.
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the cpu ticks differences, indexed by cpu number.
+ * @param[in] count  the number of items in diff array.
+ * @return           >=0 - the number of cpu cores written into diff array.
+ *                   <0  - failure.
+ */
+int sp_measure_diff_sys_cpu_core_ticks(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		sp_measure_cpu_ticks_t* diff,
+		int count
+		);
+
+/**
+ * Retrieves per cpu core usage during the time slice between two snapshots.
+ *
+ * The cpu usage is measured in the same way as sp_measure_diff_sys_cpu_usage()
+ * does: (% of cpu used) * 100, where all non-idle time is counted as used.
+ * The usage of cpu cores which were offline during either of snapshots
+ * is set to ESPMEASURE_UNDEFINED.
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the cpu usage values, indexed by cpu number.
+ * @param[in] count  the number of items in diff array.
+ * @return           >=0 - the number of cpu cores written into diff array.
+ *                   <0  - failure.
+ */
+int sp_measure_diff_sys_cpu_core_usage(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int* diff,
+		int count
+		);
+
 /**
  * Retrieves average cpu frequency during the time slice between two snapshots.
  *
@@ -285,6 +460,26 @@ int sp_measure_diff_sys_cpu_avg_freq(
 		int* diff
 		);
 
+/**
+ * Retrieves average frequency of every cpu frequency policy during the
+ * time slice between two snapshots.
+ *
+ * The cpu frequency is measured in KHz. The policies are in the same
+ * order as the common cpu_policies array.
+ * @param[in] data1  the first snapshot.
+ * @param[in] data2  the second snapshot.
+ * @param[out] diff  the average cpu frequencies.
+ * @param[in] count  the number of items in diff array.
+ * @return           >=0 - the number of policies written into diff array.
+ *                   <0  - failure.
+ */
+int sp_measure_diff_sys_cpu_policy_avg_freq(
+		const sp_measure_sys_data_t* data1,
+		const sp_measure_sys_data_t* data2,
+		int* diff,
+		int count
+		);
+
 /**
  * Retrieves system memory usage difference (in kB) between two snapshots.
  *
@@ -322,9 +517,11 @@ int sp_measure_diff_sys_mem_cgroup(
  * value.
  * This function can be used for getting measurements out of saved
  * /proc/ & /sys/ files, and for testing purposes.
+ * The root is set for the default context, see sp_measure_ctx_set_fs_root().
  * @param[in] path   the new root of proc file system. Use NULL to
  *                   reset to the default value /proc.
- * @return           0 for success.
+ * @return           0 for success, -ENOMEM if there is not enough memory
+ *                   (earlier versions returned -1).
  */
 extern int sp_measure_set_fs_root(const char* path);
 
@@ -341,7 +538,15 @@ extern int sp_measure_set_fs_root(const char* path);
 #define FIELD_SYS_CPU_MAX_FREQ(data)         (data)->common->cpu_max_freq
 #define FIELD_SYS_CPU_TICKS(data)            (data)->cpu_total_ticks
 #define FIELD_SYS_TIMESTAMP(data)            (data)->timestamp
+#define FIELD_SYS_TIMESTAMP_NS(data)         (data)->timestamp_ns
+#define FIELD_SYS_BOOTTIME_NS(data)          (data)->timestamp_boottime_ns
+#define FIELD_SYS_SCHEDULED_NS(data)         (data)->scheduled_ns
 #define FIELD_SYS_MEM_CGROUP(data)           (data)->mem_cgroup
+#define FIELD_SYS_MEMINFO(data, key)         (data)->mem_details[key]
+#define FIELD_SYS_CPU_CORE_COUNT(data)       (data)->cpu_core_count
+#define FIELD_SYS_CPU_CORE_TICKS(data, cpu)  (&(data)->cpu_core_ticks[cpu])
+#define FIELD_SYS_CPU_POLICY_COUNT(data)     (data)->common->cpu_policy_count
+#define FIELD_SYS_CPU_POLICY(data, index)    (&(data)->common->cpu_policies[index])
 
 #ifdef __cplusplus
 }
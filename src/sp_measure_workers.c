@@ -0,0 +1,312 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <memory.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sp_measure.h"
+#include "measure_utils.h"
+
+/*
+ * Process set worker pool.
+ *
+ * Every worker owns a queue holding a range of process set indices.
+ * At the start of a snapshot the processes are split evenly between
+ * the worker queues. A worker takes the processes from the head of its
+ * own queue and, when the queue is empty, steals the tail half of
+ * another worker's queue.
+ */
+
+/**
+ * Worker queue of process set indices.
+ */
+typedef struct worker_queue_t {
+	pthread_mutex_t lock;
+	/* the first index left to sample */
+	int head;
+	/* the index after the last index left to sample */
+	int tail;
+} worker_queue_t;
+
+/**
+ * Worker data.
+ */
+typedef struct worker_t {
+	/* the pool the worker belongs to */
+	struct sp_measure_proc_workers_t* pool;
+	/* the worker thread (not used for the first worker) */
+	pthread_t thread;
+	/* the processes left to sample */
+	worker_queue_t queue;
+	/* the worker parse buffer */
+	char* buffer;
+} worker_t;
+
+struct sp_measure_proc_workers_t {
+	/* the number of workers */
+	int count;
+	/* the number of started worker threads (workers 1..nthreads) */
+	int nthreads;
+	/* the workers, the first worker is the calling thread */
+	worker_t* workers;
+
+	pthread_mutex_t lock;
+	/* signalled when a new snapshot has been started */
+	pthread_cond_t start;
+	/* signalled when the last worker thread has finished the snapshot */
+	pthread_cond_t done;
+	/* the snapshot generation, incremented for every snapshot */
+	unsigned int generation;
+	/* the number of worker threads still sampling the snapshot */
+	int active;
+	/* true if the worker threads must exit */
+	bool quit;
+
+	/* the process set being sampled */
+	sp_measure_proc_set_t* set;
+	/* the resources being sampled */
+	int resources;
+	/* the number of failed processes */
+	int nfailed;
+};
+
+
+/**
+ * Takes the next process from the worker's own queue.
+ *
+ * @param[in] worker   the worker.
+ * @return             the process index or -1 if the queue is empty.
+ */
+static int worker_pop(
+		worker_t* worker
+		)
+{
+	int index = -1;
+	pthread_mutex_lock(&worker->queue.lock);
+	if (worker->queue.head < worker->queue.tail) {
+		index = worker->queue.head++;
+	}
+	pthread_mutex_unlock(&worker->queue.lock);
+	return index;
+}
+
+/**
+ * Steals half of the processes left in another worker's queue.
+ *
+ * The first stolen process is returned and the rest are moved
+ * to the worker's own queue.
+ * @param[in] worker   the worker.
+ * @return             the process index or -1 if all queues are empty.
+ */
+static int worker_steal(
+		worker_t* worker
+		)
+{
+	struct sp_measure_proc_workers_t* pool = worker->pool;
+	int self = worker - pool->workers;
+	int i;
+	for (i = 1; i < pool->count; i++) {
+		worker_t* victim = &pool->workers[(self + i) % pool->count];
+		int head = -1, tail = -1;
+		pthread_mutex_lock(&victim->queue.lock);
+		int left = victim->queue.tail - victim->queue.head;
+		if (left > 0) {
+			tail = victim->queue.tail;
+			head = tail - (left + 1) / 2;
+			victim->queue.tail = head;
+		}
+		pthread_mutex_unlock(&victim->queue.lock);
+		if (head != -1) {
+			pthread_mutex_lock(&worker->queue.lock);
+			worker->queue.head = head + 1;
+			worker->queue.tail = tail;
+			pthread_mutex_unlock(&worker->queue.lock);
+			return head;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Samples processes until all worker queues are empty.
+ *
+ * @param[in] worker   the worker.
+ */
+static void worker_run(
+		worker_t* worker
+		)
+{
+	struct sp_measure_proc_workers_t* pool = worker->pool;
+	int index, nfailed = 0;
+	while ( (index = worker_pop(worker)) != -1 || (index = worker_steal(worker)) != -1) {
+		if (proc_get_data(&pool->set->data[index], pool->resources, worker->buffer, PROC_SET_BUFFER_SIZE) != 0) {
+			proc_set_mark_failed(pool->set, index);
+			nfailed++;
+		}
+	}
+	__sync_fetch_and_add(&pool->nfailed, nfailed);
+}
+
+/**
+ * The worker thread main loop.
+ *
+ * @param[in] arg   the worker.
+ * @return          NULL.
+ */
+static void* worker_thread(
+		void* arg
+		)
+{
+	worker_t* worker = (worker_t*)arg;
+	struct sp_measure_proc_workers_t* pool = worker->pool;
+	unsigned int generation = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (generation == pool->generation && !pool->quit) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if (pool->quit) break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		worker_run(worker);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->active == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/**
+ * Releases worker resources.
+ *
+ * @param[in] worker   the worker.
+ */
+static void worker_free(
+		worker_t* worker
+		)
+{
+	pthread_mutex_destroy(&worker->queue.lock);
+	if (worker->buffer) free(worker->buffer);
+}
+
+
+struct sp_measure_proc_workers_t* proc_workers_create(
+		int count
+		)
+{
+	int i;
+	struct sp_measure_proc_workers_t* pool = (struct sp_measure_proc_workers_t*)malloc(sizeof(struct sp_measure_proc_workers_t));
+	if (pool == NULL) return NULL;
+	memset(pool, 0, sizeof(struct sp_measure_proc_workers_t));
+	pool->workers = (worker_t*)calloc(count, sizeof(worker_t));
+	if (pool->workers == NULL) {
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (i = 0; i < count; i++) {
+		worker_t* worker = &pool->workers[i];
+		worker->pool = pool;
+		pthread_mutex_init(&worker->queue.lock, NULL);
+		pool->count++;
+		worker->buffer = (char*)malloc(PROC_SET_BUFFER_SIZE);
+		if (worker->buffer == NULL) goto failure;
+	}
+	/* the first worker is the thread taking the snapshot */
+	for (i = 1; i < count; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL, worker_thread, &pool->workers[i]) != 0) {
+			goto failure;
+		}
+		pool->nthreads++;
+	}
+	return pool;
+
+failure:
+	proc_workers_free(pool);
+	return NULL;
+}
+
+void proc_workers_free(
+		struct sp_measure_proc_workers_t* pool
+		)
+{
+	int i;
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 1; i <= pool->nthreads; i++) {
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+	for (i = 0; i < pool->count; i++) {
+		worker_free(&pool->workers[i]);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+int proc_workers_run(
+		struct sp_measure_proc_workers_t* pool,
+		sp_measure_proc_set_t* set,
+		int resources
+		)
+{
+	int i;
+	pthread_mutex_lock(&pool->lock);
+	pool->set = set;
+	pool->resources = resources;
+	pool->nfailed = 0;
+	/* the worker threads are idle, so the queues can be filled without locking */
+	for (i = 0; i < pool->count; i++) {
+		pool->workers[i].queue.head = (long long)set->count * i / pool->count;
+		pool->workers[i].queue.tail = (long long)set->count * (i + 1) / pool->count;
+	}
+	pool->active = pool->count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	worker_run(&pool->workers[0]);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->active) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return pool->nfailed;
+}
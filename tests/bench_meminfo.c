@@ -0,0 +1,149 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * /proc/meminfo parser benchmark.
+ *
+ * Compares the previous sscanf based /proc/meminfo parser against the
+ * table driven parser used by sp_measure_get_sys_data() on the test
+ * fixture file.
+ *
+ * Usage: bench_meminfo [<rootfs> [<rounds>]]
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sp_measure.h>
+
+typedef struct parse_query_t {
+	const char* key;
+	int* value;
+	bool ok;
+} parse_query_t;
+
+/**
+ * The previous parser - reads the file and scans every line with sscanf,
+ * looking up the key in the query list.
+ */
+static int old_parse_proc_meminfo(
+		const char* path,
+		parse_query_t* data,
+		int length
+		)
+{
+	static char buffer[8192];
+	int nscanned = 0, value = 0, i;
+	char key[128];
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return 0;
+	int n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	close(fd);
+	if (n <= 0) return 0;
+	buffer[n] = '\0';
+	char* line = buffer;
+	while (line && *line && nscanned < length) {
+		char* next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+		if (sscanf(line, "%127[^:]: %d", key, &value) == 2) {
+			for (i = 0; i < length; i++) {
+				if (!data[i].ok) {
+					if (!strcmp(data[i].key, key)) {
+						data[i].ok = true;
+						*(data[i].value) = value;
+						nscanned++;
+						break;
+					}
+				}
+			}
+		}
+		line = next;
+	}
+	return nscanned;
+}
+
+static double time_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* root = argc > 1 ? argv[1] : "./rootfs1";
+	int rounds = argc > 2 ? atoi(argv[2]) : 100000;
+	char path[1024];
+	sp_measure_sys_data_t data;
+	int round, check = 0;
+
+	if (rounds < 1) {
+		fprintf(stderr, "Usage: %s [<rootfs> [<rounds>]]\n", argv[0]);
+		return -1;
+	}
+	snprintf(path, sizeof(path), "%s/proc/meminfo", root);
+	sp_measure_set_fs_root(root);
+	if (sp_measure_init_sys_data(&data, SNAPSHOT_SYS_MEM_TOTALS, NULL) != 0) {
+		fprintf(stderr, "Failed to read %s\n", path);
+		return -1;
+	}
+
+	printf("# file=%s rounds=%d\n", path, rounds);
+	printf("parser\tns_per_snapshot\tvalues\n");
+
+	double start = time_now();
+	for (round = 0; round < rounds; round++) {
+		int mem_free, mem_buffers, mem_cached, mem_swap_cached, mem_swap_free;
+		parse_query_t query[] = {
+			{ "MemFree",  &mem_free, false },
+			{ "Buffers", &mem_buffers, false },
+			{ "Cached", &mem_cached, false },
+			{ "SwapCached", &mem_swap_cached, false },
+			{ "SwapFree", &mem_swap_free, false },
+		};
+		check += old_parse_proc_meminfo(path, query, sizeof(query) / sizeof(query[0]));
+	}
+	printf("sscanf\t%.0f\t%d\n", (time_now() - start) * 1e9 / rounds, 5);
+
+	start = time_now();
+	for (round = 0; round < rounds; round++) {
+		check += sp_measure_get_sys_data(&data, SNAPSHOT_SYS_MEM_USAGE, NULL);
+	}
+	printf("table\t%.0f\t%d\n", (time_now() - start) * 1e9 / rounds, 5);
+
+	start = time_now();
+	for (round = 0; round < rounds; round++) {
+		check += sp_measure_get_sys_data(&data, SNAPSHOT_SYS_MEM_USAGE | SNAPSHOT_SYS_MEM_DETAILS, NULL);
+	}
+	printf("table_all\t%.0f\t%d\n", (time_now() - start) * 1e9 / rounds, MEMINFO_COUNT);
+
+	sp_measure_free_sys_data(&data);
+	sp_measure_set_fs_root(NULL);
+	return check == 5 * rounds ? 0 : -1;
+}
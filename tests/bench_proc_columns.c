@@ -0,0 +1,181 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+
+/**
+ * Process ranking benchmark.
+ *
+ * Generates a synthetic rootfs (see rootfs_gen.h) with many processes,
+ * takes two process set snapshots with different cpu usage and measures
+ * how long it takes to find the processes with the largest cpu usage
+ * between the snapshots - once by comparing the process snapshots with
+ * sp_measure_diff_proc_cpu_ticks() and once with the columnar snapshots.
+ *
+ * Usage: bench_proc_columns [<processes> [<top>]]
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sp_measure.h>
+
+#include "rootfs_gen.h"
+
+/* the number of rankings per measurement */
+#define BENCH_ROUNDS		200
+
+static double time_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the cpu usage differences sorted by the row based ranking */
+static int* row_diff;
+
+static int row_compare(const void* item1, const void* item2)
+{
+	int index1 = *(const int*)item1, index2 = *(const int*)item2;
+	if (row_diff[index1] != row_diff[index2]) return row_diff[index1] > row_diff[index2] ? -1 : 1;
+	return index1 - index2;
+}
+
+/**
+ * Ranks the processes by comparing their snapshots one by one.
+ */
+static int rank_rows(sp_measure_proc_set_t* set1, sp_measure_proc_set_t* set2, int* indices, int top)
+{
+	int i, count = 0;
+	for (i = 0; i < set1->count; i++) {
+		if (sp_measure_diff_proc_cpu_ticks(FIELD_PROC_SET_DATA(set1, i), FIELD_PROC_SET_DATA(set2, i), &row_diff[i]) == 0) {
+			indices[count++] = i;
+		}
+	}
+	qsort(indices, count, sizeof(int), row_compare);
+	return count < top ? count : top;
+}
+
+/**
+ * Ranks the processes with columnar snapshots.
+ */
+static int rank_columns(sp_measure_proc_set_t* set1, sp_measure_proc_set_t* set2, sp_measure_proc_columns_t* columns1,
+		sp_measure_proc_columns_t* columns2, int64_t* diff, int* indices, int top, int transpose)
+{
+	if (transpose) {
+		sp_measure_get_proc_columns(columns1, set1);
+		sp_measure_get_proc_columns(columns2, set2);
+	}
+	sp_measure_diff_proc_columns(columns1, columns2, PROC_COLUMN_CPU_TICKS, diff);
+	return sp_measure_column_top(diff, columns1->count, indices, top);
+}
+
+int main(int argc, char* argv[])
+{
+	int processes = argc > 1 ? atoi(argv[1]) : 10000;
+	int top = argc > 2 ? atoi(argv[2]) : 20;
+	char root[] = "/tmp/sp-measure-bench.XXXXXX";
+	rootfs_gen_t config;
+	sp_measure_proc_set_t set1, set2;
+	sp_measure_proc_columns_t columns1, columns2;
+	int i, round, n1 = 0, n2 = 0;
+
+	if (processes < 1 || processes > ROOTFS_GEN_MAX_PROCESSES || top < 1 || mkdtemp(root) == NULL) {
+		fprintf(stderr, "Usage: %s [<processes> [<top>]]\n", argv[0]);
+		return -1;
+	}
+	int* pids = (int*)malloc(sizeof(int) * processes);
+	int* indices1 = (int*)malloc(sizeof(int) * processes);
+	int* indices2 = (int*)malloc(sizeof(int) * processes);
+	row_diff = (int*)malloc(sizeof(int) * processes);
+	int64_t* diff = sp_measure_alloc_column(processes);
+	if (pids == NULL || indices1 == NULL || indices2 == NULL || row_diff == NULL || diff == NULL) {
+		fprintf(stderr, "Not enough memory\n");
+		return -1;
+	}
+	for (i = 0; i < processes; i++) {
+		pids[i] = ROOTFS_GEN_PID_BASE + i;
+	}
+
+	/* the second snapshot is taken from a rootfs generated with another seed */
+	rootfs_gen_defaults(&config);
+	config.processes = processes;
+	config.mappings = 1;
+	sp_measure_set_fs_root(root);
+	if (rootfs_gen_write(root, &config) != 0 ||
+			sp_measure_init_proc_set(&set1, pids, processes, 0, NULL) != 0 ||
+			sp_measure_init_proc_set(&set2, NULL, 0, 0, &set1) != 0 ||
+			sp_measure_get_proc_set_data(&set1, SNAPSHOT_PROC_CPU_USAGE) != 0) {
+		fprintf(stderr, "Failed to take the first snapshot in %s\n", root);
+		rootfs_gen_remove(root);
+		return -1;
+	}
+	config.seed++;
+	if (rootfs_gen_write(root, &config) != 0 || sp_measure_get_proc_set_data(&set2, SNAPSHOT_PROC_CPU_USAGE) != 0) {
+		fprintf(stderr, "Failed to take the second snapshot in %s\n", root);
+		rootfs_gen_remove(root);
+		return -1;
+	}
+	if (sp_measure_init_proc_columns(&columns1, processes) != 0 || sp_measure_init_proc_columns(&columns2, processes) != 0) {
+		fprintf(stderr, "Failed to initialize columnar snapshots\n");
+		return -1;
+	}
+
+	printf("# processes=%d top=%d\n", processes, top);
+	printf("method\tus_per_ranking\tspeedup\n");
+	double start = time_now();
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		n1 = rank_rows(&set1, &set2, indices1, top);
+	}
+	double base = (time_now() - start) / BENCH_ROUNDS;
+	printf("rows\t%.1f\t%.2f\n", base * 1e6, 1.0);
+
+	for (i = 0; i < 2; i++) {
+		start = time_now();
+		for (round = 0; round < BENCH_ROUNDS; round++) {
+			n2 = rank_columns(&set1, &set2, &columns1, &columns2, diff, indices2, top, !i);
+		}
+		double elapsed = (time_now() - start) / BENCH_ROUNDS;
+		printf("%s\t%.1f\t%.2f\n", i ? "columns" : "columns+transpose", elapsed * 1e6, base / elapsed);
+	}
+	/* both methods must give the same ranking */
+	if (n1 != n2 || memcmp(indices1, indices2, sizeof(int) * n1) != 0) {
+		fprintf(stderr, "The rankings differ\n");
+	}
+
+	sp_measure_free_proc_columns(&columns2);
+	sp_measure_free_proc_columns(&columns1);
+	sp_measure_free_proc_set(&set2);
+	sp_measure_free_proc_set(&set1);
+	sp_measure_free_column(diff);
+	free(row_diff);
+	free(indices2);
+	free(indices1);
+	free(pids);
+	sp_measure_set_fs_root(NULL);
+	rootfs_gen_remove(root);
+	return 0;
+}
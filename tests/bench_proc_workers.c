@@ -0,0 +1,119 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Process set worker pool scaling benchmark.
+ *
+ * Generates a synthetic rootfs (see rootfs_gen.h) with many processes
+ * (one of them with a huge smaps file) and measures process set snapshot
+ * throughput with 1, 2, 4, 8 and 16 worker threads.
+ *
+ * Usage: bench_proc_workers [<processes> [<mappings>]]
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sp_measure.h>
+
+#include "rootfs_gen.h"
+
+/* the number of snapshots per measurement */
+#define BENCH_ROUNDS		5
+
+/* the huge process has this many times more mappings than others */
+#define BENCH_HUGE_FACTOR	200
+
+static double time_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[])
+{
+	static const int workers[] = {1, 2, 4, 8, 16};
+	int processes = argc > 1 ? atoi(argv[1]) : 2000;
+	int mappings = argc > 2 ? atoi(argv[2]) : 50;
+	char root[] = "/tmp/sp-measure-bench.XXXXXX";
+	rootfs_gen_t config;
+	sp_measure_proc_set_t set;
+	double base = 0;
+	unsigned i;
+	int round;
+
+	if (processes < 1 || mappings < 1 || mappings * BENCH_HUGE_FACTOR > ROOTFS_GEN_MAX_MAPPINGS ||
+			mkdtemp(root) == NULL) {
+		fprintf(stderr, "Usage: %s [<processes> [<mappings>]]\n", argv[0]);
+		return -1;
+	}
+	rootfs_gen_defaults(&config);
+	config.processes = processes;
+	config.mappings = mappings;
+	config.huge_mappings = mappings * BENCH_HUGE_FACTOR;
+	if (rootfs_gen_write(root, &config) != 0) {
+		fprintf(stderr, "Failed to generate rootfs %s\n", root);
+		rootfs_gen_remove(root);
+		return -1;
+	}
+	sp_measure_set_fs_root(root);
+
+	int* pids = (int*)malloc(sizeof(int) * processes);
+	for (round = 0; round < processes; round++) {
+		pids[round] = ROOTFS_GEN_PID_BASE + round;
+	}
+	if (sp_measure_init_proc_set(&set, pids, processes, SNAPSHOT_PROC, NULL) != 0) {
+		fprintf(stderr, "Failed to initialize process set\n");
+		return -1;
+	}
+	/* warm up page cache */
+	sp_measure_get_proc_set_data(&set, SNAPSHOT_PROC);
+
+	printf("# processes=%d mappings=%d huge=%d\n", processes, mappings, mappings * BENCH_HUGE_FACTOR);
+	printf("threads\tsnapshot_ms\tprocesses_per_s\tspeedup\n");
+	for (i = 0; i < sizeof(workers) / sizeof(workers[0]); i++) {
+		if (sp_measure_proc_set_workers(&set, workers[i]) < 0) {
+			fprintf(stderr, "Failed to create %d workers\n", workers[i]);
+			break;
+		}
+		double start = time_now();
+		for (round = 0; round < BENCH_ROUNDS; round++) {
+			if (sp_measure_get_proc_set_data(&set, SNAPSHOT_PROC) != 0) {
+				fprintf(stderr, "Process set snapshot failed\n");
+			}
+		}
+		double elapsed = (time_now() - start) / BENCH_ROUNDS;
+		if (i == 0) base = elapsed;
+		printf("%d\t%.2f\t%.0f\t%.2f\n", workers[i], elapsed * 1000, processes / elapsed, base / elapsed);
+	}
+
+	sp_measure_free_proc_set(&set);
+	free(pids);
+	sp_measure_set_fs_root(NULL);
+	rootfs_gen_remove(root);
+	return 0;
+}
@@ -0,0 +1,317 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Snapshot hot path microbenchmarks.
+ *
+ * Times system and process snapshots with all resources and with every
+ * resource bit on its own, and every diff function. The benchmarks are
+ * run against the fake rootfs and the live /proc and the results are
+ * printed as tab separated values:
+ *   source  benchmark  iterations  ns_per_op  syscalls_per_op  allocs_per_op
+ * The system calls and allocations are counted by the linker wrappers
+ * of syscall_count.c, so only the calls made by the library are included.
+ *
+ * The diffs of the fake rootfs compare the system snapshots of two
+ * fake rootfs directories.
+ *
+ * Usage: bench_snapshot [<rootfs1> <rootfs2> <pid>]
+ */
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sp_measure.h>
+
+#include "syscall_count.h"
+
+/* the minimum measurement time (ns) */
+#define BENCH_MIN_TIME		(100 * 1000000LL)
+
+/* the maximum number of iterations per measurement */
+#define BENCH_MAX_ITERATIONS	(1 << 24)
+
+/* all system resources, including the optional ones */
+#define BENCH_SYS_ALL		(SNAPSHOT_SYS | SNAPSHOT_SYS_MEM_WATERMARK | SNAPSHOT_SYS_MEM_CGROUPS | \
+				SNAPSHOT_SYS_MEM_DETAILS)
+
+/* all process resources, including the optional ones */
+#define BENCH_PROC_ALL		(SNAPSHOT_PROC | SNAPSHOT_PROC_MEM_ROLLUP)
+
+/* the maximum number of cores/policies in the per core diffs */
+#define BENCH_MAX_CPUS		1024
+
+/**
+ * The benchmark state.
+ *
+ * Two initialized snapshots of both kinds - the snapshot benchmarks
+ * alternate between them and the diff benchmarks compare them.
+ */
+typedef struct bench_state_t {
+	sp_measure_sys_data_t sys[2];
+	sp_measure_proc_data_t proc[2];
+	int index;
+} bench_state_t;
+
+/**
+ * The benchmark case.
+ */
+typedef struct bench_case_t {
+	/* the benchmark name */
+	const char* name;
+	/* the benchmarked operation, returns the operation result */
+	int (*run)(bench_state_t* state, int resources);
+	/* the snapshot resources */
+	int resources;
+} bench_case_t;
+
+/* the diff results are stored here, so they are not optimized away */
+static volatile long long bench_sink;
+
+/* the per core diff buffers */
+static sp_measure_cpu_ticks_t bench_ticks[BENCH_MAX_CPUS];
+static int bench_values[BENCH_MAX_CPUS];
+
+static int bench_get_sys(bench_state_t* state, int resources)
+{
+	return sp_measure_get_sys_data(&state->sys[state->index++ & 1], resources, NULL);
+}
+
+static int bench_get_proc(bench_state_t* state, int resources)
+{
+	return sp_measure_get_proc_data(&state->proc[state->index++ & 1], resources, NULL);
+}
+
+/* the snapshots with the library overhead statistics enabled */
+static int bench_get_sys_stats(bench_state_t* state, int resources)
+{
+	sp_measure_stats_enable(1);
+	int rc = bench_get_sys(state, resources);
+	sp_measure_stats_enable(0);
+	return rc;
+}
+
+static int bench_get_proc_stats(bench_state_t* state, int resources)
+{
+	sp_measure_stats_enable(1);
+	int rc = bench_get_proc(state, resources);
+	sp_measure_stats_enable(0);
+	return rc;
+}
+
+/* defines benchmark function of a single value diff */
+#define BENCH_DIFF(fn, kind, type) \
+	static int bench_##fn(bench_state_t* state, int resources) \
+	{ \
+		type diff = 0; \
+		int rc = fn(&state->kind[0], &state->kind[1], &diff); \
+		bench_sink += diff; \
+		return rc; \
+	}
+
+/* defines benchmark function of a per core diff */
+#define BENCH_DIFF_CPUS(fn, buffer) \
+	static int bench_##fn(bench_state_t* state, int resources) \
+	{ \
+		int rc = fn(&state->sys[0], &state->sys[1], buffer, BENCH_MAX_CPUS); \
+		bench_sink += rc; \
+		return rc < 0 ? rc : 0; \
+	}
+
+BENCH_DIFF(sp_measure_diff_sys_timestamp, sys, int)
+BENCH_DIFF(sp_measure_diff_sys_timestamp_ns, sys, int64_t)
+BENCH_DIFF(sp_measure_diff_sys_boottime_ns, sys, int64_t)
+BENCH_DIFF(sp_measure_diff_sys_cpu_ticks, sys, int)
+BENCH_DIFF(sp_measure_diff_sys_cpu_usage, sys, int)
+BENCH_DIFF(sp_measure_diff_sys_cpu_avg_freq, sys, int)
+BENCH_DIFF(sp_measure_diff_sys_mem_used, sys, int)
+BENCH_DIFF(sp_measure_diff_sys_mem_cgroup, sys, int)
+BENCH_DIFF_CPUS(sp_measure_diff_sys_cpu_core_ticks, bench_ticks)
+BENCH_DIFF_CPUS(sp_measure_diff_sys_cpu_core_usage, bench_values)
+BENCH_DIFF_CPUS(sp_measure_diff_sys_cpu_policy_avg_freq, bench_values)
+BENCH_DIFF(sp_measure_diff_proc_mem_private_dirty, proc, int)
+BENCH_DIFF(sp_measure_diff_proc_cpu_ticks, proc, int)
+BENCH_DIFF(sp_measure_diff_proc_timestamp_ns, proc, int64_t)
+
+#define BENCH_CASE_DIFF(fn)	{#fn, bench_##fn, 0}
+
+static const bench_case_t bench_cases[] = {
+	{"get_sys_data", bench_get_sys, BENCH_SYS_ALL},
+	{"get_sys_data.with_stats", bench_get_sys_stats, BENCH_SYS_ALL},
+	{"get_sys_data.timestamp", bench_get_sys, SNAPSHOT_SYS_TIMESTAMP},
+	{"get_sys_data.mem_totals", bench_get_sys, SNAPSHOT_SYS_MEM_TOTALS},
+	{"get_sys_data.mem_usage", bench_get_sys, SNAPSHOT_SYS_MEM_USAGE},
+	{"get_sys_data.mem_watermark", bench_get_sys, SNAPSHOT_SYS_MEM_WATERMARK},
+	{"get_sys_data.mem_cgroups", bench_get_sys, SNAPSHOT_SYS_MEM_CGROUPS},
+	{"get_sys_data.mem_details", bench_get_sys, SNAPSHOT_SYS_MEM_DETAILS},
+	{"get_sys_data.cpu_max_freq", bench_get_sys, SNAPSHOT_SYS_CPU_MAX_FREQ},
+	{"get_sys_data.cpu_usage", bench_get_sys, SNAPSHOT_SYS_CPU_USAGE},
+	{"get_sys_data.cpu_freq", bench_get_sys, SNAPSHOT_SYS_CPU_FREQ},
+	{"get_sys_data.cpu_core_usage", bench_get_sys, SNAPSHOT_SYS_CPU_CORE_USAGE},
+	{"get_sys_data.cpu_policy_freq", bench_get_sys, SNAPSHOT_SYS_CPU_POLICY_FREQ},
+	{"get_proc_data", bench_get_proc, SNAPSHOT_PROC},
+	{"get_proc_data.with_stats", bench_get_proc_stats, SNAPSHOT_PROC},
+	{"get_proc_data.timestamp", bench_get_proc, SNAPSHOT_PROC_TIMESTAMP},
+	{"get_proc_data.mem_usage", bench_get_proc, SNAPSHOT_PROC_MEM_USAGE},
+	{"get_proc_data.mem_rollup", bench_get_proc, SNAPSHOT_PROC_MEM_USAGE | SNAPSHOT_PROC_MEM_ROLLUP},
+	{"get_proc_data.cpu_usage", bench_get_proc, SNAPSHOT_PROC_CPU_USAGE},
+	BENCH_CASE_DIFF(sp_measure_diff_sys_timestamp),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_timestamp_ns),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_boottime_ns),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_ticks),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_usage),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_avg_freq),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_mem_used),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_mem_cgroup),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_core_ticks),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_core_usage),
+	BENCH_CASE_DIFF(sp_measure_diff_sys_cpu_policy_avg_freq),
+	BENCH_CASE_DIFF(sp_measure_diff_proc_mem_private_dirty),
+	BENCH_CASE_DIFF(sp_measure_diff_proc_cpu_ticks),
+	BENCH_CASE_DIFF(sp_measure_diff_proc_timestamp_ns),
+};
+
+static void sleep_ms(int ms)
+{
+	struct timespec ts = {.tv_sec = 0, .tv_nsec = ms * 1000000L};
+	nanosleep(&ts, NULL);
+}
+
+static long long time_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Runs a single benchmark.
+ *
+ * The number of iterations is doubled until the measurement takes
+ * at least BENCH_MIN_TIME, the results of the last round are reported.
+ */
+static void bench_run(
+		const char* source,
+		const bench_case_t* bench,
+		bench_state_t* state
+		)
+{
+	long long elapsed;
+	int iterations, i;
+
+	/* the first call may initialize lazily allocated data */
+	int rc = bench->run(state, bench->resources);
+	if (rc < 0) {
+		printf("# %s\t%s\tskipped, returned %d\n", source, bench->name, rc);
+		return;
+	}
+	if (rc > 0) {
+		printf("# %s\t%s\tunavailable resources 0x%x\n", source, bench->name, rc);
+	}
+	for (iterations = 1; ; iterations *= 2) {
+		syscall_count_reset();
+		long long start = time_now();
+		for (i = 0; i < iterations; i++) {
+			bench->run(state, bench->resources);
+		}
+		elapsed = time_now() - start;
+		if (elapsed >= BENCH_MIN_TIME || iterations >= BENCH_MAX_ITERATIONS) break;
+	}
+	printf("%s\t%s\t%d\t%.1f\t%.2f\t%.2f\n", source, bench->name, iterations,
+			(double)elapsed / iterations,
+			(double)(syscall_count.open + syscall_count.close + syscall_count.read) / iterations,
+			(double)syscall_count.alloc / iterations);
+}
+
+/**
+ * Runs all benchmarks against the specified root.
+ *
+ * @param[in] source   the source name.
+ * @param[in] root     the root directory, NULL for the live system.
+ * @param[in] root2    the root directory of the second system snapshot
+ *                     used by the diff benchmarks.
+ * @param[in] pid      the process to measure.
+ * @return             0 for success.
+ */
+static int bench_source(
+		const char* source,
+		const char* root,
+		const char* root2,
+		int pid
+		)
+{
+	bench_state_t state;
+	unsigned i;
+
+	memset(&state, 0, sizeof(state));
+	sp_measure_set_fs_root(root);
+	if (sp_measure_init_sys_data(&state.sys[0], BENCH_SYS_ALL, NULL) < 0 ||
+			sp_measure_init_sys_data(&state.sys[1], 0, &state.sys[0]) < 0 ||
+			sp_measure_init_proc_data(&state.proc[0], pid, BENCH_PROC_ALL, NULL) < 0 ||
+			sp_measure_init_proc_data(&state.proc[1], 0, 0, &state.proc[0]) < 0) {
+		fprintf(stderr, "Failed to initialize %s snapshots\n", source);
+		return -1;
+	}
+	for (i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++) {
+		/* the diff benchmarks compare two full snapshots */
+		if (state.index && bench_cases[i].resources == 0) {
+			sp_measure_get_sys_data(&state.sys[0], BENCH_SYS_ALL, NULL);
+			sp_measure_get_proc_data(&state.proc[0], BENCH_PROC_ALL, NULL);
+			sleep_ms(10);
+			sp_measure_set_fs_root(root2);
+			sp_measure_get_sys_data(&state.sys[1], BENCH_SYS_ALL, NULL);
+			sp_measure_get_proc_data(&state.proc[1], BENCH_PROC_ALL, NULL);
+			sp_measure_set_fs_root(root);
+			state.index = 0;
+		}
+		bench_run(source, &bench_cases[i], &state);
+		fflush(stdout);
+	}
+
+	sp_measure_free_proc_data(&state.proc[1]);
+	sp_measure_free_proc_data(&state.proc[0]);
+	sp_measure_free_sys_data(&state.sys[1]);
+	sp_measure_free_sys_data(&state.sys[0]);
+	sp_measure_set_fs_root(NULL);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* root1 = argc > 1 ? argv[1] : "./rootfs1";
+	const char* root2 = argc > 2 ? argv[2] : "./rootfs2";
+	int pid = argc > 3 ? atoi(argv[3]) : 25268;
+
+	if ((argc != 1 && argc != 4) || pid <= 0) {
+		fprintf(stderr, "Usage: %s [<rootfs1> <rootfs2> <pid>]\n", argv[0]);
+		return -1;
+	}
+	printf("source\tbenchmark\titerations\tns_per_op\tsyscalls_per_op\tallocs_per_op\n");
+	if (bench_source("fixture", root1, root2, pid) != 0) return -1;
+	if (bench_source("live", NULL, NULL, getpid()) != 0) return -1;
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Synthetic rootfs generator for scaling benchmarks.
+ *
+ * Writes fake /proc and /sys trees which can be used with
+ * sp_measure_set_fs_root() function, see rootfs_gen.h.
+ *
+ * Usage: gen_rootfs [options] <rootfs>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rootfs_gen.h"
+
+static void usage(const char* name)
+{
+	printf("Usage: %s [options] <rootfs>\n"
+			"Generates a synthetic rootfs with /proc and /sys files read by sp-measure library.\n"
+			"Options:\n"
+			"  -p <count>   the number of processes (1-%d, default 2000).\n"
+			"  -m <count>   the number of mappings per process (1-%d, default 50).\n"
+			"  -H <count>   the number of mappings of the middle process (default -m value).\n"
+			"  -c <count>   the number of cpu cores (1-%d, default 8).\n"
+			"  -f <count>   the number of cpufreq policies (1-<cores>, default 2).\n"
+			"  -F <count>   the number of frequencies per policy (1-%d, default 8).\n"
+			"  -s <seed>    the random generator seed (default 1).\n"
+			"  -h           this help.\n"
+			"The process ids start from %d.\n", name, ROOTFS_GEN_MAX_PROCESSES, ROOTFS_GEN_MAX_MAPPINGS,
+			ROOTFS_GEN_MAX_CPUS, ROOTFS_GEN_MAX_FREQUENCIES, ROOTFS_GEN_PID_BASE);
+}
+
+int main(int argc, char* argv[])
+{
+	rootfs_gen_t config;
+	int opt, rc;
+
+	rootfs_gen_defaults(&config);
+	while ( (opt = getopt(argc, argv, "p:m:H:c:f:F:s:h")) != -1) {
+		switch (opt) {
+			case 'p':
+				config.processes = atoi(optarg);
+				break;
+			case 'm':
+				config.mappings = atoi(optarg);
+				break;
+			case 'H':
+				config.huge_mappings = atoi(optarg);
+				break;
+			case 'c':
+				config.cpus = atoi(optarg);
+				break;
+			case 'f':
+				config.policies = atoi(optarg);
+				break;
+			case 'F':
+				config.frequencies = atoi(optarg);
+				break;
+			case 's':
+				config.seed = strtoul(optarg, NULL, 0);
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 0;
+			default:
+				usage(argv[0]);
+				return -1;
+		}
+	}
+	if (optind != argc - 1 || rootfs_gen_validate(&config) != 0) {
+		usage(argv[0]);
+		return -1;
+	}
+	if ( (rc = rootfs_gen_write(argv[optind], &config)) != 0) {
+		fprintf(stderr, "Failed to generate rootfs %s: %s\n", argv[optind], strerror(-rc));
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,733 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "rootfs_gen.h"
+
+/* the stdio buffer size used for the generated files */
+#define GEN_FILE_BUFFER_SIZE	(256 * 1024)
+
+/* the lowest generated cpu frequency (kHz) */
+#define GEN_FREQ_MIN		400000
+
+/* the memory per cpu core (kB) */
+#define GEN_MEM_PER_CPU		(2 * 1024 * 1024)
+
+/**
+ * Memory usage totals of the generated process mappings (kB).
+ */
+typedef struct gen_mem_t {
+	int size;
+	int rss;
+	int pss;
+	int shared_clean;
+	int shared_dirty;
+	int private_clean;
+	int private_dirty;
+	int referenced;
+	int anonymous;
+	int swap;
+} gen_mem_t;
+
+/* the generated mapping types */
+enum {
+	GEN_MAP_TEXT,
+	GEN_MAP_DATA,
+	GEN_MAP_ANON,
+	GEN_MAP_SHM,
+};
+
+/**
+ * Returns the next pseudo random number (xorshift32).
+ *
+ * @param[in,out] state   the generator state, must not be zero.
+ * @return                the random number.
+ */
+static unsigned gen_random(
+		unsigned* state
+		)
+{
+	unsigned x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/**
+ * Creates directory together with its parent directories.
+ *
+ * @param[in] path   the directory path.
+ * @return           0 for success or -errno.
+ */
+static int gen_make_dirs(
+		const char* path
+		)
+{
+	char dir[PATH_MAX];
+	char* ptr;
+	snprintf(dir, sizeof(dir), "%s", path);
+	for (ptr = dir + 1; *ptr; ptr++) {
+		if (*ptr == '/') {
+			*ptr = '\0';
+			if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -errno;
+			*ptr = '/';
+		}
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -errno;
+	return 0;
+}
+
+/**
+ * Creates a file for writing.
+ *
+ * The parent directories are expected to exist.
+ * @param[in] root     the rootfs directory.
+ * @param[in] format   the file path format relative to the rootfs.
+ * @return             the opened file or NULL (errno is set).
+ */
+static FILE* gen_open(
+		const char* root,
+		const char* format,
+		...
+		)
+{
+	static char buffer[GEN_FILE_BUFFER_SIZE];
+	char path[PATH_MAX];
+	va_list ap;
+	int len = snprintf(path, sizeof(path), "%s", root);
+	va_start(ap, format);
+	vsnprintf(path + len, sizeof(path) - len, format, ap);
+	va_end(ap);
+	FILE* fp = fopen(path, "w");
+	if (fp) setvbuf(fp, buffer, _IOFBF, sizeof(buffer));
+	return fp;
+}
+
+/**
+ * Closes a generated file.
+ *
+ * @param[in] fp   the file.
+ * @return         0 for success or -errno.
+ */
+static int gen_close(
+		FILE* fp
+		)
+{
+	int rc = ferror(fp) ? -EIO : 0;
+	if (fclose(fp) != 0 && rc == 0) rc = -errno;
+	return rc;
+}
+
+/**
+ * Writes the mapping memory usage lines of smaps formatted file.
+ */
+static void gen_write_smaps_values(
+		FILE* fp,
+		const gen_mem_t* mem,
+		int swap_pss
+		)
+{
+	fprintf(fp, "Rss:            %8d kB\n", mem->rss);
+	fprintf(fp, "Pss:            %8d kB\n", mem->pss);
+	fprintf(fp, "Shared_Clean:   %8d kB\n", mem->shared_clean);
+	fprintf(fp, "Shared_Dirty:   %8d kB\n", mem->shared_dirty);
+	fprintf(fp, "Private_Clean:  %8d kB\n", mem->private_clean);
+	fprintf(fp, "Private_Dirty:  %8d kB\n", mem->private_dirty);
+	fprintf(fp, "Referenced:     %8d kB\n", mem->referenced);
+	fprintf(fp, "Anonymous:      %8d kB\n", mem->anonymous);
+	fputs("LazyFree:              0 kB\n"
+			"AnonHugePages:         0 kB\n"
+			"ShmemPmdMapped:        0 kB\n"
+			"FilePmdMapped:         0 kB\n"
+			"Shared_Hugetlb:        0 kB\n"
+			"Private_Hugetlb:       0 kB\n", fp);
+	fprintf(fp, "Swap:           %8d kB\n", mem->swap);
+	fprintf(fp, "SwapPss:        %8d kB\n", swap_pss);
+	fputs("Locked:                0 kB\n", fp);
+}
+
+/**
+ * Generates a single memory mapping.
+ *
+ * @param[in,out] rnd   the random generator state.
+ * @param[in] type      the mapping type.
+ * @param[out] mem      the mapping memory usage.
+ */
+static void gen_mapping(
+		unsigned* rnd,
+		int type,
+		gen_mem_t* mem
+		)
+{
+	int pages = 1 + gen_random(rnd) % 512;
+	int rss = gen_random(rnd) % (pages + 1);
+	int sharers = 1 + gen_random(rnd) % 16;
+	int part = rss ? gen_random(rnd) % (rss + 1) : 0;
+
+	/* the values are generated in pages and converted to kB */
+	pages *= 4;
+	rss *= 4;
+	part *= 4;
+	memset(mem, 0, sizeof(gen_mem_t));
+	switch (type) {
+		case GEN_MAP_TEXT:
+			mem->shared_clean = sharers > 1 ? rss - part / 16 * 4 : 0;
+			mem->private_clean = rss - mem->shared_clean;
+			break;
+		case GEN_MAP_DATA:
+			mem->private_dirty = part;
+			mem->private_clean = rss - part;
+			break;
+		case GEN_MAP_ANON:
+			mem->private_dirty = rss;
+			mem->anonymous = rss;
+			if (gen_random(rnd) % 4 == 0) mem->swap = gen_random(rnd) % ((pages - rss) / 4 + 1) * 4;
+			break;
+		case GEN_MAP_SHM:
+			mem->shared_dirty = rss;
+			break;
+	}
+	mem->size = pages;
+	mem->rss = rss;
+	mem->pss = mem->private_clean + mem->private_dirty + (mem->shared_clean + mem->shared_dirty) / sharers;
+	mem->referenced = rss - part / 8 / 4 * 4;
+}
+
+/**
+ * Writes /proc/<pid>/smaps file and sums up the mapping memory usage.
+ *
+ * @param[in] root       the rootfs directory.
+ * @param[in] pid        the process id.
+ * @param[in] mappings   the number of mappings.
+ * @param[in,out] rnd    the random generator state.
+ * @param[out] total     the memory usage totals.
+ * @return               0 for success or -errno.
+ */
+static int gen_write_smaps(
+		const char* root,
+		int pid,
+		int mappings,
+		unsigned* rnd,
+		gen_mem_t* total
+		)
+{
+	static const char* perms[] = {"r-xp", "rw-p", "rw-p", "rw-s"};
+	static const char* flags[] = {"rd ex mr mw me", "rd wr mr mw me ac", "rd wr mr mw me ac", "rd wr sh mr mw me ms"};
+	unsigned long long address = 0x555555554000ULL;
+	gen_mem_t mem;
+	int i, type;
+
+	FILE* fp = gen_open(root, "/proc/%d/smaps", pid);
+	if (fp == NULL) return -errno;
+	memset(total, 0, sizeof(gen_mem_t));
+	for (i = 0; i < mappings; i++) {
+		unsigned r = gen_random(rnd) % 10;
+		bool stack = i == mappings - 1 && mappings > 1;
+		type = i == 0 ? GEN_MAP_TEXT : stack ? GEN_MAP_ANON :
+				r < 4 ? GEN_MAP_TEXT : r < 6 ? GEN_MAP_DATA : r < 9 ? GEN_MAP_ANON : GEN_MAP_SHM;
+		gen_mapping(rnd, type, &mem);
+
+		unsigned long long end = address + (unsigned long long)mem.size * 1024;
+		fprintf(fp, "%012llx-%012llx %s %08x ", address, end, perms[type], type == GEN_MAP_ANON ? 0 : (i & 0xff) << 12);
+		if (stack) {
+			fputs("00:00 0                          [stack]\n", fp);
+		}
+		else if (i == 0) {
+			fprintf(fp, "fd:01 %-10d                 /usr/bin/synthetic\n", 1000000 + pid);
+		}
+		else if (type == GEN_MAP_ANON) {
+			fputs(i == 1 ? "00:00 0                          [heap]\n" : "00:00 0 \n", fp);
+		}
+		else if (type == GEN_MAP_SHM) {
+			fprintf(fp, "00:05 %-10d                 /SYSV%08x (deleted)\n", 2000000 + i, i);
+		}
+		else {
+			fprintf(fp, "fd:01 %-10d                 /usr/lib/libsynthetic-%d.so.%d\n", 3000000 + i / 4, i / 4, i % 4);
+		}
+		fprintf(fp, "Size:           %8d kB\n", mem.size);
+		fputs("KernelPageSize:        4 kB\n"
+				"MMUPageSize:           4 kB\n", fp);
+		gen_write_smaps_values(fp, &mem, mem.swap);
+		fputs("THPeligible:    0\n", fp);
+		fprintf(fp, "VmFlags: %s\n", flags[type]);
+
+		total->size += mem.size;
+		total->rss += mem.rss;
+		total->pss += mem.pss;
+		total->shared_clean += mem.shared_clean;
+		total->shared_dirty += mem.shared_dirty;
+		total->private_clean += mem.private_clean;
+		total->private_dirty += mem.private_dirty;
+		total->referenced += mem.referenced;
+		total->anonymous += mem.anonymous;
+		total->swap += mem.swap;
+		/* leave a guard gap between the mappings */
+		address = end + 0x1000;
+	}
+	int rc = gen_close(fp);
+	if (rc < 0) return rc;
+
+	fp = gen_open(root, "/proc/%d/smaps_rollup", pid);
+	if (fp == NULL) return -errno;
+	fprintf(fp, "%012llx-%012llx ---p 00000000 00:00 0                          [rollup]\n",
+			0x555555554000ULL, address);
+	gen_write_smaps_values(fp, total, total->swap);
+	return gen_close(fp);
+}
+
+/**
+ * Writes /proc/<pid>/status file.
+ */
+static int gen_write_status(
+		const char* root,
+		int pid,
+		const rootfs_gen_t* config,
+		const gen_mem_t* mem,
+		unsigned* rnd
+		)
+{
+	int i;
+	FILE* fp = gen_open(root, "/proc/%d/status", pid);
+	if (fp == NULL) return -errno;
+	fprintf(fp, "Name:\tsynthetic\n"
+			"Umask:\t0022\n"
+			"State:\tS (sleeping)\n"
+			"Tgid:\t%d\n"
+			"Ngid:\t0\n"
+			"Pid:\t%d\n"
+			"PPid:\t1\n"
+			"TracerPid:\t0\n"
+			"Uid:\t1000\t1000\t1000\t1000\n"
+			"Gid:\t1000\t1000\t1000\t1000\n"
+			"FDSize:\t64\n"
+			"Groups:\t4 24 27 1000 \n"
+			"NStgid:\t%d\n"
+			"NSpid:\t%d\n"
+			"NSpgid:\t%d\n"
+			"NSsid:\t%d\n", pid, pid, pid, pid, pid, pid);
+	fprintf(fp, "VmPeak:\t%8d kB\n"
+			"VmSize:\t%8d kB\n"
+			"VmLck:\t       0 kB\n"
+			"VmPin:\t       0 kB\n"
+			"VmHWM:\t%8d kB\n"
+			"VmRSS:\t%8d kB\n"
+			"RssAnon:\t%8d kB\n"
+			"RssFile:\t%8d kB\n"
+			"RssShmem:\t%8d kB\n"
+			"VmData:\t%8d kB\n"
+			"VmStk:\t     132 kB\n"
+			"VmExe:\t      16 kB\n"
+			"VmLib:\t%8d kB\n"
+			"VmPTE:\t%8d kB\n"
+			"VmSwap:\t%8d kB\n"
+			"HugetlbPages:\t       0 kB\n"
+			"CoreDumping:\t0\n"
+			"THP_enabled:\t1\n"
+			"Threads:\t%d\n"
+			"SigQ:\t0/63448\n"
+			"SigPnd:\t0000000000000000\n"
+			"ShdPnd:\t0000000000000000\n"
+			"SigBlk:\t0000000000000000\n"
+			"SigIgn:\t0000000000001000\n"
+			"SigCgt:\t0000000180004002\n"
+			"CapInh:\t0000000000000000\n"
+			"CapPrm:\t0000000000000000\n"
+			"CapEff:\t0000000000000000\n"
+			"CapBnd:\t000001ffffffffff\n"
+			"CapAmb:\t0000000000000000\n"
+			"NoNewPrivs:\t0\n"
+			"Seccomp:\t0\n"
+			"Seccomp_filters:\t0\n"
+			"Speculation_Store_Bypass:\tthread vulnerable\n",
+			mem->size + mem->size / 16, mem->size, mem->rss + mem->rss / 8, mem->rss,
+			mem->anonymous, mem->rss - mem->anonymous - mem->shared_dirty, mem->shared_dirty,
+			mem->anonymous + mem->swap, mem->size - mem->anonymous, mem->size / 512 + 4, mem->swap,
+			1 + gen_random(rnd) % 32);
+	/* the cpu mask words are printed starting from the highest cpus */
+	fputs("Cpus_allowed:\t", fp);
+	for (i = (config->cpus - 1) / 32; i >= 0; i--) {
+		int bits = config->cpus - i * 32;
+		fprintf(fp, "%08x%s", bits >= 32 ? 0xffffffffU : (1U << bits) - 1, i ? "," : "\n");
+	}
+	fprintf(fp, "Cpus_allowed_list:\t0-%d\n"
+			"Mems_allowed:\t00000001\n"
+			"Mems_allowed_list:\t0\n"
+			"voluntary_ctxt_switches:\t%u\n"
+			"nonvoluntary_ctxt_switches:\t%u\n",
+			config->cpus - 1, gen_random(rnd) % 1000000, gen_random(rnd) % 10000);
+	return gen_close(fp);
+}
+
+/**
+ * Writes the files of a single process.
+ */
+static int gen_write_process(
+		const char* root,
+		int pid,
+		int mappings,
+		const rootfs_gen_t* config
+		)
+{
+	static const char cmdline[] = "/usr/bin/synthetic\0--worker\0";
+	char path[PATH_MAX];
+	unsigned rnd = (config->seed ^ (pid * 2654435761U)) | 1;
+	gen_mem_t mem;
+	int rc;
+
+	snprintf(path, sizeof(path), "%s/proc/%d", root, pid);
+	if (mkdir(path, 0755) != 0 && errno != EEXIST) return -errno;
+
+	if ( (rc = gen_write_smaps(root, pid, mappings, &rnd, &mem)) < 0) return rc;
+	if ( (rc = gen_write_status(root, pid, config, &mem, &rnd)) < 0) return rc;
+
+	/* the statm values are in pages, assuming 4kB page size */
+	FILE* fp = gen_open(root, "/proc/%d/statm", pid);
+	if (fp == NULL) return -errno;
+	fprintf(fp, "%d %d %d 4 0 %d 0\n", mem.size / 4, mem.rss / 4, (mem.rss - mem.anonymous) / 4,
+			(mem.anonymous + mem.swap) / 4);
+	if ( (rc = gen_close(fp)) < 0) return rc;
+
+	fp = gen_open(root, "/proc/%d/stat", pid);
+	if (fp == NULL) return -errno;
+	fprintf(fp, "%d (synthetic) S 1 %d %d 0 -1 4194560 %u 0 %u 0 %u %u 0 0 20 0 %d 0 %u %llu %d "
+			"18446744073709551615 94469478264832 94469478281232 140723327330880 0 0 0 0 4096 "
+			"16386 0 0 0 17 %d 0 0 0 0 0 94469478295120 94469478296672 94469501345792 "
+			"140723327335503 140723327335530 140723327335530 140723327336424 0\n",
+			pid, pid, pid, gen_random(&rnd) % 100000, gen_random(&rnd) % 100,
+			gen_random(&rnd) % 100000, gen_random(&rnd) % 20000, 1 + gen_random(&rnd) % 32,
+			gen_random(&rnd) % 1000000, (unsigned long long)mem.size * 1024, mem.rss / 4,
+			pid % config->cpus);
+	if ( (rc = gen_close(fp)) < 0) return rc;
+
+	fp = gen_open(root, "/proc/%d/cmdline", pid);
+	if (fp == NULL) return -errno;
+	fwrite(cmdline, 1, sizeof(cmdline) - 1, fp);
+	return gen_close(fp);
+}
+
+/**
+ * Writes /proc/meminfo file.
+ */
+static int gen_write_meminfo(
+		const char* root,
+		const rootfs_gen_t* config,
+		unsigned* rnd
+		)
+{
+	/* keep the derived values within int range */
+	long long size = (long long)config->cpus * GEN_MEM_PER_CPU;
+	int total = size > INT_MAX / 2 ? INT_MAX / 2 : (int)size;
+	int free = total / 8 + gen_random(rnd) % (total / 8);
+	int cached = total / 4 + gen_random(rnd) % (total / 8);
+	int buffers = total / 64;
+	int anon = total - free - cached - buffers - total / 32;
+	int slab = total / 48;
+	int swap = total / 2;
+
+	FILE* fp = gen_open(root, "/proc/meminfo");
+	if (fp == NULL) return -errno;
+	fprintf(fp, "MemTotal:       %8d kB\n"
+			"MemFree:        %8d kB\n"
+			"MemAvailable:   %8d kB\n"
+			"Buffers:        %8d kB\n"
+			"Cached:         %8d kB\n"
+			"SwapCached:     %8d kB\n"
+			"Active:         %8d kB\n"
+			"Inactive:       %8d kB\n"
+			"Active(anon):   %8d kB\n"
+			"Inactive(anon): %8d kB\n"
+			"Active(file):   %8d kB\n"
+			"Inactive(file): %8d kB\n"
+			"Unevictable:    %8d kB\n"
+			"Mlocked:        %8d kB\n"
+			"SwapTotal:      %8d kB\n"
+			"SwapFree:       %8d kB\n"
+			"Zswap:                 0 kB\n"
+			"Zswapped:              0 kB\n"
+			"Dirty:          %8d kB\n"
+			"Writeback:             0 kB\n"
+			"AnonPages:      %8d kB\n"
+			"Mapped:         %8d kB\n"
+			"Shmem:          %8d kB\n"
+			"KReclaimable:   %8d kB\n"
+			"Slab:           %8d kB\n"
+			"SReclaimable:   %8d kB\n"
+			"SUnreclaim:     %8d kB\n"
+			"KernelStack:    %8d kB\n"
+			"PageTables:     %8d kB\n"
+			"SecPageTables:         0 kB\n"
+			"NFS_Unstable:          0 kB\n"
+			"Bounce:                0 kB\n"
+			"WritebackTmp:          0 kB\n"
+			"CommitLimit:    %8d kB\n"
+			"Committed_AS:   %8d kB\n"
+			"VmallocTotal:   34359738367 kB\n"
+			"VmallocUsed:    %8d kB\n"
+			"VmallocChunk:          0 kB\n"
+			"Percpu:         %8d kB\n"
+			"HardwareCorrupted:     0 kB\n"
+			"AnonHugePages:  %8d kB\n"
+			"ShmemHugePages:        0 kB\n"
+			"ShmemPmdMapped:        0 kB\n"
+			"FileHugePages:         0 kB\n"
+			"FilePmdMapped:         0 kB\n"
+			"Unaccepted:            0 kB\n"
+			"HugePages_Total:       0\n"
+			"HugePages_Free:        0\n"
+			"HugePages_Rsvd:        0\n"
+			"HugePages_Surp:        0\n"
+			"Hugepagesize:       2048 kB\n"
+			"Hugetlb:               0 kB\n"
+			"DirectMap4k:    %8d kB\n"
+			"DirectMap2M:    %8d kB\n",
+			total, free, free + cached / 2, buffers, cached, swap / 64,
+			anon / 2 + cached / 2, anon / 2 + cached / 2, anon / 2, anon / 2, cached / 2, cached / 2,
+			total / 1024, total / 2048, swap, swap - swap / 16, gen_random(rnd) % 4096,
+			anon, cached / 4, total / 64, slab / 2, slab, slab / 2, slab / 2, config->cpus * 16 + 2048,
+			total / 256, total / 2 + swap, anon + anon / 2, total / 512, config->cpus * 1024,
+			anon / 8, total / 32, total - total / 32);
+	return gen_close(fp);
+}
+
+/**
+ * Writes /proc/stat file.
+ */
+static int gen_write_stat(
+		const char* root,
+		const rootfs_gen_t* config,
+		unsigned* rnd
+		)
+{
+	unsigned long long sum[10] = {0};
+	int i, j;
+
+	/* per cpu tick counts are generated first to sum up the totals */
+	unsigned* ticks = (unsigned*)malloc(sizeof(unsigned) * 10 * config->cpus);
+	if (ticks == NULL) return -ENOMEM;
+	for (i = 0; i < config->cpus; i++) {
+		unsigned* cpu = ticks + 10 * i;
+		cpu[0] = gen_random(rnd) % 2000000;
+		cpu[1] = gen_random(rnd) % 20000;
+		cpu[2] = gen_random(rnd) % 1000000;
+		cpu[3] = 40000000 + gen_random(rnd) % 2000000;
+		cpu[4] = gen_random(rnd) % 100000;
+		cpu[5] = 0;
+		cpu[6] = gen_random(rnd) % 10000;
+		cpu[7] = cpu[8] = cpu[9] = 0;
+		for (j = 0; j < 10; j++) sum[j] += cpu[j];
+	}
+
+	FILE* fp = gen_open(root, "/proc/stat");
+	if (fp == NULL) {
+		free(ticks);
+		return -errno;
+	}
+	fputs("cpu ", fp);
+	for (j = 0; j < 10; j++) fprintf(fp, " %llu", sum[j]);
+	fputc('\n', fp);
+	for (i = 0; i < config->cpus; i++) {
+		fprintf(fp, "cpu%d", i);
+		for (j = 0; j < 10; j++) fprintf(fp, " %u", ticks[10 * i + j]);
+		fputc('\n', fp);
+	}
+	fprintf(fp, "intr %llu", sum[2] * 8);
+	for (j = 0; j < 64; j++) fprintf(fp, " %u", j < 16 ? gen_random(rnd) % 1000000 : 0);
+	fprintf(fp, "\nctxt %llu\n"
+			"btime 1268897314\n"
+			"processes %d\n"
+			"procs_running %d\n"
+			"procs_blocked 0\n"
+			"softirq %llu 0 %llu 0 0 0 0 0 0 0 0\n",
+			sum[0] * 16, config->processes * 4 + 1000, 1 + config->cpus / 4, sum[6], sum[6] / 2);
+	free(ticks);
+	return gen_close(fp);
+}
+
+/**
+ * Writes the cpufreq policy directories.
+ *
+ * The cores are split evenly between the policies and every core
+ * cpufreq directory links to its policy, as on real systems.
+ */
+static int gen_write_cpufreq(
+		const char* root,
+		const rootfs_gen_t* config,
+		unsigned* rnd
+		)
+{
+	char path[PATH_MAX], target[64];
+	int policy, cpu, i, rc;
+
+	for (policy = 0; policy < config->policies; policy++) {
+		int first = policy * config->cpus / config->policies;
+		int last = (policy + 1) * config->cpus / config->policies - 1;
+		int max_freq = 1800000 + policy * 400000;
+
+		snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpufreq/policy%d/stats", root, first);
+		if ( (rc = gen_make_dirs(path)) < 0) return rc;
+
+		FILE* fp = gen_open(root, "/sys/devices/system/cpu/cpufreq/policy%d/cpuinfo_max_freq", first);
+		if (fp == NULL) return -errno;
+		fprintf(fp, "%d\n", max_freq);
+		if ( (rc = gen_close(fp)) < 0) return rc;
+
+		fp = gen_open(root, "/sys/devices/system/cpu/cpufreq/policy%d/related_cpus", first);
+		if (fp == NULL) return -errno;
+		for (cpu = first; cpu <= last; cpu++) fprintf(fp, cpu < last ? "%d " : "%d\n", cpu);
+		if ( (rc = gen_close(fp)) < 0) return rc;
+
+		/* frequencies are listed in ascending order, like most drivers do */
+		fp = gen_open(root, "/sys/devices/system/cpu/cpufreq/policy%d/stats/time_in_state", first);
+		if (fp == NULL) return -errno;
+		for (i = 0; i < config->frequencies; i++) {
+			int freq = config->frequencies > 1 ?
+					GEN_FREQ_MIN + (max_freq - GEN_FREQ_MIN) / (config->frequencies - 1) * i : max_freq;
+			fprintf(fp, "%d %u\n", freq, i == 0 ? 40000000 + gen_random(rnd) % 1000000 : gen_random(rnd) % 500000);
+		}
+		if ( (rc = gen_close(fp)) < 0) return rc;
+
+		for (cpu = first; cpu <= last; cpu++) {
+			snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d", root, cpu);
+			if ( (rc = gen_make_dirs(path)) < 0) return rc;
+			snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d/cpufreq", root, cpu);
+			snprintf(target, sizeof(target), "../cpufreq/policy%d", first);
+			if (symlink(target, path) != 0 && errno != EEXIST) return -errno;
+		}
+	}
+	/* the library sizes its cpu tables by the possible cpus */
+	static const char* masks[] = {"online", "possible"};
+	for (i = 0; i < 2; i++) {
+		FILE* fp = gen_open(root, "/sys/devices/system/cpu/%s", masks[i]);
+		if (fp == NULL) return -errno;
+		fprintf(fp, "0-%d\n", config->cpus - 1);
+		if ( (rc = gen_close(fp)) < 0) return rc;
+	}
+	return 0;
+}
+
+/**
+ * Writes the small system files.
+ */
+static int gen_write_value(
+		const char* root,
+		const char* path,
+		long long value
+		)
+{
+	FILE* fp = gen_open(root, "%s", path);
+	if (fp == NULL) return -errno;
+	fprintf(fp, "%lld\n", value);
+	return gen_close(fp);
+}
+
+static int gen_remove_entry(
+		const char* path,
+		const struct stat* sb,
+		int flag,
+		struct FTW* ftwbuf
+		)
+{
+	return remove(path);
+}
+
+/*
+ * Public API implementation
+ */
+
+void rootfs_gen_defaults(
+		rootfs_gen_t* config
+		)
+{
+	memset(config, 0, sizeof(rootfs_gen_t));
+	config->processes = 2000;
+	config->mappings = 50;
+	config->cpus = 8;
+	config->policies = 2;
+	config->frequencies = 8;
+	config->seed = 1;
+}
+
+int rootfs_gen_validate(
+		const rootfs_gen_t* config
+		)
+{
+	if (config->processes < 1 || config->processes > ROOTFS_GEN_MAX_PROCESSES) return -EINVAL;
+	if (config->mappings < 1 || config->mappings > ROOTFS_GEN_MAX_MAPPINGS) return -EINVAL;
+	if (config->huge_mappings < 0 || config->huge_mappings > ROOTFS_GEN_MAX_MAPPINGS) return -EINVAL;
+	if (config->cpus < 1 || config->cpus > ROOTFS_GEN_MAX_CPUS) return -EINVAL;
+	if (config->policies < 1 || config->policies > config->cpus) return -EINVAL;
+	if (config->frequencies < 1 || config->frequencies > ROOTFS_GEN_MAX_FREQUENCIES) return -EINVAL;
+	return 0;
+}
+
+int rootfs_gen_write(
+		const char* root,
+		const rootfs_gen_t* config
+		)
+{
+	char path[PATH_MAX];
+	unsigned rnd = config->seed | 1;
+	int i, rc;
+
+	if ( (rc = rootfs_gen_validate(config)) < 0) return rc;
+
+	snprintf(path, sizeof(path), "%s/proc", root);
+	if ( (rc = gen_make_dirs(path)) < 0) return rc;
+	snprintf(path, sizeof(path), "%s/sys/kernel", root);
+	if ( (rc = gen_make_dirs(path)) < 0) return rc;
+	snprintf(path, sizeof(path), "%s/syspart", root);
+	if ( (rc = gen_make_dirs(path)) < 0) return rc;
+
+	if ( (rc = gen_write_meminfo(root, config, &rnd)) < 0) return rc;
+	if ( (rc = gen_write_stat(root, config, &rnd)) < 0) return rc;
+	if ( (rc = gen_write_cpufreq(root, config, &rnd)) < 0) return rc;
+	if ( (rc = gen_write_value(root, "/sys/kernel/low_watermark", 0)) < 0) return rc;
+	if ( (rc = gen_write_value(root, "/sys/kernel/high_watermark", 0)) < 0) return rc;
+	if ( (rc = gen_write_value(root, "/syspart/memory.memsw.usage_in_bytes",
+			(long long)config->cpus * GEN_MEM_PER_CPU * 512)) < 0) return rc;
+
+	for (i = 0; i < config->processes; i++) {
+		int mappings = config->huge_mappings && i == config->processes / 2 ? config->huge_mappings : config->mappings;
+		if ( (rc = gen_write_process(root, ROOTFS_GEN_PID_BASE + i, mappings, config)) < 0) return rc;
+	}
+	return 0;
+}
+
+int rootfs_gen_remove(
+		const char* root
+		)
+{
+	return nftw(root, gen_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
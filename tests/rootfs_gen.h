@@ -0,0 +1,109 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Synthetic rootfs generator.
+ *
+ * Writes fake /proc and /sys trees containing the files read by the
+ * sp-measure library, so the library can be benchmarked against large
+ * systems with sp_measure_set_fs_root() function. The generated content
+ * is deterministic for the same configuration and seed.
+ */
+
+#ifndef ROOTFS_GEN_H
+#define ROOTFS_GEN_H
+
+/* the first generated process id */
+#define ROOTFS_GEN_PID_BASE		1000
+
+/* the configuration limits */
+#define ROOTFS_GEN_MAX_PROCESSES	50000
+#define ROOTFS_GEN_MAX_MAPPINGS		200000
+#define ROOTFS_GEN_MAX_CPUS		512
+#define ROOTFS_GEN_MAX_FREQUENCIES	64
+
+/**
+ * The generated rootfs configuration.
+ */
+typedef struct rootfs_gen_t {
+	/* the number of processes, their ids start from ROOTFS_GEN_PID_BASE */
+	int processes;
+	/* the number of memory mappings per process */
+	int mappings;
+	/* the number of memory mappings of the middle process, 0 to use
+	 * the same number as for the other processes */
+	int huge_mappings;
+	/* the number of cpu cores */
+	int cpus;
+	/* the number of cpufreq policies, the cores are split evenly
+	 * between the policies */
+	int policies;
+	/* the number of frequencies per policy */
+	int frequencies;
+	/* the random number generator seed */
+	unsigned seed;
+} rootfs_gen_t;
+
+
+/**
+ * Initializes the configuration with default values.
+ *
+ * @param[out] config   the configuration to initialize.
+ */
+void rootfs_gen_defaults(
+		rootfs_gen_t* config
+		);
+
+/**
+ * Validates the configuration.
+ *
+ * @param[in] config   the configuration.
+ * @return             0 for valid configuration, -EINVAL otherwise.
+ */
+int rootfs_gen_validate(
+		const rootfs_gen_t* config
+		);
+
+/**
+ * Writes the synthetic rootfs.
+ *
+ * @param[in] root     the rootfs directory. It is created if necessary.
+ * @param[in] config   the rootfs configuration.
+ * @return             0 for success or a negative error code (-errno).
+ */
+int rootfs_gen_write(
+		const char* root,
+		const rootfs_gen_t* config
+		);
+
+/**
+ * Removes the rootfs directory together with its contents.
+ *
+ * @param[in] root     the rootfs directory.
+ * @return             0 for success.
+ */
+int rootfs_gen_remove(
+		const char* root
+		);
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Linker level (-Wl,--wrap) wrappers counting the file system calls
+ * and heap allocations made by the sp-measure library.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "syscall_count.h"
+
+syscall_count_t syscall_count;
+
+void syscall_count_reset(void)
+{
+	memset(&syscall_count, 0, sizeof(syscall_count));
+}
+
+int __real_open(const char* path, int flags, ...);
+int __real_open64(const char* path, int flags, ...);
+int __real_openat(int dirfd, const char* path, int flags, ...);
+FILE* __real_fopen(const char* path, const char* mode);
+FILE* __real_fopen64(const char* path, const char* mode);
+int __real_close(int fd);
+int __real_fclose(FILE* fp);
+ssize_t __real_read(int fd, void* buf, size_t count);
+ssize_t __real_pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t __real_pread64(int fd, void* buf, size_t count, off_t offset);
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+int __real_posix_memalign(void** ptr, size_t alignment, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* str);
+void __real_free(void* ptr);
+int __real_pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg);
+
+/* retrieves the optional mode argument of open() calls */
+#define OPEN_MODE(flags, mode) \
+	if (flags & O_CREAT) { \
+		va_list ap; \
+		va_start(ap, flags); \
+		mode = va_arg(ap, int); \
+		va_end(ap); \
+	}
+
+int __wrap_open(const char* path, int flags, ...)
+{
+	int mode = 0;
+	OPEN_MODE(flags, mode);
+	syscall_count.open++;
+	return __real_open(path, flags, mode);
+}
+
+int __wrap_open64(const char* path, int flags, ...)
+{
+	int mode = 0;
+	OPEN_MODE(flags, mode);
+	syscall_count.open++;
+	return __real_open64(path, flags, mode);
+}
+
+int __wrap_openat(int dirfd, const char* path, int flags, ...)
+{
+	int mode = 0;
+	OPEN_MODE(flags, mode);
+	syscall_count.open++;
+	return __real_openat(dirfd, path, flags, mode);
+}
+
+FILE* __wrap_fopen(const char* path, const char* mode)
+{
+	syscall_count.open++;
+	syscall_count.alloc++;
+	return __real_fopen(path, mode);
+}
+
+FILE* __wrap_fopen64(const char* path, const char* mode)
+{
+	syscall_count.open++;
+	syscall_count.alloc++;
+	return __real_fopen64(path, mode);
+}
+
+int __wrap_close(int fd)
+{
+	syscall_count.close++;
+	return __real_close(fd);
+}
+
+int __wrap_fclose(FILE* fp)
+{
+	syscall_count.close++;
+	syscall_count.free++;
+	return __real_fclose(fp);
+}
+
+ssize_t __wrap_read(int fd, void* buf, size_t count)
+{
+	syscall_count.read++;
+	return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_pread(int fd, void* buf, size_t count, off_t offset)
+{
+	syscall_count.read++;
+	return __real_pread(fd, buf, count, offset);
+}
+
+ssize_t __wrap_pread64(int fd, void* buf, size_t count, off_t offset)
+{
+	syscall_count.read++;
+	return __real_pread64(fd, buf, count, offset);
+}
+
+/* fails the allocation if the allocation limit has been reached */
+#define FAIL_ALLOC(value) \
+	if (syscall_count.fail_alloc && syscall_count.alloc >= syscall_count.fail_alloc) { \
+		errno = ENOMEM; \
+		return value; \
+	}
+
+void* __wrap_malloc(size_t size)
+{
+	FAIL_ALLOC(NULL);
+	syscall_count.alloc++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+	FAIL_ALLOC(NULL);
+	syscall_count.alloc++;
+	return __real_calloc(nmemb, size);
+}
+
+int __wrap_posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+	FAIL_ALLOC(ENOMEM);
+	syscall_count.alloc++;
+	return __real_posix_memalign(ptr, alignment, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	syscall_count.alloc++;
+	if (syscall_count.fail_realloc) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* str)
+{
+	syscall_count.alloc++;
+	return __real_strdup(str);
+}
+
+void __wrap_free(void* ptr)
+{
+	if (ptr) syscall_count.free++;
+	__real_free(ptr);
+}
+
+int __wrap_pthread_create(pthread_t* thread, const pthread_attr_t* attr, void* (*start)(void*), void* arg)
+{
+	syscall_count.thread++;
+	if (syscall_count.fail_thread && syscall_count.thread > syscall_count.fail_thread) {
+		return EAGAIN;
+	}
+	return __real_pthread_create(thread, attr, start, arg);
+}
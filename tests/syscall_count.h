@@ -0,0 +1,67 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+#ifndef SYSCALL_COUNT_H
+#define SYSCALL_COUNT_H
+
+/**
+ * File system call counters.
+ *
+ * The counters are updated by wrappers of the corresponding libc
+ * functions. The wrappers are enabled by linking the program with
+ * the static sp-measure library and SYSCALL_COUNT_WRAPS linker
+ * flags (see tests/Makefile.am), so only the calls made by the library
+ * itself are counted. The reads done internally by stdio streams are
+ * not counted, and every stream counts as a single heap allocation.
+ */
+typedef struct syscall_count_t {
+	/* open(), openat() and fopen() calls */
+	int open;
+	/* close() and fclose() calls */
+	int close;
+	/* read() and pread() calls */
+	int read;
+	/* malloc(), calloc(), realloc(), strdup(), posix_memalign() and fopen() calls */
+	int alloc;
+	/* free() and fclose() calls */
+	int free;
+	/* pthread_create() calls */
+	int thread;
+	/* non-zero to make realloc() calls fail with ENOMEM */
+	int fail_realloc;
+	/* non-zero to make malloc(), calloc() and posix_memalign() calls fail
+	 * with ENOMEM once the specified number of allocations has been made.
+	 * The failed calls are not counted */
+	int fail_alloc;
+	/* non-zero to make pthread_create() calls fail with EAGAIN after
+	 * the specified number of calls */
+	int fail_thread;
+} syscall_count_t;
+
+extern syscall_count_t syscall_count;
+
+/**
+ * Resets the system call counters.
+ */
+void syscall_count_reset(void);
+
+#endif
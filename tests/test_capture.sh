@@ -0,0 +1,20 @@
+#!/bin/sh
+#
+# Captures the test rootfs with sp-measure-capture and checks that
+# the captured snapshots are identical to the source.
+#
+CAPTURE=../tools/sp-measure-capture
+OUTPUT=$(mktemp -d /tmp/sp-measure-capture.XXXXXX) || exit 1
+trap 'rm -rf "$OUTPUT"' EXIT
+
+$CAPTURE -r ./rootfs1 -o "$OUTPUT" -n 2 -i 10 -a -g applications -g background || exit 1
+for snapshot in rootfs1 rootfs2; do
+	diff -r ./rootfs1 "$OUTPUT/$snapshot" || exit 1
+done
+test ! -e "$OUTPUT/rootfs3" || exit 1
+
+# explicitly listed processes are captured, missing ones are skipped
+rm -rf "$OUTPUT"/*
+$CAPTURE -r ./rootfs2 -o "$OUTPUT" -n 1 -g applications -g background 25268 25269 || exit 1
+diff -r ./rootfs2 "$OUTPUT/rootfs1" || exit 1
+exit 0
@@ -36,9 +36,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <pthread.h>
 
 #include <sp_measure.h>
 
+#include "rootfs_gen.h"
+
 #define TEST(expression, ...) if (!(expression)) {fprintf(stderr, "[failure] " #expression "\n" __VA_ARGS__ ); exit(-1);}
 
 #define TEST_VALUE_INT(expression, value)	TEST(expression == value, "\t" #expression "=%d\n", expression)
@@ -47,6 +57,11 @@
 #define SNAPSHOT_TEST_SYS  (SNAPSHOT_SYS | SNAPSHOT_SYS_MEM_WATERMARK)
 #define SNAPSHOT_TEST_PROC (SNAPSHOT_PROC)
 
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
+
+/* number of processes in the parallel process set test */
+#define PROC_SET_TEST_SIZE 99
+
 
 void check_system_api()
 {
@@ -65,6 +80,10 @@ void check_system_api()
 	TEST_VALUE_INT(data1.common->mem_total, 3096748);
 	TEST_VALUE_INT(data1.common->mem_swap, 5111800);
 	TEST_VALUE_INT(data1.common->cpu_max_freq, 2201000);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY_COUNT(&data1), 2);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY(&data1, 0)->max_freq, 2201000);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY(&data1, 1)->id, 1);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY(&data1, 1)->max_freq, 2800000);
 
 	/* take system resource usage snapshot */
 	TEST(sp_measure_get_sys_data(&data1, SNAPSHOT_TEST_SYS, "snapshot1") == 0);
@@ -76,16 +95,45 @@ void check_system_api()
 	TEST_VALUE_INT(data1.mem_cached, 1593264);
 	TEST_VALUE_INT(data1.mem_watermark, 3);
 
+	/* check the detailed memory statistics */
+	TEST(sp_measure_get_sys_data(&data1, SNAPSHOT_SYS_MEM_DETAILS, NULL) == 0);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_MEM_TOTAL), 3096748);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_ACTIVE_ANON), 386192);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_SLAB), 114980);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_COMMITTED_AS), 1486872);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_HUGE_PAGES_TOTAL), 0);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_HUGE_PAGE_SIZE), 4096);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_MEM_AVAILABLE), ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(FIELD_SYS_MEMINFO(&data1, MEMINFO_SHMEM), ESPMEASURE_UNDEFINED);
+
 	/* check cpu usage data */
 	TEST_VALUE_INT(data1.cpu_ticks_total, 85277555);
 	TEST_VALUE_INT(data1.cpu_ticks_idle, 82387691);
 	TEST_VALUE_INT(data1.cpu_freq_ticks_count, 5);
+	TEST_VALUE_INT(data1.cpu_policy_count, 2);
+	TEST_VALUE_INT(data1.cpu_policy_freq_ticks[0].freq_ticks_count, 5);
+	TEST_VALUE_INT(data1.cpu_policy_freq_ticks[1].freq_ticks_count, 4);
+	TEST_VALUE_INT((int)data1.cpu_ticks.user, 1797003);
+	TEST_VALUE_INT((int)data1.cpu_ticks.softirq, 6045);
+
+	/* check per cpu core usage data */
+	TEST_VALUE_INT(FIELD_SYS_CPU_CORE_COUNT(&data1), 2);
+	TEST_VALUE_INT((int)FIELD_SYS_CPU_CORE_TICKS(&data1, 0)->total, 41914601);
+	TEST_VALUE_INT((int)FIELD_SYS_CPU_CORE_TICKS(&data1, 1)->total, 43362950);
+	TEST_VALUE_INT((int)FIELD_SYS_CPU_CORE_TICKS(&data1, 1)->iowait, 28160);
 
 	/* set the fake rootfs */
 	sp_measure_set_fs_root("./rootfs2");
 	/* take the second snapshot */
 	TEST(sp_measure_get_sys_data(&data2, SNAPSHOT_TEST_SYS, NULL) == 0);
-	TEST(data2.name == NULL);
+	TEST(data2.name[0] == '\0');
+
+	/* check the monotonic timestamps */
+	int64_t diff_ns;
+	TEST(sp_measure_diff_sys_timestamp_ns(&data1, &data2, &diff_ns) == 0);
+	TEST(diff_ns >= 0, "\tsp_measure_diff_sys_timestamp_ns: diff=%lld\n", (long long)diff_ns);
+	TEST(sp_measure_diff_sys_boottime_ns(&data1, &data2, &diff_ns) == 0);
+	TEST(diff_ns >= 0, "\tsp_measure_diff_sys_boottime_ns: diff=%lld\n", (long long)diff_ns);
 	/* take third snapshot */
 	TEST(sp_measure_init_sys_data(&data3, SNAPSHOT_TEST_SYS, NULL) == 0);
 	TEST(sp_measure_get_sys_data(&data3, SNAPSHOT_TEST_SYS, NULL) == 0);
@@ -106,6 +154,10 @@ void check_system_api()
 	/* this isn't actually a diff, but average frequency between snapshots */
 	TEST(sp_measure_diff_sys_cpu_avg_freq(&data1, &data2, &diff) == 0);
 	TEST(diff == 839559, "\tsp_measure_diff_sys_cpu_avg_freq: diff=%d\n", diff);
+	int policy_freq[4];
+	TEST_VALUE_INT(sp_measure_diff_sys_cpu_policy_avg_freq(&data1, &data2, policy_freq, 4), 2);
+	TEST_VALUE_INT(policy_freq[0], 839559);
+	TEST_VALUE_INT(policy_freq[1], 1781981);
 
 	/* data1 and data3 does not share the same common data (they were
 	 * initialized separately. Comparison operations for such snapshots
@@ -126,6 +178,17 @@ void check_system_api()
 	TEST(sp_measure_diff_sys_mem_used(&data1, &data2, &diff) == 0);
 	TEST(diff == 824, "\tsp_measure_diff_sys_mem_used: diff=%d\n", diff);
 
+	/* check per cpu core comparison results */
+	int core_usage[4];
+	sp_measure_cpu_ticks_t core_ticks[4];
+	TEST(sp_measure_diff_sys_cpu_core_usage(&data1, &data3, core_usage, 4) < 0);
+	TEST_VALUE_INT(sp_measure_diff_sys_cpu_core_usage(&data1, &data2, core_usage, 4), 2);
+	TEST_VALUE_INT(core_usage[0], 1049);
+	TEST_VALUE_INT(core_usage[1], 629);
+	TEST_VALUE_INT(sp_measure_diff_sys_cpu_core_ticks(&data1, &data2, core_ticks, 1), 1);
+	TEST_VALUE_INT((int)core_ticks[0].total, 146364);
+	TEST_VALUE_INT((int)core_ticks[0].user, 11579);
+
 	/* reset the fake rootfs */
 	sp_measure_set_fs_root(NULL);
 
@@ -136,6 +199,41 @@ void check_system_api()
 }
 
 
+void check_cpu_freq_diff()
+{
+	sp_measure_sys_common_t common;
+	sp_measure_sys_data_t data1, data2;
+	/* the frequency sets differ between snapshots */
+	sp_measure_cpu_freq_ticks_t ticks1[] = {
+		{ 800000, 100 }, { 1200000, 50 }
+	};
+	sp_measure_cpu_freq_ticks_t ticks2[] = {
+		{ 600000, 10 }, { 800000, 150 }, { 1200000, 50 }, { 1600000, 20 }
+	};
+	int diff;
+
+	memset(&common, 0, sizeof(common));
+	memset(&data1, 0, sizeof(data1));
+	memset(&data2, 0, sizeof(data2));
+	data1.common = &common;
+	data1.cpu_freq_ticks = ticks1;
+	data1.cpu_freq_ticks_count = 2;
+	data2.common = &common;
+	data2.cpu_freq_ticks = ticks2;
+	data2.cpu_freq_ticks_count = 4;
+
+	/* (600000 * 10 + 800000 * 50 + 1600000 * 20) / 80 */
+	TEST(sp_measure_diff_sys_cpu_avg_freq(&data1, &data2, &diff) == 0);
+	TEST_VALUE_INT(diff, 975000);
+
+	/* a frequency disappearing from the table is ignored */
+	TEST(sp_measure_diff_sys_cpu_avg_freq(&data2, &data1, &diff) == 0);
+	TEST_VALUE_INT(diff, 0);
+	ticks1[0].ticks = 200;
+	TEST(sp_measure_diff_sys_cpu_avg_freq(&data2, &data1, &diff) == 0);
+	TEST_VALUE_INT(diff, 800000);
+}
+
 void check_process_api()
 {
 	sp_measure_proc_data_t data1, data2, data3;
@@ -178,7 +276,7 @@ void check_process_api()
 	TEST(sp_measure_init_proc_data(&data3, 25268, SNAPSHOT_TEST_PROC, NULL) == 0);
 	TEST(data3.common != NULL);
 	TEST(sp_measure_get_proc_data(&data3, SNAPSHOT_TEST_PROC, NULL) == 0);
-	TEST(data3.name == NULL);
+	TEST(data3.name[0] == '\0');
 
 	/* check memory usage data */
 	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_CLEAN(&data3), 14300);
@@ -219,6 +317,24 @@ void check_process_api()
 	TEST(sp_measure_diff_proc_cpu_ticks(&data1, &data2, &diff) == 0);
 	TEST(diff == 209, "\tsp_measure_diff_proc_cpu_ticks: diff=%d\n", diff);
 
+	int64_t diff_ns;
+	TEST(sp_measure_diff_proc_timestamp_ns(&data1, &data2, &diff_ns) == 0);
+	TEST(diff_ns >= 0, "\tsp_measure_diff_proc_timestamp_ns: diff=%lld\n", (long long)diff_ns);
+
+	/* smaps_rollup must give the same totals as summing up smaps
+	 * (data2 shares the data1 common, so it reads rootfs1 files) */
+	TEST(data1.common->proc_smaps_rollup_path != NULL);
+	TEST(sp_measure_get_proc_data(&data2, SNAPSHOT_TEST_PROC | SNAPSHOT_PROC_MEM_ROLLUP, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_CLEAN(&data2), FIELD_PROC_MEM_PRIVATE_CLEAN(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(&data2), FIELD_PROC_MEM_PRIVATE_DIRTY(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(&data2), FIELD_PROC_MEM_SWAP(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(&data2), FIELD_PROC_MEM_SIZE(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(&data2), FIELD_PROC_MEM_PSS(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&data2), FIELD_PROC_MEM_RSS(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_REFERENCED(&data2), FIELD_PROC_MEM_REFERENCED(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SHARED_CLEAN(&data2), FIELD_PROC_MEM_SHARED_CLEAN(&data1));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SHARED_DIRTY(&data2), FIELD_PROC_MEM_SHARED_DIRTY(&data1));
+
 	/* reset the fake rootfs */
 	sp_measure_set_fs_root(NULL);
 
@@ -228,11 +344,996 @@ void check_process_api()
 	TEST(sp_measure_free_proc_data(&data3) == 0);
 }
 
+void check_smaps_parser()
+{
+	/* the values summed up from the fake rootfs smaps files */
+	static const struct {
+		const char* root;
+		int values[9];
+	} expected[] = {
+		{"./rootfs1", {686500, 114404, 110781, 3540, 768, 14104, 95992, 68956, 16192}},
+		{"./rootfs2", {686500, 116108, 112140, 3944, 768, 14300, 97096, 75672, 15084}},
+	};
+	sp_measure_proc_data_t data;
+	sp_measure_proc_set_t set;
+	int pids[] = {25268};
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(expected); i++) {
+		sp_measure_set_fs_root(expected[i].root);
+		/* the single process snapshots use a small stack buffer, the
+		 * process sets a large heap buffer */
+		TEST(sp_measure_init_proc_data(&data, 25268, 0, NULL) == 0);
+		TEST(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_USAGE, NULL) == 0);
+		TEST(sp_measure_init_proc_set(&set, pids, ARRAY_SIZE(pids), 0, NULL) == 0);
+		TEST(sp_measure_get_proc_set_data(&set, SNAPSHOT_PROC_MEM_USAGE) == 0);
+		const sp_measure_proc_data_t* snapshots[] = {&data, FIELD_PROC_SET_DATA(&set, 0)};
+		unsigned j;
+		for (j = 0; j < ARRAY_SIZE(snapshots); j++) {
+			TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(snapshots[j]), expected[i].values[0]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_RSS(snapshots[j]), expected[i].values[1]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_PSS(snapshots[j]), expected[i].values[2]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_SHARED_CLEAN(snapshots[j]), expected[i].values[3]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_SHARED_DIRTY(snapshots[j]), expected[i].values[4]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_CLEAN(snapshots[j]), expected[i].values[5]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(snapshots[j]), expected[i].values[6]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_REFERENCED(snapshots[j]), expected[i].values[7]);
+			TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(snapshots[j]), expected[i].values[8]);
+		}
+		TEST(sp_measure_free_proc_set(&set) == 0);
+		TEST(sp_measure_free_proc_data(&data) == 0);
+	}
+	sp_measure_set_fs_root(NULL);
+}
+
+void check_mem_fields()
+{
+	sp_measure_proc_data_t data;
+	int page_size_kb = sysconf(_SC_PAGESIZE) >> 10;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_proc_data(&data, 25268, 0, NULL) == 0);
+
+	/* the memory size and resident memory are read from the statm file,
+	 * which counts the resident memory differently from smaps */
+	TEST(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(&data), 171625 * page_size_kb);
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&data), 32268 * page_size_kb);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(&data), ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(&data), ESPMEASURE_UNDEFINED);
+
+	/* the status file has no swap usage, so smaps is used instead */
+	TEST(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_SWAP, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&data), 114404);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(&data), 16192);
+
+	/* the proportional memory usage is available only from smaps */
+	TEST(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_PSS, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(&data), 110781);
+	TEST(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_PRIV_DIRTY_SUM, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(&data), 95992);
+
+	/* all requested memory fields are reported as failed */
+	TEST(sp_measure_free_proc_data(&data) == 0);
+	TEST(sp_measure_init_proc_data(&data, 25269, 0, NULL) == 0);
+	TEST_VALUE_INT(sp_measure_get_proc_data(&data, SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_SWAP, NULL),
+			SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_SWAP);
+	TEST(sp_measure_free_proc_data(&data) == 0);
+
+	sp_measure_set_fs_root(NULL);
+}
+
+void check_process_set_api()
+{
+	sp_measure_proc_set_t set1, set2;
+	/* the second process does not exist in the fake rootfs */
+	int pids[] = {25268, 25269, 25268};
+	int diff;
+
+	/* set the fake rootfs */
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_proc_set(&set1, pids, 3, SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST(sp_measure_init_proc_set(&set2, NULL, 0, 0, &set1) == 0);
+	TEST_VALUE_INT(set2.count, 3);
+	TEST(FIELD_PROC_SET_DATA(&set1, 2)->common == FIELD_PROC_SET_DATA(&set2, 2)->common);
+	TEST_VALUE_STR(FIELD_PROC_NAME(FIELD_PROC_SET_DATA(&set1, 0)), "eclipse");
+
+	/* take process set snapshot */
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set1, SNAPSHOT_TEST_PROC), 1);
+	TEST_VALUE_INT(FIELD_PROC_SET_FAILED(&set1, 0), 0);
+	TEST_VALUE_INT(FIELD_PROC_SET_FAILED(&set1, 1), 1);
+	TEST_VALUE_INT(FIELD_PROC_SET_FAILED(&set1, 2), 0);
+
+	/* check memory and cpu usage data */
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(FIELD_PROC_SET_DATA(&set1, 0)), 95992);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(FIELD_PROC_SET_DATA(&set1, 2)), 110781);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(FIELD_PROC_SET_DATA(&set1, 2)), 686500);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(FIELD_PROC_SET_DATA(&set1, 1)), ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(FIELD_PROC_CPU_UTIME(FIELD_PROC_SET_DATA(&set1, 2)), 262287);
+	TEST_VALUE_INT(FIELD_PROC_CPU_STIME(FIELD_PROC_SET_DATA(&set1, 1)), ESPMEASURE_UNDEFINED);
+
+	/* the second set snapshot in rollup mode must give the same values */
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set2, SNAPSHOT_TEST_PROC | SNAPSHOT_PROC_MEM_ROLLUP), 1);
+	TEST(sp_measure_diff_proc_mem_private_dirty(FIELD_PROC_SET_DATA(&set1, 0), FIELD_PROC_SET_DATA(&set2, 0), &diff) == 0);
+	TEST_VALUE_INT(diff, 0);
+	TEST(sp_measure_diff_proc_cpu_ticks(FIELD_PROC_SET_DATA(&set1, 2), FIELD_PROC_SET_DATA(&set2, 2), &diff) == 0);
+	TEST_VALUE_INT(diff, 0);
+	TEST(sp_measure_diff_proc_cpu_ticks(FIELD_PROC_SET_DATA(&set1, 1), FIELD_PROC_SET_DATA(&set2, 1), &diff) < 0);
+
+	/* reset the fake rootfs */
+	sp_measure_set_fs_root(NULL);
+
+	TEST(sp_measure_free_proc_set(&set2) == 0);
+	TEST(sp_measure_free_proc_set(&set1) == 0);
+}
+
+void check_process_set_workers()
+{
+	sp_measure_proc_set_t set;
+	int pids[PROC_SET_TEST_SIZE];
+	int i;
+
+	/* every third process does not exist in the fake rootfs */
+	for (i = 0; i < PROC_SET_TEST_SIZE; i++) {
+		pids[i] = i % 3 ? 25268 : 25269;
+	}
+	sp_measure_set_fs_root("./rootfs2");
+	TEST(sp_measure_init_proc_set(&set, pids, PROC_SET_TEST_SIZE, SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST_VALUE_INT(sp_measure_proc_set_workers(&set, 4), 4);
+	TEST(set.workers != NULL);
+
+	/* take the snapshot a few times to exercise the worker wake up */
+	for (i = 0; i < 3; i++) {
+		TEST_VALUE_INT(sp_measure_get_proc_set_data(&set, SNAPSHOT_TEST_PROC), PROC_SET_TEST_SIZE / 3);
+	}
+	for (i = 0; i < PROC_SET_TEST_SIZE; i++) {
+		TEST_VALUE_INT(FIELD_PROC_SET_FAILED(&set, i), i % 3 ? 0 : 1);
+		TEST_VALUE_INT(FIELD_PROC_CPU_UTIME(FIELD_PROC_SET_DATA(&set, i)), i % 3 ? 262479 : ESPMEASURE_UNDEFINED);
+		TEST_VALUE_INT(FIELD_PROC_MEM_PSS(FIELD_PROC_SET_DATA(&set, i)), i % 3 ? 112140 : ESPMEASURE_UNDEFINED);
+	}
+
+	/* the default worker count is the number of online cpus */
+	TEST(sp_measure_proc_set_workers(&set, 0) > 0);
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set, SNAPSHOT_TEST_PROC), PROC_SET_TEST_SIZE / 3);
+	/* disable parallel snapshots */
+	TEST_VALUE_INT(sp_measure_proc_set_workers(&set, 1), 1);
+	TEST(set.workers == NULL);
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set, SNAPSHOT_TEST_PROC), PROC_SET_TEST_SIZE / 3);
+
+	sp_measure_set_fs_root(NULL);
+	TEST(sp_measure_proc_set_workers(&set, 3) == 3);
+	TEST(sp_measure_free_proc_set(&set) == 0);
+}
+
+/**
+ * Waits until the condition is true, failing the test after 5 seconds.
+ */
+#define WAIT_FOR(expression) { \
+		struct timespec ts = {0, 1000000}; \
+		int wait_ms = 5000; \
+		while (!(expression) && wait_ms--) nanosleep(&ts, NULL); \
+		TEST(expression); \
+	}
+
+void check_schedule()
+{
+	sp_measure_schedule_t schedule;
+	sp_measure_sys_data_t sys;
+	struct timespec ts = {0, 10000000};
+	int64_t period_ns = 2000000;
+	int i;
+
+	TEST_VALUE_INT(sp_measure_init_schedule(&schedule, 0), -EINVAL);
+	TEST_VALUE_INT(sp_measure_init_schedule(&schedule, period_ns), 0);
+	for (i = 0; i < 5; i++) {
+		TEST(sp_measure_schedule_wait(&schedule) >= 0);
+		TEST(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+		/* the deadlines stay at period multiples from the start */
+		TEST((FIELD_SCHEDULE_DEADLINE_NS(&schedule) - schedule.start_ns) % period_ns == 0);
+		TEST(FIELD_SCHEDULE_DEADLINE_NS(&schedule) - schedule.start_ns == FIELD_SCHEDULE_TICK(&schedule) * period_ns);
+		TEST((int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec >= FIELD_SCHEDULE_DEADLINE_NS(&schedule));
+	}
+
+	/* the deadlines passed while sleeping are skipped */
+	int64_t tick = FIELD_SCHEDULE_TICK(&schedule);
+	ts.tv_sec = 0;
+	ts.tv_nsec = 5 * period_ns;
+	nanosleep(&ts, NULL);
+	int missed = sp_measure_schedule_wait(&schedule);
+	TEST(missed >= 3);
+	TEST(FIELD_SCHEDULE_MISSED(&schedule) >= missed);
+	TEST(FIELD_SCHEDULE_TICK(&schedule) == tick + missed + 1);
+	TEST((FIELD_SCHEDULE_DEADLINE_NS(&schedule) - schedule.start_ns) % period_ns == 0);
+
+	/* the snapshots are stamped with the intended snapshot time */
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_SYS_TIMESTAMP, NULL) >= 0);
+	TEST(FIELD_SYS_SCHEDULED_NS(&sys) == 0);
+	TEST(sp_measure_schedule_wait(&schedule) >= 0);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_TIMESTAMP, NULL) == 0);
+	TEST(sp_measure_schedule_stamp_sys(&schedule, &sys) == 0);
+	TEST(FIELD_SYS_SCHEDULED_NS(&sys) == FIELD_SCHEDULE_DEADLINE_NS(&schedule));
+	TEST(FIELD_SYS_TIMESTAMP_NS(&sys) >= FIELD_SYS_SCHEDULED_NS(&sys));
+	sp_measure_free_sys_data(&sys);
+}
+
+void check_sampler()
+{
+	sp_measure_sampler_t sampler;
+	sp_measure_sampler_entry_t* entry;
+	sp_measure_sys_data_t sys;
+	/* the second process does not exist in the fake rootfs */
+	int pids[] = {25268, 25269};
+	uint64_t sequence = 0;
+	int i;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_SYS, NULL) >= 0);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS, NULL) >= 0);
+
+	TEST_VALUE_INT(sp_measure_init_sampler(&sampler, 4, 1000000, SNAPSHOT_SYS, NULL, 1, 0), -EINVAL);
+	TEST_VALUE_INT(sp_measure_init_sampler(&sampler, 1, 1000000, SNAPSHOT_SYS, NULL, 0, 0), -EINVAL);
+	TEST(sp_measure_init_sampler(&sampler, 4, 1000000, SNAPSHOT_SYS, pids, ARRAY_SIZE(pids), SNAPSHOT_PROC) >= 0);
+	TEST(sp_measure_sampler_peek(&sampler) == NULL);
+	TEST_VALUE_INT(sp_measure_sampler_pop(&sampler), -ENOENT);
+
+	/* the first snapshot is taken immediately */
+	TEST_VALUE_INT(sp_measure_sampler_start(&sampler), 0);
+	TEST_VALUE_INT(sp_measure_sampler_start(&sampler), -EALREADY);
+	WAIT_FOR( (entry = sp_measure_sampler_peek(&sampler)) != NULL);
+	TEST(entry->sequence == 1);
+	TEST(entry->sys_rc >= 0);
+	TEST(entry->sys.timestamp_ns > 0);
+	TEST_VALUE_INT(entry->sys_resources, SNAPSHOT_SYS);
+	TEST_VALUE_INT(entry->proc_resources, SNAPSHOT_PROC);
+	TEST(FIELD_SYS_SCHEDULED_NS(&entry->sys) > 0);
+	TEST(FIELD_SYS_TIMESTAMP_NS(&entry->sys) >= FIELD_SYS_SCHEDULED_NS(&entry->sys));
+	TEST(FIELD_PROC_SCHEDULED_NS(FIELD_PROC_SET_DATA(&entry->procs, 0)) == FIELD_SYS_SCHEDULED_NS(&entry->sys));
+	TEST_VALUE_INT(FIELD_SYS_MEM_TOTAL(&entry->sys), FIELD_SYS_MEM_TOTAL(&sys));
+	TEST_VALUE_INT(entry->procs_rc, 1);
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(FIELD_PROC_SET_DATA(&entry->procs, 0)), 95992);
+	TEST_VALUE_INT(FIELD_PROC_SET_FAILED(&entry->procs, 1), 1);
+
+	/* the sampler skips snapshots while the ring is full */
+	WAIT_FOR(sp_measure_sampler_dropped(&sampler) > 0);
+
+	/* only the initialized resources can be sampled */
+	TEST_VALUE_INT(sp_measure_sampler_reconfigure(&sampler, 1000000, SNAPSHOT_SYS_MEM_WATERMARK, 0), -EINVAL);
+	TEST_VALUE_INT(sp_measure_sampler_reconfigure(&sampler, 0, SNAPSHOT_SYS, 0), -EINVAL);
+	TEST_VALUE_INT(sp_measure_sampler_reconfigure(&sampler, 1000000, SNAPSHOT_SYS_MEM, SNAPSHOT_PROC_CPU_USAGE), 0);
+
+	/* the published entries are consumed in order */
+	for (i = 0; (entry = sp_measure_sampler_peek(&sampler)) != NULL; i++) {
+		TEST(entry->sequence > sequence);
+		sequence = entry->sequence;
+		TEST_VALUE_INT(sp_measure_sampler_pop(&sampler), 0);
+	}
+	TEST(i >= 4);
+	/* the entries taken after the reconfiguration retrieve only the cpu usage,
+	 * a snapshot taken during the reconfiguration can still be published */
+	for (i = 0; i < 5000; i++) {
+		entry = sp_measure_sampler_peek(&sampler);
+		if (entry && entry->proc_resources == SNAPSHOT_PROC_CPU_USAGE) break;
+		if (entry) sp_measure_sampler_pop(&sampler);
+		else usleep(1000);
+	}
+	TEST(entry != NULL);
+	TEST(entry->sequence > sequence);
+	TEST_VALUE_INT(entry->sys_resources, SNAPSHOT_SYS_MEM | SNAPSHOT_SYS_TIMESTAMP);
+	TEST_VALUE_INT(entry->proc_resources, SNAPSHOT_PROC_CPU_USAGE);
+	TEST_VALUE_INT(FIELD_PROC_CPU_UTIME(FIELD_PROC_SET_DATA(&entry->procs, 0)), 262287);
+	/* the reused entry keeps the memory usage of its earlier lap, which
+	 * is told apart by the recorded resources */
+	TEST(!(entry->proc_resources & SNAPSHOT_PROC_MEM_PRIVATE_DIRTY));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(FIELD_PROC_SET_DATA(&entry->procs, 0)), 95992);
+	TEST_VALUE_INT(sp_measure_sampler_stop(&sampler), 0);
+	TEST_VALUE_INT(sp_measure_sampler_stop(&sampler), 0);
+
+	/* the sampler can be restarted */
+	while (sp_measure_sampler_pop(&sampler) == 0) ;
+	sequence = 0;
+	TEST_VALUE_INT(sp_measure_sampler_start(&sampler), 0);
+	WAIT_FOR( (entry = sp_measure_sampler_peek(&sampler)) != NULL);
+	TEST(entry->sequence > sequence);
+
+	/* the running sampler is stopped when freed */
+	TEST(sp_measure_free_sampler(&sampler) == 0);
+	TEST(sp_measure_free_sampler(&sampler) == 0);
+	sp_measure_free_sys_data(&sys);
+	sp_measure_set_fs_root(NULL);
+}
+
+static int notify_sources;
+static int notify_mem_used;
+
+static void on_notify(
+		int sources,
+		const sp_measure_sys_data_t* data,
+		int rc,
+		void* user_data
+		)
+{
+	notify_sources |= sources;
+	notify_mem_used = rc < 0 ? ESPMEASURE_UNDEFINED : FIELD_SYS_MEM_USED(data);
+	(*(int*)user_data)++;
+}
+
+void check_notify()
+{
+	sp_measure_notify_t notify;
+	sp_measure_sys_data_t sys;
+	struct epoll_event event;
+	int calls = 0, sv[2], rc;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_SYS_MEM, NULL) >= 0);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM, NULL) >= 0);
+	TEST_VALUE_INT(sp_measure_init_notify(&notify, SNAPSHOT_SYS_MEM, on_notify, &calls), 0);
+	TEST(FIELD_NOTIFY_FD(&notify) >= 0);
+	TEST_VALUE_INT(FIELD_NOTIFY_SOURCES(&notify), 0);
+
+	TEST_VALUE_INT(sp_measure_notify_add_psi(&notify, NOTIFY_PSI, 0, 100000, 2000000), -EINVAL);
+	TEST_VALUE_INT(sp_measure_notify_add_psi(&notify, NOTIFY_MEM_WATERMARK_LOW, 0, 100000, 2000000), -EINVAL);
+	TEST_VALUE_INT(sp_measure_notify_add_psi(&notify, NOTIFY_PSI_MEMORY, 0, 0, 2000000), -EINVAL);
+	/* the fake rootfs has no pressure files, and its watermark files are
+	 * regular files which can't be polled */
+	TEST_VALUE_INT(sp_measure_notify_add_psi(&notify, NOTIFY_PSI_MEMORY, 0, 100000, 2000000), -ENOENT);
+	TEST_VALUE_INT(sp_measure_notify_add_watermarks(&notify), -EPERM);
+	TEST_VALUE_INT(FIELD_NOTIFY_SOURCES(&notify), 0);
+	TEST_VALUE_INT(sp_measure_notify_dispatch(&notify, 0), 0);
+	TEST_VALUE_INT(calls, 0);
+
+	/* simulate a memory pressure trigger with an urgent data socket,
+	 * which is reported with POLLPRI like the PSI triggers */
+	TEST(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLPRI;
+	event.data.u32 = __builtin_ctz(NOTIFY_PSI_MEMORY);
+	TEST(epoll_ctl(FIELD_NOTIFY_FD(&notify), EPOLL_CTL_ADD, sv[1], &event) == 0);
+	notify.fds[event.data.u32] = sv[1];
+	notify.sources |= NOTIFY_PSI_MEMORY;
+	if (send(sv[0], "!", 1, MSG_OOB) == 1) {
+		TEST_VALUE_INT(sp_measure_notify_dispatch(&notify, 1000), NOTIFY_PSI_MEMORY);
+		TEST_VALUE_INT(calls, 1);
+		TEST_VALUE_INT(notify_sources, NOTIFY_PSI_MEMORY);
+		TEST_VALUE_INT(notify_mem_used, FIELD_SYS_MEM_USED(&sys));
+	}
+	close(sv[0]);
+
+	/* register real PSI trigger if supported by the kernel */
+	sp_measure_set_fs_root(NULL);
+	rc = sp_measure_notify_add_psi(&notify, NOTIFY_PSI_MEMORY, 0, 100000, 2000000);
+	TEST(rc <= 0);
+	TEST_VALUE_INT(FIELD_NOTIFY_SOURCES(&notify) & NOTIFY_PSI_MEMORY, rc == 0 ? NOTIFY_PSI_MEMORY : 0);
+	TEST(sp_measure_notify_dispatch(&notify, 0) >= 0);
+
+	TEST(sp_measure_free_notify(&notify) == 0);
+	TEST(sp_measure_free_notify(&notify) == 0);
+	sp_measure_free_sys_data(&sys);
+}
+
+void check_cgroup_set()
+{
+	static const char* names[] = {"applications", "background", "missing"};
+	sp_measure_cgroup_set_t set1, set2;
+	sp_measure_cgroup_data_t* data;
+	sp_measure_sys_data_t sys;
+	int diff;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST_VALUE_INT(sp_measure_init_cgroup_set(&set1, NULL, 1, NULL), -EINVAL);
+	TEST_VALUE_INT(sp_measure_init_cgroup_set(&set1, names, 3, NULL), 0);
+	TEST_VALUE_INT(FIELD_CGROUP_SET_DATA(&set1, 0)->mem_current, ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(sp_measure_get_cgroup_set_data(&set1, SNAPSHOT_CGROUP), 1);
+	TEST_VALUE_STR(FIELD_CGROUP_SET_NAME(&set1, 0), "applications");
+
+	data = FIELD_CGROUP_SET_DATA(&set1, 0);
+	TEST_VALUE_INT(FIELD_CGROUP_SET_FAILED(&set1, 0), 0);
+	TEST(FIELD_CGROUP_TIMESTAMP_NS(data) > 0);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_CURRENT(data), 204800);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_SWAP_CURRENT(data), 8192);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_STAT(data, CGROUP_MEM_STAT_ANON), 92160);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_STAT(data, CGROUP_MEM_STAT_FILE), 102400);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_STAT(data, CGROUP_MEM_STAT_FILE_WRITEBACK), 4);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_STAT(data, CGROUP_MEM_STAT_PGFAULT), 1234567);
+	TEST_VALUE_INT(FIELD_CGROUP_CPU_USAGE_USEC(data), 40000000);
+	TEST_VALUE_INT(FIELD_CGROUP_CPU_NR_THROTTLED(data), 5);
+	TEST_VALUE_INT(FIELD_CGROUP_CPU_THROTTLED_USEC(data), 120000);
+	/* the io statistics are summed over all devices */
+	TEST_VALUE_INT(FIELD_CGROUP_IO_RBYTES(data), 105906176);
+	TEST_VALUE_INT(FIELD_CGROUP_IO_WBYTES(data), 52953088);
+	TEST_VALUE_INT(FIELD_CGROUP_IO_RIOS(data), 2100);
+	TEST_VALUE_INT(FIELD_CGROUP_IO_WIOS(data), 1050);
+
+	/* the swap accounting is not enabled for the background group */
+	data = FIELD_CGROUP_SET_DATA(&set1, 1);
+	TEST_VALUE_INT(FIELD_CGROUP_SET_FAILED(&set1, 1), 0);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_CURRENT(data), 32768);
+	TEST_VALUE_INT(FIELD_CGROUP_MEM_SWAP_CURRENT(data), ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(FIELD_CGROUP_IO_RBYTES(data), 0);
+
+	TEST_VALUE_INT(FIELD_CGROUP_SET_FAILED(&set1, 2), (SNAPSHOT_CGROUP & ~SNAPSHOT_CGROUP_TIMESTAMP));
+	TEST_VALUE_INT(FIELD_CGROUP_SET_DATA(&set1, 2)->mem_current, ESPMEASURE_UNDEFINED);
+
+	/* the groups are resolved again after the file system root change */
+	TEST_VALUE_INT(sp_measure_init_cgroup_set(&set2, NULL, 0, &set1), 0);
+	TEST_VALUE_INT(set2.count, 3);
+	sp_measure_set_fs_root("./rootfs2");
+	TEST_VALUE_INT(sp_measure_get_cgroup_set_data(&set2, SNAPSHOT_CGROUP_MEM_USAGE | SNAPSHOT_CGROUP_IO_STAT), 1);
+	TEST_VALUE_INT(FIELD_CGROUP_SET_DATA(&set2, 0)->timestamp_ns, ESPMEASURE_UNDEFINED);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_mem_current(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, 4096);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_io_read(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, 1024);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_io_write(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, 2048);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_mem_current(FIELD_CGROUP_SET_DATA(&set1, 2), FIELD_CGROUP_SET_DATA(&set2, 2), &diff), -EINVAL);
+	/* the cpu statistics were not retrieved */
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), -EINVAL);
+
+	TEST_VALUE_INT(sp_measure_get_cgroup_set_data(&set2, SNAPSHOT_CGROUP_TIMESTAMP | SNAPSHOT_CGROUP_CPU_STAT), 1);
+	/* one second of cpu time in one second is 100% of one cpu */
+	FIELD_CGROUP_SET_DATA(&set1, 0)->timestamp_ns = 0;
+	FIELD_CGROUP_SET_DATA(&set2, 0)->timestamp_ns = 1000000000;
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, 10000);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set2, 0), FIELD_CGROUP_SET_DATA(&set1, 0), &diff), -EINVAL);
+	/* large cpu times over long intervals don't overflow */
+	FIELD_CGROUP_SET_DATA(&set1, 0)->cpu_usage_usec = 0;
+	FIELD_CGROUP_SET_DATA(&set2, 0)->cpu_usage_usec = 1000000000000LL;
+	FIELD_CGROUP_SET_DATA(&set2, 0)->timestamp_ns = 10000000000000LL;
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, 1000000);
+	/* the usage which does not fit into int is clamped */
+	FIELD_CGROUP_SET_DATA(&set2, 0)->timestamp_ns = 1000000000;
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set1, 0), FIELD_CGROUP_SET_DATA(&set2, 0), &diff), 0);
+	TEST_VALUE_INT(diff, INT_MAX);
+	TEST_VALUE_INT(sp_measure_diff_cgroup_cpu_usage(FIELD_CGROUP_SET_DATA(&set2, 0), FIELD_CGROUP_SET_DATA(&set1, 0), &diff), -EINVAL);
+
+	TEST(sp_measure_free_cgroup_set(&set2) == 0);
+	TEST(sp_measure_free_cgroup_set(&set1) == 0);
+
+	/* the v1 memory cgroup is looked up under the file system root */
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_SYS_MEM_CGROUPS, NULL) >= 0);
+	TEST_VALUE_STR(sp_measure_cgroup_select(&sys, "applications"), "./rootfs1/syspart/applications");
+	TEST_VALUE_INT(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM_CGROUPS, NULL), 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_CGROUP(&sys), 51200);
+	TEST_VALUE_STR(sp_measure_cgroup_select(&sys, NULL), "./rootfs1/syspart");
+	TEST_VALUE_INT(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM_CGROUPS, NULL), 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_CGROUP(&sys), 102400);
+	sp_measure_free_sys_data(&sys);
+	sp_measure_set_fs_root(NULL);
+}
+
+typedef struct ctx_thread_t {
+	sp_measure_ctx_t* ctx;
+	/* the expected process user time of the context file system root */
+	int cpu_utime;
+	/* the number of snapshots with unexpected values */
+	int failures;
+} ctx_thread_t;
+
+static void* ctx_thread(void* arg)
+{
+	ctx_thread_t* thread = (ctx_thread_t*)arg;
+	sp_measure_sys_data_t sys;
+	sp_measure_proc_data_t proc;
+	int i, mem_used;
+
+	if (sp_measure_init_sys_data_ctx(thread->ctx, &sys, SNAPSHOT_SYS_MEM, NULL) < 0 ||
+			sp_measure_init_proc_data_ctx(thread->ctx, &proc, 25268, SNAPSHOT_PROC_CPU, NULL) != 0) {
+		thread->failures = -1;
+		return NULL;
+	}
+	sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM, NULL);
+	mem_used = FIELD_SYS_MEM_USED(&sys);
+	for (i = 0; i < 200; i++) {
+		if (sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM, NULL) != 0 || FIELD_SYS_MEM_USED(&sys) != mem_used) thread->failures++;
+		if (sp_measure_get_proc_data(&proc, SNAPSHOT_PROC_CPU, NULL) != 0 ||
+				FIELD_PROC_CPU_UTIME(&proc) != thread->cpu_utime) thread->failures++;
+	}
+	sp_measure_free_proc_data(&proc);
+	sp_measure_free_sys_data(&sys);
+	return NULL;
+}
+
+void check_ctx()
+{
+	sp_measure_ctx_t ctx1, ctx2;
+	sp_measure_sys_data_t sys1, sys2;
+	sp_measure_proc_data_t proc;
+	ctx_thread_t threads[2];
+	pthread_t ids[2];
+	int i, mem_used, failures = 0;
+
+	TEST_VALUE_INT(sp_measure_init_ctx(&ctx1), 0);
+	TEST_VALUE_INT(sp_measure_init_ctx(&ctx2), 0);
+	TEST_VALUE_INT(sp_measure_ctx_set_fs_root(&ctx1, "./rootfs1"), 0);
+	TEST_VALUE_INT(sp_measure_ctx_set_fs_root(&ctx2, "./rootfs2"), 0);
+
+	/* the contexts are sampled concurrently, while the default context
+	 * reads the real file system root */
+	threads[0].ctx = &ctx1;
+	threads[0].cpu_utime = 262287;
+	threads[1].ctx = &ctx2;
+	threads[1].cpu_utime = 262479;
+	TEST(sp_measure_init_sys_data(&sys1, SNAPSHOT_SYS_MEM, NULL) >= 0);
+	TEST(sp_measure_init_proc_data(&proc, getpid(), SNAPSHOT_PROC_CPU, NULL) == 0);
+	for (i = 0; i < 2; i++) {
+		threads[i].failures = 0;
+		TEST(pthread_create(&ids[i], NULL, ctx_thread, &threads[i]) == 0);
+	}
+	for (i = 0; i < 200; i++) {
+		if (sp_measure_get_sys_data(&sys1, SNAPSHOT_SYS_MEM, NULL) != 0 ||
+				FIELD_SYS_MEM_TOTAL(&sys1) == 3096748) failures++;
+		if (sp_measure_get_proc_data(&proc, SNAPSHOT_PROC_CPU, NULL) != 0) failures++;
+	}
+	TEST_VALUE_INT(failures, 0);
+	sp_measure_free_proc_data(&proc);
+	sp_measure_free_sys_data(&sys1);
+	for (i = 0; i < 2; i++) {
+		TEST(pthread_join(ids[i], NULL) == 0);
+		TEST_VALUE_INT(threads[i].failures, 0);
+	}
+
+	/* changing the root reopens the files of the context only */
+	TEST(sp_measure_init_sys_data_ctx(&ctx1, &sys1, SNAPSHOT_SYS_MEM | SNAPSHOT_SYS_MEM_CGROUPS, NULL) >= 0);
+	TEST(sp_measure_init_sys_data_ctx(&ctx2, &sys2, SNAPSHOT_SYS_MEM | SNAPSHOT_SYS_MEM_CGROUPS, NULL) >= 0);
+	TEST(sp_measure_get_sys_data(&sys2, SNAPSHOT_SYS_MEM, NULL) == 0);
+	mem_used = FIELD_SYS_MEM_USED(&sys2);
+	TEST(sp_measure_get_sys_data(&sys1, SNAPSHOT_SYS_MEM, NULL) == 0);
+	TEST(FIELD_SYS_MEM_USED(&sys1) != mem_used);
+	TEST_VALUE_INT(sp_measure_ctx_set_fs_root(&ctx1, "./rootfs2"), 0);
+	TEST(sp_measure_get_sys_data(&sys1, SNAPSHOT_SYS_MEM, NULL) == 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_USED(&sys1), mem_used);
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_get_sys_data(&sys2, SNAPSHOT_SYS_MEM, NULL) == 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_USED(&sys2), mem_used);
+	sp_measure_set_fs_root(NULL);
+
+	/* the cgroup is selected under the context root */
+	TEST_VALUE_STR(sp_measure_cgroup_select(&sys2, "applications"), "./rootfs2/syspart/applications");
+	TEST_VALUE_INT(sp_measure_get_sys_data(&sys2, SNAPSHOT_SYS_MEM_CGROUPS, NULL), 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_CGROUP(&sys2), 52224);
+	/* the hierarchy is scanned for nested groups */
+	TEST_VALUE_STR(sp_measure_cgroup_select(&sys2, "applic"), "./rootfs2/syspart/applications");
+
+	sp_measure_free_sys_data(&sys2);
+	sp_measure_free_sys_data(&sys1);
+	TEST(sp_measure_free_ctx(&ctx2) == 0);
+	TEST(sp_measure_free_ctx(&ctx1) == 0);
+}
+
+void check_history()
+{
+	sp_measure_history_t history;
+	int i, diff;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_history(&history, 0, SNAPSHOT_TEST_SYS, 0, 0) == -EINVAL);
+	TEST(sp_measure_init_history(&history, 4, SNAPSHOT_TEST_SYS, 25268, SNAPSHOT_TEST_PROC) == 0);
+	TEST_VALUE_INT(FIELD_HISTORY_COUNT(&history), 0);
+	TEST(sp_measure_history_sys(&history, 0) == NULL);
+	TEST(sp_measure_history_find(&history, 0) < 0);
+
+	/* overwrite the ring buffer a few times */
+	for (i = 0; i < 9; i++) {
+		TEST(sp_measure_history_push(&history) == 0);
+	}
+	TEST_VALUE_INT(FIELD_HISTORY_COUNT(&history), 4);
+	TEST(sp_measure_history_sys(&history, 4) == NULL);
+	TEST(sp_measure_history_sys(&history, -1) == NULL);
+	for (i = 1; i < 4; i++) {
+		TEST(sp_measure_history_sys(&history, i)->common == sp_measure_history_sys(&history, 0)->common);
+		TEST(sp_measure_history_sys(&history, i)->timestamp_ns <= sp_measure_history_sys(&history, i - 1)->timestamp_ns);
+	}
+	TEST(sp_measure_history_proc(&history, 3) != NULL);
+
+	sp_measure_set_fs_root("./rootfs2");
+	TEST(sp_measure_history_push(&history) == 0);
+	TEST_VALUE_INT(sp_measure_history_diff_sys(&history, 1, 0, sp_measure_diff_sys_cpu_ticks, &diff), 0);
+	TEST_VALUE_INT(diff, 302886);
+	TEST_VALUE_INT(sp_measure_history_diff_sys(&history, 2, 1, sp_measure_diff_sys_cpu_ticks, &diff), 0);
+	TEST_VALUE_INT(diff, 0);
+	TEST(sp_measure_history_diff_sys(&history, 4, 0, sp_measure_diff_sys_cpu_ticks, &diff) < 0);
+	/* process common paths were resolved at initialization */
+	TEST_VALUE_INT(sp_measure_history_diff_proc(&history, 3, 0, sp_measure_diff_proc_cpu_ticks, &diff), 0);
+	TEST_VALUE_INT(diff, 0);
+
+	/* the whole history is younger than an hour */
+	TEST_VALUE_INT(sp_measure_history_find(&history, 3600LL * 1000000000), 3);
+	TEST_VALUE_INT(sp_measure_history_find(&history, 0), 0);
+
+	sp_measure_set_fs_root(NULL);
+	TEST(sp_measure_free_history(&history) == 0);
+}
+
+#define RECORD_TEST_FILE             "test_record.spm"
+#define RECORD_TEST_COMPRESSED_FILE  "test_record_compressed.spm"
+#define RECORD_TEST_COUNT            1000
+
+void check_record()
+{
+	sp_measure_sys_data_t sys;
+	sp_measure_proc_data_t proc;
+	sp_measure_record_writer_t writer;
+	sp_measure_record_reader_t reader;
+	int resources = SNAPSHOT_TEST_SYS | SNAPSHOT_SYS_MEM_DETAILS;
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_sys_data(&sys, resources, NULL) == 0);
+	TEST(sp_measure_init_proc_data(&proc, 25268, SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	TEST(sp_measure_get_proc_data(&proc, SNAPSHOT_TEST_PROC, NULL) == 0);
+
+	TEST(sp_measure_record_writer_open(&writer, RECORD_TEST_FILE, &sys, resources, &proc, 1, SNAPSHOT_TEST_PROC, 0) == 0);
+	TEST(sp_measure_record_write(&writer, &sys, &proc) == 0);
+	sp_measure_set_fs_root("./rootfs2");
+	TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	TEST(sp_measure_record_write(&writer, &sys, &proc) == 0);
+	TEST(sp_measure_record_writer_close(&writer) == 0);
+
+	TEST(sp_measure_record_reader_open(&reader, RECORD_TEST_FILE) == 0);
+	TEST_VALUE_INT(FIELD_RECORD_COUNT(&reader), 2);
+	TEST_VALUE_INT(reader.header->mem_total, 3096748);
+	TEST_VALUE_INT(reader.header->freq_count, 5);
+	TEST_VALUE_INT(reader.header->cpu_core_count, 2);
+	TEST_VALUE_INT(FIELD_RECORD_PROC_COUNT(&reader), 1);
+	TEST_VALUE_INT(FIELD_RECORD_PROC(&reader, 0)->pid, 25268);
+	TEST(sp_measure_record_get(&reader, 2) == NULL);
+
+	int mem_free = sp_measure_record_find_field(&reader, "mem_free", -1);
+	int cpu_ticks = sp_measure_record_find_field(&reader, "cpu_ticks_total", -1);
+	int slab = sp_measure_record_find_field(&reader, "meminfo.Slab", -1);
+	int core = sp_measure_record_find_field(&reader, "cpu_core.1.total", -1);
+	int utime = sp_measure_record_find_field(&reader, "cpu_utime", 0);
+	TEST(mem_free >= 0 && cpu_ticks >= 0 && slab >= 0 && core >= 0 && utime >= 0);
+	TEST(sp_measure_record_find_field(&reader, "cpu_utime", -1) < 0);
+	TEST(sp_measure_record_find_field(&reader, "no_such_field", -1) < 0);
+
+	const void* record = sp_measure_record_get(&reader, 0);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, mem_free), 460588);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, cpu_ticks), 85277555);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, slab), 114980);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, core), 43362950);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, utime), FIELD_PROC_CPU_UTIME(&proc));
+	record = sp_measure_record_get(&reader, 1);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, mem_free), 426176);
+	TEST_VALUE_INT((int)sp_measure_record_value(&reader, record, cpu_ticks), 85580441);
+	size_t size = reader.size;
+	TEST(sp_measure_record_reader_close(&reader) == 0);
+
+	/* incomplete records are ignored and invalid files rejected */
+	TEST(truncate(RECORD_TEST_FILE, size - 1) == 0);
+	TEST(sp_measure_record_reader_open(&reader, RECORD_TEST_FILE) == 0);
+	TEST_VALUE_INT(FIELD_RECORD_COUNT(&reader), 1);
+	TEST(sp_measure_record_reader_close(&reader) == 0);
+	TEST(sp_measure_record_reader_open(&reader, "./rootfs1/proc/meminfo") < 0);
+	/* files of other format versions are rejected */
+	uint32_t version = 1;
+	int fd = open(RECORD_TEST_FILE, O_WRONLY);
+	TEST(fd != -1);
+	TEST(pwrite(fd, &version, sizeof(version), offsetof(sp_measure_record_header_t, version)) == sizeof(version));
+	close(fd);
+	TEST_VALUE_INT(sp_measure_record_reader_open(&reader, RECORD_TEST_FILE), -EINVAL);
+
+	/* write the same slowly changing data into plain and compressed files */
+	sp_measure_record_writer_t compressed_writer;
+	TEST(sp_measure_record_writer_open(&writer, RECORD_TEST_FILE, &sys, resources, &proc, 1, SNAPSHOT_TEST_PROC, 0) == 0);
+	TEST(sp_measure_record_writer_open(&compressed_writer, RECORD_TEST_COMPRESSED_FILE, &sys, resources, &proc, 1,
+			SNAPSHOT_TEST_PROC, SP_MEASURE_RECORD_COMPRESSED) == 0);
+	int i, j;
+	for (i = 0; i < RECORD_TEST_COUNT; i++) {
+		sys.timestamp_ns += 100000000 + (i % 7) * 1000;
+		sys.timestamp_boottime_ns = sys.timestamp_ns + 5000;
+		sys.mem_free += (i % 5) * 4 - 8;
+		sys.cpu_ticks_total += 10;
+		sys.cpu_ticks_idle += 10 - i % 3;
+		sys.cpu_ticks.user += i % 3;
+		sys.cpu_ticks.idle += 10 - i % 3;
+		sys.cpu_freq_ticks[i % sys.cpu_freq_ticks_count].ticks += 10;
+		for (j = 0; j < sys.cpu_core_count; j++) {
+			sys.cpu_core_ticks[j].total += 5;
+			sys.cpu_core_ticks[j].idle += 5 - (i + j) % 2;
+		}
+		if (i % 50 == 0) sys.mem_details[MEMINFO_DIRTY] = i * 4;
+		proc.timestamp_ns = sys.timestamp_ns + 20000;
+		proc.cpu_utime += i % 2;
+		TEST(sp_measure_record_write(&writer, &sys, &proc) == 0);
+		TEST(sp_measure_record_write(&compressed_writer, &sys, &proc) == 0);
+	}
+	TEST(sp_measure_record_writer_close(&writer) == 0);
+	TEST(sp_measure_record_writer_close(&compressed_writer) == 0);
+
+	sp_measure_record_reader_t compressed_reader;
+	TEST(sp_measure_record_reader_open(&reader, RECORD_TEST_FILE) == 0);
+	TEST(sp_measure_record_reader_open(&compressed_reader, RECORD_TEST_COMPRESSED_FILE) == 0);
+	TEST_VALUE_INT(FIELD_RECORD_COUNT(&compressed_reader), RECORD_TEST_COUNT);
+	for (i = 0; i < RECORD_TEST_COUNT; i++) {
+		const void* record = sp_measure_record_get(&compressed_reader, i);
+		TEST(record != NULL && memcmp(record, sp_measure_record_get(&reader, i), reader.header->record_size) == 0,
+				"\trecord %d differs after decoding\n", i);
+	}
+	/* blocks can be decoded in any order */
+	TEST(sp_measure_record_get(&compressed_reader, 0) != NULL);
+	int bytes = compressed_reader.size - compressed_reader.header->header_size;
+	int values = RECORD_TEST_COUNT * compressed_reader.header->field_count;
+	TEST(bytes * 10 < values * 20, "\tcompressed size %.2f bytes per value\n", (float)bytes / values);
+	TEST(sp_measure_record_reader_close(&reader) == 0);
+	TEST(sp_measure_record_reader_close(&compressed_reader) == 0);
+
+	/* a block which could not be written is dropped, so the following
+	 * records are buffered again from the start of the block */
+	TEST(sp_measure_record_writer_open(&compressed_writer, RECORD_TEST_COMPRESSED_FILE, &sys, resources, &proc, 1,
+			SNAPSHOT_TEST_PROC, SP_MEASURE_RECORD_COMPRESSED) == 0);
+	fd = open("/dev/full", O_WRONLY);
+	TEST(fd != -1 && dup2(fd, compressed_writer.fd) != -1);
+	close(fd);
+	for (i = 0; i < SP_MEASURE_RECORD_BLOCK_RECORDS - 1; i++) {
+		TEST(sp_measure_record_write(&compressed_writer, &sys, &proc) == 0);
+	}
+	TEST_VALUE_INT(sp_measure_record_write(&compressed_writer, &sys, &proc), -ENOSPC);
+	TEST_VALUE_INT(compressed_writer.pending, 0);
+	TEST(sp_measure_record_write(&compressed_writer, &sys, &proc) == 0);
+	TEST_VALUE_INT(compressed_writer.pending, 1);
+	TEST_VALUE_INT(sp_measure_record_writer_close(&compressed_writer), -ENOSPC);
+
+	unlink(RECORD_TEST_COMPRESSED_FILE);
+	unlink(RECORD_TEST_FILE);
+	sp_measure_set_fs_root(NULL);
+	sp_measure_free_proc_data(&proc);
+	sp_measure_free_sys_data(&sys);
+}
+
+void check_generated_rootfs()
+{
+	char root[] = "/tmp/sp-measure-test.XXXXXX";
+	sp_measure_sys_data_t sys;
+	sp_measure_proc_data_t smaps, rollup;
+	rootfs_gen_t config;
+
+	rootfs_gen_defaults(&config);
+	config.processes = 3;
+	config.mappings = 500;
+	config.cpus = 16;
+	config.policies = 4;
+	config.frequencies = 5;
+	TEST(mkdtemp(root) != NULL);
+	TEST_VALUE_INT(rootfs_gen_write(root, &config), 0);
+	sp_measure_set_fs_root(root);
+
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_SYS, NULL) == 0);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS, NULL) == 0);
+	TEST_VALUE_INT(FIELD_SYS_MEM_TOTAL(&sys), 16 * 2 * 1024 * 1024);
+	TEST_VALUE_INT(FIELD_SYS_CPU_CORE_COUNT(&sys), 16);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY_COUNT(&sys), 4);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY(&sys, 1)->id, 4);
+	TEST_VALUE_INT(FIELD_SYS_CPU_POLICY(&sys, 3)->max_freq, 3000000);
+
+	/* the generated smaps_rollup must match the smaps totals */
+	TEST(sp_measure_init_proc_data(&smaps, ROOTFS_GEN_PID_BASE + 1, SNAPSHOT_PROC, NULL) == 0);
+	TEST(sp_measure_get_proc_data(&smaps, SNAPSHOT_PROC, NULL) == 0);
+	TEST(sp_measure_init_proc_data(&rollup, ROOTFS_GEN_PID_BASE + 1, SNAPSHOT_PROC | SNAPSHOT_PROC_MEM_ROLLUP, NULL) == 0);
+	TEST(sp_measure_get_proc_data(&rollup, SNAPSHOT_PROC | SNAPSHOT_PROC_MEM_ROLLUP, NULL) == 0);
+	TEST(FIELD_PROC_MEM_RSS(&smaps) > 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(&rollup), FIELD_PROC_MEM_SIZE(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&rollup), FIELD_PROC_MEM_RSS(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(&rollup), FIELD_PROC_MEM_PSS(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PRIVATE_DIRTY(&rollup), FIELD_PROC_MEM_PRIVATE_DIRTY(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(&rollup), FIELD_PROC_MEM_SWAP(&smaps));
+
+	/* the generated statm and status files must match the smaps totals too */
+	if (sysconf(_SC_PAGESIZE) == 4096) {
+		TEST(sp_measure_get_proc_data(&rollup, SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS, NULL) == 0);
+		TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(&rollup), FIELD_PROC_MEM_SIZE(&smaps));
+		TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&rollup), FIELD_PROC_MEM_RSS(&smaps));
+	}
+	TEST(sp_measure_get_proc_data(&rollup, SNAPSHOT_PROC_MEM_RSS | SNAPSHOT_PROC_MEM_SWAP, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&rollup), FIELD_PROC_MEM_RSS(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_SWAP(&rollup), FIELD_PROC_MEM_SWAP(&smaps));
+	TEST_VALUE_INT(FIELD_PROC_MEM_PSS(&rollup), ESPMEASURE_UNDEFINED);
+
+	/* memory sizes exceeding INT_MAX kB are clamped */
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/proc/%d/statm", root, ROOTFS_GEN_PID_BASE + 1);
+	FILE* fp = fopen(path, "w");
+	TEST(fp != NULL);
+	fprintf(fp, "1000000000 1000 100 10 0 500 0\n");
+	fclose(fp);
+	TEST(sp_measure_get_proc_data(&rollup, SNAPSHOT_PROC_MEM_SIZE | SNAPSHOT_PROC_MEM_RSS, NULL) == 0);
+	TEST_VALUE_INT(FIELD_PROC_MEM_SIZE(&rollup), INT_MAX);
+	TEST_VALUE_INT(FIELD_PROC_MEM_RSS(&rollup), 1000 * (int)(sysconf(_SC_PAGESIZE) >> 10));
+
+	sp_measure_free_proc_data(&rollup);
+	sp_measure_free_proc_data(&smaps);
+	sp_measure_free_sys_data(&sys);
+	sp_measure_set_fs_root(NULL);
+	TEST_VALUE_INT(rootfs_gen_remove(root), 0);
+}
+
+void check_process_columns()
+{
+	sp_measure_proc_set_t set1, set2;
+	sp_measure_proc_columns_t columns1, columns2, columns3;
+	/* the second process does not exist in the fake rootfs */
+	int pids[] = {25268, 25269, 25268};
+	int64_t* diff;
+	int64_t sum;
+
+	/* the sets read the files of the rootfs they were initialized in */
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_proc_set(&set1, pids, 3, SNAPSHOT_TEST_PROC, NULL) == 0);
+	sp_measure_set_fs_root("./rootfs2");
+	TEST(sp_measure_init_proc_set(&set2, pids, 3, SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set1, SNAPSHOT_TEST_PROC), 1);
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set2, SNAPSHOT_TEST_PROC), 1);
+
+	TEST(sp_measure_init_proc_columns(&columns1, 3) == 0);
+	TEST(sp_measure_init_proc_columns(&columns2, 3) == 0);
+	TEST(sp_measure_init_proc_columns(&columns3, 2) == 0);
+	TEST_VALUE_INT(columns1.capacity, 8);
+	TEST(((uintptr_t)columns1.columns[PROC_COLUMN_MEM_PSS] % SP_MEASURE_COLUMN_ALIGNMENT) == 0);
+	TEST(sp_measure_get_proc_columns(&columns1, &set1) == 0);
+	TEST(sp_measure_get_proc_columns(&columns2, &set2) == 0);
+	TEST(sp_measure_get_proc_columns(&columns3, &set1) == -EINVAL);
+
+	TEST(columns1.columns[PROC_COLUMN_PID][1] == 25269);
+	TEST(columns1.columns[PROC_COLUMN_CPU_UTIME][0] == 262287);
+	TEST(columns1.columns[PROC_COLUMN_CPU_UTIME][1] == SP_MEASURE_COLUMN_UNDEFINED);
+	TEST(columns1.columns[PROC_COLUMN_CPU_TICKS][2] ==
+			FIELD_PROC_CPU_UTIME(FIELD_PROC_SET_DATA(&set1, 2)) + FIELD_PROC_CPU_STIME(FIELD_PROC_SET_DATA(&set1, 2)));
+	TEST(columns1.columns[PROC_COLUMN_MEM_PSS][2] == 110781);
+	TEST(columns2.columns[PROC_COLUMN_MEM_PSS][2] == 112140);
+
+	/* column differences */
+	TEST((diff = sp_measure_alloc_column(3)) != NULL);
+	TEST(sp_measure_diff_proc_columns(&columns1, &columns2, PROC_COLUMN_CPU_UTIME, diff) == 0);
+	TEST(diff[0] == 262479 - 262287);
+	TEST(diff[1] == SP_MEASURE_COLUMN_UNDEFINED);
+	TEST(diff[2] == diff[0]);
+	TEST(sp_measure_diff_proc_columns(&columns1, &columns3, PROC_COLUMN_CPU_UTIME, diff) == -EINVAL);
+	TEST(sp_measure_diff_proc_columns(&columns1, &columns2, PROC_COLUMN_COUNT, diff) == -EINVAL);
+	TEST_VALUE_INT(sp_measure_column_sum(diff, 3, &sum), 2);
+	TEST(sum == 2 * (262479 - 262287));
+	TEST_VALUE_INT(sp_measure_column_max(diff, 3), 0);
+	sp_measure_free_column(diff);
+
+	sp_measure_set_fs_root(NULL);
+	TEST(sp_measure_free_proc_columns(&columns3) == 0);
+	TEST(sp_measure_free_proc_columns(&columns2) == 0);
+	TEST(sp_measure_free_proc_columns(&columns1) == 0);
+	TEST(sp_measure_free_proc_set(&set2) == 0);
+	TEST(sp_measure_free_proc_set(&set1) == 0);
+}
+
+void check_column_kernels()
+{
+	const int64_t U = SP_MEASURE_COLUMN_UNDEFINED;
+	const int64_t values1[] = {10, 20, U, 40, 50, 60, 70, 80, 90, 100};
+	const int64_t values2[] = {15, 20, 30, U, 45, 90, 70, 120, 95, 105};
+	int64_t diff[ARRAY_SIZE(values1)], sum;
+	int top[ARRAY_SIZE(values1)];
+
+	sp_measure_column_diff(values1, values2, diff, ARRAY_SIZE(values1));
+	TEST(diff[0] == 5 && diff[1] == 0 && diff[4] == -5 && diff[5] == 30 && diff[7] == 40);
+	TEST(diff[2] == U && diff[3] == U);
+
+	TEST_VALUE_INT(sp_measure_column_sum(diff, ARRAY_SIZE(diff), &sum), 8);
+	TEST(sum == 5 + 0 - 5 + 30 + 0 + 40 + 5 + 5);
+	TEST_VALUE_INT(sp_measure_column_max(diff, ARRAY_SIZE(diff)), 7);
+	TEST_VALUE_INT(sp_measure_column_max(diff + 2, 2), -1);
+
+	/* ties are ranked by ascending index */
+	TEST_VALUE_INT(sp_measure_column_top(diff, ARRAY_SIZE(diff), top, 4), 4);
+	TEST(top[0] == 7 && top[1] == 5 && top[2] == 0 && top[3] == 8);
+	/* the undefined values are never returned */
+	TEST_VALUE_INT(sp_measure_column_top(diff, ARRAY_SIZE(diff), top, ARRAY_SIZE(top)), 8);
+	TEST(top[4] == 9 && top[5] == 1 && top[6] == 6 && top[7] == 4);
+	TEST_VALUE_INT(sp_measure_column_top(diff, ARRAY_SIZE(diff), top, 0), 0);
+
+	/* in-place difference */
+	memcpy(diff, values2, sizeof(diff));
+	sp_measure_column_diff(values1, diff, diff, ARRAY_SIZE(diff));
+	TEST(diff[7] == 40 && diff[3] == U);
+}
+
+void check_stats()
+{
+	sp_measure_stats_t stats1, stats2;
+	sp_measure_sys_data_t sys;
+	sp_measure_proc_data_t proc;
+	sp_measure_proc_set_t set;
+	int pids[] = {25268, 25268, 25268, 25268, 25268, 25268};
+
+	sp_measure_set_fs_root("./rootfs1");
+	TEST(sp_measure_init_sys_data(&sys, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(sp_measure_init_proc_data(&proc, 25268, SNAPSHOT_TEST_PROC, NULL) == 0);
+
+	/* the statistics are disabled by default */
+	TEST_VALUE_INT(sp_measure_stats_enable(1), 0);
+	TEST(sp_measure_stats_get(&stats1) == 0);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(sp_measure_get_proc_data(&proc, SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST(sp_measure_stats_get(&stats2) == 0);
+
+	TEST(stats2.sys_total.calls - stats1.sys_total.calls == 1);
+	TEST(stats2.sys_total.wall_ns > stats1.sys_total.wall_ns);
+	TEST(stats2.sys_total.cpu_ns >= stats1.sys_total.cpu_ns);
+	/* /proc/meminfo of the fake rootfs is 1164 bytes */
+	TEST(FIELD_STATS_SYS(&stats2, SNAPSHOT_SYS_MEM_USAGE)->calls - FIELD_STATS_SYS(&stats1, SNAPSHOT_SYS_MEM_USAGE)->calls == 1);
+	TEST(FIELD_STATS_SYS(&stats2, SNAPSHOT_SYS_MEM_USAGE)->bytes_read -
+			FIELD_STATS_SYS(&stats1, SNAPSHOT_SYS_MEM_USAGE)->bytes_read == 1164);
+	TEST(FIELD_STATS_SYS(&stats2, SNAPSHOT_SYS_MEM_WATERMARK)->syscalls > FIELD_STATS_SYS(&stats1, SNAPSHOT_SYS_MEM_WATERMARK)->syscalls);
+	TEST(stats2.sys_total.failures == stats1.sys_total.failures);
+	/* /proc/<pid>/stat of the fake rootfs is 231 bytes */
+	TEST(FIELD_STATS_PROC(&stats2, SNAPSHOT_PROC_CPU_USAGE)->bytes_read -
+			FIELD_STATS_PROC(&stats1, SNAPSHOT_PROC_CPU_USAGE)->bytes_read == 231);
+	TEST(FIELD_STATS_PROC(&stats2, SNAPSHOT_PROC_CPU_USAGE)->files_opened -
+			FIELD_STATS_PROC(&stats1, SNAPSHOT_PROC_CPU_USAGE)->files_opened == 1);
+	TEST(FIELD_STATS_PROC(&stats2, SNAPSHOT_PROC_MEM_USAGE)->bytes_read > FIELD_STATS_PROC(&stats1, SNAPSHOT_PROC_MEM_USAGE)->bytes_read);
+	TEST(stats2.proc_total.calls - stats1.proc_total.calls == 1);
+
+	/* the cgroup is not available in the fake rootfs */
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_SYS_MEM_CGROUPS, NULL) == SNAPSHOT_SYS_MEM_CGROUPS);
+	TEST(sp_measure_stats_get(&stats1) == 0);
+	TEST(FIELD_STATS_SYS(&stats1, SNAPSHOT_SYS_MEM_CGROUPS)->failures - FIELD_STATS_SYS(&stats2, SNAPSHOT_SYS_MEM_CGROUPS)->failures == 1);
+
+	/* the worker thread counters are included */
+	TEST(sp_measure_init_proc_set(&set, pids, ARRAY_SIZE(pids), SNAPSHOT_TEST_PROC, NULL) == 0);
+	TEST_VALUE_INT(sp_measure_proc_set_workers(&set, 3), 3);
+	TEST_VALUE_INT(sp_measure_get_proc_set_data(&set, SNAPSHOT_TEST_PROC), 0);
+	TEST(sp_measure_free_proc_set(&set) == 0);
+	TEST(sp_measure_stats_get(&stats2) == 0);
+	TEST(stats2.proc_total.calls - stats1.proc_total.calls == ARRAY_SIZE(pids));
+
+	/* disabled statistics are not updated */
+	TEST_VALUE_INT(sp_measure_stats_enable(0), 1);
+	TEST(sp_measure_get_sys_data(&sys, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(sp_measure_stats_get(&stats1) == 0);
+	TEST(stats2.sys_total.calls == stats1.sys_total.calls);
+
+	sp_measure_set_fs_root(NULL);
+	sp_measure_free_proc_data(&proc);
+	sp_measure_free_sys_data(&sys);
+}
+
 int main() 
 {
 	check_system_api();
 	
+	check_cpu_freq_diff();
+
 	check_process_api();
 
+	check_smaps_parser();
+
+	check_mem_fields();
+
+	check_process_set_api();
+
+	check_process_set_workers();
+
+	check_schedule();
+
+	check_sampler();
+
+	check_notify();
+
+	check_cgroup_set();
+
+	check_ctx();
+
+	check_history();
+
+	check_record();
+
+	check_generated_rootfs();
+
+	check_stats();
+
+	check_process_columns();
+
+	check_column_kernels();
+
 	return 0;
 }
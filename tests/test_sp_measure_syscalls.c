@@ -0,0 +1,280 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * System call usage tests.
+ *
+ * Checks that the system snapshots keep their source files open and
+ * re-read them with a single pread() call per file instead of
+ * opening and closing them on every snapshot, and that the snapshots
+ * don't allocate memory once the snapshot structures are initialized.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sp_measure.h>
+
+#include "syscall_count.h"
+
+#define TEST(expression, ...) if (!(expression)) {fprintf(stderr, "[failure] " #expression "\n" __VA_ARGS__ ); exit(-1);}
+
+#define TEST_VALUE_INT(expression, value)	TEST(expression == value, "\t" #expression "=%d\n", expression)
+
+#define SNAPSHOT_TEST_SYS  (SNAPSHOT_SYS | SNAPSHOT_SYS_MEM_WATERMARK)
+
+/* number of files read by SNAPSHOT_TEST_SYS snapshot:
+ * meminfo, stat, time_in_state, low_watermark, high_watermark
+ * and time_in_state of the two cpufreq policies */
+#define SNAPSHOT_TEST_SYS_FILES		7
+
+/* number of snapshots taken in the steady state test */
+#define SNAPSHOT_COUNT			100
+
+
+void check_system_syscalls()
+{
+	sp_measure_sys_data_t data1, data2;
+	int i;
+
+	sp_measure_set_fs_root("./rootfs1");
+
+	TEST(sp_measure_init_sys_data(&data1, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(sp_measure_init_sys_data(&data2, 0, &data1) == 0);
+
+	/* the first snapshot opens the files */
+	syscall_count_reset();
+	TEST(sp_measure_get_sys_data(&data1, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(syscall_count.open <= SNAPSHOT_TEST_SYS_FILES, "\topen=%d\n", syscall_count.open);
+	TEST_VALUE_INT(syscall_count.close, 0);
+
+	/* the following snapshots only read them */
+	syscall_count_reset();
+	for (i = 0; i < SNAPSHOT_COUNT; i++) {
+		TEST(sp_measure_get_sys_data(i & 1 ? &data1 : &data2, SNAPSHOT_TEST_SYS, NULL) == 0);
+	}
+	TEST_VALUE_INT(syscall_count.open, 0);
+	TEST_VALUE_INT(syscall_count.close, 0);
+	TEST_VALUE_INT(syscall_count.read, SNAPSHOT_COUNT * SNAPSHOT_TEST_SYS_FILES);
+	TEST_VALUE_INT(data2.mem_free, 460588);
+	TEST_VALUE_INT(data2.cpu_ticks_total, 85277555);
+
+	/* changing the file system root reopens the files */
+	sp_measure_set_fs_root("./rootfs2");
+	syscall_count_reset();
+	TEST(sp_measure_get_sys_data(&data2, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST_VALUE_INT(syscall_count.open, SNAPSHOT_TEST_SYS_FILES);
+	TEST_VALUE_INT(syscall_count.close, SNAPSHOT_TEST_SYS_FILES);
+	TEST_VALUE_INT(data2.mem_free, 426176);
+	TEST_VALUE_INT(data2.cpu_ticks_total, 85580441);
+
+	sp_measure_set_fs_root(NULL);
+
+	/* the files are closed when the common data is released */
+	syscall_count_reset();
+	TEST(sp_measure_free_sys_data(&data1) == 0);
+	TEST(sp_measure_free_sys_data(&data2) == 0);
+	TEST_VALUE_INT(syscall_count.close, SNAPSHOT_TEST_SYS_FILES);
+}
+
+void check_steady_state_allocations()
+{
+	sp_measure_sys_data_t sys1, sys2;
+	sp_measure_proc_data_t proc1, proc2;
+	char name[32], long_name[SP_MEASURE_NAME_SIZE * 2];
+	int i;
+
+	sp_measure_set_fs_root("./rootfs1");
+
+	TEST(sp_measure_init_sys_data(&sys1, SNAPSHOT_TEST_SYS, NULL) == 0);
+	TEST(sp_measure_init_sys_data(&sys2, 0, &sys1) == 0);
+	TEST(sp_measure_init_proc_data(&proc1, 25268, SNAPSHOT_PROC, NULL) == 0);
+	TEST(sp_measure_init_proc_data(&proc2, 0, 0, &proc1) == 0);
+
+	/* the snapshot tables are sized during initialization */
+	syscall_count_reset();
+	for (i = 0; i < SNAPSHOT_COUNT; i++) {
+		snprintf(name, sizeof(name), "snapshot%d", i);
+		TEST(sp_measure_get_sys_data(i & 1 ? &sys1 : &sys2, SNAPSHOT_TEST_SYS | SNAPSHOT_SYS_CPU_CORE_USAGE, name) == 0);
+		TEST(sp_measure_get_proc_data(i & 1 ? &proc1 : &proc2, SNAPSHOT_PROC, name) == 0);
+	}
+	TEST_VALUE_INT(syscall_count.alloc, 0);
+	TEST(!strcmp(sys1.name, "snapshot99"));
+	TEST(!strcmp(proc2.name, "snapshot98"));
+	TEST_VALUE_INT(sys1.cpu_freq_ticks_count, 5);
+	TEST_VALUE_INT(sys1.cpu_policy_freq_ticks[1].freq_ticks_count, 4);
+
+	/* too long names are truncated */
+	memset(long_name, 'x', sizeof(long_name) - 1);
+	long_name[sizeof(long_name) - 1] = '\0';
+	TEST(sp_measure_get_sys_data(&sys1, 0, long_name) == 0);
+	TEST_VALUE_INT((int)strlen(sys1.name), SP_MEASURE_NAME_SIZE - 1);
+	TEST(!strncmp(sys1.name, long_name, SP_MEASURE_NAME_SIZE - 1));
+
+	sp_measure_set_fs_root(NULL);
+
+	TEST(sp_measure_free_proc_data(&proc1) == 0);
+	TEST(sp_measure_free_proc_data(&proc2) == 0);
+	TEST(sp_measure_free_sys_data(&sys1) == 0);
+	TEST(sp_measure_free_sys_data(&sys2) == 0);
+}
+
+/**
+ * Writes file into the test rootfs, creating its directory if necessary.
+ *
+ * @param[in] root     the rootfs directory.
+ * @param[in] path     the file path relative to the rootfs.
+ * @param[in] content  the file content.
+ */
+static void write_rootfs_file(const char* root, const char* path, const char* content)
+{
+	char command[4352];
+	const char* name = strrchr(path, '/');
+	snprintf(command, sizeof(command), "mkdir -p %s%.*s && printf '%s' > %s%s", root, (int)(name - path), path,
+			content, root, path);
+	TEST(system(command) == 0);
+}
+
+/**
+ * Writes time_in_state file with the specified number of frequencies.
+ */
+static void write_time_in_state(const char* root, int count)
+{
+	char content[4096];
+	int i, size = 0;
+	for (i = 0; i < count; i++) {
+		size += snprintf(content + size, sizeof(content) - size, "%d %d\\n", (i + 1) * 100000, i * 10);
+	}
+	write_rootfs_file(root, "/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state", content);
+}
+
+void check_table_growth()
+{
+	static const char* stat_1 = "cpu  10 0 10 100 0 0 0 0 0 0\\ncpu0 10 0 10 100 0 0 0 0 0 0\\n";
+	static const char* stat_4 = "cpu  40 0 40 400 0 0 0 0 0 0\\ncpu0 10 0 10 100 0 0 0 0 0 0\\n"
+			"cpu1 10 0 10 100 0 0 0 0 0 0\\ncpu2 10 0 10 100 0 0 0 0 0 0\\ncpu3 10 0 10 100 0 0 0 0 0 0\\n";
+	const int resources = SNAPSHOT_SYS_CPU_USAGE | SNAPSHOT_SYS_CPU_CORE_USAGE | SNAPSHOT_SYS_CPU_FREQ;
+	sp_measure_sys_data_t sys;
+	char root[] = "/tmp/sp-measure-syscalls.XXXXXX";
+	char command[64];
+	int i;
+
+	TEST(mkdtemp(root) != NULL);
+	write_rootfs_file(root, "/proc/stat", stat_1);
+	write_rootfs_file(root, "/sys/devices/system/cpu/possible", "0\\n");
+	write_time_in_state(root, 2);
+	sp_measure_set_fs_root(root);
+	TEST(sp_measure_init_sys_data(&sys, resources, NULL) >= 0);
+	TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	TEST_VALUE_INT(sys.cpu_freq_ticks_count, 2);
+	TEST_VALUE_INT(sys.cpu_core_count, 1);
+
+	/* the tables preallocated during initialization are grown once,
+	 * the following snapshots reuse the grown tables */
+	write_rootfs_file(root, "/proc/stat", stat_4);
+	write_time_in_state(root, 40);
+	syscall_count_reset();
+	TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	TEST(syscall_count.alloc > 0);
+	TEST_VALUE_INT(sys.cpu_freq_ticks_count, 40);
+	TEST_VALUE_INT(sys.cpu_core_count, 4);
+	syscall_count_reset();
+	for (i = 0; i < SNAPSHOT_COUNT; i++) {
+		TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	}
+	TEST_VALUE_INT(syscall_count.alloc, 0);
+
+	/* allocation failures are reported as errors, not as failed resources */
+	write_time_in_state(root, 100);
+	syscall_count.fail_realloc = 1;
+	TEST_VALUE_INT(sp_measure_get_sys_data(&sys, resources, NULL), -ENOMEM);
+	syscall_count.fail_realloc = 0;
+	TEST(sp_measure_get_sys_data(&sys, resources, NULL) == 0);
+	TEST_VALUE_INT(sys.cpu_freq_ticks_count, 100);
+
+	sp_measure_set_fs_root(NULL);
+	TEST(sp_measure_free_sys_data(&sys) == 0);
+	snprintf(command, sizeof(command), "rm -rf %s", root);
+	TEST(system(command) == 0);
+}
+
+void check_worker_pool_failure()
+{
+	static const int pids[] = {25268};
+	sp_measure_proc_set_t set;
+	TEST(sp_measure_init_proc_set(&set, pids, 1, SNAPSHOT_PROC, NULL) == 0);
+
+	/* the third worker thread fails to start, all worker buffers
+	 * must be released */
+	syscall_count_reset();
+	syscall_count.fail_thread = 2;
+	TEST(sp_measure_proc_set_workers(&set, 5) < 0);
+	TEST_VALUE_INT(syscall_count.thread, 3);
+	TEST_VALUE_INT(syscall_count.free, syscall_count.alloc);
+	syscall_count.fail_thread = 0;
+
+	syscall_count_reset();
+	TEST_VALUE_INT(sp_measure_proc_set_workers(&set, 5), 5);
+	TEST_VALUE_INT(sp_measure_proc_set_workers(&set, 1), 1);
+	TEST_VALUE_INT(syscall_count.thread, 4);
+	TEST_VALUE_INT(syscall_count.free, syscall_count.alloc);
+
+	TEST(sp_measure_free_proc_set(&set) == 0);
+}
+
+void check_sampler_init_failure()
+{
+	static const int pids[] = {25268};
+	sp_measure_sampler_t sampler;
+	int i, rc;
+
+	/* fail every allocation made by the initialization in turn, the
+	 * partially initialized sampler must release all its memory */
+	sp_measure_set_fs_root("./rootfs1");
+	for (i = 1; ; i++) {
+		syscall_count_reset();
+		syscall_count.fail_alloc = i;
+		rc = sp_measure_init_sampler(&sampler, 4, 100000000LL, SNAPSHOT_TEST_SYS, pids, 1, SNAPSHOT_PROC);
+		syscall_count.fail_alloc = 0;
+		if (rc >= 0) break;
+		TEST(syscall_count.free == syscall_count.alloc, "\tallocation %d: free=%d alloc=%d\n", i,
+				syscall_count.free, syscall_count.alloc);
+	}
+	TEST(i > 1);
+	TEST(sp_measure_free_sampler(&sampler) == 0);
+	TEST(syscall_count.free == syscall_count.alloc, "\tfree=%d alloc=%d\n", syscall_count.free, syscall_count.alloc);
+	sp_measure_set_fs_root(NULL);
+}
+
+int main()
+{
+	check_system_syscalls();
+	check_steady_state_allocations();
+	check_table_growth();
+	check_worker_pool_failure();
+	check_sampler_init_failure();
+
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*
+ * This file is a part of sp-measure library.
+ *
+ * Copyright (C) 2012 by Nokia Corporation
+ *
+ * Contact: Eero Tamminen <eero.tamminen@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ */
+
+/**
+ * Captures the /proc and /sys files read by sp-measure library into
+ * a sequence of rootfs directories (<output>/rootfs1, <output>/rootfs2 ...)
+ * at a fixed interval. The captured directories can be replayed through
+ * the library with sp_measure_set_fs_root() function.
+ *
+ * Usage: sp-measure-capture [options] [<pid> ...]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <limits.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+/* the initial file copy buffer size */
+#define CAPTURE_BUFFER_SIZE	(64 * 1024)
+
+/* the system files read by the library */
+static const char* sys_files[] = {
+	"/proc/meminfo",
+	"/proc/stat",
+	"/sys/devices/system/cpu/possible",
+	"/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq",
+	"/sys/devices/system/cpu/cpu0/cpufreq/stats/time_in_state",
+	"/sys/kernel/low_watermark",
+	"/sys/kernel/high_watermark",
+	"/syspart/memory.memsw.usage_in_bytes",
+	"/sys/fs/cgroup/cpu.stat",
+	"/sys/fs/cgroup/io.stat",
+	"/sys/fs/cgroup/memory.stat",
+};
+
+/* the cgroup v2 files, relative to the group directory */
+static const char* cgroup_files[] = {
+	"memory.current",
+	"memory.swap.current",
+	"memory.stat",
+	"cpu.stat",
+	"io.stat",
+};
+
+/* the maximum number of captured cgroups */
+#define CAPTURE_MAX_CGROUPS	32
+
+/* the cpu frequency policy files, relative to the policy directory */
+static const char* policy_files[] = {
+	"cpuinfo_max_freq",
+	"stats/time_in_state",
+};
+
+/* the process files read by the library */
+static const char* proc_files[] = {
+	"cmdline",
+	"stat",
+	"status",
+	"statm",
+	"smaps",
+	"smaps_rollup",
+};
+
+/* the capture options */
+static const char* source_root = "";
+static const char* output_dir = ".";
+static const char* cgroups[CAPTURE_MAX_CGROUPS];
+static int cgroup_count = 0;
+static int interval_ms = 1000;
+static int samples = 0;
+static int all_processes = 0;
+
+/* the file copy buffer */
+static char* buffer = NULL;
+static size_t buffer_size = 0;
+
+static volatile sig_atomic_t terminated = 0;
+
+static void on_signal(int sig)
+{
+	terminated = 1;
+}
+
+/**
+ * Creates directory together with its parent directories.
+ *
+ * @param[in] path   the directory path.
+ * @return           0 for success.
+ */
+static int make_dirs(const char* path)
+{
+	char dir[PATH_MAX];
+	char* ptr;
+	snprintf(dir, sizeof(dir), "%s", path);
+	for (ptr = dir + 1; *ptr; ptr++) {
+		if (*ptr == '/') {
+			*ptr = '\0';
+			if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+			*ptr = '/';
+		}
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) return -1;
+	return 0;
+}
+
+/**
+ * Copies file from the source root into the snapshot directory.
+ *
+ * /proc and /sys files report zero size, so the file is read until
+ * end of file into a growing buffer and then written at once.
+ * @param[in] root   the snapshot directory.
+ * @param[in] path   the file path relative to the root directories.
+ * @return           0 for success, -1 if the file does not exist or
+ *                   could not be copied.
+ */
+static int copy_file(const char* root, const char* path)
+{
+	char name[PATH_MAX];
+	size_t size = 0;
+	ssize_t n;
+
+	snprintf(name, sizeof(name), "%s%s", source_root, path);
+	int fd = open(name, O_RDONLY);
+	if (fd == -1) return -1;
+	while (1) {
+		if (size == buffer_size) {
+			size_t new_size = buffer_size ? buffer_size * 2 : CAPTURE_BUFFER_SIZE;
+			char* data = (char*)realloc(buffer, new_size);
+			if (data == NULL) {
+				close(fd);
+				return -1;
+			}
+			buffer = data;
+			buffer_size = new_size;
+		}
+		n = read(fd, buffer + size, buffer_size - size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		size += n;
+	}
+	close(fd);
+	if (n < 0) return -1;
+
+	snprintf(name, sizeof(name), "%s%s", root, path);
+	char* slash = strrchr(name, '/');
+	*slash = '\0';
+	if (make_dirs(name) != 0) return -1;
+	*slash = '/';
+
+	fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) return -1;
+	const char* ptr = buffer;
+	while (size) {
+		n = write(fd, ptr, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		ptr += n;
+		size -= n;
+	}
+	close(fd);
+	return size ? -1 : 0;
+}
+
+/**
+ * Copies the cpu frequency policy files.
+ *
+ * @param[in] root   the snapshot directory.
+ */
+static void copy_policies(const char* root)
+{
+	char path[PATH_MAX];
+	struct dirent* entry;
+	unsigned i;
+	int id;
+
+	snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpufreq", source_root);
+	DIR* dir = opendir(path);
+	if (dir == NULL) return;
+	while ( (entry = readdir(dir)) ) {
+		if (sscanf(entry->d_name, "policy%d", &id) != 1) continue;
+		for (i = 0; i < sizeof(policy_files) / sizeof(policy_files[0]); i++) {
+			snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpufreq/policy%d/%s", id, policy_files[i]);
+			copy_file(root, path);
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * Copies the cgroup files of both the v1 /syspart memory hierarchy and
+ * the v2 unified hierarchy.
+ *
+ * @param[in] root   the snapshot directory.
+ * @param[in] name   the group path relative to the hierarchy roots.
+ */
+static void copy_cgroup(const char* root, const char* name)
+{
+	char path[PATH_MAX];
+	unsigned i;
+	snprintf(path, sizeof(path), "/syspart/%s/memory.memsw.usage_in_bytes", name);
+	copy_file(root, path);
+	for (i = 0; i < sizeof(cgroup_files) / sizeof(cgroup_files[0]); i++) {
+		snprintf(path, sizeof(path), "/sys/fs/cgroup/%s/%s", name, cgroup_files[i]);
+		copy_file(root, path);
+	}
+}
+
+/**
+ * Copies the process files.
+ *
+ * @param[in] root   the snapshot directory.
+ * @param[in] pid    the process id.
+ */
+static void copy_process(const char* root, int pid)
+{
+	char path[PATH_MAX];
+	unsigned i;
+	for (i = 0; i < sizeof(proc_files) / sizeof(proc_files[0]); i++) {
+		snprintf(path, sizeof(path), "/proc/%d/%s", pid, proc_files[i]);
+		copy_file(root, path);
+	}
+}
+
+/**
+ * Copies the files of all running processes.
+ *
+ * @param[in] root   the snapshot directory.
+ */
+static void copy_all_processes(const char* root)
+{
+	char path[PATH_MAX];
+	struct dirent* entry;
+	int pid;
+
+	snprintf(path, sizeof(path), "%s/proc", source_root);
+	DIR* dir = opendir(path);
+	if (dir == NULL) return;
+	while ( (entry = readdir(dir)) ) {
+		char* end;
+		pid = strtol(entry->d_name, &end, 10);
+		if (*end || pid <= 0) continue;
+		copy_process(root, pid);
+	}
+	closedir(dir);
+}
+
+/**
+ * Captures a single snapshot.
+ *
+ * @param[in] index  the snapshot index.
+ * @param[in] pids   the processes to capture.
+ * @param[in] count  the number of processes.
+ * @return           0 for success.
+ */
+static int capture(int index, const int* pids, int count)
+{
+	char root[PATH_MAX];
+	unsigned i;
+
+	snprintf(root, sizeof(root), "%s/rootfs%d", output_dir, index);
+	if (make_dirs(root) != 0) {
+		fprintf(stderr, "Failed to create directory %s: %s\n", root, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < sizeof(sys_files) / sizeof(sys_files[0]); i++) {
+		copy_file(root, sys_files[i]);
+	}
+	for (i = 0; i < (unsigned)cgroup_count; i++) {
+		copy_cgroup(root, cgroups[i]);
+	}
+	copy_policies(root);
+	if (all_processes) {
+		copy_all_processes(root);
+	}
+	for (i = 0; i < (unsigned)count; i++) {
+		copy_process(root, pids[i]);
+	}
+	return 0;
+}
+
+static void usage(const char* name)
+{
+	printf("Usage: %s [options] [<pid> ...]\n"
+			"Captures the files read by sp-measure library into <output>/rootfs<N>\n"
+			"directories, N starting from 1.\n"
+			"Options:\n"
+			"  -i <ms>      the capture interval in milliseconds (default 1000).\n"
+			"  -n <count>   the number of snapshots to capture (default until interrupted).\n"
+			"  -o <dir>     the output directory (default current directory).\n"
+			"  -a           capture all processes.\n"
+			"  -g <group>   capture also the specified /syspart and /sys/fs/cgroup cgroup.\n"
+			"               Can be specified up to %d times.\n"
+			"  -r <dir>     the source root directory (default /).\n"
+			"  -h           this help.\n", name, CAPTURE_MAX_CGROUPS);
+}
+
+int main(int argc, char* argv[])
+{
+	struct timespec next;
+	int opt, i, index;
+
+	while ( (opt = getopt(argc, argv, "i:n:o:ag:r:h")) != -1) {
+		switch (opt) {
+			case 'i':
+				interval_ms = atoi(optarg);
+				break;
+			case 'n':
+				samples = atoi(optarg);
+				break;
+			case 'o':
+				output_dir = optarg;
+				break;
+			case 'a':
+				all_processes = 1;
+				break;
+			case 'g':
+				if (cgroup_count == CAPTURE_MAX_CGROUPS) {
+					fprintf(stderr, "Too many cgroups, at most %d can be captured\n", CAPTURE_MAX_CGROUPS);
+					return -1;
+				}
+				cgroups[cgroup_count++] = optarg;
+				break;
+			case 'r':
+				source_root = optarg;
+				break;
+			case 'h':
+				usage(argv[0]);
+				return 0;
+			default:
+				usage(argv[0]);
+				return -1;
+		}
+	}
+	if (interval_ms <= 0 || samples < 0) {
+		usage(argv[0]);
+		return -1;
+	}
+	int count = argc - optind;
+	int* pids = (int*)malloc(sizeof(int) * (count ? count : 1));
+	if (pids == NULL) return -1;
+	for (i = 0; i < count; i++) {
+		pids[i] = atoi(argv[optind + i]);
+		if (pids[i] <= 0) {
+			fprintf(stderr, "Invalid process id: %s\n", argv[optind + i]);
+			return -1;
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	/* the snapshots are taken at absolute deadlines, so the capture
+	 * time does not accumulate into the interval */
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	for (index = 1; !terminated && (samples == 0 || index <= samples); index++) {
+		if (capture(index, pids, count) != 0) break;
+		if (samples && index == samples) break;
+		next.tv_nsec += (long)(interval_ms % 1000) * 1000000;
+		next.tv_sec += interval_ms / 1000 + next.tv_nsec / 1000000000;
+		next.tv_nsec %= 1000000000;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !terminated) ;
+	}
+	free(pids);
+	free(buffer);
+	return 0;
+}